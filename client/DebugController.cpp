@@ -7,6 +7,7 @@
 
 #include "client/DebugEvents.h"
 #include "client/Game.h"
+#include "client/GameClient.h"
 #include "common/log.h"
 #include "client/RenderEngine.h"
 
@@ -88,12 +89,50 @@ void DebugController::Render()
 	ImGui::NewFrame();
 	bool showWindow = true;
 	ImGui::ShowDemoWindow(&showWindow);
+	RenderNetworkWindow();
 
 	ImGui::Render();
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
 }
 
+void DebugController::RenderNetworkWindow()
+{
+	auto toMs = [](std::chrono::microseconds us) { return us.count() / 1000.0f; };
+
+	ImGui::Begin("Network");
+	GameClient* client = g_game->GetGameClient();
+	if (client && client->HasStreamOverflowed())
+	{
+		ImGui::Text("Disconnected: a reliable stream to the server was full.");
+		ImGui::End();
+		return;
+	}
+
+	Common::RttStats rtt = client ? client->GetRttStats() : Common::RttStats();
+	if (rtt.sampleCount == 0)
+	{
+		ImGui::Text("Waiting for the first pong...");
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Text("RTT %.1f ms  smoothed %.1f ms  jitter %.1f ms", toMs(rtt.latest),
+		toMs(rtt.smoothed), toMs(rtt.jitter));
+	ImGui::Text("p50 %.1f ms  p95 %.1f ms  p99 %.1f ms  max %.1f ms", toMs(rtt.p50),
+		toMs(rtt.p95), toMs(rtt.p99), toMs(rtt.max));
+	ImGui::Text("%llu pings", static_cast<unsigned long long>(rtt.sampleCount));
+
+	m_rttPlot.clear();
+	for (std::chrono::microseconds sample : rtt.recent)
+	{
+		m_rttPlot.push_back(toMs(sample));
+	}
+	ImGui::PlotLines("RTT (ms)", m_rttPlot.data(), static_cast<int>(m_rttPlot.size()), 0,
+		nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 80.0f));
+	ImGui::End();
+}
+
 bool DebugController::HandleKeyEvent(SDL_KeyboardEvent* event)
 {
 	auto& io = ImGui::GetIO();
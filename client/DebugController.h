@@ -10,6 +10,8 @@
 #include <imgui.h>
 #include <SDL.h>
 
+#include <vector>
+
 namespace Client {
 
 //===============================================================================
@@ -46,7 +48,14 @@ public:
 	virtual bool HandleTextInputEvent(SDL_TextInputEvent* event) override;
 
 private:
+	// Round trip to the server, live.
+	void RenderNetworkWindow();
+
 	PerformanceData m_windowData;
+
+	// RttStats::recent converted to milliseconds, since that's what ImGui::PlotLines takes.
+	std::vector<float> m_rttPlot;
+
 	SDL_Window* m_window;
 };
 
@@ -6,6 +6,7 @@
 #include "Game.h"
 
 #include "common/Log.h"
+#include "common/MessageDispatcher.h"
 #include "common/Timer.h"
 #include "client/DebugController.h"
 #include "client/DebugEvents.h"
@@ -36,7 +37,8 @@ Game* g_game = nullptr;
 //-------------------------------------------------------------------------------
 
 Game::Game()
-	: m_renderEvents(std::make_unique<RenderEngineEvents>())
+	: m_messageDispatcher(std::make_unique<Common::MessageDispatcher>())
+	, m_renderEvents(std::make_unique<RenderEngineEvents>())
 	, m_debugController(std::make_unique<DebugController>())
 	, m_debugEvents(std::make_unique<DebugEvents>())
 	, m_renderEngine(std::make_unique<RenderEngine>())
@@ -103,20 +105,18 @@ void Game::ConnectToServer()
 
 void Game::ProcessCallbackQueue()
 {
-	m_callbackQueue.SwapWithEmpty(m_processCbQueue);
-
-	for (auto cb : m_processCbQueue)
-	{
-		if (cb)
+	// Everything posted so far is taken in one go. Callbacks posted while these run wait for
+	// the next call.
+	m_callbackQueue.ConsumeAll([](std::function<void()>& cb)
 		{
-			cb();
-		}
-	}
-
-	if (!m_processCbQueue.empty())
-	{
-		std::deque<std::function<void()>>().swap(m_processCbQueue);
-	}
+			if (cb)
+			{
+				cb();
+			}
+		});
+
+	// Messages dispatched by those callbacks have all been handled now.
+	m_messageDispatcher->EndTick();
 }
 
 void Game::ProcessSDLEvents()
@@ -5,13 +5,16 @@
 
 #pragma once
 
-#include "common/ThreadSafeQueue.h"
+#include "common/MpscQueue.h"
 #include "client/SDLTypes.h"
 
-#include <deque>
 #include <functional>
 #include <memory>
 
+namespace Common {
+class MessageDispatcher;
+}
+
 namespace Client {
 
 //===============================================================================
@@ -49,8 +52,12 @@ public:
 	TTF_Font* GetDefaultFont() const { return m_defaultFont.get(); }
 	RenderEngine* GetRenderEngine() const { return m_renderEngine.get(); }
 	DebugController* GetDebugController() const { return m_debugController.get(); }
+	GameClient* GetGameClient() const { return m_client.get(); }
 	MainWindow* GetMainWindow() const { return m_mainWindow; }
 
+	// Register handlers for server messages here. Messages are dispatched on the main thread.
+	Common::MessageDispatcher& GetMessageDispatcher() const { return *m_messageDispatcher; }
+
 	// Event getters.
 	RenderEngineEvents& GetRenderEngineEvents() const { return *m_renderEvents; }
 	DebugEvents& GetDebugEvents() const { return *m_debugEvents; }
@@ -72,10 +79,10 @@ private:
 	MainWindow* m_mainWindow = nullptr;
 
 	// Functions that need to get processed on the main thread get pushed here.
-	Common::ThreadSafeQueue<std::function<void()>> m_callbackQueue;
+	Common::MpscQueue<std::function<void()>> m_callbackQueue;
 
-	// Pull work from the thread safe cb q into here for processing.
-	std::deque<std::function<void()>> m_processCbQueue;
+	// Routes messages from the server to whoever registered for them.
+	std::unique_ptr<Common::MessageDispatcher> m_messageDispatcher;
 
 	// Don't reorder these.
 	std::unique_ptr<GameController> m_gameController;
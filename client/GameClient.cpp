@@ -7,12 +7,21 @@
 
 #include "client/Game.h"
 #include "common/AsioEventProcessor.h"
+#include "common/GameState.h"
 #include "common/Log.h"
+#include "common/MessageDispatcher.h"
 #include "common/NetworkTypes.h"
 #include "common/NetworkMessageParser.h"
+#include "common/Snapshot.h"
 #include "common/TcpSession.h"
+#include "common/TcpSessionConnector.h"
+#include "common/TransportRouting.h"
+#include "common/UdpChannel.h"
+
+#include <cstring>
 
 using tcp = asio::ip::tcp;
+using udp = asio::ip::udp;
 
 namespace Client {
 
@@ -22,91 +31,39 @@ namespace {
 	const std::string s_localIp = "127.0.0.1";
 	const uint32_t s_port = 26000;
 	const std::thread::id s_mainThreadId = std::this_thread::get_id();
+	const std::chrono::milliseconds s_pingInterval = std::chrono::seconds(1);
 
 	std::shared_ptr<spdlog::logger> s_logger;
 }
 
 //-------------------------------------------------------------------------------
 
-class TcpSessionConnector : public std::enable_shared_from_this<TcpSessionConnector> {
-
-public:
-	TcpSessionConnector(asio::io_context& ioc, GameClient* client)
-		: m_socket(ioc)
-		, m_client(client)
-	{
-		m_endpoints.emplace_back(asio::ip::make_address(s_localIp), s_port);
-	}
-
-	~TcpSessionConnector()
-	{
-
-	}
-
-	bool IsConnected() { return m_isConnected; }
-
-	std::shared_ptr<Common::TcpSession> GetSession() { return m_session; }
-
-	void DestroySession()
-	{
-		m_session->Stop();
-	}
-
-	void Connect()
-	{
-		SPDLOG_LOGGER_INFO(s_logger, "Attempting to connect client to server");
-		DoConnect();
-	}
-
-private:
-	void DoConnect()
-	{
-		asio::async_connect(m_socket, m_endpoints,
-			std::bind(&TcpSessionConnector::OnDoConnect,
-				shared_from_this(),
-				std::placeholders::_1));
-	}
-
-	void OnDoConnect(const std::error_code& ec)
-	{
-		if (ec)
-		{
-			SPDLOG_LOGGER_ERROR(s_logger, "Error connecting to server. ec= {}", ec.value());
-
-			// Server may not be running, keep trying.
-			if (ec == asio::error::connection_refused)
-			{
-				m_socket.close();
-				DoConnect();
-			}
-			return;
-		}
-
-		SPDLOG_LOGGER_INFO(s_logger, "Client connected to server.");
-
-		m_isConnected = true;
-		m_session = std::make_shared<Common::TcpSession>(std::move(m_socket), "Client::GameClient");
-		m_session->Start();
-	}
-
-	// Empty after connected.
-	tcp::socket m_socket;
-	bool m_isConnected = false;
-
-	std::vector<tcp::endpoint> m_endpoints;
-	std::shared_ptr<Common::TcpSession> m_session;
-
-	GameClient* m_client;
-};
-
-//-------------------------------------------------------------------------------
-
 GameClient::GameClient(Game* game)
 	: m_asioEventProcessor(std::make_unique<Common::AsioEventProcessor>())
+	, m_transportRouting(std::make_unique<Common::TransportRouting>())
+	, m_snapshotDecoder(std::make_unique<Common::SnapshotDecoder>())
+	, m_gameState(std::make_unique<Common::GameState>())
 	, m_game(game)
 {
 	REGISTER_LOGGER("GameClient");
 	s_logger = Log::Logger("GameClient");
+
+	m_game->GetMessageDispatcher().RegisterRawHandler(Common::MessageId::UdpHandshake,
+		[this](uint32_t, const std::string_view& payload)
+		{
+			Common::UdpHandshake handshake;
+			if (payload.size() != sizeof(handshake))
+			{
+				SPDLOG_LOGGER_ERROR(s_logger, "Malformed UDP handshake. size= {}", payload.size());
+				return;
+			}
+
+			std::memcpy(&handshake, payload.data(), sizeof(handshake));
+			m_asioEventProcessor->Post([this, handshake]() { StartUdpChannel(handshake); });
+		});
+
+	m_game->GetMessageDispatcher().RegisterRawHandler(Common::MessageId::Snapshot,
+		[this](uint32_t, const std::string_view& payload) { OnSnapshot(payload); });
 }
 
 GameClient::~GameClient()
@@ -115,7 +72,23 @@ GameClient::~GameClient()
 
 void GameClient::Start()
 {
-	m_sessionConnector = std::make_shared<TcpSessionConnector>(m_asioEventProcessor->GetIoService(), this);
+	Common::TcpSessionConfig config;
+	config.pingInterval = s_pingInterval;
+	m_sessionConnector = std::make_shared<Common::TcpSessionConnector>(
+		m_asioEventProcessor->GetIoService(),
+		tcp::endpoint(asio::ip::make_address(s_localIp), s_port), "Client::GameClient", config);
+
+	// Batches are handed to the game thread as a whole and dispatched there.
+	m_sessionConnector->SetConnectedHandler([game = m_game](const auto& session)
+		{
+			session->SetMessageBatchHandler([game](std::shared_ptr<Common::MessageBatch> batch)
+				{
+					game->PostToMainThread([game, batch]()
+						{
+							game->GetMessageDispatcher().Dispatch(0, *batch);
+						});
+				});
+		});
 	m_sessionConnector->Connect();
 	m_asioEventProcessor->Run();
 }
@@ -123,17 +96,116 @@ void GameClient::Start()
 void GameClient::Stop()
 {
 	m_sessionConnector->DestroySession();
+	m_asioEventProcessor->Post([this]()
+		{
+			if (m_udpChannel)
+			{
+				m_udpChannel->Stop();
+			}
+		});
 }
 
 void GameClient::PostMessageToServer(std::string message)
 {
-	m_asioEventProcessor->Post([session = m_sessionConnector->GetSession(),
-		message{ std::move(message) }]()
+	m_asioEventProcessor->Post([this, session = m_sessionConnector->GetSession(),
+		message{ std::move(message) }]() mutable
 	{
-		session->Write(message);
+		// Unreliable messages fall back to TCP until the UDP side is up, or if they don't fit a
+		// datagram. A reliable stream that had to start out over TCP stays there for the
+		// connection, so it's never reordered. One refused over UDP can't overtake the messages
+		// on its stream, and dropping it would break the stream's order, so the connection is
+		// closed instead.
+		Common::Route route = m_transportRouting->GetRoute(message);
+		if (route.transport == Common::Transport::ReliableUdp
+			&& route.stream < m_tcpStreams.size()
+			&& (!m_udpChannel || m_tcpStreams[route.stream]))
+		{
+			m_tcpStreams[route.stream] = true;
+			route.transport = Common::Transport::Tcp;
+		}
+
+		if (m_udpChannel && route.transport != Common::Transport::Tcp)
+		{
+			auto buffer = std::make_shared<const std::string>(std::move(message));
+			Common::UdpSendResult result = m_udpChannel->Send(m_clientId, route, buffer);
+			if (result == Common::UdpSendResult::Sent)
+			{
+				return;
+			}
+			if (!Common::ShouldFallBackToTcp(route, result))
+			{
+				SPDLOG_LOGGER_ERROR(s_logger, "Couldn't send a reliable message over UDP,"
+					" disconnecting. stream= {} result= {} size= {}", route.stream,
+					static_cast<uint32_t>(result), buffer->size());
+				m_hasStreamOverflowed = true;
+				session->Stop();
+				m_udpChannel->Stop();
+				return;
+			}
+
+			session->Write(std::move(buffer));
+			return;
+		}
+
+		session->Write(std::move(message));
 	});
 }
 
+Common::RttStats GameClient::GetRttStats() const
+{
+	std::shared_ptr<Common::TcpSession> session =
+		m_sessionConnector ? m_sessionConnector->GetSession() : nullptr;
+	return session ? session->GetRttStats() : Common::RttStats();
+}
+
+void GameClient::OnSnapshot(std::string_view payload)
+{
+	// Snapshots that arrive late or build on a baseline we no longer have are dropped. The
+	// server keeps sending deltas from our last ack until we catch up.
+	if (!m_snapshotDecoder->Decode(payload, *m_gameState))
+	{
+		return;
+	}
+
+	Common::SnapshotAck ack;
+	ack.sequence = m_snapshotDecoder->GetLastSequence();
+	PostMessageToServer(Common::PackageMessage(Common::MessageId::SnapshotAck,
+		std::string_view(reinterpret_cast<const char*>(&ack), sizeof(ack))));
+}
+
+void GameClient::StartUdpChannel(const Common::UdpHandshake& handshake)
+{
+	std::error_code ec;
+	udp::socket socket(m_asioEventProcessor->GetIoService());
+	socket.open(udp::v4(), ec);
+	if (!ec)
+	{
+		socket.bind(udp::endpoint(udp::v4(), 0), ec);
+	}
+
+	if (ec)
+	{
+		SPDLOG_LOGGER_ERROR(s_logger, "Failed to open UDP channel, staying on TCP. ec= {}", ec.value());
+		return;
+	}
+
+	m_clientId = handshake.clientId;
+	m_udpChannel = std::make_shared<Common::UdpChannel>(std::move(socket), "Client::UdpChannel");
+
+	Game* game = m_game;
+	m_udpChannel->SetMessageBatchHandler(
+		[game](uint32_t, std::shared_ptr<Common::MessageBatch> batch)
+		{
+			game->PostToMainThread([game, batch]()
+				{
+					game->GetMessageDispatcher().Dispatch(0, *batch);
+				});
+		});
+	m_udpChannel->Start();
+	m_udpChannel->Connect(udp::endpoint(asio::ip::make_address(s_localIp), handshake.port),
+		handshake.clientId, handshake.token);
+}
+
 //===============================================================================
 
 } // namespace Client
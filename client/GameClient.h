@@ -5,11 +5,24 @@
 
 #pragma once
 
+#include "common/ReliableEndpoint.h"
+#include "common/RttTracker.h"
+
+#include <atomic>
+#include <bitset>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <string_view>
 
 namespace Common {
 class AsioEventProcessor;
+class GameState;
+class SnapshotDecoder;
+class TcpSessionConnector;
+class TransportRouting;
+class UdpChannel;
+struct UdpHandshake;
 }
 
 namespace Client {
@@ -17,11 +30,8 @@ namespace Client {
 //===============================================================================
 
 class Game;
-class TcpSessionConnector;
 class GameClient {
 
-friend class TcpSessionConnector;
-
 public:
 	GameClient(Game* controller);
 	~GameClient();
@@ -30,9 +40,44 @@ public:
 	void Stop();
 	void PostMessageToServer(std::string message);
 
+	// True once the connection has been closed because a reliable UDP stream to the server was
+	// full, or a reliable message couldn't go over UDP. Messages posted from then on go nowhere.
+	bool HasStreamOverflowed() const { return m_hasStreamOverflowed; }
+
+	// Which messages go over UDP, and on which reliable stream. Set up before calling Start.
+	Common::TransportRouting& GetTransportRouting() { return *m_transportRouting; }
+
+	// The server's game state as of the last snapshot. Only touch it from the main thread.
+	const Common::GameState& GetGameState() const { return *m_gameState; }
+
+	// Round trip to the server, measured by the session's pings. Empty until connected.
+	Common::RttStats GetRttStats() const;
+
 private:
+	// Opens the UDP side of the connection once the server has told us how over TCP.
+	void StartUdpChannel(const Common::UdpHandshake& handshake);
+
+	// Applies a snapshot to the game state and acks it so the server can send deltas from it.
+	void OnSnapshot(std::string_view payload);
+
 	std::unique_ptr<Common::AsioEventProcessor> m_asioEventProcessor;
-	std::shared_ptr<TcpSessionConnector> m_sessionConnector;
+	std::shared_ptr<Common::TcpSessionConnector> m_sessionConnector;
+
+	// Only touched on the io thread. Null until the handshake arrives.
+	std::shared_ptr<Common::UdpChannel> m_udpChannel;
+	uint32_t m_clientId = 0;
+	std::unique_ptr<Common::TransportRouting> m_transportRouting;
+
+	// Reliable streams that sent something before the UDP side was up, and so stay on TCP for
+	// the connection. Only touched on the io thread.
+	std::bitset<Common::ReliableEndpoint::s_streamCount> m_tcpStreams;
+
+	// Set on the io thread, read from any.
+	std::atomic<bool> m_hasStreamOverflowed{ false };
+
+	// Main thread only.
+	std::unique_ptr<Common::SnapshotDecoder> m_snapshotDecoder;
+	std::unique_ptr<Common::GameState> m_gameState;
 
 	Game* m_game;
 };
@@ -7,6 +7,7 @@
 
 #include "common/Log.h"
 
+#include <algorithm>
 #include <memory>
 
 namespace Common {
@@ -17,10 +18,22 @@ namespace {
 	std::shared_ptr<spdlog::logger> s_logger;
 } // anon namespace
 
-AsioEventProcessor::AsioEventProcessor() : m_ios(std::make_unique<asio::io_service>())
+AsioEventProcessor::AsioEventProcessor(uint32_t threadCount)
 {
-	m_work.reset(new asio::io_service::work(*m_ios));
-	m_ios->post([this]()
+	if (threadCount == 0)
+	{
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	m_workers.resize(threadCount);
+	for (Worker& worker : m_workers)
+	{
+		// Each service is only ever run by one thread, which lets asio take its single thread paths.
+		worker.ios = std::make_unique<asio::io_service>(1);
+		worker.work.reset(new asio::io_service::work(*worker.ios));
+	}
+
+	m_workers.front().ios->post([this]()
 		{
 			m_isReady = true;
 		});
@@ -28,32 +41,49 @@ AsioEventProcessor::AsioEventProcessor() : m_ios(std::make_unique<asio::io_servi
 
 AsioEventProcessor::~AsioEventProcessor()
 {
-	m_ios->stop();
-	if (m_thread.joinable())
+	for (Worker& worker : m_workers)
 	{
-		m_thread.join();
+		worker.ios->stop();
+	}
+
+	for (Worker& worker : m_workers)
+	{
+		if (worker.thread.joinable())
+		{
+			worker.thread.join();
+		}
 	}
 }
 
 asio::io_service& AsioEventProcessor::GetIoService()
 {
-	return *m_ios;
+	return *m_workers.front().ios;
+}
+
+asio::io_service& AsioEventProcessor::GetNextIoService()
+{
+	uint32_t index = m_nextWorker.fetch_add(1, std::memory_order_relaxed) % GetThreadCount();
+	return *m_workers[index].ios;
 }
 
 void AsioEventProcessor::Post(const std::function<void()>& cb)
 {
-	m_ios->post(cb);
+	m_workers.front().ios->post(cb);
 }
 
 void AsioEventProcessor::Run()
 {
-	m_thread = std::thread(([this]() { DoRun(); }));
+	for (Worker& worker : m_workers)
+	{
+		asio::io_service& ios = *worker.ios;
+		worker.thread = std::thread(([this, &ios]() { DoRun(ios); }));
+	}
 }
 
-void AsioEventProcessor::DoRun()
+void AsioEventProcessor::DoRun(asio::io_service& ios)
 {
 	std::error_code ec;
-	m_ios->run(ec);
+	ios.run(ec);
 
 	if (ec)
 	{
@@ -7,32 +7,56 @@
 
 #include <asio.hpp>
 
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
 namespace Common {
 
 //===============================================================================
 
+// Runs a pool of io_services, each on its own thread. Anything bound to a single io_service
+// (a socket and all of its handlers, for example) only ever runs on that service's thread, so
+// a session's handlers stay serialized without locks or strands.
 class AsioEventProcessor
 {
 public:
-	AsioEventProcessor();
+	// A threadCount of 0 means one thread per hardware core.
+	AsioEventProcessor(uint32_t threadCount = 1);
 	~AsioEventProcessor();
 
-	// Returns the asio::io_service that's servicing the queue.
+	// Returns the asio::io_service that's servicing the queue. This is the first in the pool.
 	asio::io_service& GetIoService();
 
+	// Hands out the io_services in the pool round robin. Use this to spread sessions across threads.
+	asio::io_service& GetNextIoService();
+
+	// The io_service at index, from 0 to GetThreadCount. For anything that wants one per thread.
+	asio::io_service& GetIoService(uint32_t index) { return *m_workers[index].ios; }
+
+	// Number of io_services (and threads) in the pool.
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
 	// Post work to the io_service to be processed asynchronously.
 	void Post(const std::function<void()>& cb);
 
-	// Kicks off a new thread and starts the service on it.
+	// Kicks off a thread per io_service and starts them.
 	void Run();
 
 private:
-	void DoRun();
+	struct Worker
+	{
+		std::unique_ptr<asio::io_service> ios;
+		std::unique_ptr<asio::io_service::work> work;
+		std::thread thread;
+	};
+
+	void DoRun(asio::io_service& ios);
 
 private:
-	std::unique_ptr<asio::io_service> m_ios;
-	std::unique_ptr<asio::io_service::work> m_work;
-	std::thread m_thread;
+	std::vector<Worker> m_workers;
+	std::atomic<uint32_t> m_nextWorker{ 0 };
 	bool m_isReady = false;
 };
 
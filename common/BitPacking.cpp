@@ -0,0 +1,192 @@
+//---------------------------------------------------------------
+//
+// BitPacking.cpp
+//
+
+#include "common/BitPacking.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+
+// MSVC only defines _M_IX86_FP for 32 bit builds. 64 bit builds always have SSE2.
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define BIT_PACKING_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Common {
+
+//===============================================================================
+
+namespace {
+	const float s_twoPi = 6.28318530718f;
+	const uint32_t s_maxRangeBits = 24;
+
+	uint32_t GetMaxValue(uint32_t bits)
+	{
+		return bits >= 32 ? ~0u : (1u << bits) - 1;
+	}
+} // anon namespace
+
+//-------------------------------------------------------------------------------
+
+BitWriter::BitWriter(std::string& out)
+	: m_out(out)
+{
+}
+
+void BitWriter::Write(uint32_t value, uint32_t bits)
+{
+	assert(bits > 0 && bits <= 32);
+	m_scratch |= static_cast<uint64_t>(value & GetMaxValue(bits)) << m_scratchBits;
+	m_scratchBits += bits;
+	m_bitsWritten += bits;
+
+	// Emptied a word at a time. At most 31 bits are left over, so the next write always fits.
+	if (m_scratchBits >= 32)
+	{
+		uint32_t word = static_cast<uint32_t>(m_scratch);
+		char bytes[4] = {
+			static_cast<char>(word), static_cast<char>(word >> 8),
+			static_cast<char>(word >> 16), static_cast<char>(word >> 24)
+		};
+		m_out.append(bytes, sizeof(bytes));
+		m_scratch >>= 32;
+		m_scratchBits -= 32;
+	}
+}
+
+void BitWriter::Flush()
+{
+	while (m_scratchBits > 0)
+	{
+		m_out.push_back(static_cast<char>(m_scratch));
+		m_scratch >>= 8;
+		m_scratchBits = m_scratchBits > 8 ? m_scratchBits - 8 : 0;
+	}
+	m_scratch = 0;
+}
+
+//-------------------------------------------------------------------------------
+
+BitReader::BitReader(std::string_view data)
+	: m_data(data)
+{
+}
+
+bool BitReader::Read(uint32_t bits, uint32_t& value)
+{
+	assert(bits > 0 && bits <= 32);
+	while (m_scratchBits < bits && !m_data.empty())
+	{
+		m_scratch |= static_cast<uint64_t>(static_cast<uint8_t>(m_data.front())) << m_scratchBits;
+		m_scratchBits += 8;
+		m_data.remove_prefix(1);
+	}
+
+	if (m_scratchBits < bits)
+	{
+		return false;
+	}
+
+	value = static_cast<uint32_t>(m_scratch) & GetMaxValue(bits);
+	m_scratch >>= bits;
+	m_scratchBits -= bits;
+	return true;
+}
+
+//-------------------------------------------------------------------------------
+
+QuantizedRange::QuantizedRange(float min, float max, uint32_t bits)
+	: min(min)
+	, max(max)
+	, bits(std::min(bits, s_maxRangeBits))
+	, m_scale(GetMaxValue(this->bits) / (max - min))
+{
+	assert(max > min && bits > 0);
+}
+
+uint32_t QuantizedRange::Quantize(float value) const
+{
+	// Written so NaN ends up at min, the same as the batch path.
+	value = value > min ? value : min;
+	value = value < max ? value : max;
+
+	// At 24 bits, max rounds up to 2^24, one past the last step, which would wrap to 0.
+	return std::min(static_cast<uint32_t>((value - min) * m_scale + 0.5f), GetMaxValue(bits));
+}
+
+float QuantizedRange::Dequantize(uint32_t value) const
+{
+	return min + std::min(value, GetMaxValue(bits)) / m_scale;
+}
+
+//-------------------------------------------------------------------------------
+
+QuantizedAngle::QuantizedAngle(uint32_t bits)
+	: bits(std::min(bits, s_maxRangeBits))
+{
+	assert(bits > 0);
+}
+
+uint32_t QuantizedAngle::Quantize(const glm::vec2& direction) const
+{
+	float angle = std::atan2(direction.y, direction.x);
+	if (angle < 0.0f)
+	{
+		angle += s_twoPi;
+	}
+
+	// The angle wraps, so the step past the last one is 0 again.
+	uint32_t steps = 1u << bits;
+	uint32_t value = static_cast<uint32_t>(angle / s_twoPi * steps + 0.5f);
+	return value & (steps - 1);
+}
+
+glm::vec2 QuantizedAngle::Dequantize(uint32_t value) const
+{
+	float angle = (value & ((1u << bits) - 1)) * s_twoPi / (1u << bits);
+	return { std::cos(angle), std::sin(angle) };
+}
+
+float QuantizedAngle::GetMaxError() const
+{
+	return s_twoPi / (1u << bits) / 2.0f;
+}
+
+//-------------------------------------------------------------------------------
+
+void QuantizeBatch(const float* values, size_t count, const QuantizedRange& range, uint32_t* out)
+{
+	size_t i = 0;
+
+#ifdef BIT_PACKING_SSE2
+	const __m128 min = _mm_set1_ps(range.min);
+	const __m128 max = _mm_set1_ps(range.max);
+	const __m128 scale = _mm_set1_ps(range.GetScale());
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 maxValue = _mm_set1_ps(static_cast<float>(GetMaxValue(range.bits)));
+	for (; i + 4 <= count; i += 4)
+	{
+		// max_ps returns its second operand if either is NaN, so NaN clamps to min.
+		__m128 value = _mm_loadu_ps(values + i);
+		value = _mm_min_ps(_mm_max_ps(value, min), max);
+		value = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(value, min), scale), half);
+
+		// Clamped to the last step, the same as Quantize. Never negative and below 2^24, so
+		// truncating to a signed int is safe.
+		value = _mm_min_ps(value, maxValue);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_cvttps_epi32(value));
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		out[i] = range.Quantize(values[i]);
+	}
+}
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,102 @@
+//---------------------------------------------------------------
+//
+// BitPacking.h
+//
+
+#pragma once
+
+#include <glm/vec2.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Common {
+
+//===============================================================================
+
+// Appends values of any width from 1 to 32 bits to a string, with no padding between them.
+// Bits fill each byte from the bottom up.
+class BitWriter
+{
+public:
+	explicit BitWriter(std::string& out);
+
+	// Writes the low bits bits of value.
+	void Write(uint32_t value, uint32_t bits);
+
+	// Writes out the last partial byte. Call once everything has been written.
+	void Flush();
+
+	size_t GetBitsWritten() const { return m_bitsWritten; }
+
+private:
+	std::string& m_out;
+	uint64_t m_scratch = 0;
+	uint32_t m_scratchBits = 0;
+	size_t m_bitsWritten = 0;
+};
+
+// Reads back what a BitWriter wrote. Doesn't own data.
+class BitReader
+{
+public:
+	explicit BitReader(std::string_view data);
+
+	// Returns false if there aren't bits bits left.
+	bool Read(uint32_t bits, uint32_t& value);
+
+	size_t GetBitsRemaining() const { return m_data.size() * 8 + m_scratchBits; }
+
+private:
+	std::string_view m_data;
+	uint64_t m_scratch = 0;
+	uint32_t m_scratchBits = 0;
+};
+
+// Maps a float in [min, max] to an integer of bits bits and back. Values outside the range are
+// clamped to it. Anything decoded is within GetMaxError of what was encoded.
+struct QuantizedRange
+{
+	QuantizedRange(float min, float max, uint32_t bits);
+
+	uint32_t Quantize(float value) const;
+	float Dequantize(uint32_t value) const;
+	float GetMaxError() const { return 0.5f / m_scale; }
+
+	// Steps per unit.
+	float GetScale() const { return m_scale; }
+
+	float min;
+	float max;
+
+	// At most 24. A float can't tell more steps than that apart anyway.
+	uint32_t bits;
+
+private:
+	float m_scale;
+};
+
+// Quantizes a direction by its angle, so a unit vector costs one small integer. A zero vector
+// comes back as the direction at angle 0.
+struct QuantizedAngle
+{
+	explicit QuantizedAngle(uint32_t bits);
+
+	uint32_t Quantize(const glm::vec2& direction) const;
+	glm::vec2 Dequantize(uint32_t value) const;
+
+	// In radians.
+	float GetMaxError() const;
+
+	uint32_t bits;
+};
+
+// Quantizes count values at once. Uses SSE2 when it's available, four values at a time, and
+// gives the same results as QuantizedRange::Quantize either way.
+void QuantizeBatch(const float* values, size_t count, const QuantizedRange& range, uint32_t* out);
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,204 @@
+//---------------------------------------------------------------
+//
+// FrameCompression.cpp
+//
+
+#include "common/FrameCompression.h"
+
+#include "common/WireFormat.h"
+
+#include <zlib.h>
+
+#include <assert.h>
+
+namespace Common {
+
+//===============================================================================
+
+namespace {
+	// Raw deflate. The frame already says how long the payload is, so zlib's own header and
+	// trailer would only add bytes.
+	const int s_windowBits = -15;
+	const int s_memLevel = 8;
+
+	// Method byte plus the longest varint.
+	const uint32_t s_maxPrefixSize = 6;
+
+	using Clock = std::chrono::steady_clock;
+
+	std::chrono::microseconds Since(Clock::time_point start)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+	}
+} // anon namespace
+
+//-------------------------------------------------------------------------------
+
+struct FrameCompressor::Stream
+{
+	z_stream z = {};
+};
+
+FrameCompressor::FrameCompressor(int level, bool isStreamed)
+	: m_stream(std::make_unique<Stream>())
+	, m_isStreamed(isStreamed)
+{
+	int result = deflateInit2(&m_stream->z, level, Z_DEFLATED, s_windowBits, s_memLevel,
+		Z_DEFAULT_STRATEGY);
+	assert(result == Z_OK);
+	(void)result;
+}
+
+FrameCompressor::~FrameCompressor()
+{
+	deflateEnd(&m_stream->z);
+}
+
+bool FrameCompressor::Compress(std::string_view payload, std::string& out)
+{
+	Clock::time_point start = Clock::now();
+	z_stream& z = m_stream->z;
+	if (!m_isStreamed)
+	{
+		deflateReset(&z);
+	}
+
+	CompressionMethod method = m_isStreamed ? CompressionMethod::StreamedDeflate
+		: CompressionMethod::Deflate;
+	char prefix[s_maxPrefixSize];
+	prefix[0] = static_cast<char>(method);
+	uint32_t prefixSize = 1 + WriteVarint(static_cast<uint32_t>(payload.size()), prefix + 1);
+
+	// A sync flush adds a few bytes to what deflateBound allows for.
+	out.resize(prefixSize + deflateBound(&z, static_cast<uLong>(payload.size())) + 16);
+	out.replace(0, prefixSize, prefix, prefixSize);
+
+	z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(payload.data()));
+	z.avail_in = static_cast<uInt>(payload.size());
+	const int flush = m_isStreamed ? Z_SYNC_FLUSH : Z_FINISH;
+	size_t written = prefixSize;
+	for (;;)
+	{
+		z.next_out = reinterpret_cast<Bytef*>(&out[written]);
+		z.avail_out = static_cast<uInt>(out.size() - written);
+		int result = deflate(&z, flush);
+		written = out.size() - z.avail_out;
+		assert(result != Z_STREAM_ERROR);
+
+		// Deflate is only done flushing once it stops short of the end of the buffer.
+		bool isDone = m_isStreamed ? z.avail_out != 0 : result == Z_STREAM_END;
+		if (isDone)
+		{
+			break;
+		}
+		out.resize(out.size() * 2);
+	}
+	out.resize(written);
+
+	++m_stats.frames;
+	m_stats.uncompressedBytes += payload.size();
+	m_stats.time += Since(start);
+	if (!m_isStreamed && out.size() >= payload.size())
+	{
+		++m_stats.framesIncompressible;
+		m_stats.compressedBytes += payload.size();
+		return false;
+	}
+
+	m_stats.compressedBytes += out.size();
+	return true;
+}
+
+//-------------------------------------------------------------------------------
+
+struct FrameDecompressor::Stream
+{
+	Stream()
+	{
+		int result = inflateInit2(&z, s_windowBits);
+		assert(result == Z_OK);
+		(void)result;
+	}
+
+	~Stream()
+	{
+		inflateEnd(&z);
+	}
+
+	z_stream z = {};
+};
+
+FrameDecompressor::FrameDecompressor()
+{
+}
+
+FrameDecompressor::~FrameDecompressor()
+{
+}
+
+bool FrameDecompressor::Decompress(std::string_view payload, uint32_t maxSize, std::string& out)
+{
+	Clock::time_point start = Clock::now();
+	if (payload.empty())
+	{
+		return false;
+	}
+
+	CompressionMethod method = static_cast<CompressionMethod>(payload[0]);
+	uint32_t size = 0;
+	int32_t sizeBytes = ReadVarint(payload.data() + 1, payload.size() - 1, size);
+	if (sizeBytes <= 0 || size > maxSize)
+	{
+		return false;
+	}
+	std::string_view data = payload.substr(1 + sizeBytes);
+
+	std::unique_ptr<Stream>* stream = nullptr;
+	switch (method)
+	{
+	case CompressionMethod::Deflate:
+		stream = &m_frameStream;
+		break;
+	case CompressionMethod::StreamedDeflate:
+		stream = &m_sharedStream;
+		break;
+	default:
+		return false;
+	}
+
+	if (!*stream)
+	{
+		*stream = std::make_unique<Stream>();
+	}
+	else if (method == CompressionMethod::Deflate)
+	{
+		inflateReset(&(*stream)->z);
+	}
+
+	// A byte to spare, so running out of room can't stop inflate short of the end of the input.
+	out.resize(size + 1);
+	z_stream& z = (*stream)->z;
+	z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+	z.avail_in = static_cast<uInt>(data.size());
+	z.next_out = reinterpret_cast<Bytef*>(&out[0]);
+	z.avail_out = static_cast<uInt>(out.size());
+
+	int result = inflate(&z, method == CompressionMethod::Deflate ? Z_FINISH : Z_SYNC_FLUSH);
+	bool isComplete = method == CompressionMethod::Deflate ? result == Z_STREAM_END
+		: result == Z_OK || result == Z_BUF_ERROR;
+	if (!isComplete || z.avail_in != 0 || z.avail_out != 1)
+	{
+		return false;
+	}
+	out.resize(size);
+
+	++m_stats.frames;
+	m_stats.uncompressedBytes += size;
+	m_stats.compressedBytes += payload.size();
+	m_stats.time += Since(start);
+	return true;
+}
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,105 @@
+//---------------------------------------------------------------
+//
+// FrameCompression.h
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace Common {
+
+//===============================================================================
+
+// First byte of a compressed payload. A varint of the uncompressed size follows it, then the
+// raw deflate data.
+enum class CompressionMethod : uint8_t
+{
+	// Compressed on its own. Any frame can be inflated without the ones before it.
+	Deflate = 0,
+
+	// Compressed with the deflate stream every StreamedDeflate frame on the connection shares,
+	// so it has to be inflated after all of them, in order.
+	StreamedDeflate = 1
+};
+
+// What a compressor or decompressor has done so far. Ratio is compressed over uncompressed.
+struct CompressionStats
+{
+	uint64_t frames = 0;
+	uint64_t uncompressedBytes = 0;
+	uint64_t compressedBytes = 0;
+
+	// Frames sent uncompressed after all because deflating didn't make them any smaller. The
+	// time spent on them is still counted. Always 0 for a decompressor.
+	uint64_t framesIncompressible = 0;
+
+	std::chrono::microseconds time = std::chrono::microseconds::zero();
+
+	double Ratio() const
+	{
+		return uncompressedBytes ? static_cast<double>(compressedBytes) / uncompressedBytes : 0.0;
+	}
+};
+
+// Deflates payloads for one connection. Not thread safe.
+class FrameCompressor
+{
+public:
+	// level is zlib's, 1 fastest to 9 smallest. Streamed compressors remember what they've
+	// compressed, so a payload that's a lot like a recent one costs little.
+	FrameCompressor(int level, bool isStreamed);
+	~FrameCompressor();
+
+	FrameCompressor(const FrameCompressor&) = delete;
+	FrameCompressor& operator=(const FrameCompressor&) = delete;
+
+	// Replaces out with the compressed payload, method byte and size included. Returns false
+	// if it wouldn't be smaller, in which case send the payload as it is and ignore out. A
+	// streamed compressor always returns true, since once its stream has seen a payload the
+	// peer's has to as well.
+	bool Compress(std::string_view payload, std::string& out);
+
+	bool IsStreamed() const { return m_isStreamed; }
+	const CompressionStats& GetStats() const { return m_stats; }
+
+private:
+	struct Stream;
+	std::unique_ptr<Stream> m_stream;
+	bool m_isStreamed;
+	CompressionStats m_stats;
+};
+
+// Inflates payloads from one connection, by whichever method they were compressed with.
+// Not thread safe.
+class FrameDecompressor
+{
+public:
+	FrameDecompressor();
+	~FrameDecompressor();
+
+	FrameDecompressor(const FrameDecompressor&) = delete;
+	FrameDecompressor& operator=(const FrameDecompressor&) = delete;
+
+	// Replaces out with the inflated payload. Returns false if the payload is malformed or
+	// claims to inflate to more than maxSize. Nothing is allocated before that's checked.
+	bool Decompress(std::string_view payload, uint32_t maxSize, std::string& out);
+
+	const CompressionStats& GetStats() const { return m_stats; }
+
+private:
+	struct Stream;
+
+	// Made on first use, since most connections only ever see one kind.
+	std::unique_ptr<Stream> m_frameStream;
+	std::unique_ptr<Stream> m_sharedStream;
+	CompressionStats m_stats;
+};
+
+//===============================================================================
+
+} // namespace Common
@@ -5,10 +5,19 @@
 
 #include "common/GameState.h"
 
+#include <algorithm>
+
 namespace Common {
 
 //===============================================================================
 
+namespace {
+	bool IdLess(const EntityState& entity, uint32_t entityId)
+	{
+		return entity.entityId < entityId;
+	}
+} // anon namespace
+
 GameState::GameState()
 {
 
@@ -19,6 +28,42 @@ GameState::~GameState()
 
 }
 
+void GameState::SetEntity(const EntityState& entity)
+{
+	auto it = std::lower_bound(m_entities.begin(), m_entities.end(), entity.entityId, IdLess);
+	if (it != m_entities.end() && it->entityId == entity.entityId)
+	{
+		*it = entity;
+		return;
+	}
+
+	m_entities.insert(it, entity);
+}
+
+bool GameState::RemoveEntity(uint32_t entityId)
+{
+	auto it = std::lower_bound(m_entities.begin(), m_entities.end(), entityId, IdLess);
+	if (it == m_entities.end() || it->entityId != entityId)
+	{
+		return false;
+	}
+
+	m_entities.erase(it);
+	return true;
+}
+
+const EntityState* GameState::FindEntity(uint32_t entityId) const
+{
+	auto it = std::lower_bound(m_entities.begin(), m_entities.end(), entityId, IdLess);
+	return it != m_entities.end() && it->entityId == entityId ? &*it : nullptr;
+}
+
+EntityState* GameState::FindEntity(uint32_t entityId)
+{
+	auto it = std::lower_bound(m_entities.begin(), m_entities.end(), entityId, IdLess);
+	return it != m_entities.end() && it->entityId == entityId ? &*it : nullptr;
+}
+
 //===============================================================================
 
 } // namespace Common
@@ -5,14 +5,40 @@
 
 #pragma once
 
+#include "common/GameTypes.h"
+
+#include <cstdint>
+#include <vector>
+
 namespace Common {
 
 //===============================================================================
 
+// The replicated state of the world. Entities are kept sorted by id, so two states can be
+// compared in one pass over both.
 class GameState {
 public:
 	GameState();
 	~GameState();
+
+	// Adds the entity, or replaces the one with the same id.
+	void SetEntity(const EntityState& entity);
+
+	// Returns false if there was no entity with that id.
+	bool RemoveEntity(uint32_t entityId);
+
+	// Returns nullptr if there's no entity with that id. Pointers are invalidated by SetEntity
+	// and RemoveEntity.
+	const EntityState* FindEntity(uint32_t entityId) const;
+	EntityState* FindEntity(uint32_t entityId);
+
+	// Sorted by id.
+	const std::vector<EntityState>& GetEntities() const { return m_entities; }
+
+	void Clear() { m_entities.clear(); }
+
+private:
+	std::vector<EntityState> m_entities;
 };
 
 //===============================================================================
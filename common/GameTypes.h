@@ -5,10 +5,27 @@
 
 #pragma once
 
+#include <cstdint>
+
 namespace Common {
 
 //===============================================================================
 
+// Everything about an entity that's replicated to clients. The position and heading are what
+// Move changes, the rest is what Creature describes.
+struct EntityState
+{
+	uint32_t entityId = 0;
+
+	float x = 0.0f;
+	float y = 0.0f;
+	float z = 0.0f;
+	float heading = 0.0f;
+
+	uint32_t creatureType = 0;
+	uint32_t health = 0;
+	uint32_t flags = 0;
+};
 
 //===============================================================================
 
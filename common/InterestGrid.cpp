@@ -0,0 +1,179 @@
+//---------------------------------------------------------------
+//
+// InterestGrid.cpp
+//
+
+#include "common/InterestGrid.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+#include <iterator>
+
+namespace Common {
+
+//===============================================================================
+
+InterestGrid::InterestGrid(float cellSize)
+	: m_cellSize(cellSize)
+{
+	assert(cellSize > 0.0f);
+}
+
+void InterestGrid::Rebuild(const GameState& state)
+{
+	const std::vector<EntityState>& entities = state.GetEntities();
+	m_entries.resize(entities.size());
+	for (size_t i = 0; i < entities.size(); ++i)
+	{
+		const EntityState& entity = entities[i];
+		Entry& entry = m_entries[i];
+		entry.cell = GetCellKey(ToCell(entity.x), ToCell(entity.y));
+		entry.entityId = entity.entityId;
+		entry.x = entity.x;
+		entry.y = entity.y;
+	}
+
+	// Entities arrive sorted by id, and a stable sort keeps them that way within each cell.
+	std::stable_sort(m_entries.begin(), m_entries.end(),
+		[](const Entry& a, const Entry& b) { return a.cell < b.cell; });
+
+	m_cells.clear();
+	for (uint32_t i = 0; i < m_entries.size(); ++i)
+	{
+		CellRange& range = m_cells[m_entries[i].cell];
+		if (range.count == 0)
+		{
+			range.begin = i;
+		}
+		++range.count;
+	}
+}
+
+void InterestGrid::Query(float x, float y, float radius, std::vector<uint32_t>& entityIds) const
+{
+	entityIds.clear();
+
+	float radiusSquared = radius * radius;
+	int32_t minX = ToCell(x - radius);
+	int32_t maxX = ToCell(x + radius);
+	int32_t minY = ToCell(y - radius);
+	int32_t maxY = ToCell(y + radius);
+
+	// A query wider than the populated part of the world is quicker checking every entity than
+	// looking up every cell it covers.
+	uint64_t cellCount = static_cast<uint64_t>(static_cast<int64_t>(maxX) - minX + 1)
+		* static_cast<uint64_t>(static_cast<int64_t>(maxY) - minY + 1);
+	if (cellCount > m_cells.size())
+	{
+		for (const Entry& entry : m_entries)
+		{
+			float dx = entry.x - x;
+			float dy = entry.y - y;
+			if (dx * dx + dy * dy <= radiusSquared)
+			{
+				entityIds.push_back(entry.entityId);
+			}
+		}
+
+		std::sort(entityIds.begin(), entityIds.end());
+		return;
+	}
+
+	for (int32_t cellX = minX; cellX <= maxX; ++cellX)
+	{
+		for (int32_t cellY = minY; cellY <= maxY; ++cellY)
+		{
+			auto it = m_cells.find(GetCellKey(cellX, cellY));
+			if (it == m_cells.end())
+			{
+				continue;
+			}
+
+			const CellRange& range = it->second;
+			for (uint32_t i = range.begin; i < range.begin + range.count; ++i)
+			{
+				const Entry& entry = m_entries[i];
+				float dx = entry.x - x;
+				float dy = entry.y - y;
+				if (dx * dx + dy * dy <= radiusSquared)
+				{
+					entityIds.push_back(entry.entityId);
+				}
+			}
+		}
+	}
+
+	std::sort(entityIds.begin(), entityIds.end());
+}
+
+int32_t InterestGrid::ToCell(float value) const
+{
+	// Clamped so a stray position far out of the world, or NaN, can't overflow the cell index.
+	float cell = std::floor(value / m_cellSize);
+	cell = cell > -1.0e9f ? cell : -1.0e9f;
+	cell = cell < 1.0e9f ? cell : 1.0e9f;
+	return static_cast<int32_t>(cell);
+}
+
+uint64_t InterestGrid::GetCellKey(int32_t cellX, int32_t cellY)
+{
+	return (static_cast<uint64_t>(static_cast<uint32_t>(cellX)) << 32) | static_cast<uint32_t>(cellY);
+}
+
+//-------------------------------------------------------------------------------
+
+InterestSet::InterestSet()
+{
+}
+
+void InterestSet::Update(const InterestGrid& grid, const InterestArea& area)
+{
+	grid.Query(area.x, area.y, area.enterRadius, m_near);
+	grid.Query(area.x, area.y, std::max(area.leaveRadius, area.enterRadius), m_far);
+
+	// In view now: everything near, plus whatever was in view before and isn't far yet.
+	m_previous.swap(m_visible);
+	m_staying.clear();
+	std::set_intersection(m_previous.begin(), m_previous.end(), m_far.begin(), m_far.end(),
+		std::back_inserter(m_staying));
+
+	m_visible.clear();
+	std::set_union(m_near.begin(), m_near.end(), m_staying.begin(), m_staying.end(),
+		std::back_inserter(m_visible));
+
+	m_entered.clear();
+	std::set_difference(m_visible.begin(), m_visible.end(), m_previous.begin(), m_previous.end(),
+		std::back_inserter(m_entered));
+
+	m_left.clear();
+	std::set_difference(m_previous.begin(), m_previous.end(), m_visible.begin(), m_visible.end(),
+		std::back_inserter(m_left));
+}
+
+void InterestSet::Filter(const GameState& state, GameState& visibleState) const
+{
+	visibleState.Clear();
+
+	// Both are sorted by id, so each search starts where the last one left off, and entities are
+	// added in order, which keeps SetEntity to an append.
+	const std::vector<EntityState>& entities = state.GetEntities();
+	auto entity = entities.begin();
+	for (uint32_t entityId : m_visible)
+	{
+		entity = std::lower_bound(entity, entities.end(), entityId,
+			[](const EntityState& e, uint32_t id) { return e.entityId < id; });
+		if (entity == entities.end())
+		{
+			break;
+		}
+		if (entity->entityId == entityId)
+		{
+			visibleState.SetEntity(*entity);
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Common
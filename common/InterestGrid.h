@@ -0,0 +1,102 @@
+//---------------------------------------------------------------
+//
+// InterestGrid.h
+//
+
+#pragma once
+
+#include "common/GameState.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace Common {
+
+//===============================================================================
+
+// The part of the world a client is sent updates for. Entities come into view within
+// enterRadius of the centre, and once in view stay until they're beyond leaveRadius, so one
+// moving back and forth over the edge isn't added and removed every tick.
+struct InterestArea
+{
+	float x = 0.0f;
+	float y = 0.0f;
+	float enterRadius = 200.0f;
+	float leaveRadius = 220.0f;
+};
+
+// A uniform grid over entity positions on x and y, rebuilt from the game state once a tick and
+// then shared by every client's queries. Cells are hashed, so the world has no fixed bounds.
+// Pick a cell size around the usual enter radius, so a query only touches a few cells.
+class InterestGrid
+{
+public:
+	explicit InterestGrid(float cellSize);
+
+	void Rebuild(const GameState& state);
+
+	// Replaces entityIds with the entities within radius of x, y, sorted by id.
+	void Query(float x, float y, float radius, std::vector<uint32_t>& entityIds) const;
+
+	float GetCellSize() const { return m_cellSize; }
+
+private:
+	struct Entry
+	{
+		uint64_t cell = 0;
+		uint32_t entityId = 0;
+		float x = 0.0f;
+		float y = 0.0f;
+	};
+
+	// Where a cell's entries start in m_entries, and how many there are.
+	struct CellRange
+	{
+		uint32_t begin = 0;
+		uint32_t count = 0;
+	};
+
+	int32_t ToCell(float value) const;
+	static uint64_t GetCellKey(int32_t cellX, int32_t cellY);
+
+	float m_cellSize;
+
+	// Sorted by cell, so each cell's entities are together.
+	std::vector<Entry> m_entries;
+	std::unordered_map<uint64_t, CellRange> m_cells;
+};
+
+// Server side, one per client. Tracks which entities the client can see and which came into and
+// went out of view at the last update.
+class InterestSet
+{
+public:
+	InterestSet();
+
+	// Works out what's in view from area now. An entity that's gone from the world leaves view.
+	void Update(const InterestGrid& grid, const InterestArea& area);
+
+	// Replaces visibleState with the entities of state that are in view.
+	void Filter(const GameState& state, GameState& visibleState) const;
+
+	// Each sorted by id.
+	const std::vector<uint32_t>& GetVisible() const { return m_visible; }
+	const std::vector<uint32_t>& GetEntered() const { return m_entered; }
+	const std::vector<uint32_t>& GetLeft() const { return m_left; }
+
+private:
+	std::vector<uint32_t> m_visible;
+	std::vector<uint32_t> m_entered;
+	std::vector<uint32_t> m_left;
+
+	// Inputs to the set operations in Update. m_previous is last update's m_visible.
+	std::vector<uint32_t> m_near;
+	std::vector<uint32_t> m_far;
+	std::vector<uint32_t> m_staying;
+	std::vector<uint32_t> m_previous;
+};
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,123 @@
+//---------------------------------------------------------------
+//
+// LatencyHistogram.cpp
+//
+
+#include "common/LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Common {
+
+//===============================================================================
+
+namespace {
+	// Index of the highest set bit. value must not be 0.
+	uint32_t HighestBit(uint64_t value)
+	{
+		uint32_t bit = 0;
+		for (uint32_t shift = 32; shift > 0; shift /= 2)
+		{
+			if (value >> shift)
+			{
+				value >>= shift;
+				bit += shift;
+			}
+		}
+		return bit;
+	}
+} // anon namespace
+
+//-------------------------------------------------------------------------------
+
+void LatencyHistogram::Record(Duration value)
+{
+	uint64_t micros = static_cast<uint64_t>(std::max<int64_t>(value.count(), 0));
+	++m_buckets[GetBucket(micros)];
+	++m_count;
+	m_sum += micros;
+	m_min = std::min(m_min, micros);
+	m_max = std::max(m_max, micros);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other)
+{
+	for (uint32_t i = 0; i < s_bucketCount; ++i)
+	{
+		m_buckets[i] += other.m_buckets[i];
+	}
+	m_count += other.m_count;
+	m_sum += other.m_sum;
+	m_min = std::min(m_min, other.m_min);
+	m_max = std::max(m_max, other.m_max);
+}
+
+void LatencyHistogram::Clear()
+{
+	*this = LatencyHistogram();
+}
+
+LatencyHistogram::Duration LatencyHistogram::GetPercentile(double percentile) const
+{
+	if (m_count == 0)
+	{
+		return Duration::zero();
+	}
+
+	// The rank of the sample wanted, counting from 1.
+	double clamped = std::min(std::max(percentile, 0.0), 100.0);
+	uint64_t rank = std::max<uint64_t>(
+		static_cast<uint64_t>(std::ceil(clamped / 100.0 * m_count)), 1);
+	if (rank == m_count)
+	{
+		return Duration(m_max);
+	}
+
+	uint64_t seen = 0;
+	for (uint32_t i = 0; i < s_bucketCount; ++i)
+	{
+		seen += m_buckets[i];
+		if (seen >= rank)
+		{
+			// A bucket's middle can be past the largest value actually seen.
+			return Duration(std::min(std::max(GetBucketValue(i), m_min), m_max));
+		}
+	}
+	return Duration(m_max);
+}
+
+LatencyHistogram::Duration LatencyHistogram::GetMean() const
+{
+	return m_count ? Duration(m_sum / m_count) : Duration::zero();
+}
+
+uint32_t LatencyHistogram::GetBucket(uint64_t value)
+{
+	if (value < s_linearBuckets)
+	{
+		return static_cast<uint32_t>(value);
+	}
+
+	uint32_t bit = HighestBit(value);
+	uint32_t subBucket = static_cast<uint32_t>(value >> (bit - s_subBucketBits))
+		& ((1 << s_subBucketBits) - 1);
+	return s_linearBuckets + ((bit - 5) << s_subBucketBits) + subBucket;
+}
+
+uint64_t LatencyHistogram::GetBucketValue(uint32_t bucket)
+{
+	if (bucket < s_linearBuckets)
+	{
+		return bucket;
+	}
+
+	uint32_t bit = 5 + ((bucket - s_linearBuckets) >> s_subBucketBits);
+	uint64_t subBucket = (bucket - s_linearBuckets) & ((1 << s_subBucketBits) - 1);
+	uint64_t width = uint64_t(1) << (bit - s_subBucketBits);
+	return ((1 << s_subBucketBits) + subBucket) * width + width / 2;
+}
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,58 @@
+//---------------------------------------------------------------
+//
+// LatencyHistogram.h
+//
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace Common {
+
+//===============================================================================
+
+// Counts durations into log spaced buckets so percentiles can be read off without keeping every
+// sample. Values under 32us get a bucket each, above that each power of two is split into 16,
+// so a percentile is never more than about 3% off. Recording is a few shifts and an increment.
+class LatencyHistogram
+{
+public:
+	using Duration = std::chrono::microseconds;
+
+	void Record(Duration value);
+
+	// Adds every sample from other, as if they'd been recorded here.
+	void Merge(const LatencyHistogram& other);
+
+	void Clear();
+
+	// The value percentile (0 to 100) of the samples are at or below. Zero if there are none.
+	Duration GetPercentile(double percentile) const;
+
+	uint64_t GetCount() const { return m_count; }
+	Duration GetMin() const { return m_count ? Duration(m_min) : Duration::zero(); }
+	Duration GetMax() const { return Duration(m_max); }
+	Duration GetMean() const;
+
+private:
+	static constexpr uint32_t s_linearBuckets = 32;
+	static constexpr uint32_t s_subBucketBits = 4;
+	static constexpr uint32_t s_bucketCount = s_linearBuckets + (64 - 5) * (1 << s_subBucketBits);
+
+	static uint32_t GetBucket(uint64_t value);
+
+	// The middle of the range of values that land in bucket.
+	static uint64_t GetBucketValue(uint32_t bucket);
+
+	std::array<uint64_t, s_bucketCount> m_buckets = {};
+	uint64_t m_count = 0;
+	uint64_t m_sum = 0;
+	uint64_t m_min = UINT64_MAX;
+	uint64_t m_max = 0;
+};
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,50 @@
+//---------------------------------------------------------------
+//
+// MappedFile.h
+//
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace Common {
+
+//===============================================================================
+
+// A whole file mapped read only into memory. Pages are loaded by the OS as they're touched, so
+// opening a large file costs nothing up front.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Closes whatever was open first. Returns false if the file can't be opened or mapped.
+	bool Open(const std::string& path);
+	void Close();
+
+	bool IsOpen() const { return m_data != nullptr || m_isEmpty; }
+
+	// Valid until Close. Empty for an empty file.
+	std::string_view GetData() const { return std::string_view(m_data, m_size); }
+
+private:
+	const char* m_data = nullptr;
+	size_t m_size = 0;
+
+	// Empty files can't be mapped, but they're still open.
+	bool m_isEmpty = false;
+
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#endif
+};
+
+//===============================================================================
+
+} // namespace Common
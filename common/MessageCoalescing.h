@@ -0,0 +1,86 @@
+//---------------------------------------------------------------
+//
+// MessageCoalescing.h
+//
+
+#pragma once
+
+#include "common/NetworkTypes.h"
+
+#include <array>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+namespace Common {
+
+//===============================================================================
+
+// Reads what a latest-value-wins message is about out of its payload, the header not included.
+// Returns false if the payload doesn't have one, in which case the message is queued as usual.
+using CoalesceKeyReader = std::function<bool(std::string_view payload, uint32_t& key)>;
+
+// For payloads that start with the id of the entity they're about.
+inline bool ReadLeadingEntityId(std::string_view payload, uint32_t& key)
+{
+	if (payload.size() < sizeof(key))
+	{
+		return false;
+	}
+
+	std::memcpy(&key, payload.data(), sizeof(key));
+	return true;
+}
+
+// Which message types only matter as the latest of their kind. A queued message of one of these
+// types is replaced by a newer one with the same key, where it sits in the queue, rather than
+// both being sent. A peer that's fallen behind then has at most one of each waiting.
+class MessageCoalescing
+{
+public:
+	MessageCoalescing()
+	{
+		// Only an entity's latest position matters.
+		SetLatestValueWins(MessageId::Move, ReadLeadingEntityId);
+	}
+
+	void SetLatestValueWins(MessageId id, CoalesceKeyReader keyReader)
+	{
+		m_keyReaders[static_cast<uint32_t>(id)] = std::move(keyReader);
+	}
+
+	void SetAlwaysSent(MessageId id)
+	{
+		m_keyReaders[static_cast<uint32_t>(id)] = nullptr;
+	}
+
+	bool IsLatestValueWins(MessageId id) const
+	{
+		uint32_t index = static_cast<uint32_t>(id);
+		return index < MessageIdCount && m_keyReaders[index];
+	}
+
+	// Gets the key of a framed message, with its type in the top half so keys of different
+	// types never match. Returns false if the message isn't latest-value-wins.
+	bool GetKey(std::string_view message, uint64_t& key) const
+	{
+		MessageHeader header;
+		uint32_t payloadKey = 0;
+		if (!PeekHeader(message, header) || !IsLatestValueWins(header.messageType)
+			|| !m_keyReaders[static_cast<uint32_t>(header.messageType)](
+				message.substr(sizeof(header)), payloadKey))
+		{
+			return false;
+		}
+
+		key = (static_cast<uint64_t>(header.messageType) << 32) | payloadKey;
+		return true;
+	}
+
+private:
+	std::array<CoalesceKeyReader, MessageIdCount> m_keyReaders;
+};
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,179 @@
+//---------------------------------------------------------------
+//
+// MessageDispatcher.cpp
+//
+
+#include "common/MessageDispatcher.h"
+
+#include <algorithm>
+
+namespace Common {
+
+//===============================================================================
+
+namespace {
+	struct RawHandler
+	{
+		static void Invoke(void* context, MessageDispatcher::SenderId sender, const void*,
+			std::string_view payload)
+		{
+			static_cast<RawHandler*>(context)->handler(sender, payload);
+		}
+
+		MessageDispatcher::Handler<std::string_view> handler;
+	};
+
+	// Counts a level of Dispatch for as long as it's in scope, even if a handler throws.
+	struct DispatchDepthGuard
+	{
+		explicit DispatchDepthGuard(uint32_t& depth) : depth(depth) { ++depth; }
+		~DispatchDepthGuard() { --depth; }
+
+		uint32_t& depth;
+	};
+
+	google::protobuf::ArenaOptions MakeArenaOptions(std::vector<char>& block)
+	{
+		google::protobuf::ArenaOptions options;
+		options.initial_block = block.data();
+		options.initial_block_size = block.size();
+		return options;
+	}
+} // anon namespace
+
+MessageDispatcher::MessageDispatcher(size_t arenaBlockSize)
+	: m_arenaBlock(arenaBlockSize)
+	, m_arena(std::make_unique<google::protobuf::Arena>(MakeArenaOptions(m_arenaBlock)))
+{
+}
+
+MessageDispatcher::~MessageDispatcher()
+{
+}
+
+void MessageDispatcher::RegisterRawHandler(MessageId id, Handler<std::string_view> handler)
+{
+	auto holder = std::make_shared<RawHandler>();
+	holder->handler = std::move(handler);
+
+	Entry& entry = m_table[static_cast<uint32_t>(id)];
+	entry.decode = nullptr;
+	entry.invoke = &RawHandler::Invoke;
+	entry.context = holder.get();
+	entry.holder = std::move(holder);
+	++entry.generation;
+}
+
+void MessageDispatcher::UnregisterHandler(MessageId id)
+{
+	Entry& entry = m_table[static_cast<uint32_t>(id)];
+	uint32_t generation = entry.generation;
+	entry = Entry();
+	entry.generation = generation + 1;
+}
+
+uint32_t MessageDispatcher::Dispatch(SenderId sender, const MessageBatch& batch)
+{
+	using namespace std::chrono;
+
+	if (m_dispatchDepth == m_pending.size())
+	{
+		m_pending.emplace_back();
+	}
+	std::vector<Pending>& pendingMessages = m_pending[m_dispatchDepth];
+	DispatchDepthGuard depthGuard(m_dispatchDepth);
+
+	// Decode the whole batch up front so handlers run back to back.
+	pendingMessages.clear();
+	for (size_t i = 0; i < batch.Size(); ++i)
+	{
+		NetworkMessageView message = batch[i];
+
+		// Ids come off the wire, so anything out of range is treated as unhandled.
+		uint32_t index = static_cast<uint32_t>(message.header.messageType);
+		if (index >= MessageIdCount || !m_table[index].invoke)
+		{
+			++m_unhandledCount;
+			continue;
+		}
+
+		const void* decoded = nullptr;
+		if (m_table[index].decode)
+		{
+			decoded = m_table[index].decode(*m_arena, message.messageData);
+			if (!decoded)
+			{
+				++m_stats[index].decodeFailures;
+				continue;
+			}
+
+			++m_arenaStats.messagesDecoded;
+		}
+
+		pendingMessages.push_back({ index, m_table[index].generation, decoded, message.messageData });
+	}
+
+	uint32_t handled = 0;
+	for (Pending& pending : pendingMessages)
+	{
+		// A handler may have unregistered or replaced one of the handlers further along, whose
+		// messages were decoded for the old one.
+		const Entry& entry = m_table[pending.index];
+		if (entry.generation != pending.generation)
+		{
+			++m_unhandledCount;
+			pending.index = MessageIdCount;
+			continue;
+		}
+
+		// The handler may replace or unregister itself, so keep it alive until it returns.
+		std::shared_ptr<void> holder = entry.holder;
+		entry.invoke(entry.context, sender, pending.decoded, pending.payload);
+		++handled;
+	}
+
+	// Reading the clock once per batch rather than per message keeps it off the hot path. Every
+	// message is charged the time it took for the whole batch to be handled.
+	auto latency = duration_cast<microseconds>(MessageBatch::Clock::now() - batch.GetReceivedAt());
+	for (const Pending& pending : pendingMessages)
+	{
+		if (pending.index == MessageIdCount)
+		{
+			continue;
+		}
+
+		MessageDispatchStats& stats = m_stats[pending.index];
+		++stats.dispatched;
+		stats.totalLatency += latency;
+		stats.maxLatency = std::max(stats.maxLatency, latency);
+	}
+
+	return handled;
+}
+
+void MessageDispatcher::EndTick()
+{
+	uint64_t used = m_arena->SpaceUsed();
+	m_arenaStats.lastTickBytes = used;
+	m_arenaStats.peakTickBytes = std::max(m_arenaStats.peakTickBytes, used);
+	++m_arenaStats.ticks;
+
+	// Heap blocks are freed here. The initial block is kept for the next tick.
+	m_arena->Reset();
+}
+
+const MessageDispatchStats& MessageDispatcher::GetStats(MessageId id) const
+{
+	return m_stats[static_cast<uint32_t>(id)];
+}
+
+void MessageDispatcher::ResetStats()
+{
+	m_stats.fill(MessageDispatchStats());
+	m_unhandledCount = 0;
+	m_arenaStats = MessageArenaStats();
+}
+
+//===============================================================================
+
+} // namespace Common
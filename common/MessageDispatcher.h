@@ -0,0 +1,191 @@
+//---------------------------------------------------------------
+//
+// MessageDispatcher.h
+//
+
+#pragma once
+
+#include "common/NetworkTypes.h"
+
+#include <google/protobuf/arena.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace Common {
+
+//===============================================================================
+
+// How long messages of one type waited between arriving and their batch being handled.
+struct MessageDispatchStats
+{
+	uint64_t dispatched = 0;
+
+	// Messages that failed to decode.
+	uint64_t decodeFailures = 0;
+
+	std::chrono::microseconds totalLatency = std::chrono::microseconds::zero();
+	std::chrono::microseconds maxLatency = std::chrono::microseconds::zero();
+
+	std::chrono::microseconds AverageLatency() const
+	{
+		if (dispatched == 0)
+		{
+			return std::chrono::microseconds::zero();
+		}
+
+		return totalLatency / static_cast<int64_t>(dispatched);
+	}
+};
+
+// Memory used to decode messages between calls to EndTick.
+struct MessageArenaStats
+{
+	uint64_t messagesDecoded = 0;
+	uint64_t ticks = 0;
+
+	// Arena bytes used by the last tick and by the busiest tick so far. Anything over the size of
+	// the dispatcher's initial block came from the heap.
+	uint64_t lastTickBytes = 0;
+	uint64_t peakTickBytes = 0;
+};
+
+// Routes parsed messages to handlers. Each MessageId indexes straight into a table holding a
+// decoder and a handler registered up front, so delivering a message costs one array index and
+// one call through a function pointer. Meant to be driven from the game thread with whole
+// batches of messages at a time.
+//
+// Protobuf messages are decoded into an arena. Every message in a batch is decoded before any
+// handler runs, and all of them stay valid until EndTick resets the arena, so a tick's worth of
+// decoding costs a few pointer bumps instead of a heap allocation per message and field.
+class MessageDispatcher
+{
+public:
+	// Who the messages came from. The client id on the server, 0 on the client.
+	using SenderId = uint32_t;
+
+	template <typename T>
+	using Handler = std::function<void(SenderId sender, const T& message)>;
+
+	// The arena starts out with a block of arenaBlockSize bytes that's kept across ticks. Ticks
+	// that need more than that fall back to heap allocated blocks until the next EndTick.
+	MessageDispatcher(size_t arenaBlockSize = 64 * 1024);
+	~MessageDispatcher();
+
+	// Registers a handler for a protobuf message type. T must be generated with
+	// cc_enable_arenas, otherwise it's heap allocated and only owned by the arena.
+	// Replaces any handler already registered for id.
+	template <typename T>
+	void RegisterHandler(MessageId id, Handler<T> handler)
+	{
+		auto holder = std::make_shared<TypedHandler<T>>();
+		holder->handler = std::move(handler);
+
+		Entry& entry = m_table[static_cast<uint32_t>(id)];
+		entry.decode = &TypedHandler<T>::Decode;
+		entry.invoke = &TypedHandler<T>::Invoke;
+		entry.context = holder.get();
+		entry.holder = std::move(holder);
+		++entry.generation;
+	}
+
+	// Registers a handler that gets the raw payload instead of a decoded message.
+	void RegisterRawHandler(MessageId id, Handler<std::string_view> handler);
+
+	void UnregisterHandler(MessageId id);
+
+	// Decodes every message in the batch, then hands each one to its handler in order.
+	// Messages whose handler is unregistered or replaced by an earlier handler in the batch
+	// are counted as unhandled. Handlers may call Dispatch themselves, and may replace or
+	// unregister any handler, their own included.
+	// Returns the number of messages that were handled.
+	uint32_t Dispatch(SenderId sender, const MessageBatch& batch);
+
+	// Frees everything decoded since the last call. Call once per tick after all batches have
+	// been dispatched. Messages handed to handlers must not be used afterwards.
+	void EndTick();
+
+	const MessageDispatchStats& GetStats(MessageId id) const;
+	const MessageArenaStats& GetArenaStats() const { return m_arenaStats; }
+
+	// Messages that arrived with an id nothing was registered for.
+	uint64_t GetUnhandledCount() const { return m_unhandledCount; }
+
+	void ResetStats();
+
+private:
+	// Returns the decoded message, or nullptr if the payload couldn't be decoded.
+	using DecodeFn = const void*(*)(google::protobuf::Arena& arena, std::string_view payload);
+	using InvokeFn = void(*)(void* context, SenderId sender, const void* decoded,
+		std::string_view payload);
+
+	struct Entry
+	{
+		// Null for raw handlers, which get the payload as is.
+		DecodeFn decode = nullptr;
+		InvokeFn invoke = nullptr;
+		void* context = nullptr;
+
+		// Owns whatever context points at.
+		std::shared_ptr<void> holder;
+
+		// Bumped whenever the handler is registered or unregistered.
+		uint32_t generation = 0;
+	};
+
+	// A message that's been decoded and is waiting for its handler. Only handed over if the
+	// entry's generation is still the one it was decoded for.
+	struct Pending
+	{
+		uint32_t index;
+		uint32_t generation;
+		const void* decoded;
+		std::string_view payload;
+	};
+
+	template <typename T>
+	struct TypedHandler
+	{
+		static const void* Decode(google::protobuf::Arena& arena, std::string_view payload)
+		{
+			T* message = google::protobuf::Arena::CreateMessage<T>(&arena);
+			if (!message->ParseFromArray(payload.data(), static_cast<int>(payload.size())))
+			{
+				return nullptr;
+			}
+
+			return message;
+		}
+
+		static void Invoke(void* context, SenderId sender, const void* decoded, std::string_view)
+		{
+			static_cast<TypedHandler*>(context)->handler(sender, *static_cast<const T*>(decoded));
+		}
+
+		Handler<T> handler;
+	};
+
+	std::array<Entry, MessageIdCount> m_table;
+	std::array<MessageDispatchStats, MessageIdCount> m_stats;
+	uint64_t m_unhandledCount = 0;
+
+	// Kept across ticks and handed to the arena as its first block.
+	std::vector<char> m_arenaBlock;
+	std::unique_ptr<google::protobuf::Arena> m_arena;
+	MessageArenaStats m_arenaStats;
+
+	// Reused by Dispatch so staging a batch doesn't allocate once it's warmed up. One per level
+	// of Dispatch called from a handler, in a deque so the outer ones stay put as it grows.
+	std::deque<std::vector<Pending>> m_pending;
+	uint32_t m_dispatchDepth = 0;
+};
+
+//===============================================================================
+
+} // namespace Common
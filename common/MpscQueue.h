@@ -0,0 +1,217 @@
+//---------------------------------------------------------------
+//
+// MpscQueue.h
+//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+
+namespace Common {
+
+//==============================================================================
+
+// Lock-free multi-producer / single-consumer queue for handing work between threads.
+//
+// Producers push onto an intrusive stack with a single CAS. The consumer takes everything that
+// has been pushed so far with one atomic exchange, reverses it back into push order and hands
+// the items out. Nodes are then returned to a free list in one go, so once the queue has
+// grown to its working size, pushing never allocates.
+//
+// Nodes are addressed by index rather than pointer so the free list head can carry an ABA tag
+// in the same 64 bit word. Storage grows in fixed size chunks that are never freed or moved.
+template<class T>
+class MpscQueue
+{
+public:
+	MpscQueue() = default;
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	~MpscQueue()
+	{
+		// Anything still queued is destroyed along with its chunk.
+		for (auto& chunk : m_chunks)
+		{
+			delete[] chunk.load(std::memory_order_relaxed);
+		}
+	}
+
+	// Push onto the queue. Safe to call from any thread.
+	template <typename U>
+	void Push(U&& item)
+	{
+		uint32_t index = AcquireNode();
+		Node& node = GetNode(index);
+		node.item = std::forward<U>(item);
+
+		uint32_t head = m_head.load(std::memory_order_relaxed);
+		do
+		{
+			node.next.store(head, std::memory_order_relaxed);
+		} while (!m_head.compare_exchange_weak(head, index,
+			std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	// Takes everything pushed so far and calls fn(T&) on each item in the order it was pushed.
+	// Only the consumer thread may call this. Returns the number of items handled.
+	template <typename Fn>
+	uint32_t ConsumeAll(Fn&& fn)
+	{
+		uint32_t index = m_head.exchange(s_nil, std::memory_order_acquire);
+		if (index == s_nil)
+		{
+			return 0;
+		}
+
+		// The stack comes out newest first. Flip it so items are handled in push order.
+		uint32_t reversed = s_nil;
+		uint32_t last = index;
+		while (index != s_nil)
+		{
+			Node& node = GetNode(index);
+			uint32_t next = node.next.load(std::memory_order_relaxed);
+			node.next.store(reversed, std::memory_order_relaxed);
+			reversed = index;
+			index = next;
+		}
+
+		uint32_t count = 0;
+		for (index = reversed; index != s_nil;
+			index = GetNode(index).next.load(std::memory_order_relaxed))
+		{
+			Node& node = GetNode(index);
+			fn(node.item);
+
+			// Release whatever the item holds now rather than when the node is reused.
+			node.item = T();
+			++count;
+		}
+
+		ReleaseNodes(reversed, last);
+		return count;
+	}
+
+	// Returns true if nothing is waiting to be consumed. Only a hint when producers are active.
+	bool IsEmpty() const
+	{
+		return m_head.load(std::memory_order_relaxed) == s_nil;
+	}
+
+private:
+	static constexpr uint32_t s_nil = ~0u;
+	static constexpr uint32_t s_chunkShift = 10;
+	static constexpr uint32_t s_chunkSize = 1u << s_chunkShift;
+	static constexpr uint32_t s_maxChunks = 1024;
+
+	struct Node
+	{
+		T item;
+		std::atomic<uint32_t> next{ s_nil };
+	};
+
+	Node& GetNode(uint32_t index)
+	{
+		Node* chunk = m_chunks[index >> s_chunkShift].load(std::memory_order_acquire);
+		return chunk[index & (s_chunkSize - 1)];
+	}
+
+	// Pops a node off the free list, growing the pool if it's empty.
+	uint32_t AcquireNode()
+	{
+		uint32_t index = s_nil;
+		if (TryPopFree(index))
+		{
+			return index;
+		}
+
+		return Grow();
+	}
+
+	bool TryPopFree(uint32_t& index)
+	{
+		uint64_t head = m_freeHead.load(std::memory_order_acquire);
+		while (static_cast<uint32_t>(head) != s_nil)
+		{
+			// The tag changes on every pop and push, so a node that was popped and pushed back
+			// while we were looking at it can't fool the CAS.
+			Node& node = GetNode(static_cast<uint32_t>(head));
+			uint32_t next = node.next.load(std::memory_order_relaxed);
+			if (m_freeHead.compare_exchange_weak(head, Pack(Tag(head) + 1, next),
+				std::memory_order_acquire, std::memory_order_acquire))
+			{
+				index = static_cast<uint32_t>(head);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Pushes an already linked run of nodes onto the free list in one go.
+	void ReleaseNodes(uint32_t first, uint32_t last)
+	{
+		Node& lastNode = GetNode(last);
+		uint64_t head = m_freeHead.load(std::memory_order_relaxed);
+		do
+		{
+			lastNode.next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+		} while (!m_freeHead.compare_exchange_weak(head, Pack(Tag(head) + 1, first),
+			std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	// Adds a chunk of nodes. Keeps one for the caller and frees the rest.
+	uint32_t Grow()
+	{
+		std::lock_guard<std::mutex> lock(m_growMutex);
+
+		// Someone may have grown the pool while we waited.
+		uint32_t index = s_nil;
+		if (TryPopFree(index))
+		{
+			return index;
+		}
+
+		if (m_chunkCount == s_maxChunks)
+		{
+			throw std::bad_alloc();
+		}
+
+		uint32_t base = m_chunkCount << s_chunkShift;
+		Node* chunk = new Node[s_chunkSize];
+		for (uint32_t i = 1; i < s_chunkSize - 1; ++i)
+		{
+			chunk[i].next.store(base + i + 1, std::memory_order_relaxed);
+		}
+		m_chunks[m_chunkCount].store(chunk, std::memory_order_release);
+		++m_chunkCount;
+
+		ReleaseNodes(base + 1, base + s_chunkSize - 1);
+		return base;
+	}
+
+	static constexpr uint32_t Tag(uint64_t packed) { return static_cast<uint32_t>(packed >> 32); }
+	static constexpr uint64_t Pack(uint32_t tag, uint32_t index)
+	{
+		return (static_cast<uint64_t>(tag) << 32) | index;
+	}
+
+	// Top of the stack of pushed, not yet consumed nodes.
+	std::atomic<uint32_t> m_head{ s_nil };
+
+	// Tag in the high 32 bits, index of the first free node in the low 32 bits.
+	std::atomic<uint64_t> m_freeHead{ Pack(0, s_nil) };
+
+	std::array<std::atomic<Node*>, s_maxChunks> m_chunks{};
+	uint32_t m_chunkCount = 0;
+	std::mutex m_growMutex;
+};
+
+//==============================================================================
+
+} // namespace Common
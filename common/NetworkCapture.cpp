@@ -0,0 +1,273 @@
+//---------------------------------------------------------------
+//
+// NetworkCapture.cpp
+//
+
+#include "common/NetworkCapture.h"
+
+#include "common/NetworkMessageParser.h"
+#include "common/ReceiveRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace Common {
+
+//===============================================================================
+
+namespace {
+	// Same as TcpSession reads into, so records are parsed in the same sized pieces.
+	const uint32_t s_ringCapacity = 32768;
+} // anon namespace
+
+//-------------------------------------------------------------------------------
+
+CaptureWriter::~CaptureWriter()
+{
+	Close();
+}
+
+bool CaptureWriter::Open(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_file.is_open())
+	{
+		m_file.close();
+	}
+
+	m_file.open(path, std::ios::binary | std::ios::trunc);
+	if (!m_file)
+	{
+		return false;
+	}
+
+	CaptureFileHeader header;
+	m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	m_recordCount = 0;
+	m_clock.Restart();
+	return static_cast<bool>(m_file);
+}
+
+void CaptureWriter::Close()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_file.is_open())
+	{
+		m_file.close();
+	}
+}
+
+bool CaptureWriter::IsOpen() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_file.is_open();
+}
+
+void CaptureWriter::Record(uint32_t sessionId, std::string_view data)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_file.is_open())
+	{
+		return;
+	}
+
+	CaptureRecordHeader header;
+	header.timestamp = static_cast<uint64_t>(m_clock.GetElapsedUs().count());
+	header.sessionId = sessionId;
+	header.size = static_cast<uint32_t>(data.size());
+	m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	m_file.write(data.data(), data.size());
+	++m_recordCount;
+}
+
+void CaptureWriter::Flush()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_file.flush();
+}
+
+uint64_t CaptureWriter::GetRecordCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_recordCount;
+}
+
+//-------------------------------------------------------------------------------
+
+bool CaptureReader::Open(const std::string& path)
+{
+	if (!m_file.Open(path))
+	{
+		return false;
+	}
+
+	CaptureFileHeader header;
+	std::string_view data = m_file.GetData();
+	if (data.size() < sizeof(header))
+	{
+		m_file.Close();
+		return false;
+	}
+
+	std::memcpy(&header, data.data(), sizeof(header));
+	if (header.magic != CaptureFileHeader::s_magic || header.version != CaptureFileHeader::s_version)
+	{
+		m_file.Close();
+		return false;
+	}
+
+	Rewind();
+	return true;
+}
+
+bool CaptureReader::Next(CaptureRecord& record)
+{
+	std::string_view data = m_file.GetData();
+	CaptureRecordHeader header;
+	if (m_offset == data.size())
+	{
+		return false;
+	}
+
+	m_isTruncated = data.size() - m_offset < sizeof(header);
+	if (!m_isTruncated)
+	{
+		std::memcpy(&header, data.data() + m_offset, sizeof(header));
+		m_isTruncated = data.size() - m_offset - sizeof(header) < header.size;
+	}
+
+	if (m_isTruncated)
+	{
+		return false;
+	}
+
+	record.timestamp = std::chrono::microseconds(header.timestamp);
+	record.sessionId = header.sessionId;
+	record.data = data.substr(m_offset + sizeof(header), header.size);
+	m_offset += sizeof(header) + header.size;
+	return true;
+}
+
+void CaptureReader::Rewind()
+{
+	m_offset = sizeof(CaptureFileHeader);
+	m_isTruncated = false;
+}
+
+//-------------------------------------------------------------------------------
+
+struct CaptureReplayer::Session
+{
+	ReceiveRing ring{ s_ringCapacity };
+	NetworkMessageParser parser;
+	bool isDropped = false;
+};
+
+CaptureReplayer::CaptureReplayer(uint32_t maxFrameSize, WireFormat wireFormat)
+	: m_maxFrameSize(maxFrameSize)
+	, m_wireFormat(wireFormat)
+{
+	m_messages.reserve(1024);
+}
+
+CaptureReplayer::~CaptureReplayer()
+{
+}
+
+ReplayStats CaptureReplayer::Replay(CaptureReader& reader, ReplaySpeed speed)
+{
+	using Clock = std::chrono::steady_clock;
+
+	ReplayStats stats;
+	Clock::time_point startedAt = Clock::now();
+	std::chrono::microseconds firstTimestamp = std::chrono::microseconds::zero();
+
+	CaptureRecord record;
+	while (reader.Next(record))
+	{
+		if (stats.records == 0)
+		{
+			firstTimestamp = record.timestamp;
+		}
+
+		if (speed == ReplaySpeed::Recorded)
+		{
+			std::this_thread::sleep_until(startedAt + (record.timestamp - firstTimestamp));
+		}
+
+		std::unique_ptr<Session>& session = m_sessions[record.sessionId];
+		if (!session)
+		{
+			session = std::make_unique<Session>();
+			session->parser.SetMaxFrameSize(m_maxFrameSize);
+			session->parser.SetWireFormat(m_wireFormat);
+		}
+
+		++stats.records;
+		stats.bytes += record.data.size();
+		if (!session->isDropped)
+		{
+			Feed(*session, record.sessionId, record.data, stats);
+		}
+	}
+
+	stats.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+		Clock::now() - startedAt);
+	return stats;
+}
+
+void CaptureReplayer::Reset()
+{
+	m_sessions.clear();
+}
+
+void CaptureReplayer::Feed(Session& session, uint32_t sessionId, std::string_view data,
+	ReplayStats& stats)
+{
+	// A record is never more than the ring holds unless it was captured with a bigger one.
+	while (!data.empty())
+	{
+		uint32_t size = std::min(session.ring.WriteSize(), static_cast<uint32_t>(data.size()));
+		std::memcpy(session.ring.WriteData(), data.data(), size);
+		session.ring.CommitWrite(size);
+		data.remove_prefix(size);
+
+		if (!session.parser.ExtractMessages(session.ring, m_messages))
+		{
+			session.isDropped = true;
+			++stats.sessionsDropped;
+			m_messages.clear();
+			return;
+		}
+
+		if (m_messages.empty())
+		{
+			continue;
+		}
+
+		stats.messages += m_messages.size();
+		++stats.batches;
+		if (m_handler)
+		{
+			size_t byteCount = 0;
+			for (const NetworkMessageView& message : m_messages)
+			{
+				byteCount += message.messageData.size();
+			}
+
+			auto batch = std::make_shared<MessageBatch>();
+			batch->Reserve(m_messages.size(), byteCount);
+			for (const NetworkMessageView& message : m_messages)
+			{
+				batch->Append(message);
+			}
+			m_handler(sessionId, std::move(batch));
+		}
+		m_messages.clear();
+	}
+}
+
+//===============================================================================
+
+} // namespace Common
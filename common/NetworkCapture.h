@@ -0,0 +1,167 @@
+//---------------------------------------------------------------
+//
+// NetworkCapture.h
+//
+
+#pragma once
+
+#include "common/MappedFile.h"
+#include "common/NetworkTypes.h"
+#include "common/Timer.h"
+#include "common/WireFormat.h"
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Common {
+
+//===============================================================================
+
+// A capture file is a CaptureFileHeader followed by one record per socket read, each a
+// CaptureRecordHeader and the bytes read, in the order they arrived across every session.
+// Everything is in the byte order of the machine that wrote it.
+struct CaptureFileHeader
+{
+	static constexpr uint32_t s_magic = 0x50435948; // "HYCP"
+	static constexpr uint32_t s_version = 1;
+
+	uint32_t magic = s_magic;
+	uint32_t version = s_version;
+};
+
+struct CaptureRecordHeader
+{
+	// Microseconds since the capture was opened.
+	uint64_t timestamp = 0;
+	uint32_t sessionId = 0;
+	uint32_t size = 0;
+};
+
+// One socket read, as read back from a capture. data points into the mapped file.
+struct CaptureRecord
+{
+	std::chrono::microseconds timestamp = std::chrono::microseconds::zero();
+	uint32_t sessionId = 0;
+	std::string_view data;
+};
+
+// Appends what sessions read to a capture file. Any number of sessions, on any threads, can
+// share one writer. Writes go through the stream's buffer, so recording costs a lock and a copy.
+class CaptureWriter
+{
+public:
+	~CaptureWriter();
+
+	// Starts a new capture, replacing anything already at path.
+	bool Open(const std::string& path);
+	void Close();
+	bool IsOpen() const;
+
+	void Record(uint32_t sessionId, std::string_view data);
+
+	// Pushes buffered records out to the file.
+	void Flush();
+
+	uint64_t GetRecordCount() const;
+
+private:
+	mutable std::mutex m_mutex;
+	std::ofstream m_file;
+	Timer m_clock;
+	uint64_t m_recordCount = 0;
+};
+
+// Walks the records of a capture file in place, without copying them.
+class CaptureReader
+{
+public:
+	// Returns false if the file can't be mapped or isn't a capture.
+	bool Open(const std::string& path);
+	void Close() { m_file.Close(); }
+
+	// Fills record with the next one. Returns false at the end of the capture, or at a record
+	// cut short, which happens if the writer didn't get to close the file.
+	bool Next(CaptureRecord& record);
+
+	// Back to the first record.
+	void Rewind();
+
+	// True if the last Next stopped at a record that was cut short.
+	bool IsTruncated() const { return m_isTruncated; }
+
+private:
+	MappedFile m_file;
+	size_t m_offset = 0;
+	bool m_isTruncated = false;
+};
+
+enum class ReplaySpeed : uint32_t
+{
+	// Each record is delivered when it arrived, relative to the first.
+	Recorded,
+
+	// No waiting. For throughput benchmarks.
+	AsFastAsPossible
+};
+
+struct ReplayStats
+{
+	uint64_t records = 0;
+	uint64_t bytes = 0;
+	uint64_t batches = 0;
+	uint64_t messages = 0;
+
+	// Sessions whose stream went bad, by sending a malformed frame or one over the size limit.
+	// Nothing more is parsed for them, as a live session would have been closed.
+	uint32_t sessionsDropped = 0;
+
+	std::chrono::microseconds elapsed = std::chrono::microseconds::zero();
+};
+
+// Gets every message parsed out of one recorded read. Same shape as a UDP channel's handler,
+// so a dispatcher can be fed the same way.
+using CaptureBatchHandler = std::function<void(uint32_t sessionId,
+	std::shared_ptr<MessageBatch> batch)>;
+
+// Feeds a capture back through a NetworkMessageParser per session, the same way TcpSession
+// parses what it reads, and hands each record's messages to the handler as a batch. The wire
+// format has to match what the sessions were configured with when the capture was taken.
+class CaptureReplayer
+{
+public:
+	explicit CaptureReplayer(uint32_t maxFrameSize = 1024 * 1024,
+		WireFormat wireFormat = WireFormat::Legacy);
+	~CaptureReplayer();
+
+	void SetMessageBatchHandler(CaptureBatchHandler handler) { m_handler = std::move(handler); }
+
+	// Replays from wherever the reader is up to, to the end. Sessions carry over between calls,
+	// so call Reset before replaying a capture from the start again.
+	ReplayStats Replay(CaptureReader& reader, ReplaySpeed speed);
+
+	// Forgets every session and any partial frames they had.
+	void Reset();
+
+private:
+	struct Session;
+
+	void Feed(Session& session, uint32_t sessionId, std::string_view data, ReplayStats& stats);
+
+	uint32_t m_maxFrameSize;
+	WireFormat m_wireFormat;
+	CaptureBatchHandler m_handler;
+	std::unordered_map<uint32_t, std::unique_ptr<Session>> m_sessions;
+	std::vector<NetworkMessageView> m_messages;
+};
+
+//===============================================================================
+
+} // namespace Common
@@ -4,10 +4,13 @@
 //
 
 #include "common/NetworkMessageParser.h"
+#include "common/FrameCompression.h"
 #include "common/Log.h"
 #include "common/NetworkTypes.h"
+#include "common/ReceiveRing.h"
 
 #include <algorithm>
+#include <assert.h>
 
 
 namespace Common {
@@ -19,13 +22,23 @@ namespace {
 
 	// Increase if needed, but most streams should be smaller than this.
 	const int32_t s_defaultReservedBytes = 512;
+
+	// Ring mode scratch buffers bigger than this are freed once the frame they held is done
+	// with, rather than kept at the biggest frame a session has ever seen.
+	const size_t s_maxKeptScratchBytes = 4096;
+
+	void ReleaseIfLarge(std::string& buffer)
+	{
+		if (buffer.capacity() > s_maxKeptScratchBytes)
+		{
+			std::string().swap(buffer);
+		}
+	}
 }
 
 NetworkMessageParser::NetworkMessageParser()
 	: m_activeBuffer(&m_firstBuffer)
 {
-	m_firstBuffer.reserve(s_defaultReservedBytes);
-	m_secondBuffer.reserve(s_defaultReservedBytes);
 }
 
 NetworkMessageParser::~NetworkMessageParser()
@@ -36,6 +49,14 @@ NetworkMessageParser::~NetworkMessageParser()
 void NetworkMessageParser::ExtractMessages(const std::string& stream,
 	std::vector<Common::NetworkMessage>& messages)
 {
+	// Only reserved once the parser is used this way. Ring mode never touches these.
+	if (!m_isLegacyReserved)
+	{
+		m_isLegacyReserved = true;
+		m_firstBuffer.reserve(s_defaultReservedBytes);
+		m_secondBuffer.reserve(s_defaultReservedBytes);
+	}
+
 	while (m_totalBytesParsed < stream.size())
 	{
 		if (m_state == State::Header || m_state == State::Content)
@@ -54,6 +75,237 @@ void NetworkMessageParser::ExtractMessages(const std::string& stream,
 }
 
 
+bool NetworkMessageParser::ExtractMessages(ReceiveRing& ring,
+	std::vector<NetworkMessageView>& messages)
+{
+	// Views handed out last time are done with, so their inflated payloads can be reused, and
+	// whatever a big frame left behind can go.
+	m_inflatedCount = 0;
+	ReleaseScratch();
+
+	// Finish off a frame that was too big for the ring before looking for new ones.
+	bool spilledThisCall = false;
+	if (m_isSpilling)
+	{
+		if (!ContinueSpill(ring))
+		{
+			return true;
+		}
+
+		if (!Deliver(m_spillFrame, m_spillBuffer, messages))
+		{
+			return false;
+		}
+		spilledThisCall = true;
+	}
+
+	if (m_wireFormat == WireFormat::Compact && !m_hasPreamble)
+	{
+		char preamble[s_wirePreambleSize];
+		if (ring.ReadSize() < s_wirePreambleSize)
+		{
+			return true;
+		}
+
+		ring.Peek(0, preamble, s_wirePreambleSize);
+		if (!IsWirePreamble(preamble))
+		{
+			return false;
+		}
+
+		ring.Consume(s_wirePreambleSize);
+		m_hasPreamble = true;
+	}
+
+	bool wrappedThisCall = false;
+	Frame frame;
+	for (;;)
+	{
+		WireDecodeResult result = PeekFrame(ring, frame);
+		if (result != WireDecodeResult::Complete)
+		{
+			return result == WireDecodeResult::Partial;
+		}
+
+		const MessageHeader& header = frame.header;
+
+		// The length comes straight off the wire. Don't let it decide how much we allocate.
+		// Checked before the header's added on, which can't overflow for a length under the cap.
+		if (header.messageLength > m_maxFrameSize)
+		{
+			return false;
+		}
+
+		assert(header.messageLength <= UINT32_MAX - frame.headerSize);
+		const uint32_t frameSize = frame.headerSize + header.messageLength;
+		if (frameSize > ring.Capacity())
+		{
+			// The spill buffer may still back a view handed out above. Pick this up next time.
+			if (spilledThisCall)
+			{
+				return true;
+			}
+
+			ring.Consume(frame.headerSize);
+			m_spillFrame = frame;
+			m_spillBuffer.clear();
+			m_spillBuffer.reserve(header.messageLength);
+			m_isSpilling = true;
+
+			if (!ContinueSpill(ring))
+			{
+				return true;
+			}
+
+			if (!Deliver(m_spillFrame, m_spillBuffer, messages))
+			{
+				return false;
+			}
+			spilledThisCall = true;
+			continue;
+		}
+
+		// Still partial, leave it where it is until the rest arrives.
+		if (ring.ReadSize() < frameSize)
+		{
+			return true;
+		}
+
+		std::string_view payload;
+		if (const char* data = ring.Contiguous(frame.headerSize, header.messageLength))
+		{
+			payload = std::string_view(data, header.messageLength);
+		}
+		else
+		{
+			// Everything readable fits in the ring, so at most one frame per call can wrap.
+			assert(!wrappedThisCall);
+			wrappedThisCall = true;
+
+			m_wrapBuffer.resize(header.messageLength);
+			ring.Peek(frame.headerSize, &m_wrapBuffer[0], header.messageLength);
+			payload = m_wrapBuffer;
+		}
+
+		if (!Deliver(frame, payload, messages))
+		{
+			return false;
+		}
+		ring.Consume(frameSize);
+	}
+}
+
+CompressionStats NetworkMessageParser::GetDecompressionStats() const
+{
+	return m_decompressor ? m_decompressor->GetStats() : CompressionStats();
+}
+
+WireDecodeResult NetworkMessageParser::PeekFrame(const ReceiveRing& ring, Frame& frame) const
+{
+	if (m_wireFormat == WireFormat::Legacy)
+	{
+		if (ring.ReadSize() < s_headerSize)
+		{
+			return WireDecodeResult::Partial;
+		}
+
+		ring.Peek(0, &frame.header, s_headerSize);
+		frame.headerSize = s_headerSize;
+		return WireDecodeResult::Complete;
+	}
+
+	// Decode in place unless the header straddles the end of the ring.
+	uint32_t size = std::min(ring.ReadSize(), s_maxCompactHeaderSize);
+	char scratch[s_maxCompactHeaderSize];
+	const char* data = ring.Contiguous(0, size);
+	if (!data)
+	{
+		ring.Peek(0, scratch, size);
+		data = scratch;
+	}
+
+	CompactFrameHeader header;
+	WireDecodeResult result = DecodeCompactHeader(data, size, header);
+	frame.header.messageType = header.messageType;
+	frame.header.messageLength = header.messageLength;
+	frame.headerSize = header.size;
+	frame.flags = header.flags;
+	frame.checksum = header.checksum;
+	return result;
+}
+
+bool NetworkMessageParser::Deliver(const Frame& frame, std::string_view payload,
+	std::vector<NetworkMessageView>& messages)
+{
+	// The checksum covers the payload as it was sent, compressed or not.
+	if ((frame.flags & CompactFrameChecksum) && Crc32(payload) != frame.checksum)
+	{
+		return false;
+	}
+
+	if (!(frame.flags & CompactFrameCompressed))
+	{
+		messages.push_back({ frame.header, payload });
+		return true;
+	}
+
+	if (!m_decompressor)
+	{
+		m_decompressor = std::make_unique<FrameDecompressor>();
+	}
+
+	// A deque so earlier payloads stay put while more are added.
+	if (m_inflatedCount == m_inflated.size())
+	{
+		m_inflated.emplace_back();
+	}
+
+	std::string& inflated = m_inflated[m_inflatedCount++];
+	if (!m_decompressor->Decompress(payload, m_maxFrameSize, inflated))
+	{
+		return false;
+	}
+
+	MessageHeader header = frame.header;
+	header.messageLength = static_cast<uint32_t>(inflated.size());
+	messages.push_back({ header, inflated });
+	return true;
+}
+
+void NetworkMessageParser::ReleaseScratch()
+{
+	ReleaseIfLarge(m_wrapBuffer);
+	if (!m_isSpilling)
+	{
+		ReleaseIfLarge(m_spillBuffer);
+	}
+
+	for (std::string& inflated : m_inflated)
+	{
+		ReleaseIfLarge(inflated);
+	}
+}
+
+bool NetworkMessageParser::ContinueSpill(ReceiveRing& ring)
+{
+	uint32_t remaining = m_spillFrame.header.messageLength
+		- static_cast<uint32_t>(m_spillBuffer.size());
+	uint32_t sizeToCopy = std::min(remaining, ring.ReadSize());
+
+	size_t oldSize = m_spillBuffer.size();
+	m_spillBuffer.resize(oldSize + sizeToCopy);
+	ring.Peek(0, &m_spillBuffer[oldSize], sizeToCopy);
+	ring.Consume(sizeToCopy);
+
+	if (sizeToCopy < remaining)
+	{
+		return false;
+	}
+
+	m_isSpilling = false;
+	return true;
+}
+
 void NetworkMessageParser::Parse(const std::string& stream)
 {
 	uint32_t bytesRemaining = stream.size() - m_totalBytesParsed;
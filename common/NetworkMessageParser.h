@@ -5,6 +5,13 @@
 
 #pragma once
 
+#include "common/FrameCompression.h"
+#include "common/NetworkTypes.h"
+#include "common/WireFormat.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <vector>
 #include <string>
@@ -13,19 +20,68 @@ namespace Common {
 
 //===============================================================================
 
-struct MessageHeader;
-struct NetworkMessage;
+class ReceiveRing;
 class NetworkMessageParser
 {
 public:
 	NetworkMessageParser();
 	~NetworkMessageParser();
 
-	// Will attempt to extract NetworkMessages out of a stream.
+	// Will attempt to extract NetworkMessages out of a stream. Legacy frames only.
 	void ExtractMessages(const std::string& stream, std::vector<NetworkMessage>& messages);
 
+	// Zero copy mode. Consumes every complete frame in the ring and appends a view of it to
+	// messages. Payloads point into the ring, so views are only valid until the ring is
+	// written to again or this is called again. Partial frames are left in the ring. The only
+	// copies made are for a frame that wraps the end of the ring, one too big to ever fit, or
+	// one that has to be inflated.
+	// Returns false if a header claims a payload bigger than the max frame size, or the stream
+	// is otherwise malformed for its wire format. The stream can't be trusted past that point,
+	// so the caller should drop the connection.
+	bool ExtractMessages(ReceiveRing& ring, std::vector<NetworkMessageView>& messages);
+
+	// How ring mode expects frames to be laid out. Set before anything is parsed.
+	void SetWireFormat(WireFormat format) { m_wireFormat = format; }
+	WireFormat GetWireFormat() const { return m_wireFormat; }
+
+	// Largest payload the ring mode will accept. Nothing is allocated for a frame until its
+	// header has been checked against this. Capped so a payload at the limit plus its header
+	// still fits in 32 bits.
+	void SetMaxFrameSize(uint32_t maxFrameSize)
+	{
+		m_maxFrameSize = std::min(maxFrameSize, UINT32_MAX - s_maxCompactHeaderSize);
+	}
+	uint32_t GetMaxFrameSize() const { return m_maxFrameSize; }
+
+	// What's been inflated out of compressed compact frames so far.
+	CompressionStats GetDecompressionStats() const;
+
 private:
+	// A header read off the ring, along with what the compact format adds to it.
+	struct Frame
+	{
+		MessageHeader header;
+		uint32_t headerSize = 0;
+		uint32_t flags = CompactFrameNone;
+		uint32_t checksum = 0;
+	};
+
 	void Parse(const std::string& stream);
+
+	// Reads the next frame's header without consuming it.
+	WireDecodeResult PeekFrame(const ReceiveRing& ring, Frame& frame) const;
+
+	// Checks the payload against the frame's checksum, inflates it if it's compressed, and adds
+	// it to messages. Returns false if it fails either.
+	bool Deliver(const Frame& frame, std::string_view payload,
+		std::vector<NetworkMessageView>& messages);
+
+	// Frees the ring mode scratch buffers that have grown big. Only call once no views point
+	// into them.
+	void ReleaseScratch();
+
+	// Copies as much of the spilled frame as is available. Returns true once it's complete.
+	bool ContinueSpill(ReceiveRing& ring);
 	void SwapBuffer();
 	void TransitionState();
 	void WriteToBuffer(const std::string& data, int size);
@@ -43,11 +99,13 @@ private:
 	std::unique_ptr<NetworkMessage> m_messageCache = std::make_unique<NetworkMessage>();
 
 	// To ensure smooth writes, buffers are swapped after successful header or content reads.
+	// Legacy mode only.
 	std::string m_firstBuffer;
 	std::string m_secondBuffer;
 
 	// Points to whichever buffer is being written to.
 	std::string* m_activeBuffer;
+	bool m_isLegacyReserved = false;
 
 	// We're either parsing a header, or content.
 	State m_state = State::Header;
@@ -57,6 +115,29 @@ private:
 
 	// Keep track of where we are in the stream overall.
 	uint32_t m_totalBytesParsed = 0;
+
+	// Ring mode: holds the payload of a frame that wrapped the end of the ring.
+	std::string m_wrapBuffer;
+
+	// Ring mode: frames larger than the ring get accumulated here until they're complete.
+	std::string m_spillBuffer;
+	Frame m_spillFrame;
+	bool m_isSpilling = false;
+
+	uint32_t m_maxFrameSize = 1024 * 1024;
+
+	WireFormat m_wireFormat = WireFormat::Legacy;
+
+	// Compact streams open with a preamble that has to be checked before the first frame.
+	bool m_hasPreamble = false;
+
+	// Made when the first compressed frame arrives.
+	std::unique_ptr<FrameDecompressor> m_decompressor;
+
+	// Payloads inflated by this call of ExtractMessages, which views point into. Kept between
+	// calls so their memory gets reused.
+	std::deque<std::string> m_inflated;
+	size_t m_inflatedCount = 0;
 };
 
 //===============================================================================
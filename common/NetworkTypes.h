@@ -5,8 +5,11 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstring>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace sf {
@@ -24,8 +27,30 @@ enum struct MessageId : uint32_t
 	Attack,
 	Move,
 	TestMessage,
+
+	// Server to client over TCP. Payload is a UdpHandshake.
+	UdpHandshake,
+
+	// Server to client. Payload starts with a SnapshotHeader.
+	Snapshot,
+
+	// Client to server. Payload is a SnapshotAck.
+	SnapshotAck,
+
+	// Either way. Payload is a PingPayload, which the other side sends straight back in a Pong.
+	// Both are answered and consumed by TcpSession, they never reach a batch handler.
+	Ping,
+	Pong,
+
+	// Not a message. Number of ids, used to size tables indexed by MessageId.
+	Count
 };
 
+constexpr uint32_t MessageIdCount = static_cast<uint32_t>(MessageId::Count);
+
+// Also the legacy wire header: 8 bytes, both fields little endian. It's copied to and from the
+// wire as is, which is only right on a little endian host, so others fail to build below. See
+// WireFormat.h for the compact header.
 struct MessageHeader
 {
 	void Clear()
@@ -38,6 +63,13 @@ struct MessageHeader
 	uint32_t messageLength = 0;
 };
 
+static_assert(sizeof(MessageHeader) == 8, "The legacy wire header is 8 bytes");
+
+// MSVC only targets little endian platforms. GCC and Clang say which they're building for.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The legacy wire header is copied as is, so the host has to be little endian"
+#endif
+
 struct NetworkMessage
 {
 	NetworkMessage() {}
@@ -56,6 +88,89 @@ struct NetworkMessage
 	std::string messageData;
 };
 
+// Immutable bytes that any number of sessions can have queued at once without copying them.
+using SharedBuffer = std::shared_ptr<const std::string>;
+
+// Frames a payload the way NetworkMessageParser expects it, header first.
+inline std::string PackageMessage(MessageId id, std::string_view payload)
+{
+	MessageHeader header;
+	header.messageType = id;
+	header.messageLength = static_cast<uint32_t>(payload.size());
+
+	std::string message;
+	message.reserve(sizeof(header) + payload.size());
+	message.append(reinterpret_cast<const char*>(&header), sizeof(header));
+	message.append(payload.data(), payload.size());
+	return message;
+}
+
+// Reads the header off the front of a framed message. Returns false if there isn't a whole one.
+inline bool PeekHeader(std::string_view message, MessageHeader& header)
+{
+	if (message.size() < sizeof(header))
+	{
+		return false;
+	}
+
+	std::memcpy(&header, message.data(), sizeof(header));
+	return true;
+}
+
+// A parsed message that doesn't own its payload. messageData points into the buffer it was
+// parsed out of, so it's only valid until that buffer is written to again.
+struct NetworkMessageView
+{
+	MessageHeader header;
+	std::string_view messageData;
+};
+
+// Every message from one read, packed back to back in a single buffer so the lot can be handed
+// to another thread in one go. Owns its bytes, unlike the views it's built from.
+class MessageBatch
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	MessageBatch() : m_receivedAt(Clock::now()) {}
+
+	void Reserve(size_t messageCount, size_t byteCount)
+	{
+		m_entries.reserve(messageCount);
+		m_bytes.reserve(byteCount);
+	}
+
+	void Append(const NetworkMessageView& message)
+	{
+		m_entries.push_back({ message.header, static_cast<uint32_t>(m_bytes.size()) });
+		m_bytes.append(message.messageData.data(), message.messageData.size());
+	}
+
+	size_t Size() const { return m_entries.size(); }
+	bool IsEmpty() const { return m_entries.empty(); }
+
+	NetworkMessageView operator[](size_t i) const
+	{
+		const Entry& entry = m_entries[i];
+		return { entry.header, std::string_view(m_bytes.data() + entry.offset,
+			entry.header.messageLength) };
+	}
+
+	// When the bytes came off the socket. Used to measure how long delivery took.
+	Clock::time_point GetReceivedAt() const { return m_receivedAt; }
+
+private:
+	struct Entry
+	{
+		MessageHeader header;
+		uint32_t offset = 0;
+	};
+
+	std::vector<Entry> m_entries;
+	std::string m_bytes;
+	Clock::time_point m_receivedAt;
+};
+
 class NetworkObserver {
 
 public:
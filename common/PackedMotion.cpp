@@ -0,0 +1,88 @@
+//---------------------------------------------------------------
+//
+// PackedMotion.cpp
+//
+
+#include "common/PackedMotion.h"
+
+#include <algorithm>
+
+namespace Common {
+
+//===============================================================================
+
+namespace {
+	// States are quantized this many at a time, gathered field by field so each batch is one
+	// contiguous run of floats.
+	const size_t s_batchSize = 64;
+} // anon namespace
+
+//-------------------------------------------------------------------------------
+
+void EncodeMotion(const MotionState* states, size_t count, const MotionQuantization& quantization,
+	BitWriter& writer)
+{
+	float xs[s_batchSize];
+	float ys[s_batchSize];
+	float speeds[s_batchSize];
+	uint32_t quantizedX[s_batchSize];
+	uint32_t quantizedY[s_batchSize];
+	uint32_t quantizedSpeed[s_batchSize];
+
+	for (size_t start = 0; start < count; start += s_batchSize)
+	{
+		size_t batchCount = std::min(s_batchSize, count - start);
+		for (size_t i = 0; i < batchCount; ++i)
+		{
+			const MotionState& state = states[start + i];
+			xs[i] = state.position.x;
+			ys[i] = state.position.y;
+			speeds[i] = state.speed;
+		}
+
+		QuantizeBatch(xs, batchCount, quantization.positionX, quantizedX);
+		QuantizeBatch(ys, batchCount, quantization.positionY, quantizedY);
+		QuantizeBatch(speeds, batchCount, quantization.speed, quantizedSpeed);
+
+		for (size_t i = 0; i < batchCount; ++i)
+		{
+			const MotionState& state = states[start + i];
+			writer.Write(state.entityId, quantization.entityIdBits);
+			writer.Write(quantizedX[i], quantization.positionX.bits);
+			writer.Write(quantizedY[i], quantization.positionY.bits);
+			writer.Write(quantization.direction.Quantize(state.direction), quantization.direction.bits);
+			writer.Write(quantizedSpeed[i], quantization.speed.bits);
+		}
+	}
+}
+
+bool DecodeMotion(BitReader& reader, size_t count, const MotionQuantization& quantization,
+	std::vector<MotionState>& states)
+{
+	states.resize(count);
+	for (MotionState& state : states)
+	{
+		uint32_t x = 0;
+		uint32_t y = 0;
+		uint32_t direction = 0;
+		uint32_t speed = 0;
+		if (!reader.Read(quantization.entityIdBits, state.entityId)
+			|| !reader.Read(quantization.positionX.bits, x)
+			|| !reader.Read(quantization.positionY.bits, y)
+			|| !reader.Read(quantization.direction.bits, direction)
+			|| !reader.Read(quantization.speed.bits, speed))
+		{
+			states.clear();
+			return false;
+		}
+
+		state.position = { quantization.positionX.Dequantize(x), quantization.positionY.Dequantize(y) };
+		state.direction = quantization.direction.Dequantize(direction);
+		state.speed = quantization.speed.Dequantize(speed);
+	}
+	return true;
+}
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,58 @@
+//---------------------------------------------------------------
+//
+// PackedMotion.h
+//
+
+#pragma once
+
+#include "common/BitPacking.h"
+
+#include <glm/vec2.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Common {
+
+//===============================================================================
+
+// Where an object is and where it's heading, as the client's GameObjectData and
+// GameObjectViewData hold it.
+struct MotionState
+{
+	uint32_t entityId = 0;
+	glm::vec2 position = { 0.0f, 0.0f };
+	glm::vec2 direction = { 0.0f, 0.0f };
+	float speed = 0.0f;
+};
+
+// How each field of a MotionState is quantized. The defaults fit a world 4096 units across:
+// 16 bits of position keep it within 0.04 units and 8 bits of direction within 0.7 degrees.
+struct MotionQuantization
+{
+	QuantizedRange positionX = { -2048.0f, 2048.0f, 16 };
+	QuantizedRange positionY = { -2048.0f, 2048.0f, 16 };
+	QuantizedAngle direction = QuantizedAngle(8);
+	QuantizedRange speed = { 0.0f, 64.0f, 10 };
+	uint32_t entityIdBits = 16;
+
+	uint32_t GetBitsPerState() const
+	{
+		return entityIdBits + positionX.bits + positionY.bits + direction.bits + speed.bits;
+	}
+};
+
+// Packs count states into writer with no padding between fields. Positions and speeds are
+// quantized in batches, see QuantizeBatch. Entity ids wider than entityIdBits are truncated.
+void EncodeMotion(const MotionState* states, size_t count, const MotionQuantization& quantization,
+	BitWriter& writer);
+
+// Reads count states back into states, replacing what was there. Returns false if reader runs
+// out first.
+bool DecodeMotion(BitReader& reader, size_t count, const MotionQuantization& quantization,
+	std::vector<MotionState>& states);
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,102 @@
+//---------------------------------------------------------------
+//
+// PriorityAccumulator.cpp
+//
+
+#include "common/PriorityAccumulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace Common {
+
+//===============================================================================
+
+PriorityAccumulator::PriorityAccumulator(const PriorityConfig& config)
+	: m_config(config)
+{
+}
+
+void PriorityAccumulator::SetViewpoint(float x, float y)
+{
+	m_viewX = x;
+	m_viewY = y;
+}
+
+void PriorityAccumulator::Select(std::vector<SnapshotChange>& changes, uint32_t budget)
+{
+	++m_tick;
+
+	// Required changes are going anyway, so they start again from nothing like any other that's
+	// sent, and don't compete for the budget.
+	m_order.clear();
+	for (uint32_t i = 0; i < changes.size(); ++i)
+	{
+		if (changes[i].isRequired)
+		{
+			changes[i].isSelected = true;
+			m_accumulated.erase(changes[i].entity->entityId);
+			continue;
+		}
+
+		Accumulated& accumulated = m_accumulated[changes[i].entity->entityId];
+		accumulated.priority += GetPriority(changes[i]);
+		accumulated.tick = m_tick;
+		m_order.emplace_back(accumulated.priority, i);
+	}
+
+	// Highest first. Ties go to the lower id, which is the lower index.
+	std::sort(m_order.begin(), m_order.end(),
+		[](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b)
+		{
+			return a.first != b.first ? a.first > b.first : a.second < b.second;
+		});
+
+	// Something too big for what's left doesn't stop smaller ones behind it going in.
+	m_deferredCount = 0;
+	for (const std::pair<float, uint32_t>& entry : m_order)
+	{
+		SnapshotChange& change = changes[entry.second];
+		change.isSelected = change.size <= budget;
+		if (change.isSelected)
+		{
+			budget -= change.size;
+			m_accumulated.erase(change.entity->entityId);
+		}
+		else
+		{
+			++m_deferredCount;
+		}
+	}
+
+	// Entities that aren't changes any more are up to date on the client or gone from view.
+	for (auto it = m_accumulated.begin(); it != m_accumulated.end();)
+	{
+		it = it->second.tick == m_tick ? std::next(it) : m_accumulated.erase(it);
+	}
+}
+
+float PriorityAccumulator::GetPriority(const SnapshotChange& change) const
+{
+	const EntityState& entity = *change.entity;
+	float weight = entity.creatureType < m_config.typeWeights.size()
+		? m_config.typeWeights[entity.creatureType] : 1.0f;
+	if (change.isNew)
+	{
+		weight *= m_config.newEntityWeight;
+	}
+
+	float distance = std::hypot(entity.x - m_viewX, entity.y - m_viewY);
+	return weight / (1.0f + distance / m_config.distanceFalloff);
+}
+
+float PriorityAccumulator::GetAccumulated(uint32_t entityId) const
+{
+	auto it = m_accumulated.find(entityId);
+	return it != m_accumulated.end() ? it->second.priority : 0.0f;
+}
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,90 @@
+//---------------------------------------------------------------
+//
+// PriorityAccumulator.h
+//
+
+#pragma once
+
+#include "common/Snapshot.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Common {
+
+//===============================================================================
+
+// How much an entity's update matters each tick it isn't sent.
+struct PriorityConfig
+{
+	// Bytes of snapshot a client is sent each tick, at most. The default keeps a snapshot inside
+	// one UDP datagram.
+	uint32_t bytesPerTick = 1024;
+
+	// An entity this far from the client gets half the priority of one right next to it, one
+	// twice as far a third, and so on.
+	float distanceFalloff = 100.0f;
+
+	// Priority per tick by creature type, indexed by type. Types past the end get 1.
+	std::vector<float> typeWeights;
+
+	// Multiplies the priority of entities the client doesn't have yet, so they aren't held back
+	// behind updates to ones it can already see.
+	float newEntityWeight = 2.0f;
+};
+
+// Server side, one per client. Picks which changes a snapshot carries when they don't all fit
+// in the client's budget. Every tick a change goes unsent its priority is added to again, so
+// even a far away, unimportant entity is sent eventually, and the further behind it falls the
+// sooner that is. Sending an entity starts it again from nothing.
+//
+// Use Select as the SnapshotEncoder::ChangeSelector.
+class PriorityAccumulator
+{
+public:
+	explicit PriorityAccumulator(const PriorityConfig& config = PriorityConfig());
+
+	void SetConfig(const PriorityConfig& config) { m_config = config; }
+	const PriorityConfig& GetConfig() const { return m_config; }
+
+	// Where the client is, for the distance part of the priority.
+	void SetViewpoint(float x, float y);
+
+	// Adds this tick's priority to each change's, then selects those with the most until budget
+	// runs out. Required changes are left selected and don't count against budget. Entities
+	// that aren't among the changes any more are forgotten.
+	void Select(std::vector<SnapshotChange>& changes, uint32_t budget);
+
+	// What a change adds to its priority each tick it waits.
+	float GetPriority(const SnapshotChange& change) const;
+
+	// What the change for entityId has built up. 0 if it has none waiting.
+	float GetAccumulated(uint32_t entityId) const;
+
+	// How many changes were left for a later tick at the last Select.
+	uint32_t GetDeferredCount() const { return m_deferredCount; }
+
+private:
+	struct Accumulated
+	{
+		float priority = 0.0f;
+		uint32_t tick = 0;
+	};
+
+	PriorityConfig m_config;
+	float m_viewX = 0.0f;
+	float m_viewY = 0.0f;
+
+	std::unordered_map<uint32_t, Accumulated> m_accumulated;
+	uint32_t m_tick = 0;
+	uint32_t m_deferredCount = 0;
+
+	// Each change's priority and index into the changes given to Select, highest first.
+	std::vector<std::pair<float, uint32_t>> m_order;
+};
+
+//===============================================================================
+
+} // namespace Common
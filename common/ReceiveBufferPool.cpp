@@ -0,0 +1,164 @@
+//---------------------------------------------------------------
+//
+// ReceiveBufferPool.cpp
+//
+
+#include "common/ReceiveBufferPool.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <utility>
+
+namespace Common {
+
+//===============================================================================
+
+namespace {
+	// Small classes are carved several to a slab, big ones at least one.
+	const uint32_t s_slabSize = 256 * 1024;
+
+	uint32_t NextPowerOfTwo(uint32_t value)
+	{
+		uint32_t result = 1;
+		while (result < value)
+		{
+			result <<= 1;
+		}
+		return result;
+	}
+} // anon namespace
+
+//-------------------------------------------------------------------------------
+
+PooledBuffer::PooledBuffer(char* data, uint32_t size, ReceiveBufferPool* pool)
+	: m_data(data)
+	, m_size(size)
+	, m_pool(pool)
+{
+}
+
+PooledBuffer::~PooledBuffer()
+{
+	Reset();
+}
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept
+	: m_data(other.m_data)
+	, m_size(other.m_size)
+	, m_pool(other.m_pool)
+{
+	other.m_data = nullptr;
+	other.m_size = 0;
+	other.m_pool = nullptr;
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept
+{
+	if (this != &other)
+	{
+		Reset();
+		std::swap(m_data, other.m_data);
+		std::swap(m_size, other.m_size);
+		std::swap(m_pool, other.m_pool);
+	}
+	return *this;
+}
+
+PooledBuffer PooledBuffer::Allocate(uint32_t size)
+{
+	return PooledBuffer(new char[size], size, nullptr);
+}
+
+void PooledBuffer::Reset()
+{
+	if (!m_data)
+	{
+		return;
+	}
+
+	if (m_pool)
+	{
+		m_pool->Return(m_data, m_size);
+	}
+	else
+	{
+		delete[] m_data;
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_pool = nullptr;
+}
+
+//-------------------------------------------------------------------------------
+
+ReceiveBufferPool::ReceiveBufferPool(uint32_t minSize, uint32_t maxSize)
+	: m_minSize(NextPowerOfTwo(std::max<uint32_t>(minSize, 1)))
+	, m_maxSize(std::max(m_minSize, NextPowerOfTwo(maxSize)))
+{
+	m_freeLists.resize(ClassIndex(m_maxSize) + 1);
+}
+
+ReceiveBufferPool::~ReceiveBufferPool()
+{
+	assert(m_stats.buffersInUse == 0);
+}
+
+PooledBuffer ReceiveBufferPool::Borrow(uint32_t size)
+{
+	const uint32_t classSize = NextPowerOfTwo(std::min(std::max(size, m_minSize), m_maxSize));
+	std::vector<char*>& freeList = m_freeLists[ClassIndex(classSize)];
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (freeList.empty())
+	{
+		const uint32_t count = std::max<uint32_t>(s_slabSize / classSize, 1);
+		m_slabs.emplace_back(new char[static_cast<size_t>(count) * classSize]);
+		char* slab = m_slabs.back().get();
+		for (uint32_t i = count; i > 0; --i)
+		{
+			freeList.push_back(slab + static_cast<size_t>(i - 1) * classSize);
+		}
+
+		++m_stats.slabsAllocated;
+		m_stats.bytesReserved += static_cast<uint64_t>(count) * classSize;
+	}
+
+	char* data = freeList.back();
+	freeList.pop_back();
+
+	++m_stats.borrows;
+	++m_stats.buffersInUse;
+	m_stats.bytesInUse += classSize;
+	m_stats.peakBytesInUse = std::max(m_stats.peakBytesInUse, m_stats.bytesInUse);
+	return PooledBuffer(data, classSize, this);
+}
+
+ReceiveBufferPoolStats ReceiveBufferPool::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void ReceiveBufferPool::Return(char* data, uint32_t size)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_freeLists[ClassIndex(size)].push_back(data);
+
+	--m_stats.buffersInUse;
+	m_stats.bytesInUse -= size;
+}
+
+uint32_t ReceiveBufferPool::ClassIndex(uint32_t size) const
+{
+	uint32_t index = 0;
+	for (uint32_t classSize = m_minSize; classSize < size; classSize <<= 1)
+	{
+		++index;
+	}
+	return index;
+}
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,109 @@
+//---------------------------------------------------------------
+//
+// ReceiveBufferPool.h
+//
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Common {
+
+//===============================================================================
+
+class ReceiveBufferPool;
+
+// A buffer borrowed from a ReceiveBufferPool, or allocated on its own if there's no pool.
+// Goes back where it came from when it's destroyed or reset.
+class PooledBuffer
+{
+public:
+	PooledBuffer() = default;
+	~PooledBuffer();
+
+	PooledBuffer(PooledBuffer&& other) noexcept;
+	PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+	PooledBuffer(const PooledBuffer&) = delete;
+	PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+	// A buffer of exactly size bytes that belongs to no pool.
+	static PooledBuffer Allocate(uint32_t size);
+
+	char* Data() const { return m_data; }
+	uint32_t Size() const { return m_size; }
+	bool IsEmpty() const { return m_data == nullptr; }
+
+	// Gives the buffer back, leaving this empty.
+	void Reset();
+
+private:
+	friend class ReceiveBufferPool;
+	PooledBuffer(char* data, uint32_t size, ReceiveBufferPool* pool);
+
+	char* m_data = nullptr;
+	uint32_t m_size = 0;
+	ReceiveBufferPool* m_pool = nullptr;
+};
+
+struct ReceiveBufferPoolStats
+{
+	uint64_t borrows = 0;
+
+	// Borrows that found their size class empty and had to carve a new slab.
+	uint64_t slabsAllocated = 0;
+
+	// Memory taken by slabs, which is never given back, and how much of it is lent out.
+	uint64_t bytesReserved = 0;
+	uint64_t bytesInUse = 0;
+	uint64_t buffersInUse = 0;
+
+	// High watermark of bytesInUse. bytesReserved is roughly this, rounded up to whole slabs.
+	uint64_t peakBytesInUse = 0;
+};
+
+// Receive buffers shared by every session that's given the pool. Sessions only borrow one while
+// they're reading or holding part of a frame, so idle ones cost nothing here.
+//
+// Buffers come in power of two size classes from minSize to maxSize. Each class is carved out
+// of slabs of several buffers at a time, and returned buffers are kept on a free list for the
+// next borrow rather than freed. Thread safe. Every buffer has to be back before the pool is
+// destroyed, so hold it by shared_ptr wherever its buffers are.
+class ReceiveBufferPool
+{
+public:
+	ReceiveBufferPool(uint32_t minSize = 4096, uint32_t maxSize = 64 * 1024);
+	~ReceiveBufferPool();
+
+	ReceiveBufferPool(const ReceiveBufferPool&) = delete;
+	ReceiveBufferPool& operator=(const ReceiveBufferPool&) = delete;
+
+	// A buffer from the smallest class that holds size bytes. Sizes are clamped to the range
+	// of classes.
+	PooledBuffer Borrow(uint32_t size);
+
+	uint32_t GetMinSize() const { return m_minSize; }
+	uint32_t GetMaxSize() const { return m_maxSize; }
+
+	ReceiveBufferPoolStats GetStats() const;
+
+private:
+	friend class PooledBuffer;
+	void Return(char* data, uint32_t size);
+
+	uint32_t ClassIndex(uint32_t size) const;
+
+	const uint32_t m_minSize;
+	const uint32_t m_maxSize;
+
+	mutable std::mutex m_mutex;
+	std::vector<std::vector<char*>> m_freeLists;
+	std::vector<std::unique_ptr<char[]>> m_slabs;
+	ReceiveBufferPoolStats m_stats;
+};
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,154 @@
+//---------------------------------------------------------------
+//
+// ReceiveRing.cpp
+//
+
+#include "common/ReceiveRing.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cstring>
+#include <utility>
+
+namespace Common {
+
+//===============================================================================
+
+namespace {
+	uint32_t NextPowerOfTwo(uint32_t value)
+	{
+		uint32_t result = 1;
+		while (result < value)
+		{
+			result <<= 1;
+		}
+		return result;
+	}
+} // anon namespace
+
+ReceiveRing::ReceiveRing(uint32_t capacity)
+	: m_buffer(PooledBuffer::Allocate(NextPowerOfTwo(std::max<uint32_t>(capacity, 1))))
+	, m_mask(m_buffer.Size() - 1)
+{
+}
+
+ReceiveRing::ReceiveRing(std::shared_ptr<ReceiveBufferPool> pool, uint32_t maxCapacity)
+	: m_pool(std::move(pool))
+{
+	if (!m_pool)
+	{
+		m_buffer = PooledBuffer::Allocate(NextPowerOfTwo(std::max<uint32_t>(maxCapacity, 1)));
+		m_mask = m_buffer.Size() - 1;
+		return;
+	}
+
+	m_nextCapacity = m_pool->GetMinSize();
+	m_maxCapacity = std::max(m_nextCapacity,
+		std::min(NextPowerOfTwo(maxCapacity), m_pool->GetMaxSize()));
+}
+
+ReceiveRing::~ReceiveRing()
+{
+}
+
+void ReceiveRing::Borrow()
+{
+	if (m_pool && m_buffer.IsEmpty())
+	{
+		m_buffer = m_pool->Borrow(m_nextCapacity);
+		m_mask = m_buffer.Size() - 1;
+		m_peakReadSize = 0;
+	}
+}
+
+void ReceiveRing::ReturnIfEmpty()
+{
+	if (!m_pool || m_buffer.IsEmpty() || ReadSize() > 0)
+	{
+		return;
+	}
+
+	// Filled to the brim means reads were cut short, so the next buffer should be bigger.
+	const uint32_t capacity = Capacity();
+	if (m_peakReadSize == capacity)
+	{
+		m_nextCapacity = std::min(capacity * 2, m_maxCapacity);
+	}
+	else if (m_peakReadSize <= capacity / 4)
+	{
+		m_nextCapacity = std::max(capacity / 2, m_pool->GetMinSize());
+	}
+	else
+	{
+		m_nextCapacity = capacity;
+	}
+
+	m_buffer.Reset();
+	m_mask = 0;
+	Clear();
+}
+
+char* ReceiveRing::WriteData()
+{
+	assert(HasBuffer());
+	return m_buffer.Data() + Index(m_writePos);
+}
+
+uint32_t ReceiveRing::WriteSize() const
+{
+	uint32_t freeBytes = Capacity() - ReadSize();
+	uint32_t untilEnd = Capacity() - Index(m_writePos);
+	return std::min(freeBytes, untilEnd);
+}
+
+void ReceiveRing::CommitWrite(uint32_t bytes)
+{
+	assert(bytes <= WriteSize());
+	m_writePos += bytes;
+	m_peakReadSize = std::max(m_peakReadSize, ReadSize());
+}
+
+const char* ReceiveRing::Contiguous(uint32_t offset, uint32_t size) const
+{
+	assert(offset + size <= ReadSize());
+	uint32_t start = Index(m_readPos + offset);
+	if (start + size > Capacity())
+	{
+		return nullptr;
+	}
+
+	return m_buffer.Data() + start;
+}
+
+void ReceiveRing::Peek(uint32_t offset, void* dest, uint32_t size) const
+{
+	assert(offset + size <= ReadSize());
+	uint32_t start = Index(m_readPos + offset);
+	uint32_t firstPart = std::min(size, Capacity() - start);
+
+	char* out = static_cast<char*>(dest);
+	std::memcpy(out, m_buffer.Data() + start, firstPart);
+	std::memcpy(out + firstPart, m_buffer.Data(), size - firstPart);
+}
+
+void ReceiveRing::Consume(uint32_t bytes)
+{
+	assert(bytes <= ReadSize());
+	m_readPos += bytes;
+
+	// Once drained, start over from the front so the next read gets the whole buffer.
+	if (m_readPos == m_writePos)
+	{
+		Clear();
+	}
+}
+
+void ReceiveRing::Clear()
+{
+	m_readPos = 0;
+	m_writePos = 0;
+}
+
+//===============================================================================
+
+} // namespace Common
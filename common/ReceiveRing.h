@@ -0,0 +1,98 @@
+//---------------------------------------------------------------
+//
+// ReceiveRing.h
+//
+
+#pragma once
+
+#include "common/ReceiveBufferPool.h"
+
+#include <cstdint>
+#include <memory>
+
+namespace Common {
+
+//===============================================================================
+
+// Circular byte buffer that socket reads land in directly. Readers can look at bytes in place
+// and only need to copy when a range straddles the end of the buffer.
+//
+// A ring either owns a fixed buffer for its whole life, or borrows one from a pool only while
+// it's needed. A pooled ring has no buffer, and a capacity of 0, until Borrow is called, and
+// gives it back on ReturnIfEmpty once everything in it has been consumed.
+class ReceiveRing
+{
+public:
+	// Capacity is rounded up to the next power of two.
+	ReceiveRing(uint32_t capacity = 32768);
+
+	// Borrows from pool, starting at its smallest size. A ring whose reads keep filling it
+	// borrows the next size up next time, to at most maxCapacity, and one that only ever uses a
+	// little of it drops a size. With no pool, this owns a fixed buffer of maxCapacity.
+	ReceiveRing(std::shared_ptr<ReceiveBufferPool> pool, uint32_t maxCapacity);
+	~ReceiveRing();
+
+	ReceiveRing(const ReceiveRing&) = delete;
+	ReceiveRing& operator=(const ReceiveRing&) = delete;
+
+	// Makes sure a pooled ring has a buffer to write into. Does nothing otherwise.
+	void Borrow();
+
+	// Gives a pooled ring's buffer back if nothing's left in it. Does nothing otherwise.
+	void ReturnIfEmpty();
+
+	bool HasBuffer() const { return !m_buffer.IsEmpty(); }
+
+	// Start of the largest contiguous free region. Write into this, then call CommitWrite.
+	char* WriteData();
+
+	// Size of the region returned by WriteData.
+	uint32_t WriteSize() const;
+
+	// Marks bytes written into WriteData as readable.
+	void CommitWrite(uint32_t bytes);
+
+	// Number of bytes that have been written but not consumed.
+	uint32_t ReadSize() const { return m_writePos - m_readPos; }
+
+	// Total number of bytes the ring can hold.
+	uint32_t Capacity() const { return m_buffer.Size(); }
+
+	// Returns a pointer to size readable bytes starting offset bytes past the read head.
+	// Returns nullptr if that range wraps around the end of the buffer.
+	const char* Contiguous(uint32_t offset, uint32_t size) const;
+
+	// Copies size readable bytes starting offset bytes past the read head into dest.
+	void Peek(uint32_t offset, void* dest, uint32_t size) const;
+
+	// Releases bytes from the read head. Memory is left untouched until the next write.
+	void Consume(uint32_t bytes);
+
+	// Drops everything that's readable.
+	void Clear();
+
+private:
+	uint32_t Index(uint32_t position) const { return position & m_mask; }
+
+	// Null for a ring that owns its buffer. Declared before m_buffer so the pool outlives it,
+	// since the buffer goes back to the pool when it's destroyed.
+	std::shared_ptr<ReceiveBufferPool> m_pool;
+
+	PooledBuffer m_buffer;
+
+	// Capacity - 1. Capacity is a power of two so positions can be masked into the buffer.
+	uint32_t m_mask = 0;
+
+	// Size to borrow next, and the most that's been readable at once with the current buffer.
+	uint32_t m_nextCapacity = 0;
+	uint32_t m_maxCapacity = 0;
+	uint32_t m_peakReadSize = 0;
+
+	// Positions only ever increase (modulo 2^32) and are masked on access.
+	uint32_t m_readPos = 0;
+	uint32_t m_writePos = 0;
+};
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,305 @@
+//---------------------------------------------------------------
+//
+// ReliableEndpoint.cpp
+//
+
+#include "common/ReliableEndpoint.h"
+
+#include <algorithm>
+
+namespace Common {
+
+//===============================================================================
+
+namespace {
+	// True if a is newer than b, allowing for the sequence wrapping around.
+	bool IsNewer(uint32_t a, uint32_t b)
+	{
+		return static_cast<int32_t>(a - b) > 0;
+	}
+} // anon namespace
+
+ReliableEndpoint::ReliableEndpoint(Clock::duration minResendDelay)
+	: m_minResendDelay(minResendDelay)
+	, m_sentPackets(s_sentPacketCount)
+{
+}
+
+bool ReliableEndpoint::Queue(uint8_t stream, SharedBuffer message)
+{
+	if (stream >= s_streamCount)
+	{
+		return false;
+	}
+
+	SendStream& sendStream = m_sendStreams[stream];
+	if (sendStream.pending.size() < s_windowSize)
+	{
+		AddPending(sendStream, std::move(message));
+		return true;
+	}
+
+	// Refusing it would leave the caller to send it some other way, ahead of the ones in the
+	// window. Holding it back keeps the stream in order.
+	if (sendStream.backlog.size() >= s_maxBacklog)
+	{
+		return false;
+	}
+
+	sendStream.backlog.push_back(std::move(message));
+	return true;
+}
+
+bool ReliableEndpoint::HasDue(Clock::time_point now) const
+{
+	for (const SendStream& stream : m_sendStreams)
+	{
+		for (const PendingMessage& message : stream.pending)
+		{
+			if (IsDue(message, now))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void ReliableEndpoint::WritePacket(Clock::time_point now, uint32_t budget, uint32_t maxMessages,
+	OutgoingPacket& packet)
+{
+	packet.sequence = m_nextSequence++;
+	packet.ack = m_ack;
+	packet.ackBits = m_ackBits;
+	packet.reliable.clear();
+	packet.resentCount = 0;
+	m_needsAck = false;
+	m_packetsSinceAck = 0;
+
+	SentPacket& sent = m_sentPackets[packet.sequence % s_sentPacketCount];
+	sent.sequence = packet.sequence;
+	sent.isInUse = true;
+	sent.sentAt = now;
+	sent.messages.clear();
+
+	for (uint32_t i = 0; i < s_streamCount; ++i)
+	{
+		for (PendingMessage& message : m_sendStreams[i].pending)
+		{
+			if (packet.reliable.size() == maxMessages)
+			{
+				return;
+			}
+
+			if (!IsDue(message, now))
+			{
+				continue;
+			}
+
+			uint32_t size = static_cast<uint32_t>(sizeof(ReliableMessageHeader) + message.message->size());
+			if (size > budget)
+			{
+				continue;
+			}
+
+			ReliableMessage reliable;
+			reliable.header.messageSequence = message.sequence;
+			reliable.header.stream = static_cast<uint8_t>(i);
+			reliable.message = message.message;
+			packet.reliable.push_back(std::move(reliable));
+			sent.messages.push_back(packet.reliable.back().header);
+
+			packet.resentCount += message.isSent ? 1 : 0;
+			message.isSent = true;
+			message.lastSent = now;
+			budget -= size;
+		}
+	}
+}
+
+PacketStatus ReliableEndpoint::OnPacket(uint32_t sequence, uint32_t ack, uint32_t ackBits,
+	Clock::time_point now)
+{
+	PacketStatus status = PacketStatus::New;
+	if (!m_hasReceived)
+	{
+		m_ack = sequence;
+		m_ackBits = 0;
+		m_hasReceived = true;
+	}
+	else if (IsNewer(sequence, m_ack))
+	{
+		// Slide the window up. The old newest becomes one of the bits.
+		uint32_t shift = sequence - m_ack;
+		m_ackBits = shift < s_ackBitCount ? m_ackBits << shift : 0;
+		if (shift <= s_ackBitCount)
+		{
+			m_ackBits |= 1u << (shift - 1);
+		}
+		m_ack = sequence;
+	}
+	else
+	{
+		uint32_t distance = m_ack - sequence;
+		if (distance == 0)
+		{
+			return PacketStatus::Duplicate;
+		}
+
+		// Too old to ack. Its reliable messages will be resent and weeded out then.
+		status = PacketStatus::Late;
+		if (distance <= s_ackBitCount)
+		{
+			uint32_t bit = 1u << (distance - 1);
+			if (m_ackBits & bit)
+			{
+				return PacketStatus::Duplicate;
+			}
+			m_ackBits |= bit;
+		}
+	}
+
+	++m_packetsSinceAck;
+
+	OnAck(ack, now);
+	for (uint32_t i = 0; i < s_ackBitCount; ++i)
+	{
+		if (ackBits & (1u << i))
+		{
+			OnAck(ack - 1 - i, now);
+		}
+	}
+
+	return status;
+}
+
+void ReliableEndpoint::OnReliableMessage(const ReliableMessageHeader& header,
+	const NetworkMessageView& message, MessageBatch& delivered)
+{
+	if (header.stream >= s_streamCount)
+	{
+		return;
+	}
+
+	// Acks are owed for anything reliable, even a repeat, since it means our last ack was lost.
+	m_needsAck = true;
+
+	ReceiveStream& stream = m_receiveStreams[header.stream];
+	uint16_t distance = static_cast<uint16_t>(header.messageSequence - stream.nextSequence);
+	if (distance >= s_windowSize)
+	{
+		// Either delivered already, or so far ahead we'd have to drop something to hold it.
+		return;
+	}
+
+	if (distance > 0)
+	{
+		BufferedMessage& buffered = stream.buffered[header.messageSequence % s_windowSize];
+		if (!buffered.isPresent)
+		{
+			buffered.isPresent = true;
+			buffered.header = message.header;
+			buffered.payload.assign(message.messageData.data(), message.messageData.size());
+		}
+		return;
+	}
+
+	delivered.Append(message);
+	++stream.nextSequence;
+
+	// Release whatever was waiting on this one.
+	for (;;)
+	{
+		BufferedMessage& buffered = stream.buffered[stream.nextSequence % s_windowSize];
+		if (!buffered.isPresent)
+		{
+			break;
+		}
+
+		delivered.Append({ buffered.header, buffered.payload });
+		buffered.isPresent = false;
+		++stream.nextSequence;
+	}
+}
+
+ReliableEndpoint::Clock::duration ReliableEndpoint::GetResendDelay() const
+{
+	return std::max(m_minResendDelay, m_roundTripTime * 2);
+}
+
+uint32_t ReliableEndpoint::GetUnackedCount() const
+{
+	uint32_t count = 0;
+	for (const SendStream& stream : m_sendStreams)
+	{
+		count += static_cast<uint32_t>(stream.pending.size() + stream.backlog.size());
+	}
+	return count;
+}
+
+void ReliableEndpoint::AddPending(SendStream& stream, SharedBuffer message)
+{
+	PendingMessage pending;
+	pending.sequence = stream.nextSequence++;
+	pending.message = std::move(message);
+	stream.pending.push_back(std::move(pending));
+}
+
+bool ReliableEndpoint::IsDue(const PendingMessage& message, Clock::time_point now) const
+{
+	return !message.isAcked && (!message.isSent || now - message.lastSent >= GetResendDelay());
+}
+
+void ReliableEndpoint::OnAck(uint32_t sequence, Clock::time_point now)
+{
+	SentPacket& sent = m_sentPackets[sequence % s_sentPacketCount];
+	if (!sent.isInUse || sent.sequence != sequence)
+	{
+		return;
+	}
+
+	// Only the first ack gives a fair round trip sample. Later ones are repeats in ack bits.
+	Clock::duration sample = now - sent.sentAt;
+	m_roundTripTime = m_roundTripTime == Clock::duration::zero()
+		? sample : m_roundTripTime + (sample - m_roundTripTime) / 8;
+
+	for (const ReliableMessageHeader& header : sent.messages)
+	{
+		AckMessage(header);
+	}
+
+	sent.isInUse = false;
+}
+
+void ReliableEndpoint::AckMessage(const ReliableMessageHeader& header)
+{
+	SendStream& stream = m_sendStreams[header.stream];
+	if (stream.pending.empty())
+	{
+		return;
+	}
+
+	uint16_t index = static_cast<uint16_t>(header.messageSequence - stream.pending.front().sequence);
+	if (index >= stream.pending.size())
+	{
+		return;
+	}
+
+	stream.pending[index].isAcked = true;
+	while (!stream.pending.empty() && stream.pending.front().isAcked)
+	{
+		stream.pending.pop_front();
+	}
+
+	// The window has room again, so whatever was held back takes it.
+	while (!stream.backlog.empty() && stream.pending.size() < s_windowSize)
+	{
+		AddPending(stream, std::move(stream.backlog.front()));
+		stream.backlog.pop_front();
+	}
+}
+
+//===============================================================================
+
+} // namespace Common
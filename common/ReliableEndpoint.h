@@ -0,0 +1,211 @@
+//---------------------------------------------------------------
+//
+// ReliableEndpoint.h
+//
+
+#pragma once
+
+#include "common/NetworkTypes.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace Common {
+
+//===============================================================================
+
+// Goes in front of each reliable message in a datagram.
+struct ReliableMessageHeader
+{
+	uint16_t messageSequence = 0;
+	uint8_t stream = 0;
+	uint8_t reserved = 0;
+};
+
+// A reliable message picked to go out in a packet.
+struct ReliableMessage
+{
+	ReliableMessageHeader header;
+	SharedBuffer message;
+};
+
+// What a packet should carry, filled in by ReliableEndpoint::WritePacket.
+struct OutgoingPacket
+{
+	uint32_t sequence = 0;
+
+	// The newest sequence we've received, and which of the 32 before it we've received as well.
+	// Bit n is for sequence ack - 1 - n.
+	uint32_t ack = 0;
+	uint32_t ackBits = 0;
+
+	std::vector<ReliableMessage> reliable;
+
+	// How many of the reliable messages have been sent before.
+	uint32_t resentCount = 0;
+};
+
+enum class PacketStatus : uint32_t
+{
+	// Newer than anything we've had from the peer.
+	New,
+
+	// Older than one we've already had, but not seen before.
+	Late,
+
+	// Seen before.
+	Duplicate
+};
+
+// The reliability half of a UDP connection, with no I/O of its own. Numbers packets and tracks
+// which the peer has acked, resends reliable messages whose packets go unacked, and puts the
+// messages it receives back in order.
+//
+// Acks ride on every packet going the other way: the newest sequence received plus a bitfield
+// for the 32 before it, so one lost ack is covered by the next. Only the messages in unacked
+// packets are resent, not everything after them.
+//
+// Messages are ordered within a stream but not across streams, so a lost message only holds
+// up the ones behind it on its own stream.
+class ReliableEndpoint
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr uint32_t s_streamCount = 4;
+
+	// Most unacked messages a stream has out at once, and the furthest ahead of a gap the
+	// receiver will buffer.
+	static constexpr uint32_t s_windowSize = 256;
+
+	// Most messages a stream holds back while its window is full, before refusing more.
+	static constexpr uint32_t s_maxBacklog = 4096;
+
+	ReliableEndpoint(Clock::duration minResendDelay = std::chrono::milliseconds(30));
+
+	// Sending.
+
+	// Messages queued while the stream's window is full wait behind it, in order, and go out
+	// as acks make room. Returns false if the stream doesn't exist or its backlog is full too.
+	bool Queue(uint8_t stream, SharedBuffer message);
+
+	// True if a reliable message hasn't been sent yet or is due to be resent.
+	bool HasDue(Clock::time_point now) const;
+
+	// True if we've received a reliable message since we last sent an ack. Packets with nothing
+	// reliable in them don't need acking, which keeps two idle endpoints from acking each other's
+	// acks forever.
+	bool NeedsAck() const { return m_needsAck; }
+
+	// True if so many packets have come in since we last sent an ack that the oldest are about to
+	// fall out of the ack bits. Send one straight away rather than waiting.
+	bool NeedsAckNow() const { return m_needsAck && m_packetsSinceAck >= s_ackBitCount / 2; }
+
+	// Numbers the next packet and adds the current acks and as many due reliable messages as fit
+	// in budget bytes, counting their headers, up to maxMessages. Ones that don't fit stay due for
+	// the next packet.
+	void WritePacket(Clock::time_point now, uint32_t budget, uint32_t maxMessages,
+		OutgoingPacket& packet);
+
+	// Receiving.
+
+	// Takes in the sequence and acks from a packet's header. Call before handing over its
+	// messages, and drop the packet if it's a duplicate.
+	PacketStatus OnPacket(uint32_t sequence, uint32_t ack, uint32_t ackBits, Clock::time_point now);
+
+	// Hands over a reliable message from a received packet. Appends it to delivered, followed by
+	// any it was holding up, if it's the next one on its stream. Buffers it if it's early and
+	// drops it if it's already been delivered.
+	void OnReliableMessage(const ReliableMessageHeader& header, const NetworkMessageView& message,
+		MessageBatch& delivered);
+
+	// Smoothed from the packets that have been acked. Zero until the first ack.
+	Clock::duration GetRoundTripTime() const { return m_roundTripTime; }
+
+	// How long a reliable message waits for an ack before it's resent.
+	Clock::duration GetResendDelay() const;
+
+	// Messages queued but not acked yet, across all streams, counting ones still waiting for
+	// room in the window.
+	uint32_t GetUnackedCount() const;
+
+private:
+	static constexpr uint32_t s_sentPacketCount = 1024;
+	static constexpr uint32_t s_ackBitCount = 32;
+
+	struct PendingMessage
+	{
+		uint16_t sequence = 0;
+		SharedBuffer message;
+		Clock::time_point lastSent;
+		bool isSent = false;
+		bool isAcked = false;
+	};
+
+	struct SendStream
+	{
+		uint16_t nextSequence = 0;
+
+		// Oldest first. The front is popped as soon as it's acked.
+		std::deque<PendingMessage> pending;
+
+		// Queued while pending was full. Only numbered once they move into pending.
+		std::deque<SharedBuffer> backlog;
+	};
+
+	struct BufferedMessage
+	{
+		bool isPresent = false;
+		MessageHeader header;
+		std::string payload;
+	};
+
+	struct ReceiveStream
+	{
+		uint16_t nextSequence = 0;
+
+		// Messages that arrived ahead of a gap, indexed by sequence modulo the window.
+		std::array<BufferedMessage, s_windowSize> buffered;
+	};
+
+	// What went out in a packet, so its messages can be marked acked when it is.
+	struct SentPacket
+	{
+		uint32_t sequence = 0;
+		bool isInUse = false;
+		Clock::time_point sentAt;
+		std::vector<ReliableMessageHeader> messages;
+	};
+
+	// Numbers message and adds it to the stream's window.
+	void AddPending(SendStream& stream, SharedBuffer message);
+
+	bool IsDue(const PendingMessage& message, Clock::time_point now) const;
+	void OnAck(uint32_t sequence, Clock::time_point now);
+	void AckMessage(const ReliableMessageHeader& header);
+
+	Clock::duration m_minResendDelay;
+	Clock::duration m_roundTripTime = Clock::duration::zero();
+
+	std::array<SendStream, s_streamCount> m_sendStreams;
+	std::array<ReceiveStream, s_streamCount> m_receiveStreams;
+	std::vector<SentPacket> m_sentPackets;
+
+	// Starts at 1 so the ack of 0 a peer sends before it's heard from us doesn't ack anything.
+	uint32_t m_nextSequence = 1;
+
+	// The newest sequence received and which of the ones before it we've had, as sent in acks.
+	uint32_t m_ack = 0;
+	uint32_t m_ackBits = 0;
+	bool m_hasReceived = false;
+	bool m_needsAck = false;
+	uint32_t m_packetsSinceAck = 0;
+};
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,78 @@
+//---------------------------------------------------------------
+//
+// RttTracker.cpp
+//
+
+#include "common/RttTracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Common {
+
+//===============================================================================
+
+namespace {
+	// RFC 6298 and RFC 3550 gains.
+	const double s_smoothingGain = 1.0 / 8.0;
+	const double s_jitterGain = 1.0 / 16.0;
+} // anon namespace
+
+//-------------------------------------------------------------------------------
+
+void RttTracker::AddSample(std::chrono::microseconds rtt)
+{
+	rtt = std::max(rtt, std::chrono::microseconds::zero());
+	double sample = static_cast<double>(rtt.count());
+
+	if (m_sampleCount == 0)
+	{
+		m_smoothed = sample;
+	}
+	else
+	{
+		double previous = static_cast<double>(m_recent[(m_sampleCount - 1) % s_recentCount].count());
+		m_jitter += (std::abs(sample - previous) - m_jitter) * s_jitterGain;
+		m_smoothed += (sample - m_smoothed) * s_smoothingGain;
+	}
+
+	m_recent[m_sampleCount % s_recentCount] = rtt;
+	++m_sampleCount;
+	m_histogram.Record(rtt);
+}
+
+RttStats RttTracker::GetStats(bool withRecent) const
+{
+	using std::chrono::microseconds;
+
+	RttStats stats;
+	stats.sampleCount = m_sampleCount;
+	if (m_sampleCount == 0)
+	{
+		return stats;
+	}
+
+	stats.latest = m_recent[(m_sampleCount - 1) % s_recentCount];
+	stats.smoothed = microseconds(std::llround(m_smoothed));
+	stats.jitter = microseconds(std::llround(m_jitter));
+	stats.min = m_histogram.GetMin();
+	stats.max = m_histogram.GetMax();
+	stats.p50 = m_histogram.GetPercentile(50.0);
+	stats.p95 = m_histogram.GetPercentile(95.0);
+	stats.p99 = m_histogram.GetPercentile(99.0);
+
+	if (withRecent)
+	{
+		uint64_t count = std::min<uint64_t>(m_sampleCount, s_recentCount);
+		stats.recent.reserve(count);
+		for (uint64_t i = m_sampleCount - count; i < m_sampleCount; ++i)
+		{
+			stats.recent.push_back(m_recent[i % s_recentCount]);
+		}
+	}
+	return stats;
+}
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,83 @@
+//---------------------------------------------------------------
+//
+// RttTracker.h
+//
+
+#pragma once
+
+#include "common/LatencyHistogram.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace Common {
+
+//===============================================================================
+
+// Payload of MessageId::Ping. A Pong carries the Ping's payload back unchanged, so sentAt only
+// has to make sense to whoever sent the Ping.
+struct PingPayload
+{
+	uint32_t sequence = 0;
+	uint32_t reserved = 0;
+
+	// Microseconds on the sender's session clock.
+	int64_t sentAt = 0;
+};
+
+// A copy of what an RttTracker knows, safe to hold on to.
+struct RttStats
+{
+	uint64_t sampleCount = 0;
+
+	std::chrono::microseconds latest = std::chrono::microseconds::zero();
+
+	// Moves an eighth of the way towards each new sample, the way TCP's SRTT does.
+	std::chrono::microseconds smoothed = std::chrono::microseconds::zero();
+
+	// Smoothed difference between consecutive samples, as in RFC 3550.
+	std::chrono::microseconds jitter = std::chrono::microseconds::zero();
+
+	// Over every sample so far.
+	std::chrono::microseconds min = std::chrono::microseconds::zero();
+	std::chrono::microseconds max = std::chrono::microseconds::zero();
+	std::chrono::microseconds p50 = std::chrono::microseconds::zero();
+	std::chrono::microseconds p95 = std::chrono::microseconds::zero();
+	std::chrono::microseconds p99 = std::chrono::microseconds::zero();
+
+	// The last few samples, oldest first. For graphs.
+	std::vector<std::chrono::microseconds> recent;
+};
+
+// Round trip times to one peer. Keeps the last s_recentCount samples in a ring, running smoothed
+// and jitter figures, and a histogram of every sample for percentiles. Not thread safe.
+class RttTracker
+{
+public:
+	static constexpr uint32_t s_recentCount = 128;
+
+	void AddSample(std::chrono::microseconds rtt);
+
+	// recent is left empty unless withRecent is set, which saves copying it when it isn't needed.
+	RttStats GetStats(bool withRecent = true) const;
+
+	const LatencyHistogram& GetHistogram() const { return m_histogram; }
+
+private:
+	std::array<std::chrono::microseconds, s_recentCount> m_recent = {};
+
+	// Total samples ever added. The next one goes at m_sampleCount % s_recentCount.
+	uint64_t m_sampleCount = 0;
+
+	// Kept in microseconds as doubles so small steps towards a sample aren't rounded away.
+	double m_smoothed = 0.0;
+	double m_jitter = 0.0;
+
+	LatencyHistogram m_histogram;
+};
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,213 @@
+//---------------------------------------------------------------
+//
+// SlotMap.h
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Common {
+
+//==============================================================================
+
+// Fixed capacity map from generated ids to shared objects, built for many lookups from one
+// thread while other threads add and remove entries.
+//
+// An id packs a slot index with the slot's generation. Removing an entry bumps the generation,
+// so ids that have been removed are rejected even once their slot has been reused. Find is a
+// couple of atomic loads and an index, with no locking.
+//
+// Removed objects aren't released straight away, since the reader may still be using a pointer
+// it got from Find. They're kept alive until the reader thread calls Collect, at a point where
+// it's holding on to nothing it found.
+template<class T>
+class SlotMap
+{
+public:
+	using Id = uint32_t;
+
+	// Never handed out by Add.
+	static constexpr Id s_invalidId = 0;
+
+	// Capacity is capped at 65535 entries.
+	SlotMap(uint32_t capacity = 4096)
+		: m_slots(std::min<uint32_t>(capacity, s_indexMask))
+	{
+	}
+
+	SlotMap(const SlotMap&) = delete;
+	SlotMap& operator=(const SlotMap&) = delete;
+
+	// Returns s_invalidId if the map is full. Safe to call from any thread.
+	Id Add(std::shared_ptr<T> value)
+	{
+		std::lock_guard<std::mutex> lock(m_writeMutex);
+
+		uint32_t index = 0;
+		if (!m_freeSlots.empty())
+		{
+			index = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else if (m_usedSlots < m_slots.size())
+		{
+			index = m_usedSlots++;
+		}
+		else
+		{
+			return s_invalidId;
+		}
+
+		Slot& slot = m_slots[index];
+		slot.value.store(value.get(), std::memory_order_release);
+		slot.owner = std::move(value);
+		++m_size;
+
+		return MakeId(index, slot.generation.load(std::memory_order_relaxed));
+	}
+
+	// Returns false if id was already removed. Safe to call from any thread.
+	bool Remove(Id id)
+	{
+		std::lock_guard<std::mutex> lock(m_writeMutex);
+
+		Slot* slot = GetSlot(id);
+		if (!slot || slot->generation.load(std::memory_order_relaxed) != GetGeneration(id))
+		{
+			return false;
+		}
+
+		// Invalidate the id before clearing the value, so a reader that sees the old value also
+		// sees the generation change when it checks again.
+		slot->generation.store(NextGeneration(GetGeneration(id)), std::memory_order_release);
+		slot->value.store(nullptr, std::memory_order_release);
+		m_retired.push_back(std::move(slot->owner));
+		m_freeSlots.push_back(GetIndex(id));
+		--m_size;
+
+		return true;
+	}
+
+	// Returns nullptr if id isn't in the map. Doesn't lock. The pointer stays valid until the
+	// calling thread next calls Collect, even if the entry is removed in the meantime.
+	T* Find(Id id) const
+	{
+		const Slot* slot = GetSlot(id);
+		if (!slot)
+		{
+			return nullptr;
+		}
+
+		uint32_t generation = slot->generation.load(std::memory_order_acquire);
+		if (generation != GetGeneration(id))
+		{
+			return nullptr;
+		}
+
+		T* value = slot->value.load(std::memory_order_acquire);
+
+		// The slot may have been removed and reused between the two loads.
+		if (slot->generation.load(std::memory_order_relaxed) != generation)
+		{
+			return nullptr;
+		}
+
+		return value;
+	}
+
+	// Releases everything removed since the last call. Call from the thread that uses Find,
+	// once it's done with any pointers it got from it.
+	void Collect()
+	{
+		std::vector<std::shared_ptr<T>> retired;
+		{
+			std::lock_guard<std::mutex> lock(m_writeMutex);
+			retired.swap(m_retired);
+		}
+	}
+
+	// Calls fn(Id, const std::shared_ptr<T>&) for each entry. Blocks Add and Remove while it runs,
+	// so fn mustn't call them.
+	template <typename Fn>
+	void ForEach(Fn&& fn) const
+	{
+		std::lock_guard<std::mutex> lock(m_writeMutex);
+		for (uint32_t index = 0; index < m_usedSlots; ++index)
+		{
+			const Slot& slot = m_slots[index];
+			if (slot.owner)
+			{
+				fn(MakeId(index, slot.generation.load(std::memory_order_relaxed)), slot.owner);
+			}
+		}
+	}
+
+	uint32_t Size() const
+	{
+		std::lock_guard<std::mutex> lock(m_writeMutex);
+		return m_size;
+	}
+
+	uint32_t Capacity() const { return static_cast<uint32_t>(m_slots.size()); }
+
+private:
+	static constexpr uint32_t s_indexBits = 16;
+	static constexpr uint32_t s_indexMask = (1u << s_indexBits) - 1;
+
+	struct Slot
+	{
+		// Generations start at 1 so no id is ever 0.
+		std::atomic<uint32_t> generation{ 1 };
+		std::atomic<T*> value{ nullptr };
+
+		// Only touched with the write mutex held.
+		std::shared_ptr<T> owner;
+	};
+
+	static Id MakeId(uint32_t index, uint32_t generation)
+	{
+		return (generation << s_indexBits) | index;
+	}
+
+	static uint32_t GetIndex(Id id) { return id & s_indexMask; }
+	static uint32_t GetGeneration(Id id) { return id >> s_indexBits; }
+
+	// Wraps within the bits left over for the generation, skipping 0.
+	static uint32_t NextGeneration(uint32_t generation)
+	{
+		uint32_t next = (generation + 1) & (~0u >> s_indexBits);
+		return next ? next : 1;
+	}
+
+	const Slot* GetSlot(Id id) const
+	{
+		uint32_t index = GetIndex(id);
+		return index < m_slots.size() ? &m_slots[index] : nullptr;
+	}
+
+	Slot* GetSlot(Id id)
+	{
+		uint32_t index = GetIndex(id);
+		return index < m_slots.size() ? &m_slots[index] : nullptr;
+	}
+
+	// Sized up front and never reallocated, so Find never races with a resize.
+	std::vector<Slot> m_slots;
+
+	// Guards everything below, and the owners in m_slots.
+	mutable std::mutex m_writeMutex;
+	std::vector<uint32_t> m_freeSlots;
+	std::vector<std::shared_ptr<T>> m_retired;
+	uint32_t m_usedSlots = 0;
+	uint32_t m_size = 0;
+};
+
+//==============================================================================
+
+} // namespace Common
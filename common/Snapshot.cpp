@@ -0,0 +1,492 @@
+//---------------------------------------------------------------
+//
+// Snapshot.cpp
+//
+
+#include "common/Snapshot.h"
+
+#include <assert.h>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace Common {
+
+//===============================================================================
+
+namespace {
+	const float s_twoPi = 6.28318530718f;
+
+	// Most removals, and most changes, one snapshot can carry. SnapshotHeader counts them in 16
+	// bits.
+	const uint32_t s_maxListed = std::numeric_limits<uint16_t>::max();
+
+	template <typename T>
+	void Write(std::string& out, const T& value)
+	{
+		out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	// Reads a T off the front of data. Returns false if there isn't a whole one.
+	template <typename T>
+	bool Read(std::string_view& data, T& value)
+	{
+		if (data.size() < sizeof(value))
+		{
+			return false;
+		}
+
+		std::memcpy(&value, data.data(), sizeof(value));
+		data.remove_prefix(sizeof(value));
+		return true;
+	}
+
+	uint8_t GetChangedFields(const EntityState& baseline, const EntityState& current)
+	{
+		uint8_t fields = 0;
+		if (baseline.x != current.x || baseline.y != current.y || baseline.z != current.z)
+		{
+			fields |= EntityFields::Position;
+		}
+		if (baseline.heading != current.heading)
+		{
+			fields |= EntityFields::Heading;
+		}
+		if (baseline.creatureType != current.creatureType)
+		{
+			fields |= EntityFields::CreatureType;
+		}
+		if (baseline.health != current.health)
+		{
+			fields |= EntityFields::Health;
+		}
+		if (baseline.flags != current.flags)
+		{
+			fields |= EntityFields::Flags;
+		}
+		return fields;
+	}
+
+	// The quantized fields in fields, packed together.
+	uint32_t GetQuantizedBits(uint8_t fields)
+	{
+		uint32_t bits = 0;
+		if (fields & EntityFields::Position)
+		{
+			bits += 2 * SnapshotQuantization::s_horizontal.bits + SnapshotQuantization::s_vertical.bits;
+		}
+		if (fields & EntityFields::Heading)
+		{
+			bits += SnapshotQuantization::s_heading.bits;
+		}
+		return bits;
+	}
+
+	uint32_t GetQuantizedSize(uint8_t fields)
+	{
+		return (GetQuantizedBits(fields) + 7) / 8;
+	}
+
+	float WrapHeading(float heading)
+	{
+		heading = std::fmod(heading, s_twoPi);
+		return heading < 0.0f ? heading + s_twoPi : heading;
+	}
+
+	// What WriteEntity writes for fields.
+	uint32_t GetEntitySize(uint8_t fields)
+	{
+		uint32_t size = sizeof(EntityState::entityId) + sizeof(fields) + GetQuantizedSize(fields);
+		if (fields & EntityFields::CreatureType)
+		{
+			size += sizeof(EntityState::creatureType);
+		}
+		if (fields & EntityFields::Health)
+		{
+			size += sizeof(EntityState::health);
+		}
+		if (fields & EntityFields::Flags)
+		{
+			size += sizeof(EntityState::flags);
+		}
+		return size;
+	}
+
+	void WriteEntity(std::string& out, const EntityState& entity, uint8_t fields)
+	{
+		Write(out, entity.entityId);
+		Write(out, fields);
+		if (GetQuantizedBits(fields))
+		{
+			const QuantizedRange& horizontal = SnapshotQuantization::s_horizontal;
+			const QuantizedRange& vertical = SnapshotQuantization::s_vertical;
+			const QuantizedRange& heading = SnapshotQuantization::s_heading;
+			BitWriter writer(out);
+			if (fields & EntityFields::Position)
+			{
+				writer.Write(horizontal.Quantize(entity.x), horizontal.bits);
+				writer.Write(horizontal.Quantize(entity.y), horizontal.bits);
+				writer.Write(vertical.Quantize(entity.z), vertical.bits);
+			}
+			if (fields & EntityFields::Heading)
+			{
+				writer.Write(heading.Quantize(WrapHeading(entity.heading)), heading.bits);
+			}
+			writer.Flush();
+		}
+		if (fields & EntityFields::CreatureType)
+		{
+			Write(out, entity.creatureType);
+		}
+		if (fields & EntityFields::Health)
+		{
+			Write(out, entity.health);
+		}
+		if (fields & EntityFields::Flags)
+		{
+			Write(out, entity.flags);
+		}
+	}
+
+	bool ReadEntity(std::string_view& data, GameState& state)
+	{
+		uint32_t entityId = 0;
+		uint8_t fields = 0;
+		if (!Read(data, entityId) || !Read(data, fields))
+		{
+			return false;
+		}
+
+		// A new entity has every field set. A changed one starts from what the baseline had.
+		EntityState entity;
+		entity.entityId = entityId;
+		if (const EntityState* existing = state.FindEntity(entityId))
+		{
+			entity = *existing;
+		}
+
+		uint32_t quantizedSize = GetQuantizedSize(fields);
+		if (data.size() < quantizedSize)
+		{
+			return false;
+		}
+
+		const QuantizedRange& horizontal = SnapshotQuantization::s_horizontal;
+		const QuantizedRange& vertical = SnapshotQuantization::s_vertical;
+		const QuantizedRange& heading = SnapshotQuantization::s_heading;
+		BitReader reader(data.substr(0, quantizedSize));
+		data.remove_prefix(quantizedSize);
+
+		// The size was checked above, so these reads can't run out.
+		uint32_t value = 0;
+		if (fields & EntityFields::Position)
+		{
+			reader.Read(horizontal.bits, value);
+			entity.x = horizontal.Dequantize(value);
+			reader.Read(horizontal.bits, value);
+			entity.y = horizontal.Dequantize(value);
+			reader.Read(vertical.bits, value);
+			entity.z = vertical.Dequantize(value);
+		}
+		if (fields & EntityFields::Heading)
+		{
+			reader.Read(heading.bits, value);
+			entity.heading = heading.Dequantize(value);
+		}
+
+		bool isValid = true;
+		if (fields & EntityFields::CreatureType)
+		{
+			isValid = isValid && Read(data, entity.creatureType);
+		}
+		if (fields & EntityFields::Health)
+		{
+			isValid = isValid && Read(data, entity.health);
+		}
+		if (fields & EntityFields::Flags)
+		{
+			isValid = isValid && Read(data, entity.flags);
+		}
+
+		if (isValid)
+		{
+			state.SetEntity(entity);
+		}
+		return isValid;
+	}
+} // anon namespace
+
+//-------------------------------------------------------------------------------
+
+// Each range stops a step short of its round number, so steps are 1/32 and 1/8 of a unit apart
+// and whole positions, 0 included, come through exactly.
+const QuantizedRange SnapshotQuantization::s_horizontal(-2048.0f, 2048.0f - 1.0f / 32.0f, 17);
+const QuantizedRange SnapshotQuantization::s_vertical(-256.0f, 256.0f - 1.0f / 8.0f, 12);
+const QuantizedRange SnapshotQuantization::s_heading(0.0f, s_twoPi, 11);
+
+//-------------------------------------------------------------------------------
+
+SnapshotEncoder::SnapshotEncoder()
+	: m_history(s_historySize)
+{
+}
+
+std::string SnapshotEncoder::Encode(const GameState& state)
+{
+	return Encode(state, std::numeric_limits<uint32_t>::max(), nullptr);
+}
+
+std::string SnapshotEncoder::Encode(const GameState& state, uint32_t maxBytes,
+	const ChangeSelector& selector)
+{
+	const Sent* baseline = GetBaseline();
+	const Sent* latest = GetLatest(baseline);
+	const std::vector<EntityState>& before = baseline ? baseline->state.GetEntities()
+		: m_emptyState.GetEntities();
+	const std::vector<EntityState>& after = state.GetEntities();
+
+	SnapshotHeader header;
+	header.sequence = m_nextSequence++;
+	header.baselineSequence = baseline ? baseline->sequence : 0;
+
+	// Both lists are sorted by id, so one walk over them finds what was removed, added and
+	// changed. Removals are written straight away since they always go in, unless there are
+	// more than the header can count.
+	std::string removed;
+	uint32_t removedTotal = 0;
+	m_changes.clear();
+	size_t i = 0;
+	size_t j = 0;
+	while (i < before.size() || j < after.size())
+	{
+		if (j == after.size() || (i < before.size() && before[i].entityId < after[j].entityId))
+		{
+			if (header.removedCount < s_maxListed)
+			{
+				Write(removed, before[i].entityId);
+				++header.removedCount;
+			}
+			++removedTotal;
+			++i;
+		}
+		else if (i == before.size() || after[j].entityId < before[i].entityId)
+		{
+			SnapshotChange change{ &after[j], EntityFields::All, GetEntitySize(EntityFields::All), true };
+			change.isRequired = latest && latest->state.FindEntity(after[j].entityId);
+			m_changes.push_back(change);
+			++j;
+		}
+		else
+		{
+			uint8_t fields = GetChangedFields(before[i], after[j]);
+			if (fields)
+			{
+				// Required if the newest snapshot has the entity as anything but the baseline did.
+				SnapshotChange change{ &after[j], fields, GetEntitySize(fields) };
+				const EntityState* sent = latest ? latest->state.FindEntity(after[j].entityId) : nullptr;
+				change.isRequired = latest && (!sent || GetChangedFields(before[i], *sent));
+				m_changes.push_back(change);
+			}
+			++i;
+			++j;
+		}
+	}
+
+	size_t used = sizeof(header) + removed.size();
+	for (SnapshotChange& change : m_changes)
+	{
+		change.isSelected = change.isRequired;
+		used += change.isRequired ? change.size : 0;
+	}
+
+	uint32_t budget = maxBytes > used ? static_cast<uint32_t>(maxBytes - used) : 0;
+	if (selector)
+	{
+		selector(m_changes, budget);
+	}
+	else
+	{
+		for (SnapshotChange& change : m_changes)
+		{
+			change.isSelected = true;
+		}
+	}
+
+	// Whatever the selector picked, never go over what it was given.
+	std::string changed;
+	uint32_t spent = 0;
+	bool isEverythingSent = removedTotal == header.removedCount;
+	for (SnapshotChange& change : m_changes)
+	{
+		if (!change.isRequired)
+		{
+			change.isSelected = change.isSelected && spent + change.size <= budget;
+			spent += change.isSelected ? change.size : 0;
+		}
+
+		// Past what the header can count, even required changes wait for the next snapshot.
+		// It's remembered without them, so the next is encoded against what the client has.
+		change.isSelected = change.isSelected || change.isRequired;
+		change.isSelected = change.isSelected && header.changedCount < s_maxListed;
+		if (change.isSelected)
+		{
+			WriteEntity(changed, *change.entity, change.fields);
+			++header.changedCount;
+		}
+		isEverythingSent = isEverythingSent && change.isSelected;
+	}
+
+	assert(removed.size() == header.removedCount * sizeof(uint32_t));
+
+	std::string payload;
+	payload.reserve(sizeof(header) + removed.size() + changed.size());
+	Write(payload, header);
+	payload.append(removed);
+	payload.append(changed);
+
+	// Remember the snapshot as the client will have it. If anything was left out that's the
+	// baseline with just the selected changes and the removals that fit applied.
+	if (isEverythingSent)
+	{
+		Sent& sent = m_history[header.sequence % s_historySize];
+		sent.sequence = header.sequence;
+		sent.state = state;
+	}
+	else
+	{
+		GameState result;
+		auto change = m_changes.begin();
+		uint32_t removals = 0;
+		i = 0;
+		j = 0;
+		while (i < before.size() || j < after.size())
+		{
+			if (j == after.size() || (i < before.size() && before[i].entityId < after[j].entityId))
+			{
+				if (removals++ >= header.removedCount)
+				{
+					result.SetEntity(before[i]);
+				}
+				++i;
+				continue;
+			}
+
+			bool isNew = i == before.size() || after[j].entityId < before[i].entityId;
+			bool isChange = change != m_changes.end() && change->entity == &after[j];
+			if (isChange ? change->isSelected : !isNew)
+			{
+				result.SetEntity(after[j]);
+			}
+			else if (!isNew)
+			{
+				result.SetEntity(before[i]);
+			}
+
+			change += isChange ? 1 : 0;
+			i += isNew ? 0 : 1;
+			++j;
+		}
+
+		// Only written once the walk is done, since the slot can be the baseline's own.
+		Sent& sent = m_history[header.sequence % s_historySize];
+		sent.sequence = header.sequence;
+		sent.state = std::move(result);
+	}
+
+	return payload;
+}
+
+void SnapshotEncoder::OnAck(uint32_t sequence)
+{
+	// Only ever move forward, and only to something we actually sent.
+	if (sequence > m_ackedSequence && sequence < m_nextSequence)
+	{
+		m_ackedSequence = sequence;
+	}
+}
+
+const SnapshotEncoder::Sent* SnapshotEncoder::GetBaseline() const
+{
+	if (m_ackedSequence == 0)
+	{
+		return nullptr;
+	}
+
+	// The slot may have been reused by a newer snapshot since it was acked.
+	const Sent& sent = m_history[m_ackedSequence % s_historySize];
+	return sent.sequence == m_ackedSequence ? &sent : nullptr;
+}
+
+const SnapshotEncoder::Sent* SnapshotEncoder::GetLatest(const Sent* baseline) const
+{
+	uint32_t sequence = m_nextSequence - 1;
+	const Sent& sent = m_history[sequence % s_historySize];
+	return sequence != 0 && sent.sequence == sequence && &sent != baseline ? &sent : nullptr;
+}
+
+//-------------------------------------------------------------------------------
+
+SnapshotDecoder::SnapshotDecoder()
+	: m_history(SnapshotEncoder::s_historySize)
+{
+}
+
+bool SnapshotDecoder::Decode(std::string_view payload, GameState& state)
+{
+	SnapshotHeader header;
+	if (!Read(payload, header) || header.sequence <= m_lastSequence)
+	{
+		return false;
+	}
+
+	GameState result;
+	if (header.baselineSequence != 0)
+	{
+		const Received& baseline = m_history[header.baselineSequence % SnapshotEncoder::s_historySize];
+		if (baseline.sequence != header.baselineSequence)
+		{
+			return false;
+		}
+		result = baseline.state;
+	}
+
+	// The ids come in order, so removing from the last one back doesn't move the entities
+	// behind each removal over and over when a lot go at once.
+	const size_t removedSize = header.removedCount * sizeof(uint32_t);
+	if (payload.size() < removedSize)
+	{
+		return false;
+	}
+	for (uint32_t i = header.removedCount; i > 0; --i)
+	{
+		uint32_t entityId = 0;
+		std::memcpy(&entityId, payload.data() + (i - 1) * sizeof(uint32_t), sizeof(entityId));
+		result.RemoveEntity(entityId);
+	}
+	payload.remove_prefix(removedSize);
+
+	for (uint16_t i = 0; i < header.changedCount; ++i)
+	{
+		if (!ReadEntity(payload, result))
+		{
+			return false;
+		}
+	}
+
+	if (!payload.empty())
+	{
+		return false;
+	}
+
+	Received& received = m_history[header.sequence % SnapshotEncoder::s_historySize];
+	received.sequence = header.sequence;
+	received.state = result;
+
+	m_lastSequence = header.sequence;
+	state = std::move(result);
+	return true;
+}
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,173 @@
+//---------------------------------------------------------------
+//
+// Snapshot.h
+//
+
+#pragma once
+
+#include "common/BitPacking.h"
+#include "common/GameState.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Common {
+
+//===============================================================================
+
+// Payload of MessageId::Snapshot starts with this. removedCount entity ids follow, then
+// changedCount entities, each an id, a mask of EntityFields and then just the fields in the mask.
+// Position and heading are quantized and packed together into as few bytes as they fit, ahead of
+// the other fields. See SnapshotQuantization.
+struct SnapshotHeader
+{
+	uint32_t sequence = 0;
+
+	// The snapshot this one is a delta from. 0 if it's the whole state.
+	uint32_t baselineSequence = 0;
+
+	uint16_t removedCount = 0;
+	uint16_t changedCount = 0;
+};
+
+// Payload of MessageId::SnapshotAck.
+struct SnapshotAck
+{
+	uint32_t sequence = 0;
+};
+
+// How snapshots quantize the fields that change with every move. What the client decodes is
+// within each range's GetMaxError of what the server has: about 0.016 units for x and y, 0.06
+// for z and a tenth of a degree for heading. x and y cover the same 4096 unit world as
+// MotionQuantization. Whole numbers come through exactly. Values outside a range are clamped to
+// it, and headings come back wrapped into [0, 2pi).
+struct SnapshotQuantization
+{
+	static const QuantizedRange s_horizontal;
+	static const QuantizedRange s_vertical;
+	static const QuantizedRange s_heading;
+};
+
+// Bits in a changed entity's mask.
+struct EntityFields
+{
+	static constexpr uint8_t Position = 1 << 0;
+	static constexpr uint8_t Heading = 1 << 1;
+	static constexpr uint8_t CreatureType = 1 << 2;
+	static constexpr uint8_t Health = 1 << 3;
+	static constexpr uint8_t Flags = 1 << 4;
+
+	static constexpr uint8_t All = Position | Heading | CreatureType | Health | Flags;
+};
+
+// An entity a snapshot could carry, because it's new to the client or has changed since the
+// baseline. size is what it costs in the payload.
+struct SnapshotChange
+{
+	const EntityState* entity = nullptr;
+	uint8_t fields = 0;
+	uint32_t size = 0;
+
+	// The client doesn't have the entity yet.
+	bool isNew = false;
+
+	// Went out in a snapshot that hasn't been acked, so the client may already have it. Leaving
+	// it out would take the entity back to how it was in the baseline, or remove it if it's new.
+	// Always sent, and paid for before the selector gets the budget.
+	bool isRequired = false;
+
+	bool isSelected = false;
+};
+
+// Server side, one per client. Encodes each snapshot as a delta from the newest one the client
+// has acked, so entities that haven't changed since then cost nothing, and ones that have only
+// cost the fields that changed. Until something is acked, or if the last ack is too old to
+// still be in the history, the whole state is sent.
+//
+// Deltas never build on a snapshot that hasn't been acked, so they can go over a transport
+// that loses them. Losing one just means the next is a delta from an older baseline.
+class SnapshotEncoder
+{
+public:
+	// How many sent snapshots are kept to encode against. An ack older than this is ignored.
+	static constexpr uint32_t s_historySize = 32;
+
+	// Marks which changes to send, spending no more than budget bytes on them. Changes are sorted
+	// by entity id. Required ones are already selected and not counted in budget.
+	using ChangeSelector = std::function<void(std::vector<SnapshotChange>& changes, uint32_t budget)>;
+
+	SnapshotEncoder();
+
+	// Returns a MessageId::Snapshot payload for state.
+	std::string Encode(const GameState& state);
+
+	// Same, but no bigger than maxBytes, leaving selector to pick which changes make it in.
+	// Removals and required changes always go in, so while acks are slow to come back this can
+	// go over maxBytes. The exception is past 65535 of either, which is all SnapshotHeader can
+	// count. The rest wait for the next snapshot. Changes left out stay different from the
+	// baseline, so they're offered to selector again next time. The snapshot is remembered as
+	// the client will have it, with the changes left out still as they were in the baseline.
+	std::string Encode(const GameState& state, uint32_t maxBytes, const ChangeSelector& selector);
+
+	// Called when the client acks a snapshot. Ignored if it's older than the current baseline.
+	void OnAck(uint32_t sequence);
+
+	// 0 until the client has acked something.
+	uint32_t GetAckedSequence() const { return m_ackedSequence; }
+
+private:
+	struct Sent
+	{
+		uint32_t sequence = 0;
+		GameState state;
+	};
+
+	// Returns the baseline to encode against, or nullptr to send everything.
+	const Sent* GetBaseline() const;
+
+	// Returns the newest snapshot sent, or nullptr if there isn't one or it's baseline.
+	const Sent* GetLatest(const Sent* baseline) const;
+
+	std::vector<Sent> m_history;
+	uint32_t m_nextSequence = 1;
+	uint32_t m_ackedSequence = 0;
+
+	// Stands in for the baseline when there isn't one.
+	GameState m_emptyState;
+
+	// What differs from the baseline, gathered before the accumulator picks what fits.
+	std::vector<SnapshotChange> m_changes;
+};
+
+// Client side. Rebuilds the server's state from snapshots and keeps recent ones as baselines
+// for the deltas that follow.
+class SnapshotDecoder
+{
+public:
+	SnapshotDecoder();
+
+	// Applies a snapshot payload and replaces state with the result. Returns false, leaving state
+	// alone, if the payload is malformed, older than the last one applied or a delta from a
+	// baseline that isn't held. Ack the sequence whenever it returns true.
+	bool Decode(std::string_view payload, GameState& state);
+
+	// The newest snapshot applied. 0 before the first.
+	uint32_t GetLastSequence() const { return m_lastSequence; }
+
+private:
+	struct Received
+	{
+		uint32_t sequence = 0;
+		GameState state;
+	};
+
+	std::vector<Received> m_history;
+	uint32_t m_lastSequence = 0;
+};
+
+//===============================================================================
+
+} // namespace Common
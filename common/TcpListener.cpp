@@ -0,0 +1,265 @@
+//---------------------------------------------------------------
+//
+// TcpListener.cpp
+//
+
+#include "common/TcpListener.h"
+
+#include "common/AsioEventProcessor.h"
+#include "common/Log.h"
+
+using tcp = asio::ip::tcp;
+
+namespace Common {
+
+//===============================================================================
+
+namespace {
+#ifdef SO_REUSEPORT
+	using ReusePort = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+	// Errors that say the process or system is out of something a socket needs, rather than
+	// that something's wrong with the connection.
+	bool IsExhausted(const std::error_code& ec)
+	{
+		return ec == asio::error::no_descriptors
+			|| ec == std::errc::too_many_files_open_in_system
+			|| ec == asio::error::no_buffer_space
+			|| ec == asio::error::no_memory;
+	}
+} // anon namespace
+
+TcpListener::TcpListener(AsioEventProcessor& ioPool, const std::string& loggingContext,
+	const TcpListenerConfig& config)
+	: m_ioPool(ioPool)
+	, m_config(config)
+{
+	REGISTER_LOGGER(loggingContext);
+	m_logger = Log::Logger(loggingContext);
+}
+
+TcpListener::~TcpListener()
+{
+}
+
+bool TcpListener::Listen(const tcp::endpoint& endpoint, std::error_code& ec)
+{
+	uint32_t acceptorCount = 1;
+	if (m_config.reusePort && IsReusePortSupported())
+	{
+		acceptorCount = m_ioPool.GetThreadCount();
+	}
+
+	tcp::endpoint bindTo = endpoint;
+	for (uint32_t i = 0; i < acceptorCount; ++i)
+	{
+		auto acceptor = std::make_unique<Acceptor>(m_ioPool.GetIoService(i));
+		if (!Open(*acceptor, bindTo, ec))
+		{
+			m_acceptors.clear();
+			return false;
+		}
+
+		// A port of 0 is only picked once. The other acceptors join the first on it.
+		bindTo.port(acceptor->acceptor.local_endpoint(ec).port());
+		m_acceptors.push_back(std::move(acceptor));
+	}
+
+	m_port = bindTo.port();
+	m_isRunning = true;
+	SPDLOG_LOGGER_INFO(m_logger, "Listening on port {}. acceptors= {}", m_port, acceptorCount);
+
+	// Each acceptor's accepts only ever run on its own thread.
+	for (const std::unique_ptr<Acceptor>& acceptor : m_acceptors)
+	{
+		asio::post(acceptor->ios, [self = shared_from_this(), &entry = *acceptor]()
+			{
+				self->DoAccept(entry);
+			});
+	}
+	return true;
+}
+
+void TcpListener::Stop()
+{
+	if (!m_isRunning.exchange(false))
+	{
+		return;
+	}
+
+	TcpListenerStats stats = GetStats();
+	SPDLOG_LOGGER_INFO(m_logger, "Stopping listener. accepted= {} wakeups= {} acceptErrors= {}"
+		" backoffs= {}", stats.accepted, stats.wakeups, stats.acceptErrors, stats.backoffs);
+
+	// Closing cancels the pending accept, so it has to happen on the thread that started it.
+	for (const std::unique_ptr<Acceptor>& acceptor : m_acceptors)
+	{
+		asio::post(acceptor->ios, [self = shared_from_this(), &entry = *acceptor]()
+			{
+				std::error_code ec;
+				entry.acceptor.close(ec);
+				entry.retryTimer.cancel(ec);
+			});
+	}
+}
+
+TcpListenerStats TcpListener::GetStats() const
+{
+	TcpListenerStats stats;
+	stats.accepted = m_accepted.load(std::memory_order_relaxed);
+	stats.acceptErrors = m_acceptErrors.load(std::memory_order_relaxed);
+	stats.wakeups = m_wakeups.load(std::memory_order_relaxed);
+	stats.backoffs = m_backoffs.load(std::memory_order_relaxed);
+	return stats;
+}
+
+bool TcpListener::IsReusePortSupported()
+{
+#ifdef SO_REUSEPORT
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool TcpListener::Open(Acceptor& acceptor, const tcp::endpoint& endpoint, std::error_code& ec)
+{
+	// Options have to be set before bind to have any effect on it.
+	acceptor.acceptor.open(endpoint.protocol(), ec);
+	if (!ec)
+	{
+		acceptor.acceptor.set_option(tcp::acceptor::reuse_address(true), ec);
+	}
+#ifdef SO_REUSEPORT
+	if (!ec && m_config.reusePort)
+	{
+		acceptor.acceptor.set_option(ReusePort(true), ec);
+	}
+#endif
+	if (!ec)
+	{
+		acceptor.acceptor.bind(endpoint, ec);
+	}
+	if (!ec)
+	{
+		acceptor.acceptor.listen(m_config.backlog, ec);
+	}
+	if (!ec)
+	{
+		// Only affects the synchronous accepts that drain the queue. Async ones never block.
+		acceptor.acceptor.non_blocking(true, ec);
+	}
+
+	if (ec)
+	{
+		SPDLOG_LOGGER_ERROR(m_logger, "Failed to open acceptor. port= {} ec={}", endpoint.port(),
+			ec.value());
+		return false;
+	}
+	return true;
+}
+
+void TcpListener::DoAccept(Acceptor& acceptor)
+{
+	// Every accept gets a socket of its own, made on the io_service it's going to live on.
+	acceptor.acceptor.async_accept(GetSocketIoService(acceptor),
+		[self = shared_from_this(), &acceptor](const std::error_code& ec, tcp::socket socket)
+		{
+			self->OnAccept(acceptor, ec, std::move(socket));
+		});
+}
+
+void TcpListener::OnAccept(Acceptor& acceptor, const std::error_code& ec, tcp::socket socket)
+{
+	if (!m_isRunning)
+	{
+		return;
+	}
+
+	m_wakeups.fetch_add(1, std::memory_order_relaxed);
+	std::error_code error = ec;
+	if (!error)
+	{
+		Deliver(acceptor, std::move(socket));
+
+		// In a connection storm more are queued by the time this one's handled. Taking them
+		// now saves a trip through the reactor for each.
+		for (uint32_t i = 1; i < m_config.maxAcceptsPerWakeup; ++i)
+		{
+			std::error_code acceptEc;
+			tcp::socket next = acceptor.acceptor.accept(GetSocketIoService(acceptor), acceptEc);
+			if (acceptEc == asio::error::would_block || acceptEc == asio::error::try_again)
+			{
+				break;
+			}
+			if (acceptEc)
+			{
+				error = acceptEc;
+				break;
+			}
+
+			Deliver(acceptor, std::move(next));
+		}
+	}
+
+	if (error && !OnAcceptError(error))
+	{
+		return;
+	}
+
+	if (IsExhausted(error))
+	{
+		DoAcceptLater(acceptor);
+		return;
+	}
+	DoAccept(acceptor);
+}
+
+void TcpListener::DoAcceptLater(Acceptor& acceptor)
+{
+	m_backoffs.fetch_add(1, std::memory_order_relaxed);
+	acceptor.retryTimer.expires_after(m_config.exhaustedRetryDelay);
+	acceptor.retryTimer.async_wait(
+		[self = shared_from_this(), &acceptor](const std::error_code& ec)
+		{
+			if (!ec && self->m_isRunning)
+			{
+				self->DoAccept(acceptor);
+			}
+		});
+}
+
+asio::io_service& TcpListener::GetSocketIoService(Acceptor& acceptor)
+{
+	if (m_acceptors.size() > 1)
+	{
+		return acceptor.ios;
+	}
+
+	// Only moved on once a socket is handed out, so a failed accept doesn't skip a thread.
+	return m_ioPool.GetIoService(acceptor.socketCount % m_ioPool.GetThreadCount());
+}
+
+void TcpListener::Deliver(Acceptor& acceptor, tcp::socket socket)
+{
+	++acceptor.socketCount;
+	m_accepted.fetch_add(1, std::memory_order_relaxed);
+	m_acceptHandler(std::move(socket));
+}
+
+bool TcpListener::OnAcceptError(const std::error_code& ec)
+{
+	if (ec == asio::error::operation_aborted)
+	{
+		return false;
+	}
+
+	m_acceptErrors.fetch_add(1, std::memory_order_relaxed);
+	SPDLOG_LOGGER_ERROR(m_logger, "Error accepting incoming connection. ec={}", ec.value());
+	return true;
+}
+
+//===============================================================================
+
+} // namespace Common
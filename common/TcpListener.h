@@ -0,0 +1,141 @@
+//---------------------------------------------------------------
+//
+// TcpListener.h
+//
+
+#pragma once
+
+#include <asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace spdlog {
+class logger;
+}
+
+namespace Common {
+
+//===============================================================================
+
+class AsioEventProcessor;
+
+struct TcpListenerConfig
+{
+	// One acceptor per io thread, all bound to the same port with SO_REUSEPORT. The kernel
+	// spreads incoming connections across their queues, and each thread keeps the sockets it
+	// accepts. Platforms without SO_REUSEPORT get one acceptor, as if this were false.
+	bool reusePort = false;
+
+	// Most connections an acceptor takes per wakeup. Once one accept completes, whatever else
+	// is queued behind it is accepted straight away, without going back to the reactor.
+	uint32_t maxAcceptsPerWakeup = 64;
+
+	// Queue length asked for on each acceptor. The kernel caps it, at net.core.somaxconn on Linux.
+	int backlog = asio::socket_base::max_listen_connections;
+
+	// How long an acceptor waits before accepting again after running out of file descriptors
+	// or memory. The connection it failed on is still queued, so trying again straight away
+	// would only fail again.
+	std::chrono::milliseconds exhaustedRetryDelay = std::chrono::milliseconds(100);
+};
+
+struct TcpListenerStats
+{
+	uint64_t accepted = 0;
+	uint64_t acceptErrors = 0;
+
+	// Times an acceptor was woken by an accept completing. Accepted over wakeups is the average
+	// batch.
+	uint64_t wakeups = 0;
+
+	// Times an acceptor waited out exhaustedRetryDelay.
+	uint64_t backoffs = 0;
+};
+
+// Accepts connections on a port and hands the sockets out across an AsioEventProcessor's threads.
+// With one acceptor they're handed out round robin. With one per thread, each socket stays on
+// the thread that accepted it.
+class TcpListener : public std::enable_shared_from_this<TcpListener>
+{
+public:
+	// Gets each socket once it's accepted, on the accepting acceptor's thread. The socket is
+	// already bound to the io_service it will live on, which may be another thread's.
+	using AcceptHandler = std::function<void(asio::ip::tcp::socket socket)>;
+
+	TcpListener(AsioEventProcessor& ioPool, const std::string& loggingContext,
+		const TcpListenerConfig& config = {});
+	~TcpListener();
+
+	// Set this before Listen.
+	void SetAcceptHandler(AcceptHandler handler) { m_acceptHandler = std::move(handler); }
+
+	// Opens the acceptors and starts accepting. A port of 0 picks a free one, see GetPort.
+	// Returns false, with nothing left open, if any of them can't be opened. Call once.
+	bool Listen(const asio::ip::tcp::endpoint& endpoint, std::error_code& ec);
+
+	// Closes every acceptor. Safe from any thread.
+	void Stop();
+
+	uint16_t GetPort() const { return m_port; }
+	uint32_t GetAcceptorCount() const { return static_cast<uint32_t>(m_acceptors.size()); }
+
+	// Safe from any thread.
+	TcpListenerStats GetStats() const;
+
+	// True if this platform can bind more than one acceptor to a port.
+	static bool IsReusePortSupported();
+
+private:
+	struct Acceptor
+	{
+		explicit Acceptor(asio::io_service& ios) : ios(ios), acceptor(ios), retryTimer(ios) {}
+
+		asio::io_service& ios;
+		asio::ip::tcp::acceptor acceptor;
+		asio::steady_timer retryTimer;
+
+		// Picks the next io_service round robin when there's only one acceptor. Only touched
+		// on the acceptor's thread.
+		uint32_t socketCount = 0;
+	};
+
+	bool Open(Acceptor& acceptor, const asio::ip::tcp::endpoint& endpoint, std::error_code& ec);
+	void DoAccept(Acceptor& acceptor);
+	void OnAccept(Acceptor& acceptor, const std::error_code& ec, asio::ip::tcp::socket socket);
+
+	// Accepts again once exhaustedRetryDelay has passed.
+	void DoAcceptLater(Acceptor& acceptor);
+
+	// Where a socket accepted by acceptor should live.
+	asio::io_service& GetSocketIoService(Acceptor& acceptor);
+
+	// Hands a socket accepted by acceptor to the accept handler.
+	void Deliver(Acceptor& acceptor, asio::ip::tcp::socket socket);
+
+	// Counts an accept that failed. Returns false if the acceptor was closed.
+	bool OnAcceptError(const std::error_code& ec);
+
+	AsioEventProcessor& m_ioPool;
+	TcpListenerConfig m_config;
+	AcceptHandler m_acceptHandler;
+	std::vector<std::unique_ptr<Acceptor>> m_acceptors;
+	uint16_t m_port = 0;
+	std::atomic<bool> m_isRunning{ false };
+
+	std::atomic<uint64_t> m_accepted{ 0 };
+	std::atomic<uint64_t> m_acceptErrors{ 0 };
+	std::atomic<uint64_t> m_wakeups{ 0 };
+	std::atomic<uint64_t> m_backoffs{ 0 };
+
+	std::shared_ptr<spdlog::logger> m_logger;
+};
+
+//===============================================================================
+
+} // namespace Common
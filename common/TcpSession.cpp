@@ -6,8 +6,12 @@
 #include "TcpSession.h"
 
 #include "common/Log.h"
+#include "common/NetworkCapture.h"
 #include "common/NetworkMessageParser.h"
 
+#include <algorithm>
+#include <cstring>
+
 using tcp = asio::ip::tcp;
 
 namespace Common {
@@ -15,21 +19,74 @@ namespace Common {
 //===============================================================================
 
 namespace {
-	std::shared_ptr<spdlog::logger> s_logger;
+	// Number of whole legacy frames in message, or 0 if it isn't made of whole frames.
+	uint32_t CountLegacyFrames(std::string_view message)
+	{
+		uint32_t count = 0;
+		MessageHeader header;
+		while (PeekHeader(message, header))
+		{
+			if (header.messageLength > message.size() - sizeof(header))
+			{
+				return 0;
+			}
+
+			message.remove_prefix(sizeof(header) + header.messageLength);
+			++count;
+		}
+		return message.empty() ? count : 0;
+	}
+
+	// Messages parsed out of a read. They point into the session's ring and are packed into a
+	// MessageBatch before the read handler returns, and a thread runs one handler at a time, so
+	// every session on the thread can share one list rather than each keep its own.
+	std::vector<NetworkMessageView>& GetParsedMessages()
+	{
+		thread_local std::vector<NetworkMessageView> s_messages;
+		if (s_messages.capacity() == 0)
+		{
+			s_messages.reserve(1024);
+		}
+		return s_messages;
+	}
 } // anon namespace
 
-TcpSession::TcpSession(tcp::socket socket, const std::string& loggingContext)
-	: m_socket(std::move(socket))
+//-------------------------------------------------------------------------------
+
+bool ParseReadEngine(std::string_view name, ReadEngine& engine)
 {
-	REGISTER_LOGGER(loggingContext);
-	s_logger = Log::Logger(loggingContext);
+	if (name == "async")
+	{
+		engine = ReadEngine::Async;
+		return true;
+	}
+	if (name == "drain")
+	{
+		engine = ReadEngine::Drain;
+		return true;
+	}
+	return false;
+}
 
-	// Reserve some space for read buffer.
-	m_inputBuffer.reserve(32768);
-	m_inputBuffer.resize(32768);
+//-------------------------------------------------------------------------------
 
-	// Reserve a good amount of space for queued messages.
-	m_messages.reserve(1024);
+TcpSession::TcpSession(tcp::socket socket, const std::string& loggingContext,
+	const TcpSessionConfig& config)
+	: m_config(config)
+	, m_inputBuffer(config.receivePool, config.receiveBufferSize)
+	, m_parser(std::make_unique<NetworkMessageParser>())
+	, m_socket(std::move(socket))
+	, m_pingTimer(m_socket.get_executor().context())
+{
+	REGISTER_LOGGER(loggingContext);
+	m_logger = Log::Logger(loggingContext);
+	m_parser->SetMaxFrameSize(m_config.maxInboundFrameSize);
+	m_parser->SetWireFormat(m_config.wireFormat);
+	if (m_config.wireFormat == WireFormat::Compact && m_config.compressionThreshold > 0)
+	{
+		m_compressor = std::make_unique<FrameCompressor>(m_config.compressionLevel,
+			m_config.streamCompression);
+	}
 }
 
 TcpSession::~TcpSession()
@@ -39,26 +96,368 @@ TcpSession::~TcpSession()
 void TcpSession::Start()
 {
 	SPDLOG_INFO("Client TCP session running...");
+
+	std::error_code ec;
+	m_socket.set_option(tcp::no_delay(m_config.noDelay), ec);
+	if (ec)
+	{
+		SPDLOG_LOGGER_WARN(m_logger, "Failed to set TCP_NODELAY. ec= {}", ec.value());
+	}
+
+	if (m_config.readEngine == ReadEngine::Drain)
+	{
+		m_socket.non_blocking(true, ec);
+		if (ec)
+		{
+			SPDLOG_LOGGER_WARN(m_logger, "Failed to make the socket non blocking, reading with"
+				" async reads instead. ec= {}", ec.value());
+			m_config.readEngine = ReadEngine::Async;
+		}
+	}
+
 	WaitRead();
 	WaitWrite();
+
+	m_clock.Start();
+	if (m_config.pingInterval > std::chrono::milliseconds::zero())
+	{
+		SendPing();
+	}
 }
 
 void TcpSession::Stop()
 {
+	if (m_socket.is_open())
+	{
+		TcpSessionStats stats = GetStats();
+		SPDLOG_LOGGER_INFO(m_logger, "Stopping TCP session. writeCalls= {} messagesWritten= {}"
+			" bytesWritten= {} writeCallsPerMessage= {:.3f}", stats.writeCalls,
+			stats.messagesWritten, stats.bytesWritten, stats.WriteCallsPerMessage());
+		SPDLOG_LOGGER_INFO(m_logger, "Reads. readWakeups= {} readCalls= {} messagesRead= {}"
+			" bytesRead= {} readCallsPerMessage= {:.3f}", stats.readWakeups, stats.readCalls,
+			stats.messagesRead, stats.bytesRead, stats.ReadCallsPerMessage());
+		SPDLOG_LOGGER_INFO(m_logger, "Compression. framesCompressed= {} ratio= {:.3f} timeUs= {}"
+			" framesIncompressible= {} framesDecompressed= {} decompressionTimeUs= {}",
+			stats.compression.frames, stats.compression.Ratio(), stats.compression.time.count(),
+			stats.compression.framesIncompressible, stats.decompression.frames,
+			stats.decompression.time.count());
+		SPDLOG_LOGGER_INFO(m_logger, "Session limits. peakQueuedBytes= {}/{}"
+			" peakInboundFrameSize= {}/{} messagesDropped= {} bytesDropped= {}"
+			" messagesCoalesced= {} bytesCoalesced= {}",
+			stats.peakQueuedBytes, m_config.maxQueuedBytes, stats.peakInboundFrameSize,
+			m_config.maxInboundFrameSize, stats.messagesDropped, stats.bytesDropped,
+			stats.messagesCoalesced, stats.bytesCoalesced);
+
+		RttStats rtt = GetRttStats(false);
+		SPDLOG_LOGGER_INFO(m_logger, "Round trip. samples= {} smoothedUs= {} jitterUs= {}"
+			" p50Us= {} p99Us= {}", rtt.sampleCount, rtt.smoothed.count(), rtt.jitter.count(),
+			rtt.p50.count(), rtt.p99.count());
+	}
+
+	m_pingTimer.cancel();
 	m_socket.close();
+	ReleaseOutput();
+
+	// Moved out first so it only ever runs once, however many times Stop is called.
+	if (m_stoppedHandler)
+	{
+		SessionStoppedHandler handler = std::move(m_stoppedHandler);
+		m_stoppedHandler = nullptr;
+		handler();
+	}
 }
 
 void TcpSession::Write(std::string data)
 {
-	m_outputBuffer.push_back(std::move(data));
+	Write(std::make_shared<const std::string>(std::move(data)));
+}
+
+void TcpSession::Write(SharedBuffer data)
+{
+	// Nothing queued now would ever be sent.
+	if (IsStopped())
+	{
+		return;
+	}
+
+	uint64_t key = 0;
+	bool isCoalescable = m_config.coalescing && m_config.coalescing->GetKey(*data, key);
+	if (isCoalescable && ReplaceQueued(key, data))
+	{
+		// Took the place of one already waiting, so there's nothing new to start writing.
+		return;
+	}
+
+	uint32_t size = static_cast<uint32_t>(data->size());
+	if (!MakeRoom(size))
+	{
+		return;
+	}
 
-	// Ensure that we're only processing one at a time. Begins async loop.
-	if (m_writeReady && m_outputBuffer.size() == 1)
+	uint64_t position = m_outputFront + m_outputBuffer.size();
+	if (isCoalescable)
+	{
+		m_coalesceIndex[key] = position;
+	}
+	else
+	{
+		m_coalesceBarrier = position + 1;
+	}
+
+	m_queuedBytes += size;
+	m_outputBuffer.push_back({ std::move(data), isCoalescable, key });
+	UpdatePeakQueuedBytes();
+
+	// Only one write is in flight at a time. Anything queued meanwhile joins the next batch.
+	if (!m_writeReady || m_isWriting)
+	{
+		return;
+	}
+
+	if (IsBatchReady())
 	{
 		DoWrite();
 	}
 }
 
+void TcpSession::Post(std::function<void()> cb)
+{
+	asio::post(m_socket.get_executor(), std::move(cb));
+}
+
+void TcpSession::Flush()
+{
+	if (m_outputBuffer.empty())
+	{
+		return;
+	}
+
+	// Keeps writing batches until the queue drains, even if a write is already in flight.
+	m_flushRequested = true;
+	if (m_writeReady && !m_isWriting)
+	{
+		DoWrite();
+	}
+}
+
+TcpSessionStats TcpSession::GetStats() const
+{
+	TcpSessionStats stats;
+	stats.writeCalls = m_writeCalls.load(std::memory_order_relaxed);
+	stats.messagesWritten = m_messagesWritten.load(std::memory_order_relaxed);
+	stats.bytesWritten = m_bytesWritten.load(std::memory_order_relaxed);
+	stats.peakQueuedBytes = m_peakQueuedBytes.load(std::memory_order_relaxed);
+	stats.peakInboundFrameSize = m_peakInboundFrameSize.load(std::memory_order_relaxed);
+	stats.messagesDropped = m_messagesDropped.load(std::memory_order_relaxed);
+	stats.bytesDropped = m_bytesDropped.load(std::memory_order_relaxed);
+	stats.messagesCoalesced = m_messagesCoalesced.load(std::memory_order_relaxed);
+	stats.bytesCoalesced = m_bytesCoalesced.load(std::memory_order_relaxed);
+	stats.probesDropped = m_probesDropped.load(std::memory_order_relaxed);
+	stats.readWakeups = m_readWakeups.load(std::memory_order_relaxed);
+	stats.readCalls = m_readCalls.load(std::memory_order_relaxed);
+	stats.messagesRead = m_messagesRead.load(std::memory_order_relaxed);
+	stats.bytesRead = m_bytesRead.load(std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> lock(m_compressionMutex);
+	stats.compression = m_compressionStats;
+	stats.decompression = m_decompressionStats;
+	return stats;
+}
+
+RttStats TcpSession::GetRttStats(bool withRecent) const
+{
+	std::lock_guard<std::mutex> lock(m_rttMutex);
+	return m_rtt.GetStats(withRecent);
+}
+
+LatencyHistogram TcpSession::GetRttHistogram() const
+{
+	std::lock_guard<std::mutex> lock(m_rttMutex);
+	return m_rtt.GetHistogram();
+}
+
+bool TcpSession::IsBatchReady() const
+{
+	return !m_config.corkWrites
+		|| m_flushRequested
+		|| PendingWriteBytes() >= m_config.maxWriteBatchBytes;
+}
+
+bool TcpSession::MakeRoom(uint32_t size)
+{
+	const uint64_t limit = m_config.maxQueuedBytes;
+	if (limit == 0 || static_cast<uint64_t>(m_queuedBytes) + size <= limit)
+	{
+		return true;
+	}
+
+	if (!m_isOverLimit)
+	{
+		m_isOverLimit = true;
+		m_overLimitSince = m_clock.GetElapsedUs();
+		m_overLimitDropped = 0;
+		SPDLOG_LOGGER_WARN(m_logger, "Output queue is full. queuedBytes= {} limit= {} policy= {}",
+			m_queuedBytes, limit, static_cast<uint32_t>(m_config.overflowPolicy));
+	}
+
+	switch (m_config.overflowPolicy)
+	{
+	case OverflowPolicy::Coalesce:
+	{
+		// The front of the queue may be in flight. Only what's behind it can go, and only if
+		// it's a value a later write would have replaced anyway.
+		uint64_t messages = 0;
+		uint64_t bytes = 0;
+		auto it = m_outputBuffer.begin() + m_batchMessages;
+		while (it != m_outputBuffer.end() && static_cast<uint64_t>(m_queuedBytes) + size > limit)
+		{
+			if (!it->isCoalescable)
+			{
+				++it;
+				continue;
+			}
+
+			uint32_t oldest = static_cast<uint32_t>(it->buffer->size());
+			it = m_outputBuffer.erase(it);
+			m_queuedBytes -= oldest;
+			++messages;
+			bytes += oldest;
+		}
+		CountDropped(messages, bytes);
+		if (messages > 0)
+		{
+			RebuildCoalesceIndex();
+		}
+
+		if (static_cast<uint64_t>(m_queuedBytes) + size <= limit)
+		{
+			return true;
+		}
+
+		// Nothing left that can make way for it.
+		CountDropped(1, size);
+		return false;
+	}
+	case OverflowPolicy::Disconnect:
+		CountDropped(1, size);
+		if (m_clock.GetElapsedUs() - m_overLimitSince >= m_config.overflowGracePeriod)
+		{
+			SPDLOG_LOGGER_ERROR(m_logger, "Peer isn't keeping up with writes, disconnecting."
+				" messagesDropped= {}", m_overLimitDropped);
+			Stop();
+		}
+		return false;
+	case OverflowPolicy::Drop:
+	default:
+		CountDropped(1, size);
+		return false;
+	}
+}
+
+void TcpSession::CheckDrained()
+{
+	if (m_isOverLimit && m_queuedBytes <= m_config.maxQueuedBytes / 2)
+	{
+		m_isOverLimit = false;
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+			m_clock.GetElapsedUs() - m_overLimitSince);
+		SPDLOG_LOGGER_INFO(m_logger, "Output queue drained. queuedBytes= {} limit= {}"
+			" overLimitMs= {} messagesDropped= {}", m_queuedBytes, m_config.maxQueuedBytes,
+			elapsed.count(), m_overLimitDropped);
+	}
+}
+
+void TcpSession::ReleaseOutput()
+{
+	// The socket may still be reading from the batch in flight until its write completes.
+	size_t keep = m_isWriting ? m_batchMessages : 0;
+	m_outputBuffer.erase(m_outputBuffer.begin() + keep, m_outputBuffer.end());
+	m_probes.erase(m_probes.begin() + (m_isWriting ? m_batchProbes : 0), m_probes.end());
+	m_queuedBytes = m_isWriting ? m_batchBytes : 0;
+	if (!m_isWriting)
+	{
+		m_writeBuffers.clear();
+		m_compressed.clear();
+		m_batchMessages = 0;
+		m_batchBytes = 0;
+		m_batchProbes = 0;
+	}
+
+	m_coalesceIndex.clear();
+	m_coalesceBarrier = m_outputFront + m_outputBuffer.size();
+	m_flushRequested = false;
+}
+
+void TcpSession::CountDropped(uint64_t messages, uint64_t bytes)
+{
+	m_messagesDropped.fetch_add(messages, std::memory_order_relaxed);
+	m_bytesDropped.fetch_add(bytes, std::memory_order_relaxed);
+	m_overLimitDropped += messages;
+}
+
+bool TcpSession::ReplaceQueued(uint64_t key, SharedBuffer& data)
+{
+	auto it = m_coalesceIndex.find(key);
+	if (it == m_coalesceIndex.end() || it->second < m_coalesceBarrier)
+	{
+		return false;
+	}
+
+	// Messages in the batch being written are out of reach.
+	uint64_t offset = it->second - m_outputFront;
+	if (offset < m_batchMessages || offset >= m_outputBuffer.size())
+	{
+		return false;
+	}
+
+	QueuedMessage& queued = m_outputBuffer[offset];
+	uint32_t oldSize = static_cast<uint32_t>(queued.buffer->size());
+	uint32_t newSize = static_cast<uint32_t>(data->size());
+
+	// A bigger replacement that doesn't fit is queued the usual way instead, so the overflow
+	// policy gets its say.
+	const uint64_t limit = m_config.maxQueuedBytes;
+	if (limit != 0 && newSize > oldSize
+		&& static_cast<uint64_t>(m_queuedBytes) + (newSize - oldSize) > limit)
+	{
+		return false;
+	}
+
+	m_queuedBytes = m_queuedBytes - oldSize + newSize;
+	queued.buffer = std::move(data);
+	UpdatePeakQueuedBytes();
+
+	m_messagesCoalesced.fetch_add(1, std::memory_order_relaxed);
+	m_bytesCoalesced.fetch_add(oldSize, std::memory_order_relaxed);
+	return true;
+}
+
+void TcpSession::RebuildCoalesceIndex()
+{
+	m_coalesceIndex.clear();
+	m_coalesceBarrier = m_outputFront;
+	for (size_t i = 0; i < m_outputBuffer.size(); ++i)
+	{
+		const QueuedMessage& queued = m_outputBuffer[i];
+		if (queued.isCoalescable)
+		{
+			m_coalesceIndex[queued.coalesceKey] = m_outputFront + i;
+		}
+		else
+		{
+			m_coalesceBarrier = m_outputFront + i + 1;
+		}
+	}
+}
+
+void TcpSession::UpdatePeakQueuedBytes()
+{
+	if (m_queuedBytes > m_peakQueuedBytes.load(std::memory_order_relaxed))
+	{
+		m_peakQueuedBytes.store(m_queuedBytes, std::memory_order_relaxed);
+	}
+}
+
 void TcpSession::WaitWrite()
 {
 	m_socket.async_wait(tcp::socket::wait_write,
@@ -70,7 +469,7 @@ void TcpSession::WaitWrite()
 void TcpSession::OnWaitWriteComplete(const std::error_code& ec)
 {
 	m_writeReady = true;
-	if (!m_outputBuffer.empty())
+	if (!m_probes.empty() || (!m_outputBuffer.empty() && IsBatchReady()))
 	{
 		DoWrite();
 	}
@@ -78,6 +477,8 @@ void TcpSession::OnWaitWriteComplete(const std::error_code& ec)
 
 void TcpSession::WaitRead()
 {
+	// Unless part of a frame is waiting on the rest, there's no need to hold a buffer while idle.
+	m_inputBuffer.ReturnIfEmpty();
 	m_socket.async_wait(tcp::socket::wait_read,
 		std::bind(&TcpSession::OnWaitReadComplete,
 			shared_from_this(),
@@ -88,18 +489,28 @@ void TcpSession::OnWaitReadComplete(const std::error_code& ec)
 {
 	if (ec)
 	{
-		SPDLOG_LOGGER_ERROR(s_logger,
+		SPDLOG_LOGGER_ERROR(m_logger,
 			"Error waiting for socket to be read ready. ec= {} ecc= {}",
 			ec.value(), ec.category().name());
 		return;
 	}
 
+	m_readWakeups.fetch_add(1, std::memory_order_relaxed);
+	if (m_config.readEngine == ReadEngine::Drain)
+	{
+		DrainRead();
+		return;
+	}
+
 	DoRead();
 }
 
 void TcpSession::DoRead()
 {
-	m_socket.async_read_some(asio::buffer(m_inputBuffer),
+	// Read straight into the ring so the parser can hand out views without copying.
+	m_inputBuffer.Borrow();
+	m_readCalls.fetch_add(1, std::memory_order_relaxed);
+	m_socket.async_read_some(asio::buffer(m_inputBuffer.WriteData(), m_inputBuffer.WriteSize()),
 		std::bind(&TcpSession::OnDoRead,
 			shared_from_this(),
 			std::placeholders::_1,
@@ -108,54 +519,495 @@ void TcpSession::DoRead()
 }
 
 void TcpSession::OnDoRead(const std::error_code ec, std::size_t bytesRead)
+{
+	m_readWakeups.fetch_add(1, std::memory_order_relaxed);
+	if (HandleRead(ec, bytesRead))
+	{
+		WaitRead();
+	}
+}
+
+void TcpSession::DrainRead()
+{
+	for (uint32_t reads = 0; reads < m_config.maxReadsPerWakeup; ++reads)
+	{
+		if (IsStopped())
+		{
+			m_inputBuffer.Clear();
+			m_inputBuffer.ReturnIfEmpty();
+			return;
+		}
+
+		m_inputBuffer.Borrow();
+		std::error_code ec;
+		const std::size_t size = m_inputBuffer.WriteSize();
+		std::size_t bytesRead = m_socket.read_some(
+			asio::buffer(m_inputBuffer.WriteData(), size), ec);
+		m_readCalls.fetch_add(1, std::memory_order_relaxed);
+
+		// Drained. Nothing more until the socket is readable again.
+		if (ec == asio::error::would_block || ec == asio::error::try_again)
+		{
+			WaitRead();
+			return;
+		}
+
+		if (!HandleRead(ec, bytesRead))
+		{
+			return;
+		}
+
+		// A short read emptied the socket, so don't spend a syscall finding that out. Waiting
+		// checks readiness afresh, so nothing that arrived since then is missed.
+		if (bytesRead < size)
+		{
+			WaitRead();
+			return;
+		}
+	}
+
+	// There may be more, but waiting for readiness could miss it, so queue up behind the other
+	// sessions on this thread instead.
+	asio::post(m_socket.get_executor(), std::bind(&TcpSession::DrainRead, shared_from_this()));
+}
+
+bool TcpSession::HandleRead(const std::error_code& ec, std::size_t bytesRead)
 {
 	if (IsStopped())
 	{
-		m_inputBuffer.clear();
-		return;
+		m_inputBuffer.Clear();
+		m_inputBuffer.ReturnIfEmpty();
+		return false;
 	}
 
 	if (ec)
 	{
-		SPDLOG_LOGGER_ERROR(s_logger, "Error reading data from server. ec= {}", ec.value());
+		SPDLOG_LOGGER_ERROR(m_logger, "Error reading data from server. ec= {}", ec.value());
 		if (ec != asio::error::operation_aborted)
 		{
 			Stop();
 		}
-		return;
+		return false;
 	}
 
-	if (!m_messages.empty())
+	m_bytesRead.fetch_add(bytesRead, std::memory_order_relaxed);
+
+	if (m_config.capture)
 	{
-		m_parser->ExtractMessages(m_inputBuffer, m_messages);
-		// TODO: Notify that we have messages;
+		m_config.capture->Record(m_config.captureSessionId,
+			std::string_view(m_inputBuffer.WriteData(), bytesRead));
 	}
+
+	m_inputBuffer.CommitWrite(static_cast<uint32_t>(bytesRead));
+	std::vector<NetworkMessageView>& messages = GetParsedMessages();
+	bool isValid = m_parser->ExtractMessages(m_inputBuffer, messages);
+	if (m_config.wireFormat == WireFormat::Compact)
+	{
+		// Most reads inflate nothing, so the lock is only taken when the count moves. This is the
+		// only thread that writes m_decompressionStats, so it can read it without the lock.
+		CompressionStats decompression = m_parser->GetDecompressionStats();
+		if (decompression.frames != m_decompressionStats.frames)
+		{
+			std::lock_guard<std::mutex> lock(m_compressionMutex);
+			m_decompressionStats = decompression;
+		}
+	}
+
+	if (!isValid)
+	{
+		SPDLOG_LOGGER_ERROR(m_logger, "Peer sent a malformed frame or one over the size limit,"
+			" disconnecting. limit= {}", m_config.maxInboundFrameSize);
+		messages.clear();
+		Stop();
+		return false;
+	}
+	m_messagesRead.fetch_add(messages.size(), std::memory_order_relaxed);
+
+	// Pings are answered here rather than wait their turn on the game thread, which would count
+	// its frame time as network latency.
+	messages.erase(std::remove_if(messages.begin(), messages.end(),
+		[this](const NetworkMessageView& message) { return HandleProbe(message); }),
+		messages.end());
+
+	if (!messages.empty())
+	{
+		size_t byteCount = 0;
+		size_t largest = 0;
+		for (const NetworkMessageView& message : messages)
+		{
+			byteCount += message.messageData.size();
+			largest = std::max(largest, message.messageData.size());
+		}
+
+		if (largest > m_peakInboundFrameSize.load(std::memory_order_relaxed))
+		{
+			m_peakInboundFrameSize.store(largest, std::memory_order_relaxed);
+		}
+
+		if (m_batchHandler)
+		{
+			// One copy and one allocation for the whole read, rather than one per message.
+			auto batch = std::make_shared<MessageBatch>();
+			batch->Reserve(messages.size(), byteCount);
+			for (const NetworkMessageView& message : messages)
+			{
+				batch->Append(message);
+			}
+
+			m_batchHandler(std::move(batch));
+		}
+
+		messages.clear();
+	}
+	return true;
 }
 
 void TcpSession::DoWrite()
 {
-	asio::async_write(m_socket, asio::buffer(m_outputBuffer.front().data(),
-		m_outputBuffer.front().length()),
-		std::bind(&TcpSession::OnDoWrite,
+	// Reserved on the first write rather than up front, so idle sessions don't pay for it.
+	if (m_writeBuffers.capacity() == 0)
+	{
+		m_writeBuffers.reserve(m_config.maxWriteBatchBuffers);
+	}
+
+	m_writeBuffers.clear();
+	m_batchMessages = 0;
+	m_batchBytes = 0;
+
+	// Probes go out on their own, without taking the corked queue with them.
+	if (!m_probes.empty())
+	{
+		BatchProbes();
+		m_isWriting = true;
+		WriteSome();
+		return;
+	}
+
+	// Gather as much of the backlog as the batch limits allow into one buffer sequence.
+	// A compact stream's first write also carries the preamble, in a buffer of its own.
+	const bool isCompact = m_config.wireFormat == WireFormat::Compact;
+	uint32_t frameCount = 0;
+	uint32_t bufferCount = isCompact && !m_isPreambleSent ? 1 : 0;
+	for (const QueuedMessage& queued : m_outputBuffer)
+	{
+		const std::string& message = *queued.buffer;
+
+		// Reframed messages go out as a header and a payload per frame.
+		uint32_t frames = isCompact ? CountLegacyFrames(message) : 1;
+		uint32_t buffers = isCompact ? 2 * frames : 1;
+		if (m_batchMessages > 0 && bufferCount + buffers > m_config.maxWriteBatchBuffers)
+		{
+			break;
+		}
+
+		uint32_t size = static_cast<uint32_t>(message.size());
+		if (m_batchMessages > 0 && m_batchBytes + size > m_config.maxWriteBatchBytes)
+		{
+			break;
+		}
+
+		if (!isCompact)
+		{
+			m_writeBuffers.emplace_back(message.data(), message.size());
+		}
+		frameCount += frames;
+		bufferCount += buffers;
+		m_batchBytes += size;
+		++m_batchMessages;
+	}
+
+	m_batchWireBytes = m_batchBytes;
+	if (isCompact)
+	{
+		ReframeBatch(frameCount);
+	}
+
+	m_isWriting = true;
+	WriteSome();
+}
+
+void TcpSession::ReframeBatch(uint32_t frameCount)
+{
+	// Sized up front so the buffers pointing into it stay put.
+	m_headerScratch.resize(frameCount * s_maxCompactHeaderSize);
+	char* header = m_headerScratch.data();
+
+	m_batchWireBytes = 0;
+	AddPreamble();
+
+	const uint32_t checksumFlag = m_config.wireChecksums ? CompactFrameChecksum : CompactFrameNone;
+	size_t compressedCount = 0;
+	for (size_t i = 0; i < m_batchMessages; ++i)
+	{
+		std::string_view message = *m_outputBuffer[i].buffer;
+		if (CountLegacyFrames(message) == 0)
+		{
+			// Sending it anyway would leave the peer reading garbage for the rest of the stream.
+			if (!message.empty())
+			{
+				SPDLOG_LOGGER_ERROR(m_logger, "Can't reframe a message that isn't whole legacy"
+					" frames, dropping it. size= {}", message.size());
+				CountDropped(1, message.size());
+			}
+			continue;
+		}
+
+		MessageHeader legacy;
+		while (PeekHeader(message, legacy))
+		{
+			std::string_view payload = message.substr(sizeof(legacy), legacy.messageLength);
+			message.remove_prefix(sizeof(legacy) + legacy.messageLength);
+
+			uint32_t flags = checksumFlag;
+			if (m_compressor && legacy.messageLength >= m_config.compressionThreshold)
+			{
+				if (compressedCount == m_compressed.size())
+				{
+					m_compressed.emplace_back();
+				}
+
+				std::string& compressed = m_compressed[compressedCount];
+				if (m_compressor->Compress(payload, compressed))
+				{
+					++compressedCount;
+					payload = compressed;
+					flags |= CompactFrameCompressed;
+				}
+			}
+
+			uint32_t checksum = m_config.wireChecksums ? Crc32(payload) : 0;
+			uint32_t headerSize = EncodeCompactHeader(legacy.messageType,
+				static_cast<uint32_t>(payload.size()), flags, checksum, header);
+
+			m_writeBuffers.emplace_back(header, headerSize);
+			m_writeBuffers.emplace_back(payload.data(), payload.size());
+			m_batchWireBytes += headerSize + static_cast<uint32_t>(payload.size());
+			header += headerSize;
+		}
+	}
+
+	if (m_compressor)
+	{
+		std::lock_guard<std::mutex> lock(m_compressionMutex);
+		m_compressionStats = m_compressor->GetStats();
+	}
+}
+
+void TcpSession::BatchProbes()
+{
+	// Compact probes take a header and a payload buffer each, and the first write also carries
+	// the preamble. Always take at least one so a tiny limit can't stall them.
+	const bool isCompact = m_config.wireFormat == WireFormat::Compact;
+	uint32_t buffers = m_config.maxWriteBatchBuffers;
+	if (isCompact)
+	{
+		buffers = (buffers - (m_isPreambleSent ? 0 : std::min(buffers, 1u))) / 2;
+	}
+	m_batchProbes = std::clamp<std::size_t>(buffers, 1, m_probes.size());
+	m_batchWireBytes = 0;
+	if (!isCompact)
+	{
+		for (std::size_t i = 0; i < m_batchProbes; ++i)
+		{
+			const std::string& probe = m_probes[i];
+			m_writeBuffers.emplace_back(probe.data(), probe.size());
+			m_batchWireBytes += static_cast<uint32_t>(probe.size());
+		}
+		return;
+	}
+
+	// Too small to be worth compressing.
+	m_headerScratch.resize(m_batchProbes * s_maxCompactHeaderSize);
+	char* header = m_headerScratch.data();
+	AddPreamble();
+	for (std::size_t i = 0; i < m_batchProbes; ++i)
+	{
+		const std::string& probe = m_probes[i];
+		MessageHeader legacy;
+		PeekHeader(probe, legacy);
+		std::string_view payload = std::string_view(probe).substr(sizeof(legacy));
+
+		uint32_t flags = m_config.wireChecksums ? CompactFrameChecksum : CompactFrameNone;
+		uint32_t checksum = m_config.wireChecksums ? Crc32(payload) : 0;
+		uint32_t headerSize = EncodeCompactHeader(legacy.messageType,
+			static_cast<uint32_t>(payload.size()), flags, checksum, header);
+
+		m_writeBuffers.emplace_back(header, headerSize);
+		m_writeBuffers.emplace_back(payload.data(), payload.size());
+		m_batchWireBytes += headerSize + static_cast<uint32_t>(payload.size());
+		header += headerSize;
+	}
+}
+
+void TcpSession::AddPreamble()
+{
+	if (!m_isPreambleSent)
+	{
+		m_writeBuffers.emplace_back(s_wirePreamble, s_wirePreambleSize);
+		m_batchWireBytes += s_wirePreambleSize;
+		m_isPreambleSent = true;
+	}
+}
+
+void TcpSession::WriteSome()
+{
+	m_writeCalls.fetch_add(1, std::memory_order_relaxed);
+	m_socket.async_write_some(m_writeBuffers,
+		std::bind(&TcpSession::OnWriteSome,
 			shared_from_this(),
 			std::placeholders::_1,
 			std::placeholders::_2));
 }
 
-void TcpSession::OnDoWrite(const std::error_code& ec, uint32_t bytesWritten)
+void TcpSession::OnWriteSome(const std::error_code& ec, std::size_t bytesWritten)
 {
 	if (ec)
 	{
-		SPDLOG_LOGGER_ERROR(s_logger, "Error writing data to server. ec= {}", ec.value());
+		m_isWriting = false;
+		SPDLOG_LOGGER_ERROR(m_logger, "Error writing data to server. ec= {}", ec.value());
 		if (ec != asio::error::operation_aborted)
 		{
 			Stop();
 		}
+
+		// The write that was holding on to the batch is done with it.
+		if (IsStopped())
+		{
+			ReleaseOutput();
+		}
+		return;
+	}
+
+	// Drop whatever made it out. On a short write, pick up where the socket left off.
+	auto it = m_writeBuffers.begin();
+	while (it != m_writeBuffers.end() && bytesWritten >= it->size())
+	{
+		bytesWritten -= it->size();
+		++it;
+	}
+	if (it != m_writeBuffers.end())
+	{
+		*it += bytesWritten;
+	}
+	m_writeBuffers.erase(m_writeBuffers.begin(), it);
+
+	if (!m_writeBuffers.empty())
+	{
+		WriteSome();
+		return;
+	}
+
+	m_messagesWritten.fetch_add(m_batchMessages + m_batchProbes, std::memory_order_relaxed);
+	m_bytesWritten.fetch_add(m_batchWireBytes, std::memory_order_relaxed);
+	m_queuedBytes -= m_batchBytes;
+	CheckDrained();
+	m_probes.erase(m_probes.begin(), m_probes.begin() + m_batchProbes);
+	m_batchProbes = 0;
+
+	// Anything written can't be replaced any more.
+	for (size_t i = 0; i < m_batchMessages; ++i)
+	{
+		const QueuedMessage& queued = m_outputBuffer[i];
+		auto it = queued.isCoalescable ? m_coalesceIndex.find(queued.coalesceKey) : m_coalesceIndex.end();
+		if (it != m_coalesceIndex.end() && it->second == m_outputFront + i)
+		{
+			m_coalesceIndex.erase(it);
+		}
+	}
+	m_outputBuffer.erase(m_outputBuffer.begin(), m_outputBuffer.begin() + m_batchMessages);
+	m_outputFront += m_batchMessages;
+	m_batchMessages = 0;
+	m_batchBytes = 0;
+	m_isWriting = false;
+
+	if (m_outputBuffer.empty())
+	{
+		m_flushRequested = false;
+	}
+
+	if (!m_probes.empty() || (!m_outputBuffer.empty() && IsBatchReady()))
+	{
+		DoWrite();
+	}
+}
+
+void TcpSession::SendPing()
+{
+	PingPayload ping;
+	ping.sequence = m_pingSequence++;
+	ping.sentAt = m_clock.GetElapsedUs().count();
+	WriteProbe(PackageMessage(MessageId::Ping,
+		std::string_view(reinterpret_cast<const char*>(&ping), sizeof(ping))));
+
+	m_pingTimer.expires_after(m_config.pingInterval);
+	m_pingTimer.async_wait(std::bind(&TcpSession::OnPingTimer,
+		shared_from_this(),
+		std::placeholders::_1));
+}
+
+void TcpSession::OnPingTimer(const std::error_code& ec)
+{
+	if (ec || IsStopped())
+	{
+		return;
+	}
+
+	SendPing();
+}
+
+bool TcpSession::HandleProbe(const NetworkMessageView& message)
+{
+	if (message.header.messageType == MessageId::Ping)
+	{
+		// Only a ping the size of ours is answered, so the peer can't pick how much we echo.
+		if (message.messageData.size() != sizeof(PingPayload))
+		{
+			SPDLOG_LOGGER_WARN(m_logger, "Malformed ping. size= {}", message.messageData.size());
+			return true;
+		}
+
+		WriteProbe(PackageMessage(MessageId::Pong, message.messageData));
+		return true;
+	}
+
+	if (message.header.messageType != MessageId::Pong)
+	{
+		return false;
+	}
+
+	PingPayload pong;
+	if (message.messageData.size() != sizeof(pong))
+	{
+		SPDLOG_LOGGER_WARN(m_logger, "Malformed pong. size= {}", message.messageData.size());
+		return true;
+	}
+
+	// Anything from the future wasn't one of ours.
+	std::memcpy(&pong, message.messageData.data(), sizeof(pong));
+	std::chrono::microseconds rtt = m_clock.GetElapsedUs() - std::chrono::microseconds(pong.sentAt);
+	if (pong.sentAt >= 0 && rtt >= std::chrono::microseconds::zero())
+	{
+		std::lock_guard<std::mutex> lock(m_rttMutex);
+		m_rtt.AddSample(rtt);
+	}
+	return true;
+}
+
+void TcpSession::WriteProbe(std::string probe)
+{
+	if (IsStopped())
+	{
+		return;
+	}
+
+	if (m_probes.size() >= s_maxQueuedProbes)
+	{
+		m_probesDropped.fetch_add(1, std::memory_order_relaxed);
 		return;
 	}
 
-	m_outputBuffer.pop_front();
-	if (!m_outputBuffer.empty())
+	m_probes.push_back(std::move(probe));
+	if (m_writeReady && !m_isWriting)
 	{
 		DoWrite();
 	}
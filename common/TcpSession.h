@@ -5,30 +5,245 @@
 
 #pragma once
 
+#include "common/FrameCompression.h"
+#include "common/MessageCoalescing.h"
 #include "common/NetworkTypes.h"
+#include "common/ReceiveRing.h"
+#include "common/RttTracker.h"
+#include "common/Timer.h"
+#include "common/WireFormat.h"
 
 #include <asio.hpp>
+#include <atomic>
+#include <chrono>
 #include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace spdlog {
+class logger;
+}
 
 namespace Common {
 
 //===============================================================================
 
+class CaptureWriter;
+
+// What a session does when a write would take its output queue over maxQueuedBytes. A session
+// counts as over its limit from the first write that doesn't fit until the queue drains to
+// half of maxQueuedBytes.
+enum class OverflowPolicy : uint32_t
+{
+	// Drop the new message. What's queued still goes out.
+	Drop,
+
+	// Drop the oldest queued latest-value-wins messages (see TcpSessionConfig::coalescing) that
+	// aren't being written yet until the new one fits. Anything else queued is kept, so a
+	// reliable stream never loses a message it can't afford to. If dropping all of them doesn't
+	// make room, the new message is dropped instead, as with Drop.
+	Coalesce,
+
+	// Drop the new message, and close the session once it's been over its limit for
+	// overflowGracePeriod. For peers that should never stay that far behind.
+	Disconnect
+};
+
+// How a session gets data off its socket.
+enum class ReadEngine : uint32_t
+{
+	// Wait for the socket to be readable, then issue an async read. Every read takes two trips
+	// through the reactor.
+	Async,
+
+	// Wait for the socket to be readable, then read it without blocking until a read comes up
+	// short or it would block, parsing as it goes. One trip through the reactor drains whatever
+	// has arrived, the way an edge triggered epoll loop does.
+	Drain
+};
+
+// Reads "async" or "drain", as given on a command line. Returns false for anything else.
+bool ParseReadEngine(std::string_view name, ReadEngine& engine);
+
+struct TcpSessionConfig
+{
+	// Queued messages are gathered into a single write until it would exceed this many bytes.
+	// A message bigger than this is still sent, just on its own.
+	uint32_t maxWriteBatchBytes = 64 * 1024;
+
+	// Upper bound on buffers per write. Keeps us under the OS scatter/gather limit (IOV_MAX).
+	uint32_t maxWriteBatchBuffers = 64;
+
+	// When corked, writes only queue up. They go out on Flush, or once a full batch is queued.
+	// When uncorked, a write starts as soon as the socket is idle and anything queued while it's
+	// in flight is gathered into the next one.
+	bool corkWrites = false;
+
+	// We do our own batching, so there's no reason to let Nagle hold small writes back.
+	bool noDelay = true;
+
+	// Most bytes that may be waiting to be written, including the write in flight. A peer that
+	// doesn't read can't make us buffer more than this. 0 means no limit. See OverflowPolicy for
+	// what happens to a write that doesn't fit.
+	uint32_t maxQueuedBytes = 4 * 1024 * 1024;
+	OverflowPolicy overflowPolicy = OverflowPolicy::Drop;
+
+	// How long a Disconnect session may stay over maxQueuedBytes before it's closed. Zero closes
+	// it on the first write that doesn't fit.
+	std::chrono::milliseconds overflowGracePeriod = std::chrono::seconds(2);
+
+	// Incoming frames claiming a bigger payload than this close the session.
+	uint32_t maxInboundFrameSize = 1024 * 1024;
+
+	// Latest-value-wins messages replace a queued one with the same key rather than queue
+	// behind it. A replacement never goes out ahead of a message that isn't latest-value-wins
+	// and was queued after the one it replaces; it's queued at the back instead. Nothing is
+	// coalesced if this is null.
+	std::shared_ptr<const MessageCoalescing> coalescing;
+
+	// How often to ping the peer to measure the round trip. Zero never pings. Pings from the
+	// peer are answered either way.
+	std::chrono::milliseconds pingInterval = std::chrono::milliseconds::zero();
+
+	// Everything read is recorded here, tagged with captureSessionId, if it's set. See
+	// CaptureReplayer for playing it back.
+	std::shared_ptr<CaptureWriter> capture;
+	uint32_t captureSessionId = 0;
+
+	// How frames are laid out on the wire, both ways. Messages are still written framed by
+	// PackageMessage. A Compact session swaps each legacy header for a compact one as it writes,
+	// pointing at the payload where it's queued rather than copying it.
+	WireFormat wireFormat = WireFormat::Legacy;
+
+	// Compact only. Every frame written carries a checksum of its payload.
+	bool wireChecksums = false;
+
+	// Compact only. Payloads of at least this many bytes are deflated before they're written,
+	// and sent as they are if that doesn't make them smaller. 0 never compresses. Compressed
+	// frames from the peer are inflated either way.
+	uint32_t compressionThreshold = 0;
+
+	// zlib's level, 1 fastest to 9 smallest.
+	int compressionLevel = 6;
+
+	// Deflate every compressed frame with one stream for the whole session rather than on its
+	// own, so a payload that's a lot like one sent recently, like the next snapshot, costs
+	// little. Every payload over the threshold is then sent compressed, even if it grew.
+	bool streamCompression = false;
+
+	ReadEngine readEngine = ReadEngine::Async;
+
+	// Drain only. Most reads in a row before letting other sessions on the thread have a turn.
+	// The session carries on reading after them without waiting for the socket again.
+	uint32_t maxReadsPerWakeup = 16;
+
+	// Biggest buffer reads land in. A frame bigger than this is still read, through a copy.
+	uint32_t receiveBufferSize = 32768;
+
+	// Where receive buffers are borrowed from, if it's set. A session only holds one while it's
+	// reading or has part of a frame waiting on the rest, so idle sessions hold none. Share one
+	// pool between every session. With no pool, each session keeps a buffer of its own.
+	std::shared_ptr<ReceiveBufferPool> receivePool;
+};
+
+// Plain copy of a session's counters, safe to read from any thread.
+struct TcpSessionStats
+{
+	// Number of write syscalls issued (one per async_write_some).
+	uint64_t writeCalls = 0;
+	uint64_t messagesWritten = 0;
+	uint64_t bytesWritten = 0;
+
+	// High watermarks.
+	uint64_t peakQueuedBytes = 0;
+	uint64_t peakInboundFrameSize = 0;
+
+	// Messages thrown away because the output queue was full.
+	uint64_t messagesDropped = 0;
+	uint64_t bytesDropped = 0;
+
+	// Queued messages replaced by newer ones before they were sent.
+	uint64_t messagesCoalesced = 0;
+	uint64_t bytesCoalesced = 0;
+
+	// Pings and pongs not sent because too many were already waiting on the peer.
+	uint64_t probesDropped = 0;
+
+	// Frames deflated on the way out, and inflated on the way in. Use these to tune the
+	// compression threshold: a ratio near 1 or a lot of time per frame means it's too low.
+	CompressionStats compression;
+	CompressionStats decompression;
+
+	// Times the io thread was woken to read, counting readiness waits and async reads alike,
+	// and the read syscalls made, including ones that found nothing to read.
+	uint64_t readWakeups = 0;
+	uint64_t readCalls = 0;
+	uint64_t messagesRead = 0;
+	uint64_t bytesRead = 0;
+
+	double WriteCallsPerMessage() const
+	{
+		return messagesWritten ? static_cast<double>(writeCalls) / messagesWritten : 0.0;
+	}
+
+	double ReadCallsPerMessage() const
+	{
+		return messagesRead ? static_cast<double>(readCalls) / messagesRead : 0.0;
+	}
+};
+
 struct NetworkMessage;
 class NetworkMessageParser;
+
+// Gets every message parsed out of one read. Called on the session's io thread.
+using MessageBatchHandler = std::function<void(std::shared_ptr<MessageBatch> batch)>;
+
+// Called once when a session stops, whether it was told to or the peer went away, on the
+// session's io thread.
+using SessionStoppedHandler = std::function<void()>;
+
 class TcpSession : public std::enable_shared_from_this<TcpSession> {
 
 public:
-	TcpSession(asio::ip::tcp::socket socket, const std::string& loggingContext);
+	TcpSession(asio::ip::tcp::socket socket, const std::string& loggingContext,
+		const TcpSessionConfig& config = {});
 
 	~TcpSession();
 
 	bool IsStopped() { return !m_socket.is_open(); }
 	void Start();
+
+	// Closes the socket and lets go of everything queued. Writes from then on are ignored.
 	void Stop();
 	void Write(std::string data);
 
+	// Queues a buffer that may also be queued on other sessions. Only a reference is kept.
+	void Write(SharedBuffer data);
+
+	// Where parsed messages go. Set this before Start.
+	void SetMessageBatchHandler(MessageBatchHandler handler) { m_batchHandler = std::move(handler); }
+
+	// Set this before Start.
+	void SetStoppedHandler(SessionStoppedHandler handler) { m_stoppedHandler = std::move(handler); }
+
+	// Runs cb on the thread that services this session's socket. Use this to call into the
+	// session from anywhere else.
+	void Post(std::function<void()> cb);
+
+	// Sends everything that's queued. Only needed when writes are corked.
+	void Flush();
+
+	TcpSessionStats GetStats() const;
+
+	// Round trips measured by our pings. Safe to call from any thread.
+	RttStats GetRttStats(bool withRecent = true) const;
+	LatencyHistogram GetRttHistogram() const;
+
 private:
 	void WaitWrite();
 	void OnWaitWriteComplete(const std::error_code& ec);
@@ -36,27 +251,182 @@ private:
 	void OnWaitReadComplete(const std::error_code& ec);
 	void DoRead();
 	void OnDoRead(const std::error_code ec, std::size_t bytesRead);
+
+	// Reads until the socket would block or maxReadsPerWakeup is reached.
+	void DrainRead();
+
+	// Parses and hands off what a read got. Returns false if reading should stop, because of an
+	// error or because the session was stopped.
+	bool HandleRead(const std::error_code& ec, std::size_t bytesRead);
 	void DoWrite();
-	void OnDoWrite(const std::error_code& ec, uint32_t bytesWritten);
+
+	// Fills m_writeBuffers with the batch in compact frames, compressing payloads over the
+	// threshold. frameCount is how many legacy frames the batch's messages hold between them.
+	void ReframeBatch(uint32_t frameCount);
+
+	// Fills m_writeBuffers with as many waiting probes as maxWriteBatchBuffers allows, in the
+	// session's wire format.
+	void BatchProbes();
+
+	// Adds the compact preamble to m_writeBuffers if it hasn't gone out yet.
+	void AddPreamble();
+	void WriteSome();
+	void OnWriteSome(const std::error_code& ec, std::size_t bytesWritten);
+
+	// Sends a ping and sets the timer for the next one.
+	void SendPing();
+	void OnPingTimer(const std::error_code& ec);
+
+	// Answers a Ping or records a Pong. Returns false for any other message. Malformed probes
+	// are dropped without an answer.
+	bool HandleProbe(const NetworkMessageView& message);
+
+	// Sends a Ping or Pong in a write of its own, ahead of anything queued. A corked session
+	// would otherwise hold it until the next Flush and count the wait as round trip time.
+	// Dropped if s_maxQueuedProbes are already waiting, so a peer that pings without reading
+	// can't grow the queue.
+	void WriteProbe(std::string probe);
+
+	// True if what's queued should go out now rather than wait for more.
+	bool IsBatchReady() const;
+
+	// Applies the overflow policy before size more bytes are queued. Returns false if they
+	// shouldn't be.
+	bool MakeRoom(uint32_t size);
+	void CountDropped(uint64_t messages, uint64_t bytes);
+
+	// Leaves the over limit state once the queue has drained to its low watermark.
+	void CheckDrained();
+
+	// Empties the output queue once the session is stopped, apart from a batch still in flight.
+	void ReleaseOutput();
+
+	// Puts data in place of the queued message with the same key. Returns false if there isn't
+	// one that can be replaced, or data is bigger and the difference would overflow the queue.
+	bool ReplaceQueued(uint64_t key, SharedBuffer& data);
+
+	// Needed whenever messages are taken out of the middle of the queue.
+	void RebuildCoalesceIndex();
+	void UpdatePeakQueuedBytes();
+
+	// Number of bytes sitting in m_outputBuffer that aren't part of the write in flight.
+	uint32_t PendingWriteBytes() const { return m_queuedBytes - m_batchBytes; }
+
+	TcpSessionConfig m_config;
 
 	// Indicates that the socket is ready to be written to.
 	bool m_writeReady = false;
 
-	// Filled with data over the wire before parsing.
-	std::string m_inputBuffer;
+	// True while a batch is being written.
+	bool m_isWriting = false;
+
+	// Set by Flush. Corked batches keep going out until the queue is empty.
+	bool m_flushRequested = false;
+
+	// The batch in flight. Points at the first m_batchMessages buffers in m_outputBuffer.
+	// Fully written buffers are dropped from the front as partial writes complete.
+	std::vector<asio::const_buffer> m_writeBuffers;
+	std::size_t m_batchMessages = 0;
+	uint32_t m_batchBytes = 0;
+
+	// What the batch takes on the wire, which is less than m_batchBytes once it's reframed.
+	uint32_t m_batchWireBytes = 0;
+
+	// Compact headers for the batch in flight, which m_writeBuffers points into.
+	std::vector<char> m_headerScratch;
+	bool m_isPreambleSent = false;
+
+	// Null unless compressionThreshold is set. Compressed payloads of the batch in flight are
+	// kept in m_compressed, a deque so they stay put as more are added.
+	std::unique_ptr<FrameCompressor> m_compressor;
+	std::deque<std::string> m_compressed;
+
+	// Copies of the compressor's and parser's stats, for reading from other threads.
+	mutable std::mutex m_compressionMutex;
+	CompressionStats m_compressionStats;
+	CompressionStats m_decompressionStats;
+
+	// Total bytes in m_outputBuffer, including the batch in flight.
+	uint32_t m_queuedBytes = 0;
+
+	// Write counters. Bumped on the io thread, read from anywhere through GetStats.
+	std::atomic<uint64_t> m_writeCalls{ 0 };
+	std::atomic<uint64_t> m_messagesWritten{ 0 };
+	std::atomic<uint64_t> m_bytesWritten{ 0 };
+	std::atomic<uint64_t> m_peakQueuedBytes{ 0 };
+	std::atomic<uint64_t> m_peakInboundFrameSize{ 0 };
+	std::atomic<uint64_t> m_messagesDropped{ 0 };
+	std::atomic<uint64_t> m_bytesDropped{ 0 };
+	std::atomic<uint64_t> m_messagesCoalesced{ 0 };
+	std::atomic<uint64_t> m_bytesCoalesced{ 0 };
+	std::atomic<uint64_t> m_probesDropped{ 0 };
+
+	// Read counters, same as above.
+	std::atomic<uint64_t> m_readWakeups{ 0 };
+	std::atomic<uint64_t> m_readCalls{ 0 };
+	std::atomic<uint64_t> m_messagesRead{ 0 };
+	std::atomic<uint64_t> m_bytesRead{ 0 };
 
-	// Messages are written one at a time. Store a backlog of them.
-	std::deque<std::string> m_outputBuffer;
+	// Set from the first write that doesn't fit until the queue drains to half of
+	// maxQueuedBytes. Entering and leaving are logged once each, so a session that stays
+	// connected still reports falling behind. m_overLimitSince is on m_clock.
+	bool m_isOverLimit = false;
+	std::chrono::microseconds m_overLimitSince{ 0 };
+	uint64_t m_overLimitDropped = 0;
+
+	// Filled with data over the wire before parsing. Messages are parsed in place.
+	ReceiveRing m_inputBuffer;
+
+	struct QueuedMessage
+	{
+		SharedBuffer buffer;
+		bool isCoalescable = false;
+		uint64_t coalesceKey = 0;
+	};
+
+	// Backlog of messages to write. Whatever is queued goes out together in one gathered write.
+	// Buffers are shared, so a broadcast queues the same bytes on every session.
+	std::deque<QueuedMessage> m_outputBuffer;
+
+	// Every message queued gets the next position, so positions stay put as the front of
+	// m_outputBuffer is written and dropped. This is the position of its front.
+	uint64_t m_outputFront = 0;
+
+	// Position of the newest queued message for each coalesce key.
+	std::unordered_map<uint64_t, uint64_t> m_coalesceIndex;
+
+	// Just after the newest message that isn't latest-value-wins. Messages before it can't be
+	// replaced, since the replacement would overtake it.
+	uint64_t m_coalesceBarrier = 0;
 
 	// Will parse messages that we get over the wire.
 	std::unique_ptr<NetworkMessageParser> m_parser;
 
-	// TODO: I think I should just send these out and not store them.
-	// Parsed messages that need to be sent to be delivered to their destination.
-	std::vector<NetworkMessage> m_messages;
+	MessageBatchHandler m_batchHandler;
+	SessionStoppedHandler m_stoppedHandler;
 
 	// The connected socket.
 	asio::ip::tcp::socket m_socket;
+
+	// Pings are stamped with this, so only our own clock is ever compared with itself. Also
+	// times how long the output queue stays over its limit.
+	Timer m_clock;
+	asio::steady_timer m_pingTimer;
+	uint32_t m_pingSequence = 0;
+
+	// Pings and pongs waiting to go out ahead of m_outputBuffer. A deque so the ones in flight
+	// stay put as more are added. m_batchProbes of them are being written, in a batch of
+	// their own. Probes aren't counted in m_queuedBytes; they're bounded by count instead.
+	static constexpr std::size_t s_maxQueuedProbes = 8;
+	std::deque<std::string> m_probes;
+	std::size_t m_batchProbes = 0;
+
+	// Written on the io thread, read from anywhere.
+	mutable std::mutex m_rttMutex;
+	RttTracker m_rtt;
+
+	// Sessions run on different io threads, so each one holds its own logger.
+	std::shared_ptr<spdlog::logger> m_logger;
 };
 
 //===============================================================================
@@ -0,0 +1,111 @@
+//---------------------------------------------------------------
+//
+// TcpSessionConnector.cpp
+//
+
+#include "common/TcpSessionConnector.h"
+
+#include "common/Log.h"
+
+using tcp = asio::ip::tcp;
+
+namespace Common {
+
+//===============================================================================
+
+namespace {
+	std::shared_ptr<spdlog::logger> s_logger;
+} // anon namespace
+
+//-------------------------------------------------------------------------------
+
+TcpSessionConnector::TcpSessionConnector(asio::io_context& ioc, const tcp::endpoint& endpoint,
+	const std::string& loggingContext, const TcpSessionConfig& config)
+	: m_socket(ioc)
+	, m_loggingContext(loggingContext)
+	, m_config(config)
+{
+	m_endpoints.push_back(endpoint);
+
+	// Shared by every connector, there may be thousands of them.
+	static const bool s_isLoggerRegistered = []()
+	{
+		REGISTER_LOGGER("Common::TcpSessionConnector");
+		s_logger = Log::Logger("Common::TcpSessionConnector");
+		return true;
+	}();
+	(void)s_isLoggerRegistered;
+}
+
+TcpSessionConnector::~TcpSessionConnector()
+{
+}
+
+std::shared_ptr<TcpSession> TcpSessionConnector::GetSession() const
+{
+	std::lock_guard<std::mutex> lock(m_sessionMutex);
+	return m_session;
+}
+
+void TcpSessionConnector::DestroySession()
+{
+	if (std::shared_ptr<TcpSession> session = GetSession())
+	{
+		session->Stop();
+	}
+}
+
+void TcpSessionConnector::Connect()
+{
+	SPDLOG_LOGGER_INFO(s_logger, "Attempting to connect {} to server", m_loggingContext);
+	DoConnect();
+}
+
+void TcpSessionConnector::DoConnect()
+{
+	asio::async_connect(m_socket, m_endpoints,
+		std::bind(&TcpSessionConnector::OnDoConnect,
+			shared_from_this(),
+			std::placeholders::_1));
+}
+
+void TcpSessionConnector::OnDoConnect(const std::error_code& ec)
+{
+	if (ec)
+	{
+		SPDLOG_LOGGER_ERROR(s_logger, "Error connecting {} to server. ec= {}", m_loggingContext,
+			ec.value());
+
+		// Server may not be running, keep trying.
+		if (ec == asio::error::connection_refused && m_retryOnRefused)
+		{
+			m_socket.close();
+			DoConnect();
+			return;
+		}
+
+		if (m_errorHandler)
+		{
+			m_errorHandler(ec);
+		}
+		return;
+	}
+
+	SPDLOG_LOGGER_INFO(s_logger, "{} connected to server.", m_loggingContext);
+
+	auto session = std::make_shared<TcpSession>(std::move(m_socket), m_loggingContext, m_config);
+	{
+		std::lock_guard<std::mutex> lock(m_sessionMutex);
+		m_session = session;
+	}
+	m_isConnected = true;
+	if (m_connectedHandler)
+	{
+		m_connectedHandler(session);
+	}
+	session->Start();
+}
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,78 @@
+//---------------------------------------------------------------
+//
+// TcpSessionConnector.h
+//
+
+#pragma once
+
+#include "common/TcpSession.h"
+
+#include <asio.hpp>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace Common {
+
+//===============================================================================
+
+// Connects to a server and wraps the socket in a TcpSession once it's up. Everything happens on
+// the thread running ioc.
+class TcpSessionConnector : public std::enable_shared_from_this<TcpSessionConnector> {
+
+public:
+	// Gets the session before it's started. Set its handlers here.
+	using ConnectedHandler = std::function<void(const std::shared_ptr<TcpSession>& session)>;
+
+	// Called if connecting fails and won't be retried.
+	using ErrorHandler = std::function<void(const std::error_code& ec)>;
+
+	TcpSessionConnector(asio::io_context& ioc, const asio::ip::tcp::endpoint& endpoint,
+		const std::string& loggingContext, const TcpSessionConfig& config = {});
+
+	~TcpSessionConnector();
+
+	void SetConnectedHandler(ConnectedHandler handler) { m_connectedHandler = std::move(handler); }
+	void SetErrorHandler(ErrorHandler handler) { m_errorHandler = std::move(handler); }
+
+	// When set, a refused connection is retried straight away, as if the server isn't up yet.
+	// Set by default.
+	void SetRetryOnRefused(bool retry) { m_retryOnRefused = retry; }
+
+	bool IsConnected() { return m_isConnected; }
+
+	// Null until connected. Safe to call from any thread, but the session itself should only be
+	// called into on its own.
+	std::shared_ptr<TcpSession> GetSession() const;
+
+	void DestroySession();
+	void Connect();
+
+private:
+	void DoConnect();
+	void OnDoConnect(const std::error_code& ec);
+
+	// Empty after connected.
+	asio::ip::tcp::socket m_socket;
+	std::atomic<bool> m_isConnected{ false };
+	bool m_retryOnRefused = true;
+
+	std::vector<asio::ip::tcp::endpoint> m_endpoints;
+
+	// Set on the io thread once connected, read from wherever GetSession is called.
+	mutable std::mutex m_sessionMutex;
+	std::shared_ptr<TcpSession> m_session;
+	std::string m_loggingContext;
+	TcpSessionConfig m_config;
+
+	ConnectedHandler m_connectedHandler;
+	ErrorHandler m_errorHandler;
+};
+
+//===============================================================================
+
+} // namespace Common
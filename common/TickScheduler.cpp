@@ -0,0 +1,127 @@
+//---------------------------------------------------------------
+//
+// TickScheduler.cpp
+//
+
+#include "common/TickScheduler.h"
+
+#include "common/Timer.h"
+
+#include <algorithm>
+#include <assert.h>
+
+namespace Common {
+
+//===============================================================================
+
+TickScheduler::TickScheduler(uint32_t tickRate)
+{
+	SetTickRate(tickRate);
+}
+
+TickScheduler::~TickScheduler()
+{
+}
+
+void TickScheduler::SetTickRate(uint32_t tickRate)
+{
+	assert(tickRate > 0);
+	m_tickInterval = std::chrono::microseconds(1000000 / std::max<uint32_t>(tickRate, 1));
+}
+
+void TickScheduler::Run(const std::function<void()>& onWork, const std::function<void()>& onTick,
+	const OverrunHandler& onOverrun)
+{
+	m_stopRequested = false;
+
+	Clock::time_point nextTick = Clock::now();
+	while (!m_stopRequested)
+	{
+		Clock::time_point now = Clock::now();
+		if (now >= nextTick)
+		{
+			if (RunTick(onTick) && onOverrun)
+			{
+				onOverrun(m_stats);
+			}
+
+			// Ticks that ran long are dropped rather than run back to back to catch up.
+			nextTick += m_tickInterval;
+			now = Clock::now();
+			if (nextTick <= now)
+			{
+				nextTick = now + m_tickInterval;
+			}
+			continue;
+		}
+
+		if (WaitUntil(nextTick))
+		{
+			++m_stats.wakeups;
+			onWork();
+		}
+	}
+}
+
+void TickScheduler::Notify()
+{
+	if (m_notified.exchange(true))
+	{
+		// Already pending. The scheduler hasn't woken up for the last one yet.
+		return;
+	}
+
+	// Taking the lock orders this against the scheduler checking m_notified before it sleeps.
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+	}
+	m_condition.notify_one();
+}
+
+void TickScheduler::Stop()
+{
+	m_stopRequested = true;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+	}
+	m_condition.notify_one();
+}
+
+bool TickScheduler::RunTick(const std::function<void()>& onTick)
+{
+	Timer timer;
+	timer.Start();
+
+	// The tick handles everything that's been posted so far.
+	m_notified = false;
+	onTick();
+
+	timer.Stop();
+	std::chrono::microseconds elapsed = timer.GetElapsedUs();
+
+	++m_stats.ticks;
+	m_stats.tickInterval = m_tickInterval;
+	m_stats.lastTickTime = elapsed;
+	m_stats.totalTickTime += elapsed;
+	m_stats.maxTickTime = std::max(m_stats.maxTickTime, elapsed);
+	if (elapsed <= m_tickInterval)
+	{
+		return false;
+	}
+
+	++m_stats.overruns;
+	return true;
+}
+
+bool TickScheduler::WaitUntil(Clock::time_point deadline)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_condition.wait_until(lock, deadline,
+		[this]() { return m_notified.load() || m_stopRequested.load(); });
+
+	return m_notified.exchange(false);
+}
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,99 @@
+//---------------------------------------------------------------
+//
+// TickScheduler.h
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+namespace Common {
+
+//===============================================================================
+
+// How long ticks took compared to the time they were given.
+struct TickSchedulerStats
+{
+	uint64_t ticks = 0;
+
+	// Ticks that took longer than the tick interval.
+	uint64_t overruns = 0;
+
+	// Times the scheduler woke between ticks because work was posted.
+	uint64_t wakeups = 0;
+
+	std::chrono::microseconds tickInterval = std::chrono::microseconds::zero();
+	std::chrono::microseconds lastTickTime = std::chrono::microseconds::zero();
+	std::chrono::microseconds maxTickTime = std::chrono::microseconds::zero();
+	std::chrono::microseconds totalTickTime = std::chrono::microseconds::zero();
+
+	// Fraction of the tick interval the average tick used. Over 1 means ticks are overrunning.
+	double AverageBudgetUsed() const
+	{
+		if (ticks == 0 || tickInterval.count() == 0)
+		{
+			return 0.0;
+		}
+
+		return static_cast<double>(totalTickTime.count()) / ticks / tickInterval.count();
+	}
+};
+
+// Runs a fixed rate game loop on the calling thread. Between ticks the thread sleeps rather
+// than spinning, but wakes straight away when another thread calls Notify so posted work
+// doesn't have to wait for the next tick.
+class TickScheduler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+	using OverrunHandler = std::function<void(const TickSchedulerStats& stats)>;
+
+	TickScheduler(uint32_t tickRate = 30);
+	~TickScheduler();
+
+	// Ticks per second. Takes effect from the next tick.
+	void SetTickRate(uint32_t tickRate);
+	std::chrono::microseconds GetTickInterval() const { return m_tickInterval; }
+
+	// Calls onTick at the tick rate and onWork whenever Notify wakes the scheduler in between,
+	// until Stop is called. onOverrun, if set, is called after any tick that ran past its
+	// interval. Blocks the calling thread.
+	void Run(const std::function<void()>& onWork, const std::function<void()>& onTick,
+		const OverrunHandler& onOverrun = nullptr);
+
+	// Wakes the scheduler to run onWork. Safe to call from any thread.
+	void Notify();
+
+	// Makes Run return after whatever it's currently doing. Safe to call from any thread.
+	void Stop();
+
+	// Only meaningful on the thread calling Run, or once Run has returned.
+	const TickSchedulerStats& GetStats() const { return m_stats; }
+
+private:
+	// Returns true if the tick overran.
+	bool RunTick(const std::function<void()>& onTick);
+
+	// Sleeps until deadline or until notified. Returns true if notified.
+	bool WaitUntil(Clock::time_point deadline);
+
+	std::chrono::microseconds m_tickInterval;
+	TickSchedulerStats m_stats;
+
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+
+	// Set by Notify and cleared when the scheduler wakes. Only the first Notify after a wake
+	// takes the lock.
+	std::atomic<bool> m_notified{ false };
+	std::atomic<bool> m_stopRequested{ false };
+};
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,85 @@
+//---------------------------------------------------------------
+//
+// TransportRouting.h
+//
+
+#pragma once
+
+#include "common/NetworkTypes.h"
+
+#include <array>
+#include <string_view>
+
+namespace Common {
+
+//===============================================================================
+
+enum class Transport : uint32_t
+{
+	// Reliable and ordered. Anything that must arrive.
+	Tcp,
+
+	// Unreliable and sequenced. State that's only worth having while it's fresh.
+	Udp,
+
+	// Reliable and ordered within a stream. Anything that must arrive but shouldn't wait behind
+	// unrelated messages that were lost.
+	ReliableUdp
+};
+
+struct Route
+{
+	Transport transport = Transport::Tcp;
+
+	// Which ReliableUdp stream. Messages on different streams don't wait for each other.
+	uint8_t stream = 0;
+};
+
+// Which transport each message type goes over. Messages routed to Udp still go over TCP until
+// the UDP side of the connection is up, or if they're too big for a datagram. ReliableUdp
+// messages never switch transports part way through a stream: they're held until the UDP side
+// is up, or the stream stays on TCP for the whole connection if there's no UDP side to wait
+// for. One too big for a datagram, or refused by a stream whose backlog is full, closes the
+// connection instead. See UdpSendResult.
+class TransportRouting
+{
+public:
+	TransportRouting()
+	{
+		// Only the latest position matters. Old ones shouldn't hold up new ones.
+		m_routes[static_cast<uint32_t>(MessageId::Move)].transport = Transport::Udp;
+
+		// Snapshots are deltas from acked baselines, so losing one costs nothing but a bigger
+		// delta next time.
+		m_routes[static_cast<uint32_t>(MessageId::Snapshot)].transport = Transport::Udp;
+		m_routes[static_cast<uint32_t>(MessageId::SnapshotAck)].transport = Transport::Udp;
+	}
+
+	void SetTransport(MessageId id, Transport transport, uint8_t stream = 0)
+	{
+		m_routes[static_cast<uint32_t>(id)] = { transport, stream };
+	}
+
+	Route GetRoute(MessageId id) const
+	{
+		uint32_t index = static_cast<uint32_t>(id);
+		return index < MessageIdCount ? m_routes[index] : Route();
+	}
+
+	// Routes a framed message by the id in its header.
+	Route GetRoute(std::string_view message) const
+	{
+		MessageHeader header;
+		return PeekHeader(message, header) ? GetRoute(header.messageType) : Route();
+	}
+
+	Transport GetTransport(MessageId id) const { return GetRoute(id).transport; }
+	Transport GetTransport(std::string_view message) const { return GetRoute(message).transport; }
+
+private:
+	std::array<Route, MessageIdCount> m_routes;
+};
+
+//===============================================================================
+
+} // namespace Common
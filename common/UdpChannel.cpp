@@ -0,0 +1,488 @@
+//---------------------------------------------------------------
+//
+// UdpChannel.cpp
+//
+
+#include "common/UdpChannel.h"
+
+#include "common/Log.h"
+
+using udp = asio::ip::udp;
+
+namespace Common {
+
+//===============================================================================
+
+namespace {
+	const uint32_t s_packetHeaderSize = sizeof(UdpPacketHeader);
+	const uint32_t s_reliableHeaderSize = sizeof(ReliableMessageHeader);
+
+	// Each reliable message goes out as two buffers, its header and the message. Keeps a whole
+	// datagram under the scatter/gather limit of 64 buffers.
+	const uint32_t s_maxReliablePerDatagram = 31;
+
+	// Hellos are tiny and the server can't send us anything over UDP until one gets through,
+	// so a few go out in case some are lost.
+	const uint32_t s_helloCount = 3;
+
+	// Reads a framed message off the front of data. Returns false if there isn't a whole one.
+	bool ParseFrame(std::string_view& data, NetworkMessageView& message)
+	{
+		if (!PeekHeader(data, message.header)
+			|| message.header.messageLength > data.size() - sizeof(MessageHeader))
+		{
+			return false;
+		}
+
+		message.messageData = data.substr(sizeof(MessageHeader), message.header.messageLength);
+		data.remove_prefix(sizeof(MessageHeader) + message.header.messageLength);
+		return true;
+	}
+} // anon namespace
+
+struct UdpChannel::Outgoing
+{
+	udp::endpoint endpoint;
+	UdpPacketHeader header;
+	std::vector<ReliableMessage> reliable;
+
+	// Null if there's no unreliable message. A hello or bare ack is just the header.
+	SharedBuffer message;
+};
+
+UdpChannel::UdpChannel(udp::socket socket, const std::string& loggingContext,
+	const UdpChannelConfig& config)
+	: m_config(config)
+	, m_socket(std::move(socket))
+	, m_updateTimer(m_socket.get_executor().context())
+	, m_random(config.simulationSeed)
+{
+	REGISTER_LOGGER(loggingContext);
+	m_logger = Log::Logger(loggingContext);
+}
+
+UdpChannel::~UdpChannel()
+{
+}
+
+void UdpChannel::Start()
+{
+	SPDLOG_LOGGER_INFO(m_logger, "UDP channel running on port {}", GetLocalPort());
+	DoReceive();
+	DoUpdate();
+}
+
+void UdpChannel::Stop()
+{
+	if (m_socket.is_open())
+	{
+		UdpChannelStats stats = GetStats();
+		SPDLOG_LOGGER_INFO(m_logger, "Stopping UDP channel. datagramsSent= {}"
+			" datagramsReceived= {} datagramsStale= {} datagramsRejected= {}"
+			" reliableMessagesSent= {} reliableMessagesResent= {}",
+			stats.datagramsSent, stats.datagramsReceived, stats.datagramsStale,
+			stats.datagramsRejected, stats.reliableMessagesSent, stats.reliableMessagesResent);
+	}
+
+	// Nothing follows it now, so it's held back no longer.
+	if (m_heldBack && m_socket.is_open())
+	{
+		DoTransmit(std::move(m_heldBack));
+		m_heldBack.reset();
+	}
+
+	std::error_code ec;
+	m_socket.close(ec);
+	m_updateTimer.cancel(ec);
+}
+
+uint16_t UdpChannel::GetLocalPort() const
+{
+	std::error_code ec;
+	return m_socket.local_endpoint(ec).port();
+}
+
+void UdpChannel::AddPeer(uint32_t clientId, uint32_t token)
+{
+	m_peers.erase(clientId);
+	m_peers.emplace(clientId, Peer(token, m_config.minResendDelay));
+}
+
+void UdpChannel::RemovePeer(uint32_t clientId)
+{
+	m_peers.erase(clientId);
+}
+
+void UdpChannel::Connect(const udp::endpoint& remote, uint32_t clientId, uint32_t token)
+{
+	AddPeer(clientId, token);
+	Peer& peer = m_peers.at(clientId);
+	peer.endpoint = remote;
+	peer.hasEndpoint = true;
+
+	for (uint32_t i = 0; i < s_helloCount; ++i)
+	{
+		SendDatagram(clientId, peer, nullptr);
+	}
+}
+
+bool UdpChannel::Send(uint32_t clientId, const SharedBuffer& message)
+{
+	if (message->size() > s_maxMessageSize)
+	{
+		return false;
+	}
+
+	auto it = m_peers.find(clientId);
+	if (it == m_peers.end() || !it->second.hasEndpoint)
+	{
+		return false;
+	}
+
+	SendDatagram(clientId, it->second, message);
+	return true;
+}
+
+UdpSendResult UdpChannel::SendReliable(uint32_t clientId, uint8_t stream,
+	const SharedBuffer& message)
+{
+	if (message->size() > s_maxReliableMessageSize)
+	{
+		return UdpSendResult::TooLarge;
+	}
+
+	if (stream >= ReliableEndpoint::s_streamCount)
+	{
+		return UdpSendResult::NotRoutable;
+	}
+
+	auto it = m_peers.find(clientId);
+	if (it == m_peers.end())
+	{
+		return UdpSendResult::NotConnected;
+	}
+
+	if (!it->second.reliable.Queue(stream, message))
+	{
+		m_reliableMessagesRefused.fetch_add(1, std::memory_order_relaxed);
+		return UdpSendResult::StreamFull;
+	}
+
+	// Otherwise it goes out with the first update after the peer's hello.
+	if (it->second.hasEndpoint)
+	{
+		SendDueMessages(clientId, it->second);
+	}
+	return UdpSendResult::Sent;
+}
+
+UdpSendResult UdpChannel::Send(uint32_t clientId, const Route& route, const SharedBuffer& message)
+{
+	switch (route.transport)
+	{
+	case Transport::Udp:
+		if (message->size() > s_maxMessageSize)
+		{
+			return UdpSendResult::TooLarge;
+		}
+		return Send(clientId, message) ? UdpSendResult::Sent : UdpSendResult::NotConnected;
+	case Transport::ReliableUdp:
+		return SendReliable(clientId, route.stream, message);
+	default:
+		return UdpSendResult::NotRoutable;
+	}
+}
+
+void UdpChannel::Post(std::function<void()> cb)
+{
+	asio::post(m_socket.get_executor(), std::move(cb));
+}
+
+UdpChannelStats UdpChannel::GetStats() const
+{
+	UdpChannelStats stats;
+	stats.datagramsSent = m_datagramsSent.load(std::memory_order_relaxed);
+	stats.datagramsReceived = m_datagramsReceived.load(std::memory_order_relaxed);
+	stats.messagesReceived = m_messagesReceived.load(std::memory_order_relaxed);
+	stats.datagramsStale = m_datagramsStale.load(std::memory_order_relaxed);
+	stats.datagramsRejected = m_datagramsRejected.load(std::memory_order_relaxed);
+	stats.datagramsSimulatedLost = m_datagramsSimulatedLost.load(std::memory_order_relaxed);
+	stats.reliableMessagesSent = m_reliableMessagesSent.load(std::memory_order_relaxed);
+	stats.reliableMessagesResent = m_reliableMessagesResent.load(std::memory_order_relaxed);
+	stats.reliableMessagesDelivered = m_reliableMessagesDelivered.load(std::memory_order_relaxed);
+	stats.reliableMessagesRefused = m_reliableMessagesRefused.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void UdpChannel::DoReceive()
+{
+	m_socket.async_receive_from(asio::buffer(m_receiveBuffer), m_senderEndpoint,
+		std::bind(&UdpChannel::OnReceive,
+			shared_from_this(),
+			std::placeholders::_1,
+			std::placeholders::_2));
+}
+
+void UdpChannel::OnReceive(const std::error_code& ec, std::size_t bytesReceived)
+{
+	if (IsStopped() || ec == asio::error::operation_aborted)
+	{
+		return;
+	}
+
+	// Errors here are about one datagram (or an ICMP reply to one we sent), not the socket.
+	if (ec)
+	{
+		SPDLOG_LOGGER_WARN(m_logger, "Error receiving datagram. ec= {}", ec.value());
+		DoReceive();
+		return;
+	}
+
+	m_datagramsReceived.fetch_add(1, std::memory_order_relaxed);
+
+	UdpPacketHeader header;
+	auto it = m_peers.end();
+	if (bytesReceived >= s_packetHeaderSize)
+	{
+		std::memcpy(&header, m_receiveBuffer.data(), s_packetHeaderSize);
+		it = m_peers.find(header.clientId);
+	}
+
+	if (it == m_peers.end() || it->second.token != header.token)
+	{
+		m_datagramsRejected.fetch_add(1, std::memory_order_relaxed);
+		DoReceive();
+		return;
+	}
+
+	if (!ParseMessages(header, m_receiveBuffer.data() + s_packetHeaderSize,
+		bytesReceived - s_packetHeaderSize))
+	{
+		m_datagramsRejected.fetch_add(1, std::memory_order_relaxed);
+		DoReceive();
+		return;
+	}
+
+	// The token checks out, so this is where the peer is now.
+	Peer& peer = it->second;
+	peer.endpoint = m_senderEndpoint;
+	peer.hasEndpoint = true;
+
+	PacketStatus status = peer.reliable.OnPacket(header.sequence, header.ack, header.ackBits,
+		ReliableEndpoint::Clock::now());
+	if (status != PacketStatus::New)
+	{
+		m_datagramsStale.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	auto batch = std::make_shared<MessageBatch>();
+	if (status != PacketStatus::Duplicate)
+	{
+		for (const auto& reliable : m_reliableReceived)
+		{
+			peer.reliable.OnReliableMessage(reliable.first, reliable.second, *batch);
+		}
+		m_reliableMessagesDelivered.fetch_add(batch->Size(), std::memory_order_relaxed);
+	}
+
+	// Unreliable messages are only worth delivering if nothing newer has beaten them here.
+	if (status == PacketStatus::New)
+	{
+		for (const NetworkMessageView& message : m_unreliableReceived)
+		{
+			batch->Append(message);
+		}
+	}
+
+	if (!batch->IsEmpty())
+	{
+		m_messagesReceived.fetch_add(batch->Size(), std::memory_order_relaxed);
+		if (m_batchHandler)
+		{
+			m_batchHandler(header.clientId, std::move(batch));
+		}
+	}
+
+	if (peer.reliable.NeedsAckNow())
+	{
+		SendDatagram(header.clientId, peer, nullptr);
+	}
+
+	DoReceive();
+}
+
+bool UdpChannel::ParseMessages(const UdpPacketHeader& header, const char* data, std::size_t size)
+{
+	m_reliableReceived.clear();
+	m_unreliableReceived.clear();
+
+	std::string_view remaining(data, size);
+	for (uint32_t i = 0; i < header.reliableCount; ++i)
+	{
+		ReliableMessageHeader reliableHeader;
+		NetworkMessageView message;
+		if (remaining.size() < s_reliableHeaderSize)
+		{
+			return false;
+		}
+
+		std::memcpy(&reliableHeader, remaining.data(), s_reliableHeaderSize);
+		remaining.remove_prefix(s_reliableHeaderSize);
+		if (!ParseFrame(remaining, message))
+		{
+			return false;
+		}
+
+		m_reliableReceived.emplace_back(reliableHeader, message);
+	}
+
+	while (!remaining.empty())
+	{
+		NetworkMessageView message;
+		if (!ParseFrame(remaining, message))
+		{
+			return false;
+		}
+
+		m_unreliableReceived.push_back(message);
+	}
+
+	return true;
+}
+
+void UdpChannel::DoUpdate()
+{
+	m_updateTimer.expires_after(m_config.updateInterval);
+	m_updateTimer.async_wait(std::bind(&UdpChannel::OnUpdate,
+		shared_from_this(),
+		std::placeholders::_1));
+}
+
+void UdpChannel::OnUpdate(const std::error_code& ec)
+{
+	if (IsStopped() || ec == asio::error::operation_aborted)
+	{
+		return;
+	}
+
+	for (auto& entry : m_peers)
+	{
+		Peer& peer = entry.second;
+		if (!peer.hasEndpoint)
+		{
+			continue;
+		}
+
+		if (peer.reliable.HasDue(ReliableEndpoint::Clock::now()))
+		{
+			SendDueMessages(entry.first, peer);
+		}
+		else if (peer.reliable.NeedsAck())
+		{
+			// Nothing has gone the other way to carry the acks, so send them on their own.
+			SendDatagram(entry.first, peer, nullptr);
+		}
+	}
+
+	// A datagram held back for the simulated reordering goes out late rather than never, even
+	// if nothing was sent to overtake it.
+	if (m_heldBack)
+	{
+		DoTransmit(std::move(m_heldBack));
+		m_heldBack.reset();
+	}
+
+	DoUpdate();
+}
+
+uint32_t UdpChannel::SendDatagram(uint32_t clientId, Peer& peer, const SharedBuffer& message)
+{
+	uint32_t budget = s_maxMessageSize - (message ? static_cast<uint32_t>(message->size()) : 0);
+	ReliableEndpoint::Clock::time_point now = ReliableEndpoint::Clock::now();
+	peer.reliable.WritePacket(now, budget, s_maxReliablePerDatagram, m_outgoingPacket);
+	uint32_t reliableCount = static_cast<uint32_t>(m_outgoingPacket.reliable.size());
+
+	auto outgoing = std::make_shared<Outgoing>();
+	outgoing->endpoint = peer.endpoint;
+	outgoing->header.clientId = clientId;
+	outgoing->header.token = peer.token;
+	outgoing->header.sequence = m_outgoingPacket.sequence;
+	outgoing->header.ack = m_outgoingPacket.ack;
+	outgoing->header.ackBits = m_outgoingPacket.ackBits;
+	outgoing->header.reliableCount = static_cast<uint16_t>(m_outgoingPacket.reliable.size());
+	outgoing->reliable.swap(m_outgoingPacket.reliable);
+	outgoing->message = message;
+
+	m_reliableMessagesSent.fetch_add(outgoing->reliable.size(), std::memory_order_relaxed);
+	m_reliableMessagesResent.fetch_add(m_outgoingPacket.resentCount, std::memory_order_relaxed);
+
+	Transmit(std::move(outgoing));
+	return reliableCount;
+}
+
+void UdpChannel::SendDueMessages(uint32_t clientId, Peer& peer)
+{
+	// Every reliable message was checked to fit an empty datagram when it was queued, so each
+	// pass sends at least one. The check on the count is just a backstop.
+	while (peer.reliable.HasDue(ReliableEndpoint::Clock::now()))
+	{
+		if (SendDatagram(clientId, peer, nullptr) == 0)
+		{
+			break;
+		}
+	}
+}
+
+void UdpChannel::Transmit(std::shared_ptr<Outgoing> outgoing)
+{
+	if (m_config.simulatedLoss > 0.0f && m_chance(m_random) < m_config.simulatedLoss)
+	{
+		m_datagramsSimulatedLost.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	if (m_config.simulatedReorder > 0.0f && !m_heldBack
+		&& m_chance(m_random) < m_config.simulatedReorder)
+	{
+		m_heldBack = std::move(outgoing);
+		return;
+	}
+
+	DoTransmit(std::move(outgoing));
+	if (m_heldBack)
+	{
+		DoTransmit(std::move(m_heldBack));
+		m_heldBack.reset();
+	}
+}
+
+void UdpChannel::DoTransmit(std::shared_ptr<Outgoing> outgoing)
+{
+	// Gathered straight from the header and the messages, without copying them into one buffer.
+	std::vector<asio::const_buffer> buffers;
+	buffers.reserve(2 + outgoing->reliable.size() * 2);
+	buffers.push_back(asio::buffer(&outgoing->header, s_packetHeaderSize));
+	for (const ReliableMessage& reliable : outgoing->reliable)
+	{
+		buffers.push_back(asio::buffer(&reliable.header, s_reliableHeaderSize));
+		buffers.push_back(asio::buffer(*reliable.message));
+	}
+	if (outgoing->message)
+	{
+		buffers.push_back(asio::buffer(*outgoing->message));
+	}
+
+	m_datagramsSent.fetch_add(1, std::memory_order_relaxed);
+	m_socket.async_send_to(buffers, outgoing->endpoint,
+		[self = shared_from_this(), outgoing](const std::error_code& ec, std::size_t)
+		{
+			if (ec && ec != asio::error::operation_aborted)
+			{
+				SPDLOG_LOGGER_WARN(self->m_logger, "Error sending datagram. ec= {}", ec.value());
+			}
+		});
+}
+
+//===============================================================================
+
+} // namespace Common
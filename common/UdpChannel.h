@@ -0,0 +1,276 @@
+//---------------------------------------------------------------
+//
+// UdpChannel.h
+//
+
+#pragma once
+
+#include "common/NetworkTypes.h"
+#include "common/ReliableEndpoint.h"
+#include "common/TransportRouting.h"
+
+#include <asio.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace spdlog {
+class logger;
+}
+
+namespace Common {
+
+//===============================================================================
+
+// Starts every datagram. Ties it to a connection that was made over TCP and carries acks for
+// the reliable messages going the other way. reliableCount messages, each behind a
+// ReliableMessageHeader, come straight after it, then any unreliable ones.
+struct UdpPacketHeader
+{
+	uint32_t clientId = 0;
+	uint32_t token = 0;
+	uint32_t sequence = 0;
+	uint32_t ack = 0;
+	uint32_t ackBits = 0;
+	uint16_t reliableCount = 0;
+	uint16_t reserved = 0;
+};
+
+// Payload of MessageId::UdpHandshake. Tells a client what to put on its datagrams and where
+// to send them.
+struct UdpHandshake
+{
+	uint32_t clientId = 0;
+	uint32_t token = 0;
+	uint16_t port = 0;
+};
+
+struct UdpChannelConfig
+{
+	// Stand-in for a bad network, applied to outgoing datagrams. For tests and local debugging.
+	// Chance a datagram is dropped.
+	float simulatedLoss = 0.0f;
+
+	// Chance a datagram is held back and sent after the one that follows it.
+	float simulatedReorder = 0.0f;
+
+	uint32_t simulationSeed = 0;
+
+	// How often unacked reliable messages are checked for resending, and acks go out on their
+	// own if nothing else has carried them.
+	std::chrono::milliseconds updateInterval{ 10 };
+
+	// Shortest wait for an ack before a reliable message is resent. Grows with the round trip.
+	std::chrono::milliseconds minResendDelay{ 30 };
+};
+
+// Plain copy of a channel's counters, safe to read from any thread.
+struct UdpChannelStats
+{
+	uint64_t datagramsSent = 0;
+	uint64_t datagramsReceived = 0;
+	uint64_t messagesReceived = 0;
+
+	// Arrived after a newer datagram from the same peer, so weren't delivered.
+	uint64_t datagramsStale = 0;
+
+	// From an unknown peer, with the wrong token, or malformed.
+	uint64_t datagramsRejected = 0;
+
+	// Dropped by the simulated loss.
+	uint64_t datagramsSimulatedLost = 0;
+
+	uint64_t reliableMessagesSent = 0;
+	uint64_t reliableMessagesResent = 0;
+	uint64_t reliableMessagesDelivered = 0;
+
+	// Refused because their stream's backlog was full. See UdpSendResult::StreamFull.
+	uint64_t reliableMessagesRefused = 0;
+};
+
+// What happened to a message handed to UdpChannel to send.
+enum class UdpSendResult : uint32_t
+{
+	// Sent, or queued on its stream to be sent in order.
+	Sent,
+
+	// The peer hasn't said hello yet, so there's nowhere to send it. Reliable messages are held
+	// for a peer that was added, so for them this means it never was.
+	NotConnected,
+
+	// Won't fit in a datagram.
+	TooLarge,
+
+	// Routed to TCP, or to a stream that doesn't exist.
+	NotRoutable,
+
+	// So many of the stream's messages are waiting on acks that no more can be held behind them.
+	// The stream can't be delivered in order any more, so the caller should close the connection.
+	StreamFull
+};
+
+// True if a message that wasn't sent should go over TCP instead. Only unreliable ones may. A
+// reliable message over TCP would overtake, or be overtaken by, the ones on its stream still
+// waiting on acks, so the caller should close the connection instead.
+inline bool ShouldFallBackToTcp(const Route& route, UdpSendResult result)
+{
+	if (route.transport == Transport::ReliableUdp)
+	{
+		return false;
+	}
+
+	return result == UdpSendResult::NotConnected
+		|| result == UdpSendResult::TooLarge
+		|| result == UdpSendResult::NotRoutable;
+}
+
+// Gets every message from one datagram. Called on the channel's io thread.
+using UdpBatchHandler = std::function<void(uint32_t clientId, std::shared_ptr<MessageBatch> batch)>;
+
+// Datagrams for messages that shouldn't wait behind each other the way they do over TCP. Lives
+// next to the TcpSessions: connections are made over TCP, which hands out the client id and
+// token every datagram has to carry.
+//
+// Unreliable messages are for state that's only useful while it's fresh. If one turns up after
+// a newer datagram from the same peer, it's dropped rather than delivered late. Reliable
+// messages are acked and resent until they arrive, and delivered in order within their stream
+// (see ReliableEndpoint).
+//
+// The server runs one channel for all of its clients. A client runs one with the server as its
+// only peer. Apart from Post and GetStats, only call into it from its socket's io thread.
+class UdpChannel : public std::enable_shared_from_this<UdpChannel>
+{
+public:
+	// Largest datagram we send. Small enough to avoid IP fragmentation on any sane path.
+	static constexpr uint32_t s_maxDatagramSize = 1200;
+	static constexpr uint32_t s_maxMessageSize = s_maxDatagramSize - sizeof(UdpPacketHeader);
+	static constexpr uint32_t s_maxReliableMessageSize =
+		s_maxMessageSize - sizeof(ReliableMessageHeader);
+
+	UdpChannel(asio::ip::udp::socket socket, const std::string& loggingContext,
+		const UdpChannelConfig& config = {});
+	~UdpChannel();
+
+	void Start();
+	void Stop();
+	bool IsStopped() const { return !m_socket.is_open(); }
+	uint16_t GetLocalPort() const;
+
+	// Accepts datagrams from clientId that carry token. The peer's address is taken from the
+	// first one, so clients behind NAT work.
+	void AddPeer(uint32_t clientId, uint32_t token);
+	void RemovePeer(uint32_t clientId);
+
+	// Client side. Adds the server as a peer at a known address and says hello so the server
+	// learns ours.
+	void Connect(const asio::ip::udp::endpoint& remote, uint32_t clientId, uint32_t token);
+
+	// Sends one framed message. Returns false if the peer's address isn't known yet or the
+	// message won't fit in a datagram, in which case it should go over TCP instead.
+	bool Send(uint32_t clientId, const SharedBuffer& message);
+
+	// Queues one framed message to be delivered in order on stream, and sends it straight away
+	// if the stream's window has room. Otherwise it waits behind the window, up to
+	// ReliableEndpoint::s_maxBacklog messages. A peer that was added but hasn't said hello yet
+	// has its messages held until it does, so a stream never has to start out over TCP.
+	UdpSendResult SendReliable(uint32_t clientId, uint8_t stream, const SharedBuffer& message);
+
+	// Sends over whichever UDP transport route names.
+	UdpSendResult Send(uint32_t clientId, const Route& route, const SharedBuffer& message);
+
+	// Where received messages go. Set this before Start.
+	void SetMessageBatchHandler(UdpBatchHandler handler) { m_batchHandler = std::move(handler); }
+
+	// Runs cb on the thread that services this channel's socket.
+	void Post(std::function<void()> cb);
+
+	UdpChannelStats GetStats() const;
+
+private:
+	struct Peer
+	{
+		Peer(uint32_t token, std::chrono::milliseconds minResendDelay)
+			: token(token)
+			, reliable(minResendDelay)
+		{
+		}
+
+		uint32_t token = 0;
+		asio::ip::udp::endpoint endpoint;
+		bool hasEndpoint = false;
+
+		// Numbers our datagrams, tracks acks both ways and holds the reliable streams.
+		ReliableEndpoint reliable;
+	};
+
+	// A datagram on its way out. The header sits next to a reference to the message, so the
+	// two go out as one gathered send without copying the message.
+	struct Outgoing;
+
+	void DoReceive();
+	void OnReceive(const std::error_code& ec, std::size_t bytesReceived);
+
+	// Parses everything after the packet header into m_reliableReceived and m_unreliableReceived.
+	// Returns false if it doesn't add up.
+	bool ParseMessages(const UdpPacketHeader& header, const char* data, std::size_t size);
+
+	void DoUpdate();
+	void OnUpdate(const std::error_code& ec);
+
+	// Sends a datagram with message, if there is one, and whatever due reliable messages fit.
+	// Returns how many reliable messages went.
+	uint32_t SendDatagram(uint32_t clientId, Peer& peer, const SharedBuffer& message);
+
+	// Sends datagrams until no reliable messages are due.
+	void SendDueMessages(uint32_t clientId, Peer& peer);
+
+	// Where the simulated loss and reordering happen.
+	void Transmit(std::shared_ptr<Outgoing> outgoing);
+	void DoTransmit(std::shared_ptr<Outgoing> outgoing);
+
+	UdpChannelConfig m_config;
+	asio::ip::udp::socket m_socket;
+
+	std::unordered_map<uint32_t, Peer> m_peers;
+
+	std::array<char, s_maxDatagramSize> m_receiveBuffer;
+	asio::ip::udp::endpoint m_senderEndpoint;
+
+	// The messages of the datagram being handled, split by header before any are delivered, and
+	// the packet being written by SendDueMessages.
+	std::vector<std::pair<ReliableMessageHeader, NetworkMessageView>> m_reliableReceived;
+	std::vector<NetworkMessageView> m_unreliableReceived;
+	OutgoingPacket m_outgoingPacket;
+
+	asio::steady_timer m_updateTimer;
+
+	UdpBatchHandler m_batchHandler;
+
+	// Simulated network conditions.
+	std::mt19937 m_random;
+	std::uniform_real_distribution<float> m_chance{ 0.0f, 1.0f };
+	std::shared_ptr<Outgoing> m_heldBack;
+
+	std::atomic<uint64_t> m_datagramsSent{ 0 };
+	std::atomic<uint64_t> m_datagramsReceived{ 0 };
+	std::atomic<uint64_t> m_messagesReceived{ 0 };
+	std::atomic<uint64_t> m_datagramsStale{ 0 };
+	std::atomic<uint64_t> m_datagramsRejected{ 0 };
+	std::atomic<uint64_t> m_datagramsSimulatedLost{ 0 };
+	std::atomic<uint64_t> m_reliableMessagesSent{ 0 };
+	std::atomic<uint64_t> m_reliableMessagesResent{ 0 };
+	std::atomic<uint64_t> m_reliableMessagesDelivered{ 0 };
+	std::atomic<uint64_t> m_reliableMessagesRefused{ 0 };
+
+	std::shared_ptr<spdlog::logger> m_logger;
+};
+
+//===============================================================================
+
+} // namespace Common
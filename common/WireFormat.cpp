@@ -0,0 +1,116 @@
+//---------------------------------------------------------------
+//
+// WireFormat.cpp
+//
+
+#include "common/WireFormat.h"
+
+#include <zlib.h>
+
+namespace Common {
+
+//===============================================================================
+
+const char s_wirePreamble[s_wirePreambleSize] = { 'H', 'Y', s_compactWireVersion, 0 };
+
+uint32_t Crc32(std::string_view data)
+{
+	uLong crc = crc32(0L, Z_NULL, 0);
+	return static_cast<uint32_t>(crc32(crc, reinterpret_cast<const Bytef*>(data.data()),
+		static_cast<uInt>(data.size())));
+}
+
+uint32_t EncodeCompactHeader(MessageId id, uint32_t length, uint32_t flags, uint32_t checksum,
+	char* out)
+{
+	uint32_t tag = (static_cast<uint32_t>(id) << s_compactFrameFlagBits) | flags;
+	uint32_t size = WriteVarint(tag, out);
+	size += WriteVarint(length, out + size);
+	if (flags & CompactFrameChecksum)
+	{
+		// Spelled out byte by byte so it comes out the same on any host.
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			out[size++] = static_cast<char>(checksum >> (8 * i));
+		}
+	}
+	return size;
+}
+
+WireDecodeResult DecodeCompactHeader(const char* data, size_t size, CompactFrameHeader& header)
+{
+	uint32_t tag = 0;
+	int32_t tagSize = ReadVarint(data, size, tag);
+	if (tagSize <= 0)
+	{
+		return tagSize == 0 ? WireDecodeResult::Partial : WireDecodeResult::Malformed;
+	}
+
+	int32_t lengthSize = ReadVarint(data + tagSize, size - tagSize, header.messageLength);
+	if (lengthSize <= 0)
+	{
+		return lengthSize == 0 ? WireDecodeResult::Partial : WireDecodeResult::Malformed;
+	}
+
+	header.flags = tag & ((1 << s_compactFrameFlagBits) - 1);
+	header.messageType = static_cast<MessageId>(tag >> s_compactFrameFlagBits);
+	header.size = static_cast<uint32_t>(tagSize + lengthSize);
+	header.checksum = 0;
+	if (header.flags & CompactFrameChecksum)
+	{
+		if (size < header.size + 4)
+		{
+			return WireDecodeResult::Partial;
+		}
+
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			uint8_t byte = static_cast<uint8_t>(data[header.size + i]);
+			header.checksum |= static_cast<uint32_t>(byte) << (8 * i);
+		}
+		header.size += 4;
+	}
+
+	return WireDecodeResult::Complete;
+}
+
+bool IsWirePreamble(const char* data)
+{
+	return data[0] == s_wirePreamble[0]
+		&& data[1] == s_wirePreamble[1]
+		&& data[2] == s_wirePreamble[2]
+		&& data[3] == s_wirePreamble[3];
+}
+
+bool ParseWireFormat(std::string_view name, WireFormat& format)
+{
+	if (name == "legacy")
+	{
+		format = WireFormat::Legacy;
+		return true;
+	}
+	if (name == "compact")
+	{
+		format = WireFormat::Compact;
+		return true;
+	}
+	return false;
+}
+
+std::string PackageCompactMessage(MessageId id, std::string_view payload, uint32_t flags)
+{
+	char header[s_maxCompactHeaderSize];
+	uint32_t checksum = (flags & CompactFrameChecksum) ? Crc32(payload) : 0;
+	uint32_t headerSize = EncodeCompactHeader(id, static_cast<uint32_t>(payload.size()), flags,
+		checksum, header);
+
+	std::string message;
+	message.reserve(headerSize + payload.size());
+	message.append(header, headerSize);
+	message.append(payload.data(), payload.size());
+	return message;
+}
+
+//===============================================================================
+
+} // namespace Common
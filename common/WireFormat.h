@@ -0,0 +1,147 @@
+//---------------------------------------------------------------
+//
+// WireFormat.h
+//
+
+#pragma once
+
+#include "common/NetworkTypes.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Common {
+
+//===============================================================================
+
+// How frames are laid out on a TCP stream. Both ends of a connection have to agree.
+enum class WireFormat : uint32_t
+{
+	// A MessageHeader, 8 bytes in little endian order, then the payload. What every peer spoke
+	// before Compact, and still the default.
+	Legacy,
+
+	// The stream starts with a preamble naming the format version. Every frame after it is
+	// a varint of the id and flags, a varint of the payload length, a checksum if the frame
+	// has one, then the payload. Movement messages get a 2 byte header instead of 8.
+	Compact
+};
+
+// Bits in the low end of a compact frame's first varint. The id takes the rest.
+enum CompactFrameFlags : uint32_t
+{
+	CompactFrameNone = 0,
+
+	// The payload is compressed. See FrameCompression.h for how.
+	CompactFrameCompressed = 1 << 0,
+
+	// A CRC-32 of the payload follows the length, 4 bytes in little endian order.
+	CompactFrameChecksum = 1 << 1,
+
+	CompactFrameFlagMask = CompactFrameCompressed | CompactFrameChecksum
+};
+
+constexpr uint32_t s_compactFrameFlagBits = 2;
+
+// "HY", the version, then a reserved byte that's always 0.
+constexpr uint8_t s_compactWireVersion = 1;
+constexpr uint32_t s_wirePreambleSize = 4;
+extern const char s_wirePreamble[s_wirePreambleSize];
+
+// 5 bytes for the id and flags, 5 for the length, 4 for the checksum.
+constexpr uint32_t s_maxCompactHeaderSize = 14;
+
+enum class WireDecodeResult : uint32_t
+{
+	Complete,
+
+	// Not enough bytes yet. Try again once more arrive.
+	Partial,
+
+	// Nothing that follows can be trusted. The connection should be dropped.
+	Malformed
+};
+
+struct CompactFrameHeader
+{
+	MessageId messageType = MessageId::None;
+	uint32_t messageLength = 0;
+	uint32_t flags = CompactFrameNone;
+	uint32_t checksum = 0;
+
+	// Bytes taken by the header itself, payload not included.
+	uint32_t size = 0;
+};
+
+// Writes value 7 bits at a time, low bits first, to out. Returns the bytes written, at most 5.
+inline uint32_t WriteVarint(uint32_t value, char* out)
+{
+	uint32_t size = 0;
+	while (value >= 0x80)
+	{
+		out[size++] = static_cast<char>(value | 0x80);
+		value >>= 7;
+	}
+	out[size++] = static_cast<char>(value);
+	return size;
+}
+
+// Reads a varint off the front of data. Returns the bytes read, 0 if data ends part way
+// through it, or -1 if it's longer than a uint32_t can need.
+inline int32_t ReadVarint(const char* data, size_t size, uint32_t& value)
+{
+	// Most ids and lengths fit in a byte.
+	if (size > 0 && static_cast<uint8_t>(data[0]) < 0x80)
+	{
+		value = static_cast<uint8_t>(data[0]);
+		return 1;
+	}
+
+	value = 0;
+	for (uint32_t i = 0; i < 5; ++i)
+	{
+		if (i == size)
+		{
+			return 0;
+		}
+
+		uint8_t byte = static_cast<uint8_t>(data[i]);
+		if (i == 4 && byte > 0x0F)
+		{
+			return -1;
+		}
+
+		value |= static_cast<uint32_t>(byte & 0x7F) << (7 * i);
+		if (byte < 0x80)
+		{
+			return static_cast<int32_t>(i + 1);
+		}
+	}
+	return -1;
+}
+
+// CRC-32, as computed by zlib.
+uint32_t Crc32(std::string_view data);
+
+// Writes a compact frame header to out, which needs s_maxCompactHeaderSize bytes. checksum is
+// only written if flags has CompactFrameChecksum. Returns the bytes written.
+uint32_t EncodeCompactHeader(MessageId id, uint32_t length, uint32_t flags, uint32_t checksum,
+	char* out);
+
+// Reads a compact frame header off the front of data.
+WireDecodeResult DecodeCompactHeader(const char* data, size_t size, CompactFrameHeader& header);
+
+// Checks the first s_wirePreambleSize bytes of a compact stream.
+bool IsWirePreamble(const char* data);
+
+// Reads "legacy" or "compact", as given on a command line. Returns false for anything else.
+bool ParseWireFormat(std::string_view name, WireFormat& format);
+
+// Frames a payload in the compact format. The stream preamble isn't included.
+std::string PackageCompactMessage(MessageId id, std::string_view payload,
+	uint32_t flags = CompactFrameNone);
+
+//===============================================================================
+
+} // namespace Common
@@ -0,0 +1,547 @@
+//---------------------------------------------------------------
+//
+// LoadGenerator.cpp
+//
+
+#include "loadgen/LoadGenerator.h"
+
+#include "common/AsioEventProcessor.h"
+#include "common/NetworkTypes.h"
+#include "common/Snapshot.h"
+#include "common/TcpSession.h"
+#include "common/TcpSessionConnector.h"
+
+#include <asio.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+using tcp = asio::ip::tcp;
+using Clock = std::chrono::steady_clock;
+
+namespace LoadGen {
+
+//===============================================================================
+
+namespace {
+	// How often each client works out what it's due to send.
+	const Clock::duration s_stepInterval = std::chrono::milliseconds(50);
+
+	// Clients walk in circles this big, around a point of their own.
+	const float s_walkRadius = 50.0f;
+	const float s_worldSize = 2000.0f;
+
+	bool ParseNumber(const char* text, double& value)
+	{
+		char* end = nullptr;
+		value = std::strtod(text, &end);
+		return end != text && *end == '\0' && value >= 0.0;
+	}
+
+	double ToMilliseconds(Common::LatencyHistogram::Duration duration)
+	{
+		return duration.count() / 1000.0;
+	}
+
+	Common::TcpSessionConfig MakeSessionConfig(const LoadGen::LoadConfig& config,
+		const std::shared_ptr<Common::ReceiveBufferPool>& receivePool)
+	{
+		Common::TcpSessionConfig sessionConfig;
+		sessionConfig.receivePool = receivePool;
+		sessionConfig.pingInterval = config.pingInterval;
+		sessionConfig.wireFormat = config.wireFormat;
+		sessionConfig.readEngine = config.readEngine;
+		return sessionConfig;
+	}
+} // anon namespace
+
+//-------------------------------------------------------------------------------
+
+bool ParseArgs(int argc, char** argv, LoadConfig& config, std::string& error)
+{
+	for (int i = 1; i < argc; i += 2)
+	{
+		std::string name = argv[i];
+		if (i + 1 >= argc)
+		{
+			error = "Missing value for " + name;
+			return false;
+		}
+
+		const char* text = argv[i + 1];
+		if (name == "--host")
+		{
+			std::error_code ec;
+			asio::ip::make_address(text, ec);
+			if (ec)
+			{
+				error = "Not an IP address: " + std::string(text);
+				return false;
+			}
+			config.host = text;
+			continue;
+		}
+
+		if (name == "--wire-format")
+		{
+			if (!Common::ParseWireFormat(text, config.wireFormat))
+			{
+				error = "Unknown wire format: " + std::string(text);
+				return false;
+			}
+			continue;
+		}
+
+		if (name == "--read-engine")
+		{
+			if (!Common::ParseReadEngine(text, config.readEngine))
+			{
+				error = "Unknown read engine: " + std::string(text);
+				return false;
+			}
+			continue;
+		}
+
+		double value = 0.0;
+		if (!ParseNumber(text, value))
+		{
+			error = "Not a number: " + name + " " + text;
+			return false;
+		}
+
+		if (name == "--clients")
+		{
+			config.clientCount = static_cast<uint32_t>(value);
+		}
+		else if (name == "--threads")
+		{
+			config.threadCount = static_cast<uint32_t>(value);
+		}
+		else if (name == "--duration")
+		{
+			config.duration = std::chrono::seconds(static_cast<int64_t>(value));
+		}
+		else if (name == "--connect-rate")
+		{
+			config.connectRate = value;
+		}
+		else if (name == "--move-rate")
+		{
+			config.moveRate = value;
+		}
+		else if (name == "--attack-rate")
+		{
+			config.attackRate = value;
+		}
+		else if (name == "--ping-interval")
+		{
+			config.pingInterval = std::chrono::milliseconds(static_cast<int64_t>(value));
+		}
+		else if (name == "--port")
+		{
+			config.port = static_cast<uint16_t>(value);
+		}
+		else
+		{
+			error = "Unknown argument " + name;
+			return false;
+		}
+	}
+
+	if (config.connectRate <= 0.0)
+	{
+		error = "--connect-rate must be more than 0";
+		return false;
+	}
+	return true;
+}
+
+//-------------------------------------------------------------------------------
+
+void LoadStats::Merge(const LoadStats& other)
+{
+	connected += other.connected;
+	connectFailures += other.connectFailures;
+	disconnects += other.disconnects;
+	messagesSent += other.messagesSent;
+	bytesSent += other.bytesSent;
+	messagesReceived += other.messagesReceived;
+	bytesReceived += other.bytesReceived;
+	snapshotsReceived += other.snapshotsReceived;
+	readWakeups += other.readWakeups;
+	readCalls += other.readCalls;
+	framesRead += other.framesRead;
+	connectTime.Merge(other.connectTime);
+	roundTrip.Merge(other.roundTrip);
+	snapshotInterval.Merge(other.snapshotInterval);
+}
+
+std::string LoadReport::ToString() const
+{
+	double seconds = std::max(elapsed.count() / 1000.0, 0.001);
+
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(2);
+
+	auto writePercentiles = [&out](const char* name, const Common::LatencyHistogram& histogram)
+	{
+		out << name << " (ms, " << histogram.GetCount() << " samples):"
+			<< " p50 " << ToMilliseconds(histogram.GetPercentile(50.0))
+			<< " p95 " << ToMilliseconds(histogram.GetPercentile(95.0))
+			<< " p99 " << ToMilliseconds(histogram.GetPercentile(99.0))
+			<< " max " << ToMilliseconds(histogram.GetMax()) << "\n";
+	};
+
+	auto writeTraffic = [&out, seconds](const char* name, uint64_t messages, uint64_t bytes)
+	{
+		out << name << " " << messages << " messages, " << bytes / 1024.0 << " KB ("
+			<< messages / seconds << " msg/s, " << bytes / 1024.0 / seconds << " KB/s)\n";
+	};
+
+	out << "Ran " << clientsStarted << " of " << config.clientCount << " clients against "
+		<< config.host << ":" << config.port << " for " << seconds << "s\n";
+	out << "Connected " << stats.connected << ", failed to connect " << stats.connectFailures
+		<< ", disconnected by server " << stats.disconnects << "\n";
+	writePercentiles("Connect time", stats.connectTime);
+	writePercentiles("Round trip", stats.roundTrip);
+	writePercentiles("Snapshot interval", stats.snapshotInterval);
+	writeTraffic("Sent", stats.messagesSent, stats.bytesSent);
+	writeTraffic("Received", stats.messagesReceived, stats.bytesReceived);
+	out << "Snapshots received " << stats.snapshotsReceived << "\n";
+
+	double frames = static_cast<double>(std::max<uint64_t>(stats.framesRead, 1));
+	out << "Reads: " << stats.readWakeups << " wakeups, " << stats.readCalls << " read calls ("
+		<< stats.readWakeups / frames << " wakeups, " << stats.readCalls / frames
+		<< " read calls per frame received)\n";
+	out << "Receive buffers: peak " << receivePool.peakBytesInUse / 1024.0 << " KB in use, "
+		<< receivePool.bytesReserved / 1024.0 << " KB reserved ("
+		<< static_cast<double>(receivePool.peakBytesInUse) / std::max(stats.connected, 1u)
+		<< " bytes per client at peak)\n";
+	return out.str();
+}
+
+//-------------------------------------------------------------------------------
+
+// One fake player. Everything it does happens on the thread running its io_context, which is
+// also the one its session runs on, so none of it needs locking.
+class LoadGenerator::SimulatedClient : public std::enable_shared_from_this<SimulatedClient> {
+
+public:
+	SimulatedClient(asio::io_context& ioc, const tcp::endpoint& endpoint, uint32_t clientId,
+		const LoadConfig& config, const std::shared_ptr<Common::ReceiveBufferPool>& receivePool)
+		: m_ioc(ioc)
+		, m_connector(std::make_shared<Common::TcpSessionConnector>(ioc, endpoint,
+			"LoadClient-" + std::to_string(clientId), MakeSessionConfig(config, receivePool)))
+		, m_stepTimer(ioc)
+		, m_clientId(clientId)
+		, m_clientCount(config.clientCount)
+		, m_moveRate(config.moveRate)
+		, m_attackRate(config.attackRate)
+		, m_random(clientId)
+	{
+		// A refused connection is something to report, not wait out.
+		m_connector->SetRetryOnRefused(false);
+	}
+
+	asio::io_context& GetIoContext() { return m_ioc; }
+
+	// Only read once the client's stopped.
+	const LoadStats& GetStats() const { return m_stats; }
+
+	void Start()
+	{
+		std::uniform_real_distribution<float> position(0.0f, s_worldSize);
+		m_centerX = position(m_random);
+		m_centerY = position(m_random);
+
+		std::weak_ptr<SimulatedClient> weakThis = weak_from_this();
+		m_connector->SetConnectedHandler(
+			[weakThis](const std::shared_ptr<Common::TcpSession>& session)
+			{
+				if (auto client = weakThis.lock())
+				{
+					client->OnConnected(session);
+				}
+			});
+		m_connector->SetErrorHandler([weakThis](const std::error_code&)
+			{
+				if (auto client = weakThis.lock())
+				{
+					++client->m_stats.connectFailures;
+				}
+			});
+
+		m_connectStartedAt = Clock::now();
+		m_connector->Connect();
+	}
+
+	void Stop()
+	{
+		m_isStopping = true;
+		m_stepTimer.cancel();
+		if (m_session)
+		{
+			m_stats.roundTrip = m_session->GetRttHistogram();
+
+			Common::TcpSessionStats sessionStats = m_session->GetStats();
+			m_stats.readWakeups = sessionStats.readWakeups;
+			m_stats.readCalls = sessionStats.readCalls;
+			m_stats.framesRead = sessionStats.messagesRead;
+			m_session->Stop();
+		}
+	}
+
+private:
+	void OnConnected(const std::shared_ptr<Common::TcpSession>& session)
+	{
+		m_session = session;
+		if (m_isStopping)
+		{
+			// The connector starts the session after this returns.
+			asio::post(m_ioc, [session]() { session->Stop(); });
+			return;
+		}
+
+		++m_stats.connected;
+		m_stats.connectTime.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+			Clock::now() - m_connectStartedAt));
+
+		std::weak_ptr<SimulatedClient> weakThis = weak_from_this();
+		m_session->SetMessageBatchHandler([weakThis](std::shared_ptr<Common::MessageBatch> batch)
+			{
+				if (auto client = weakThis.lock())
+				{
+					client->OnMessageBatch(*batch);
+				}
+			});
+
+		// Spread the clients' steps out so they don't all send at once.
+		std::uniform_int_distribution<Clock::rep> offset(0, s_stepInterval.count() - 1);
+		ScheduleStep(Clock::duration(offset(m_random)));
+	}
+
+	void OnMessageBatch(const Common::MessageBatch& batch)
+	{
+		if (m_isStopping)
+		{
+			return;
+		}
+
+		for (size_t i = 0; i < batch.Size(); ++i)
+		{
+			Common::NetworkMessageView message = batch[i];
+			++m_stats.messagesReceived;
+			m_stats.bytesReceived += sizeof(message.header) + message.messageData.size();
+
+			// The UDP handshake is ignored, everything stays on TCP.
+			if (message.header.messageType == Common::MessageId::Snapshot)
+			{
+				OnSnapshot(message.messageData, batch.GetReceivedAt());
+			}
+		}
+	}
+
+	// Acks every snapshot straight away, as a client that keeps up would.
+	void OnSnapshot(std::string_view payload, Clock::time_point receivedAt)
+	{
+		++m_stats.snapshotsReceived;
+		if (m_hasSnapshot)
+		{
+			m_stats.snapshotInterval.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+				receivedAt - m_lastSnapshotAt));
+		}
+		m_hasSnapshot = true;
+		m_lastSnapshotAt = receivedAt;
+
+		Common::SnapshotHeader header;
+		if (payload.size() < sizeof(header))
+		{
+			return;
+		}
+		std::memcpy(&header, payload.data(), sizeof(header));
+
+		Common::SnapshotAck ack;
+		ack.sequence = header.sequence;
+		Send(Common::PackageMessage(Common::MessageId::SnapshotAck,
+			std::string_view(reinterpret_cast<const char*>(&ack), sizeof(ack))));
+	}
+
+	void ScheduleStep(Clock::duration delay)
+	{
+		m_stepTimer.expires_after(delay);
+		m_stepTimer.async_wait(std::bind(&SimulatedClient::OnStep, shared_from_this(),
+			std::placeholders::_1));
+	}
+
+	void OnStep(const std::error_code& ec)
+	{
+		if (ec || m_isStopping)
+		{
+			return;
+		}
+
+		if (m_session->IsStopped())
+		{
+			++m_stats.disconnects;
+			return;
+		}
+
+		// Rates that don't divide into steps carry over, so they come out right on average.
+		double stepSeconds = std::chrono::duration<double>(s_stepInterval).count();
+		m_movesDue += m_moveRate * stepSeconds;
+		m_attacksDue += m_attackRate * stepSeconds;
+		for (; m_movesDue >= 1.0; m_movesDue -= 1.0)
+		{
+			SendMove();
+		}
+		for (; m_attacksDue >= 1.0; m_attacksDue -= 1.0)
+		{
+			SendAttack();
+		}
+
+		ScheduleStep(s_stepInterval);
+	}
+
+	// Payload is the entity id, which lets the server coalesce them, then the new position.
+	void SendMove()
+	{
+		m_angle += 0.1f;
+		float position[2] = { m_centerX + s_walkRadius * std::cos(m_angle),
+			m_centerY + s_walkRadius * std::sin(m_angle) };
+
+		std::string payload(reinterpret_cast<const char*>(&m_clientId), sizeof(m_clientId));
+		payload.append(reinterpret_cast<const char*>(position), sizeof(position));
+		Send(Common::PackageMessage(Common::MessageId::Move, payload));
+	}
+
+	// Payload is the attacker's id then the target's, some other client picked at random.
+	void SendAttack()
+	{
+		std::uniform_int_distribution<uint32_t> target(1, std::max(m_clientCount, 1u));
+		uint32_t ids[2] = { m_clientId, target(m_random) };
+		Send(Common::PackageMessage(Common::MessageId::Attack,
+			std::string_view(reinterpret_cast<const char*>(ids), sizeof(ids))));
+	}
+
+	void Send(std::string message)
+	{
+		++m_stats.messagesSent;
+		m_stats.bytesSent += message.size();
+		m_session->Write(std::move(message));
+	}
+
+	asio::io_context& m_ioc;
+	std::shared_ptr<Common::TcpSessionConnector> m_connector;
+	std::shared_ptr<Common::TcpSession> m_session;
+	asio::steady_timer m_stepTimer;
+
+	uint32_t m_clientId;
+	uint32_t m_clientCount;
+	double m_moveRate;
+	double m_attackRate;
+	double m_movesDue = 0.0;
+	double m_attacksDue = 0.0;
+
+	float m_centerX = 0.0f;
+	float m_centerY = 0.0f;
+	float m_angle = 0.0f;
+
+	Clock::time_point m_connectStartedAt;
+	Clock::time_point m_lastSnapshotAt;
+	bool m_hasSnapshot = false;
+	bool m_isStopping = false;
+
+	std::mt19937 m_random;
+	LoadStats m_stats;
+};
+
+//-------------------------------------------------------------------------------
+
+LoadGenerator::LoadGenerator(const LoadConfig& config)
+	: m_config(config)
+	, m_asioEventProcessor(std::make_unique<Common::AsioEventProcessor>(config.threadCount))
+	, m_receivePool(std::make_shared<Common::ReceiveBufferPool>())
+{
+}
+
+LoadGenerator::~LoadGenerator()
+{
+}
+
+LoadReport LoadGenerator::Run()
+{
+	tcp::endpoint endpoint(asio::ip::make_address(m_config.host), m_config.port);
+	m_asioEventProcessor->Run();
+
+	Clock::time_point startedAt = Clock::now();
+	Clock::time_point endAt = startedAt + m_config.duration;
+
+	m_clients.reserve(m_config.clientCount);
+	for (uint32_t i = 0; i < m_config.clientCount; ++i)
+	{
+		asio::io_context& ioc = m_asioEventProcessor->GetNextIoService();
+		auto client = std::make_shared<SimulatedClient>(ioc, endpoint, i + 1, m_config,
+			m_receivePool);
+		m_clients.push_back(client);
+		asio::post(ioc, [client]() { client->Start(); });
+
+		Clock::time_point nextAt = startedAt + std::chrono::duration_cast<Clock::duration>(
+			std::chrono::duration<double>((i + 1) / m_config.connectRate));
+		if (nextAt >= endAt)
+		{
+			break;
+		}
+		std::this_thread::sleep_until(nextAt);
+	}
+
+	std::this_thread::sleep_until(endAt);
+	StopClients();
+
+	LoadReport report;
+	report.config = m_config;
+	report.clientsStarted = static_cast<uint32_t>(m_clients.size());
+	report.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+		Clock::now() - startedAt);
+	for (const auto& client : m_clients)
+	{
+		report.stats.Merge(client->GetStats());
+	}
+	report.receivePool = m_receivePool->GetStats();
+	return report;
+}
+
+void LoadGenerator::StopClients()
+{
+	std::mutex mutex;
+	std::condition_variable stopped;
+	size_t remaining = m_clients.size();
+
+	for (const auto& client : m_clients)
+	{
+		asio::post(client->GetIoContext(), [&, client]()
+			{
+				client->Stop();
+
+				std::lock_guard<std::mutex> lock(mutex);
+				if (--remaining == 0)
+				{
+					stopped.notify_one();
+				}
+			});
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	stopped.wait(lock, [&remaining]() { return remaining == 0; });
+}
+
+//===============================================================================
+
+} // namespace LoadGen
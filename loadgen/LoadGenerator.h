@@ -0,0 +1,144 @@
+//---------------------------------------------------------------
+//
+// LoadGenerator.h
+//
+
+#pragma once
+
+#include "common/LatencyHistogram.h"
+#include "common/ReceiveBufferPool.h"
+#include "common/WireFormat.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Common {
+class AsioEventProcessor;
+enum class ReadEngine : uint32_t;
+}
+
+namespace LoadGen {
+
+//===============================================================================
+
+struct LoadConfig
+{
+	std::string host = "127.0.0.1";
+	uint16_t port = 26000;
+
+	uint32_t clientCount = 1000;
+
+	// Threads the clients are spread across. 0 means one per core.
+	uint32_t threadCount = 0;
+
+	// How long to run for, ramp up included.
+	std::chrono::seconds duration = std::chrono::seconds(30);
+
+	// New connections opened per second while ramping up.
+	double connectRate = 500.0;
+
+	// Messages each client sends per second.
+	double moveRate = 10.0;
+	double attackRate = 1.0;
+
+	// How often each client pings the server.
+	std::chrono::milliseconds pingInterval = std::chrono::seconds(1);
+
+	// Has to match the server's.
+	Common::WireFormat wireFormat = Common::WireFormat::Legacy;
+
+	// How the clients' sockets are read. Value initialized, it's ReadEngine::Async.
+	Common::ReadEngine readEngine{};
+};
+
+// Reads --clients, --threads, --duration (seconds), --connect-rate, --move-rate, --attack-rate,
+// --ping-interval (milliseconds), --wire-format (legacy or compact), --read-engine (async or
+// drain), --host and --port.
+// Returns false and says why in error if an argument isn't understood.
+bool ParseArgs(int argc, char** argv, LoadConfig& config, std::string& error);
+
+// What one client, or all of them merged, saw.
+struct LoadStats
+{
+	uint32_t connected = 0;
+	uint32_t connectFailures = 0;
+
+	// Sessions the server closed before the run was over.
+	uint32_t disconnects = 0;
+
+	uint64_t messagesSent = 0;
+	uint64_t bytesSent = 0;
+	uint64_t messagesReceived = 0;
+	uint64_t bytesReceived = 0;
+	uint64_t snapshotsReceived = 0;
+
+	// From the sessions' own counters. See TcpSessionStats.
+	uint64_t readWakeups = 0;
+	uint64_t readCalls = 0;
+	uint64_t framesRead = 0;
+
+	// From starting to connect to the session being up.
+	Common::LatencyHistogram connectTime;
+
+	// Round trips measured by pinging the server.
+	Common::LatencyHistogram roundTrip;
+
+	// Time between consecutive snapshots. The server sends one a tick, so anything over the tick
+	// interval is how late they were.
+	Common::LatencyHistogram snapshotInterval;
+
+	void Merge(const LoadStats& other);
+};
+
+struct LoadReport
+{
+	LoadConfig config;
+
+	// Fewer than asked for if ramping up took the whole run.
+	uint32_t clientsStarted = 0;
+
+	LoadStats stats;
+	std::chrono::milliseconds elapsed = std::chrono::milliseconds::zero();
+
+	// The receive buffers every client borrowed from.
+	Common::ReceiveBufferPoolStats receivePool;
+
+	std::string ToString() const;
+};
+
+// Opens clientCount loopback connections to a running server, ramping up at connectRate, and
+// has each send Move and Attack messages at a steady rate and ack every snapshot it's sent, the
+// way a real client would. Nothing is rendered or simulated, so one process can stand in for
+// thousands of players.
+//
+// Each connection uses a socket and an ephemeral port. Raise the open file limit before asking
+// for more than a thousand or so clients.
+class LoadGenerator
+{
+public:
+	explicit LoadGenerator(const LoadConfig& config);
+	~LoadGenerator();
+
+	// Blocks until the run is over, then closes every connection.
+	LoadReport Run();
+
+private:
+	class SimulatedClient;
+
+	// Stops every client on its own thread and waits for them all.
+	void StopClients();
+
+	LoadConfig m_config;
+
+	// Declared before the clients so it outlives them.
+	std::unique_ptr<Common::AsioEventProcessor> m_asioEventProcessor;
+	std::shared_ptr<Common::ReceiveBufferPool> m_receivePool;
+	std::vector<std::shared_ptr<SimulatedClient>> m_clients;
+};
+
+//===============================================================================
+
+} // namespace LoadGen
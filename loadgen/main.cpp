@@ -0,0 +1,49 @@
+//---------------------------------------------------------------
+//
+// main.cpp
+//
+
+#include "common/Log.h"
+#include "loadgen/LoadGenerator.h"
+
+#include <filesystem>
+#include <iostream>
+
+namespace {
+	const char* s_usage =
+		"Usage: LoadGenerator [--clients n] [--threads n] [--duration seconds]\n"
+		"                     [--connect-rate per second] [--move-rate per second]\n"
+		"                     [--attack-rate per second] [--ping-interval ms]\n"
+		"                     [--wire-format legacy|compact] [--read-engine async|drain]\n"
+		"                     [--host ip] [--port n]\n";
+}
+
+int main(int argc, char** argv)
+{
+	//init directories.
+	if (!std::filesystem::is_regular_file(Log::GetLogFile()))
+	{
+		// create log file if it doesn't exist
+		std::filesystem::create_directory("../logs/");
+		std::ofstream(Log::GetLogFile().c_str());
+	}
+
+	LoadGen::LoadConfig config;
+	std::string error;
+	if (!LoadGen::ParseArgs(argc, argv, config, error))
+	{
+		std::cerr << error << "\n" << s_usage;
+		return 1;
+	}
+
+	// Every session says hello on the console otherwise, which drowns out the report.
+	spdlog::default_logger()->set_level(spdlog::level::warn);
+
+	std::cout << "Running " << config.clientCount << " clients for " << config.duration.count()
+		<< "s...\n";
+
+	LoadGen::LoadGenerator generator(config);
+	LoadGen::LoadReport report = generator.Run();
+	std::cout << report.ToString();
+	return report.stats.connected > 0 ? 0 : 1;
+}
@@ -5,12 +5,19 @@
 
 #include "server/Game.h"
 
+#include "common/GameState.h"
+#include "common/InterestGrid.h"
 #include "common/Log.h"
+#include "common/MessageDispatcher.h"
+#include "common/NetworkTypes.h"
+#include "common/Snapshot.h"
+#include "common/TickScheduler.h"
 #include "server/ClientSessionEvents.h"
 #include "server/GameClient.h"
 #include "server/GameServer.h"
 
 #include <assert.h>
+#include <cstring>
 #include <thread>
 
 namespace Server {
@@ -22,10 +29,18 @@ namespace {
 std::shared_ptr<spdlog::logger> s_logger;
 const std::thread::id s_mainThreadId = std::this_thread::get_id();
 
+// About the radius clients see, so an interest query only covers a few cells.
+const float s_interestCellSize = 200.0f;
+
 } // anon namespace
 
-Game::Game()
-	: m_server(std::make_unique<GameServer>(this))
+Game::Game(const GameOptions& options)
+	: m_messageDispatcher(std::make_unique<Common::MessageDispatcher>())
+	, m_gameState(std::make_unique<Common::GameState>())
+	, m_interestGrid(std::make_unique<Common::InterestGrid>(s_interestCellSize))
+	, m_snapshotBytesPerTick(options.snapshotBytesPerTick)
+	, m_tickScheduler(std::make_unique<Common::TickScheduler>(options.tickRate))
+	, m_server(std::make_unique<GameServer>(this, options.ioThreadCount))
 {
 	auto& events = m_server->GetEvents();
 	events.GetSessionCreatedEvent().subscribe(
@@ -34,11 +49,40 @@ Game::Game()
 			assert(std::this_thread::get_id() == s_mainThreadId);
 			SPDLOG_LOGGER_INFO(s_logger, "OnSessionCreatedEvent clientId= {}", clientId);
 
-			m_clients.emplace_back(std::make_unique<GameClient>(this, clientId));
+			m_clients[clientId] = std::make_unique<GameClient>(this, clientId);
+			SetClientSnapshotBudget(clientId, m_snapshotBytesPerTick);
+		});
+	events.GetSessionDestroyedEvent().subscribe(
+		[this](uint32_t clientId)
+		{
+			assert(std::this_thread::get_id() == s_mainThreadId);
+			SPDLOG_LOGGER_INFO(s_logger, "OnSessionDestroyedEvent clientId= {}", clientId);
+
+			m_clients.erase(clientId);
+		});
+
+	m_messageDispatcher->RegisterRawHandler(Common::MessageId::SnapshotAck,
+		[this](uint32_t clientId, const std::string_view& payload)
+		{
+			Common::SnapshotAck ack;
+			GameClient* client = FindClient(clientId);
+			if (client && payload.size() == sizeof(ack))
+			{
+				std::memcpy(&ack, payload.data(), sizeof(ack));
+				client->OnSnapshotAck(ack.sequence);
+			}
 		});
 
 	REGISTER_LOGGER("Server::Game");
 	s_logger = Log::Logger("Server::Game");
+	if (!options.capturePath.empty())
+	{
+		m_server->StartCapture(options.capturePath);
+	}
+	m_server->SetWireFormat(options.wireFormat);
+	m_server->SetCompression(options.compressionThreshold, options.streamCompression);
+	m_server->SetReadEngine(options.readEngine);
+	m_server->SetReusePort(options.reusePort);
 	m_server->Start();
 }
 
@@ -48,39 +92,68 @@ Game::~Game()
 
 void Game::Run()
 {
-	while (m_isRunning)
-	{
-		ProcessCallbackQueue();
-		for (auto& c : m_clients)
+	m_tickScheduler->Run(
+		[this]() { ProcessCallbackQueue(); },
+		[this]() { Tick(); },
+		[](const Common::TickSchedulerStats& stats)
 		{
-			c->Process();
-		}
-	}
+			SPDLOG_LOGGER_WARN(s_logger, "Tick exceeded its budget. time={}us budget={}us overruns={}",
+				stats.lastTickTime.count(), stats.tickInterval.count(), stats.overruns);
+		});
 }
 
 void Game::PostToMainThread(const std::function<void()>& cb)
 {
 	m_callbackQueue.Push(cb);
+	m_tickScheduler->Notify();
 }
 
-void Game::ProcessCallbackQueue()
+void Game::Tick()
 {
-	m_callbackQueue.SwapWithEmpty(m_processCbQueue);
+	ProcessCallbackQueue();
 
-	for (auto cb : m_processCbQueue)
+	// Built once for every client to query.
+	m_interestGrid->Rebuild(*m_gameState);
+	for (auto& c : m_clients)
 	{
-		if (cb)
-		{
-			cb();
-		}
+		c.second->Process();
 	}
 
-	if (!m_processCbQueue.empty())
+	m_server->Update();
+}
+
+void Game::SetClientSnapshotBudget(uint32_t clientId, uint32_t bytesPerTick)
+{
+	if (GameClient* client = FindClient(clientId))
 	{
-		std::deque<std::function<void()>>().swap(m_processCbQueue);
+		Common::PriorityConfig config = client->GetPriorityAccumulator().GetConfig();
+		config.bytesPerTick = bytesPerTick;
+		client->SetPriorityConfig(config);
 	}
 }
 
+GameClient* Game::FindClient(uint32_t clientId)
+{
+	auto it = m_clients.find(clientId);
+	return it != m_clients.end() ? it->second.get() : nullptr;
+}
+
+void Game::ProcessCallbackQueue()
+{
+	// Everything posted so far is taken in one go. Callbacks posted while these run wait for
+	// the next call.
+	m_callbackQueue.ConsumeAll([](std::function<void()>& cb)
+		{
+			if (cb)
+			{
+				cb();
+			}
+		});
+
+	// Messages dispatched by those callbacks have all been handled now.
+	m_messageDispatcher->EndTick();
+}
+
 //===============================================================================
 
 } // namespace Server
@@ -5,11 +5,21 @@
 
 #pragma once
 
-#include "common/ThreadSafeQueue.h"
+#include "common/MpscQueue.h"
+#include "common/WireFormat.h"
 
-#include <deque>
 #include <functional>
 #include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace Common {
+class GameState;
+class InterestGrid;
+class MessageDispatcher;
+class TickScheduler;
+enum class ReadEngine : uint32_t;
+}
 
 namespace Server {
 
@@ -17,9 +27,42 @@ namespace Server {
 class GameClient;
 class GameServer;
 class NetworkController;
+
+struct GameOptions
+{
+	// Ticks per second, usually 20, 30 or 60. Posted work is still handled as soon as it
+	// arrives between ticks.
+	uint32_t tickRate = 30;
+
+	// Bytes of snapshot each client is sent per tick, until SetClientSnapshotBudget says
+	// otherwise. See PriorityConfig::bytesPerTick.
+	uint32_t snapshotBytesPerTick = 1024;
+
+	// Everything clients send is recorded here, unless it's empty.
+	std::string capturePath;
+
+	// How frames are laid out on client connections.
+	Common::WireFormat wireFormat = Common::WireFormat::Legacy;
+
+	// Compact only. What's sent to clients is compressed from this many bytes up. 0 never
+	// compresses.
+	uint32_t compressionThreshold = 0;
+	bool streamCompression = false;
+
+	// How client sockets are read. Value initialized, it's ReadEngine::Async.
+	Common::ReadEngine readEngine{};
+
+	// Number of io threads client sessions are spread across. 0 means one per hardware core.
+	uint32_t ioThreadCount = 0;
+
+	// An acceptor per io thread instead of one, so a storm of reconnects doesn't overflow the
+	// accept queue.
+	bool reusePort = false;
+};
+
 class Game {
 public:
-	Game();
+	explicit Game(const GameOptions& options = GameOptions());
 	~Game();
 
 	void Run();
@@ -27,17 +70,44 @@ public:
 
 	GameServer* GetGameServer() { return m_server.get(); }
 
+	// The world as it's replicated to clients. Only touch it from the main thread.
+	Common::GameState& GetGameState() { return *m_gameState; }
+
+	// Where every entity in the game state is, as of the start of this tick.
+	const Common::InterestGrid& GetInterestGrid() const { return *m_interestGrid; }
+
+	// Register handlers for client messages here. Messages are dispatched on the main thread.
+	Common::MessageDispatcher& GetMessageDispatcher() { return *m_messageDispatcher; }
+
+	// Changes how many bytes of snapshot one client is sent per tick, e.g. to match what its
+	// connection can take. Does nothing if there's no such client. Main thread only.
+	void SetClientSnapshotBudget(uint32_t clientId, uint32_t bytesPerTick);
+
 private:
 	void ProcessCallbackQueue();
+	void Tick();
 
-	std::unique_ptr<GameServer> m_server;
-	std::vector<std::unique_ptr<GameClient>> m_clients;
+	GameClient* FindClient(uint32_t clientId);
 
-	Common::ThreadSafeQueue<std::function<void()>> m_callbackQueue;
-	std::deque<std::function<void()>> m_processCbQueue;
+	std::unique_ptr<Common::MessageDispatcher> m_messageDispatcher;
+	std::unique_ptr<Common::GameState> m_gameState;
+	std::unique_ptr<Common::InterestGrid> m_interestGrid;
+
+	// What each new client's snapshot budget starts out as.
+	uint32_t m_snapshotBytesPerTick;
+
+	// Drives Run. Stopping it will shut the server down. Outlives m_server since io threads
+	// notify it when they post work.
+	std::unique_ptr<Common::TickScheduler> m_tickScheduler;
+
+	// Functions that need to get processed on the main thread get pushed here. Outlives
+	// m_server, since its io threads push to it until they're stopped.
+	Common::MpscQueue<std::function<void()>> m_callbackQueue;
+
+	std::unique_ptr<GameServer> m_server;
 
-	// Turning this off will shut the server down.
-	bool m_isRunning = true;
+	// Connected clients, keyed by client id. Each is removed when its session is destroyed.
+	std::unordered_map<uint32_t, std::unique_ptr<GameClient>> m_clients;
 };
 
 //===============================================================================
@@ -5,6 +5,8 @@
 
 #include "server/GameClient.h"
 
+#include "common/NetworkTypes.h"
+#include "common/Snapshot.h"
 #include "server/Game.h"
 #include "server/GameServer.h"
 
@@ -15,6 +17,7 @@ namespace Server {
 GameClient::GameClient(Game* game, uint32_t clientId)
 	: m_game(game)
 	, m_clientId(clientId)
+	, m_snapshotEncoder(std::make_unique<Common::SnapshotEncoder>())
 {
 }
 
@@ -25,7 +28,28 @@ GameClient::~GameClient()
 
 void GameClient::Process()
 {
-	// NYI
+	SendSnapshot();
+}
+
+void GameClient::OnSnapshotAck(uint32_t sequence)
+{
+	m_snapshotEncoder->OnAck(sequence);
+}
+
+void GameClient::SendSnapshot()
+{
+	m_interestSet.Update(m_game->GetInterestGrid(), m_interestArea);
+	m_interestSet.Filter(m_game->GetGameState(), m_visibleState);
+
+	m_priorityAccumulator.SetViewpoint(m_interestArea.x, m_interestArea.y);
+	std::string payload = m_snapshotEncoder->Encode(m_visibleState,
+		m_priorityAccumulator.GetConfig().bytesPerTick,
+		[this](std::vector<Common::SnapshotChange>& changes, uint32_t budget)
+		{
+			m_priorityAccumulator.Select(changes, budget);
+		});
+	m_game->GetGameServer()->PostMessageToClient(m_clientId,
+		Common::PackageMessage(Common::MessageId::Snapshot, payload));
 }
 
 //===============================================================================
@@ -5,7 +5,15 @@
 
 #pragma once
 
+#include "common/InterestGrid.h"
+#include "common/PriorityAccumulator.h"
+
 #include <cstdint>
+#include <memory>
+
+namespace Common {
+class SnapshotEncoder;
+}
 
 namespace Server {
 
@@ -20,9 +28,40 @@ public:
 	// This will process every system needed for game simulation on this client. 
 	void Process();
 
+	// The client has the snapshot with this sequence, so later ones can be deltas from it.
+	void OnSnapshotAck(uint32_t sequence);
+
+	uint32_t GetClientId() const { return m_clientId; }
+
+	// Only entities in this area are sent to the client. Move it along with whatever the client
+	// is looking at.
+	void SetInterestArea(const Common::InterestArea& area) { m_interestArea = area; }
+	const Common::InterestArea& GetInterestArea() const { return m_interestArea; }
+
+	// What the client could see as of the last snapshot sent.
+	const Common::InterestSet& GetInterestSet() const { return m_interestSet; }
+
+	// The client's bandwidth budget, and how updates are prioritised when they don't all fit.
+	void SetPriorityConfig(const Common::PriorityConfig& config) { m_priorityAccumulator.SetConfig(config); }
+	const Common::PriorityAccumulator& GetPriorityAccumulator() const { return m_priorityAccumulator; }
+
 private:
+	// Sends the client whatever in its interest area has changed since its last acked snapshot,
+	// or as much of it as the budget allows. Entities that leave the area are removed from the
+	// client's state like ones that leave the world.
+	void SendSnapshot();
+
 	Game* m_game;
 	uint32_t m_clientId = 0;
+
+	std::unique_ptr<Common::SnapshotEncoder> m_snapshotEncoder;
+
+	Common::InterestArea m_interestArea;
+	Common::InterestSet m_interestSet;
+	Common::PriorityAccumulator m_priorityAccumulator;
+
+	// What the interest set lets through of the game state, refilled before each snapshot.
+	Common::GameState m_visibleState;
 };
 
 //===============================================================================
@@ -6,19 +6,27 @@
 #include "GameServer.h"
 #include "common/AsioEventProcessor.h"
 #include "common/Log.h"
+#include "common/MessageDispatcher.h"
+#include "common/NetworkCapture.h"
 #include "common/NetworkMessageParser.h"
 #include "common/NetworkTypes.h"
+#include "common/SlotMap.h"
+#include "common/TcpListener.h"
 #include "common/TcpSession.h"
+#include "common/TransportRouting.h"
+#include "common/UdpChannel.h"
 #include "server/ClientSessionEvents.h"
 #include "server/Game.h"
 
 #include <asio.hpp>
 #include <functional>
 #include <memory>
-#include <set>
+#include <mutex>
+#include <random>
 #include <system_error>
 
 using tcp = asio::ip::tcp;
+using udp = asio::ip::udp;
 
 namespace Server {
 
@@ -30,8 +38,41 @@ const char* s_localIp = "127.0.0.1";
 const uint16_t s_port = 26000;
 const std::thread::id s_mainThreadId = std::this_thread::get_id();
 
+// Most clients that can be connected at once.
+const uint32_t s_maxSessions = 4096;
+
+// Clients that stop reading get cut off rather than have the server buffer for them, and no
+// client message should come anywhere near the frame limit.
+Common::TcpSessionConfig MakeSessionConfig()
+{
+	Common::TcpSessionConfig config;
+	config.maxQueuedBytes = 1024 * 1024;
+	config.overflowPolicy = Common::OverflowPolicy::Disconnect;
+	config.maxInboundFrameSize = 64 * 1024;
+	config.pingInterval = std::chrono::seconds(1);
+
+	// Most clients are idle between ticks, so they shouldn't each sit on a receive buffer.
+	config.receivePool = std::make_shared<Common::ReceiveBufferPool>();
+
+	// A client that falls behind only needs the latest of each entity's updates.
+	static const std::shared_ptr<const Common::MessageCoalescing> s_coalescing =
+		std::make_shared<Common::MessageCoalescing>();
+	config.coalescing = s_coalescing;
+	return config;
+}
+
+// Sessions are numbered in captures rather than by client id, since client ids are reused.
+Common::TcpSessionConfig ForSession(Common::TcpSessionConfig config, uint32_t sessionNumber)
+{
+	config.captureSessionId = sessionNumber;
+	return config;
+}
+
 std::shared_ptr<spdlog::logger> s_logger;
 
+// Client ids are reused, so session logger names are numbered separately to stay unique.
+std::atomic<uint32_t> s_sessionCount{ 0 };
+
 } // anon namespace
 
 //-------------------------------------------------------------------------------
@@ -39,10 +80,8 @@ std::shared_ptr<spdlog::logger> s_logger;
 class ClientTcpSession : public std::enable_shared_from_this<ClientTcpSession> {
 
 public:
-	ClientTcpSession(tcp::socket socket, uint32_t id)
-		: m_session(std::make_shared<Common::TcpSession>(std::move(socket),
-			"ServerClient-" + std::to_string(id)))
-		, m_clientId(id)
+	ClientTcpSession(tcp::socket socket, const Common::TcpSessionConfig& config)
+		: ClientTcpSession(std::move(socket), config, s_sessionCount++)
 	{
 	}
 
@@ -53,13 +92,25 @@ public:
 	}
 
 	uint32_t GetClientId() { return m_clientId; }
+	void SetClientId(uint32_t clientId) { m_clientId = clientId; }
 	std::shared_ptr<Common::TcpSession> GetSession() { return m_session; }
 
 	// The current TcpSession for this client id.
 	std::shared_ptr<Common::TcpSession> m_session;
 
+	// Routes this client's messages instead of the server's table, if it's set. Game thread only.
+	std::shared_ptr<const Common::TransportRouting> m_transportRouting;
+
 	// Identifier for the client.
 	uint32_t m_clientId = 0;
+
+private:
+	ClientTcpSession(tcp::socket socket, const Common::TcpSessionConfig& config,
+		uint32_t sessionNumber)
+		: m_session(std::make_shared<Common::TcpSession>(std::move(socket),
+			"ServerClient-" + std::to_string(sessionNumber), ForSession(config, sessionNumber)))
+	{
+	}
 };
 
 //-------------------------------------------------------------------------------
@@ -68,7 +119,9 @@ class ClientSessionManager
 {
 public:
 	ClientSessionManager(GameServer* server)
-	: m_server(server)
+	: m_sessions(s_maxSessions)
+	, m_tokenGenerator(std::random_device()())
+	, m_server(server)
 	{
 	}
 
@@ -76,48 +129,93 @@ public:
 
 	void CreateSession(tcp::socket socket)
 	{
-		uint32_t clientId = m_nextId++;
-		auto newSession = std::make_shared<ClientTcpSession>(std::move(socket), clientId);
-		newSession->GetSession()->Start();
-		m_sessions.insert(newSession);
+		// The client id is the session's slot in m_sessions, so it's only known once it's added.
+		auto newSession = std::make_shared<ClientTcpSession>(std::move(socket),
+			*m_server->m_sessionConfig);
+		uint32_t clientId = m_sessions.Add(newSession);
+		if (clientId == SessionMap::s_invalidId)
+		{
+			SPDLOG_LOGGER_ERROR(s_logger, "Too many sessions, dropping connection. max={}",
+				m_sessions.Capacity());
+			return;
+		}
+
+		newSession->SetClientId(clientId);
+		++m_server->m_currentConnectionCount;
+
+		// Batches are handed to the game thread as a whole and dispatched there.
+		std::shared_ptr<Common::TcpSession> tcpSession = newSession->GetSession();
+		Game* game = m_server->m_game;
+		tcpSession->SetMessageBatchHandler(
+			[game, clientId](std::shared_ptr<Common::MessageBatch> batch)
+			{
+				game->PostToMainThread([game, clientId, batch]()
+					{
+						game->GetMessageDispatcher().Dispatch(clientId, *batch);
+					});
+			});
 
-		m_server->m_game->PostToMainThread([this, clientId]()
+		// However the session ends, its slot is given back on the game thread.
+		tcpSession->SetStoppedHandler([this, game, clientId]()
+			{
+				game->PostToMainThread([this, clientId]() { DestroySession(clientId); });
+			});
+
+		// The session may stop as soon as it starts, so the game and the UDP channel hear about
+		// it before it does. Otherwise they could be told it's gone before it was created. The
+		// channel hears first, so it knows the peer by the time the game sends it anything and
+		// can hold reliable messages until its hello.
+		StartUdpHandshake(clientId, tcpSession);
+		game->PostToMainThread([this, clientId]()
 		{
 			m_server->GetEvents().GetSessionCreatedEvent().notify(clientId);
 		});
+
+		// Only touch the session from the io thread that owns its socket.
+		tcpSession->Post([tcpSession]() { tcpSession->Start(); });
 	}
 
+	// Stops the session and frees its slot. Does nothing if it's already gone, since a session
+	// that stops on its own ends up here too. Only call from the game thread.
 	void DestroySession(uint32_t clientId)
 	{
-		auto session = GetSessionById(clientId);
-		if (session)
+		ClientTcpSession* session = m_sessions.Find(clientId);
+		if (!session)
 		{
-			session->GetSession()->Stop();
+			return;
 		}
-	}
 
-	void DestroyAllSessions()
-	{
-		for (auto session : m_sessions)
+		StopSession(session->GetSession());
+		if (auto udpChannel = m_server->m_udpChannel)
 		{
-			if (session)
-			{
-				session->GetSession()->Stop();
-			}
+			udpChannel->Post([udpChannel, clientId]() { udpChannel->RemovePeer(clientId); });
 		}
+		m_sessions.Remove(clientId);
+		--m_server->m_currentConnectionCount;
+
+		m_server->GetEvents().GetSessionDestroyedEvent().notify(clientId);
 	}
 
-	const std::shared_ptr<ClientTcpSession> GetSessionById(uint32_t clientId) const
+	void DestroyAllSessions()
 	{
-		auto it = std::find_if(std::cbegin(m_sessions), std::cend(m_sessions),
-			[clientId](const std::shared_ptr<ClientTcpSession>& session)
+		m_sessions.ForEach([this](uint32_t, const std::shared_ptr<ClientTcpSession>& session)
 			{
-				return session->GetClientId() == clientId;
+				StopSession(session->GetSession());
 			});
+	}
 
-		if (it != std::cend(m_sessions))
+	void StopSession(std::shared_ptr<Common::TcpSession> tcpSession)
+	{
+		tcpSession->Post([tcpSession]() { tcpSession->Stop(); });
+	}
+
+	// Doesn't lock. Only call from the game thread. The session stays valid until the next
+	// CollectDestroyedSessions.
+	ClientTcpSession* GetSessionById(uint32_t clientId) const
+	{
+		if (ClientTcpSession* session = m_sessions.Find(clientId))
 		{
-			return *it;
+			return session;
 		}
 
 		SPDLOG_LOGGER_ERROR(s_logger, "Tried to get session that doesn't exist. clientId= {}",
@@ -125,11 +223,51 @@ public:
 		return nullptr;
 	}
 
-	// Increments every time a client is connected, guaranteeing uniqueness.
-	std::atomic<uint32_t> m_nextId{ 0 };
+	// Tells the client over TCP how to reach us over UDP. The peer is registered first, so the
+	// channel knows the token by the time the client's hello arrives.
+	void StartUdpHandshake(uint32_t clientId, std::shared_ptr<Common::TcpSession> tcpSession)
+	{
+		std::shared_ptr<Common::UdpChannel> udpChannel = m_server->m_udpChannel;
+		if (!udpChannel)
+		{
+			return;
+		}
 
-	// Store sessions here.
-	std::set<std::shared_ptr<ClientTcpSession>> m_sessions;
+		Common::UdpHandshake handshake;
+		handshake.clientId = clientId;
+		{
+			std::lock_guard<std::mutex> lock(m_tokenMutex);
+			handshake.token = m_tokenGenerator();
+		}
+		handshake.port = udpChannel->GetLocalPort();
+
+		udpChannel->Post([udpChannel, tcpSession, handshake]()
+			{
+				udpChannel->AddPeer(handshake.clientId, handshake.token);
+
+				std::string message = Common::PackageMessage(Common::MessageId::UdpHandshake,
+					std::string_view(reinterpret_cast<const char*>(&handshake), sizeof(handshake)));
+				tcpSession->Post([tcpSession, message{ std::move(message) }]() mutable
+					{
+						tcpSession->Write(std::move(message));
+					});
+			});
+	}
+
+	// Releases destroyed sessions. Call from the game thread.
+	void CollectDestroyedSessions()
+	{
+		m_sessions.Collect();
+	}
+
+	// Store sessions here, keyed by client id.
+	using SessionMap = Common::SlotMap<ClientTcpSession>;
+	SessionMap m_sessions;
+
+	// Tokens are what stop anyone spoofing a client id over UDP. Sessions can be created on
+	// every io thread at once, so the generator is locked.
+	std::mutex m_tokenMutex;
+	std::mt19937 m_tokenGenerator;
 
 	// Pointer to parent.
 	GameServer* m_server;
@@ -137,144 +275,268 @@ public:
 
 //-------------------------------------------------------------------------------
 
-class TcpListener : public std::enable_shared_from_this<TcpListener> {
+GameServer::GameServer(Game* game, uint32_t ioThreadCount)
+	: m_asioEventProcessor(std::make_unique<Common::AsioEventProcessor>(ioThreadCount))
+	, m_sessionManager(std::make_unique<ClientSessionManager>(this))
+	, m_transportRouting(std::make_unique<Common::TransportRouting>())
+	, m_events(std::make_unique<ClientSessionEvents>())
+	, m_game(game)
+{
+	REGISTER_LOGGER("Server");
+	s_logger = Log::Logger("Server");
+	m_sessionConfig = std::make_unique<Common::TcpSessionConfig>(MakeSessionConfig());
+}
 
-public:
-	TcpListener(asio::io_context& ioc,
-		ClientSessionManager* connectionManager)
-		: m_acceptor(ioc)
-		, m_socket(ioc)
-		, m_connectionManager(connectionManager)
-	{
-	}
+//-------------------------------------------------------------------------------
 
-	void Run()
+void GameServer::Start()
+{
+	Common::TcpListenerConfig listenerConfig;
+	listenerConfig.reusePort = m_reusePort;
+	m_listener = std::make_shared<Common::TcpListener>(*m_asioEventProcessor,
+		"Server::TcpListener", listenerConfig);
+
+	// With an acceptor per io thread, sessions are created on several threads at once.
+	ClientSessionManager* sessionManager = m_sessionManager.get();
+	m_listener->SetAcceptHandler([sessionManager](tcp::socket socket)
+		{
+			SPDLOG_LOGGER_DEBUG(s_logger, "Socket accepted. Creating session.");
+			sessionManager->CreateSession(std::move(socket));
+		});
+
+	std::error_code ec;
+	SPDLOG_LOGGER_INFO(s_logger, "Attempting to listen on port {}", s_port);
+	if (!m_listener->Listen(tcp::endpoint{ asio::ip::make_address(s_localIp), s_port }, ec))
 	{
-		std::error_code ec;
+		SPDLOG_LOGGER_ERROR(s_logger, "Failed to listen for connections. ec={}", ec.value());
+	}
+	StartUdpChannel();
 
-		tcp::endpoint endPoint{ asio::ip::make_address(s_localIp), s_port };
-		SPDLOG_LOGGER_INFO(s_logger, "Attempting to listen on port{}", s_port);
+	m_asioEventProcessor->Run();
+}
 
-		tcp::acceptor acceptor{ m_socket.get_io_context() };
+bool GameServer::StartCapture(const std::string& path)
+{
+	auto capture = std::make_shared<Common::CaptureWriter>();
+	if (!capture->Open(path))
+	{
+		SPDLOG_LOGGER_ERROR(s_logger, "Failed to open capture file. path= {}", path);
+		return false;
+	}
 
-		acceptor.open(endPoint.protocol(), ec);
-		if (ec)
-		{
-			SPDLOG_LOGGER_ERROR(s_logger,"Error opening acceptor. ec={}",
-				ec.value());
-			return;
-		}
+	SPDLOG_LOGGER_INFO(s_logger, "Capturing client traffic. path= {}", path);
+	m_sessionConfig->capture = std::move(capture);
+	return true;
+}
 
-		acceptor.bind(endPoint, ec);
-		if (ec)
-		{
-			SPDLOG_LOGGER_ERROR(s_logger, "Error binding acceptor to endpoint. ec={}",
-				ec.value());
-			return;
-		}
-			
-		acceptor.listen(asio::socket_base::max_listen_connections, ec);
-		if (ec)
-		{
-			SPDLOG_LOGGER_ERROR(s_logger, "Error listening for connections. ec={}",
-				ec.value());
-			return;
-		}
+void GameServer::SetWireFormat(Common::WireFormat format)
+{
+	m_sessionConfig->wireFormat = format;
+}
 
-		asio::socket_base::reuse_address option(true);
-		acceptor.set_option(option);
+void GameServer::SetCompression(uint32_t threshold, bool isStreamed)
+{
+	m_sessionConfig->compressionThreshold = threshold;
+	m_sessionConfig->streamCompression = isStreamed;
+}
 
-		m_acceptor = std::move(acceptor);
+void GameServer::SetReadEngine(Common::ReadEngine engine)
+{
+	m_sessionConfig->readEngine = engine;
+}
 
-		if (!m_acceptor.is_open())
-		{
-			SPDLOG_LOGGER_ERROR(s_logger, "Failed to find available port. ec={}",
-				ec.value());
-			return;
-		}
+void GameServer::SetReusePort(bool reusePort)
+{
+	m_reusePort = reusePort;
+}
 
-		m_isRunning = true;
-		m_port = m_acceptor.local_endpoint(ec).port();
-		SPDLOG_LOGGER_INFO(s_logger, "Listening on port {}", m_port);
-		DoAccept();
+void GameServer::StartUdpChannel()
+{
+	// Same port number as TCP. Clients are told it in the handshake either way.
+	std::error_code ec;
+	udp::socket socket(m_asioEventProcessor->GetIoService());
+	socket.open(udp::v4(), ec);
+	if (!ec)
+	{
+		socket.bind(udp::endpoint(asio::ip::make_address(s_localIp), s_port), ec);
 	}
 
-private:
-	void OnAccept(const std::error_code& ec)
+	if (ec)
 	{
-		if (ec)
-		{
-			SPDLOG_LOGGER_ERROR(s_logger, "Error accepting incoming connection. ec={}",
-				ec.value());
-		}
-		else
-		{
-			SPDLOG_LOGGER_INFO(s_logger, "Socket accepted. Creating session.");
+		SPDLOG_LOGGER_ERROR(s_logger, "Failed to open UDP channel, everything will go over TCP."
+			" ec={}", ec.value());
+		return;
+	}
 
-			// create session
-			m_connectionManager->CreateSession(std::move(m_socket));
-		}
+	m_udpChannel = std::make_shared<Common::UdpChannel>(std::move(socket), "Server::UdpChannel");
 
-		if (m_isRunning)
+	// Datagrams are dispatched with everything else, as if they'd come over the client's session.
+	Game* game = m_game;
+	m_udpChannel->SetMessageBatchHandler(
+		[game](uint32_t clientId, std::shared_ptr<Common::MessageBatch> batch)
 		{
-			DoAccept();
-		}
-	}
+			game->PostToMainThread([game, clientId, batch]()
+				{
+					game->GetMessageDispatcher().Dispatch(clientId, *batch);
+				});
+		});
+	m_udpChannel->Start();
+}
+
+GameServer::~GameServer()
+{
+}
 
-	void DoAccept()
+void GameServer::Stop()
+{
+	if (m_listener)
 	{
-		m_acceptor.async_accept(
-			m_socket,
-			std::bind(&TcpListener::OnAccept, shared_from_this(), std::placeholders::_1));
+		m_listener->Stop();
 	}
+	m_sessionManager->DestroyAllSessions();
 
-private:
-	tcp::acceptor m_acceptor;
-	tcp::socket m_socket;
-	ClientSessionManager* m_connectionManager;
-
-	uint16_t m_port = 0;
-	bool m_isRunning = false;
-};
+	Common::ReceiveBufferPoolStats pool = GetReceivePoolStats();
+	SPDLOG_LOGGER_INFO(s_logger, "Receive buffers. peakBytesInUse= {} bytesReserved= {}"
+		" borrows= {} slabsAllocated= {}", pool.peakBytesInUse, pool.bytesReserved, pool.borrows,
+		pool.slabsAllocated);
+	if (m_sessionConfig->capture)
+	{
+		m_sessionConfig->capture->Flush();
+	}
+	if (m_udpChannel)
+	{
+		m_udpChannel->Post([udpChannel = m_udpChannel]() { udpChannel->Stop(); });
+	}
+}
 
-GameServer::GameServer(Game* game)
-	: m_asioEventProcessor(std::make_unique<Common::AsioEventProcessor>())
-	, m_sessionManager(std::make_unique<ClientSessionManager>(this))
-	, m_events(std::make_unique<ClientSessionEvents>())
-	, m_game(game)
+void GameServer::DestroySession(uint32_t clientId)
 {
-	REGISTER_LOGGER("Server");
-	s_logger = Log::Logger("Server");
+	m_sessionManager->DestroySession(clientId);
 }
 
-//-------------------------------------------------------------------------------
+void GameServer::Update()
+{
+	m_sessionManager->CollectDestroyedSessions();
+}
 
-void GameServer::Start()
+Common::ReceiveBufferPoolStats GameServer::GetReceivePoolStats() const
 {
-	m_listener = std::make_shared<TcpListener>(m_asioEventProcessor->GetIoService(),
-		m_sessionManager.get());
-	m_listener->Run();
+	return m_sessionConfig->receivePool->GetStats();
+}
 
-	m_asioEventProcessor->Run();
+Common::RttStats GameServer::GetClientRttStats(uint32_t clientId) const
+{
+	if (ClientTcpSession* session = m_sessionManager->GetSessionById(clientId))
+	{
+		return session->GetSession()->GetRttStats(false);
+	}
+	return Common::RttStats();
 }
 
-GameServer::~GameServer()
+void GameServer::PostMessageToClient(uint32_t clientId, std::string message)
 {
+	if (ClientTcpSession* session = m_sessionManager->GetSessionById(clientId))
+	{
+		PostBuffer(*session, std::make_shared<const std::string>(std::move(message)));
+	}
 }
 
-void GameServer::Stop()
+void GameServer::BroadcastToAll(std::string message)
 {
-	m_sessionManager->DestroyAllSessions();
+	BroadcastIf([](uint32_t) { return true; }, std::move(message));
 }
 
-void GameServer::PostMessageToClient(uint32_t clientId, std::string message)
+void GameServer::BroadcastToClients(const std::vector<uint32_t>& clientIds, std::string message)
 {
-	if (std::shared_ptr<ClientTcpSession> session = m_sessionManager->GetSessionById(clientId))
+	Common::SharedBuffer buffer = std::make_shared<const std::string>(std::move(message));
+	for (uint32_t clientId : clientIds)
 	{
-		m_asioEventProcessor->Post([session, message{std::move(message)}]()
+		if (ClientTcpSession* session = m_sessionManager->GetSessionById(clientId))
+		{
+			PostBuffer(*session, buffer);
+		}
+	}
+}
+
+void GameServer::BroadcastIf(const std::function<bool(uint32_t clientId)>& predicate,
+	std::string message)
+{
+	// Taken out of the member while in use, so a predicate that broadcasts fills a list of its
+	// own instead of this one.
+	std::vector<std::pair<uint32_t, std::shared_ptr<ClientTcpSession>>> targets;
+	targets.swap(m_broadcastTargets);
+
+	// ForEach holds the lock io threads need to add sessions, so only the copy happens under it.
+	m_sessionManager->m_sessions.ForEach(
+		[&targets](uint32_t clientId, const std::shared_ptr<ClientTcpSession>& session)
 		{
-			session->GetSession()->Write(message);
+			targets.emplace_back(clientId, session);
 		});
+
+	Common::SharedBuffer buffer = std::make_shared<const std::string>(std::move(message));
+	for (const auto& target : targets)
+	{
+		if (predicate(target.first))
+		{
+			PostBuffer(*target.second, buffer);
+		}
+	}
+
+	// Otherwise sessions destroyed since would be kept alive until the next broadcast.
+	targets.clear();
+	m_broadcastTargets.swap(targets);
+}
+
+void GameServer::PostBuffer(ClientTcpSession& session, std::shared_ptr<const std::string> buffer)
+{
+	// The session may live on any io thread. Its writes have to happen on that one.
+	std::shared_ptr<Common::TcpSession> tcpSession = session.GetSession();
+	const Common::TransportRouting& routing = session.m_transportRouting
+		? *session.m_transportRouting : *m_transportRouting;
+	Common::Route route = routing.GetRoute(*buffer);
+	if (m_udpChannel && route.transport != Common::Transport::Tcp)
+	{
+		// Unreliable messages fall back to TCP if the client hasn't said hello over UDP yet, or
+		// they won't fit in a datagram. Reliable ones never do, since they'd overtake the
+		// messages on their stream. The client is disconnected instead, the same as when its TCP
+		// queue overflows, and its session is destroyed on the next tick.
+		m_udpChannel->Post([udpChannel = m_udpChannel, tcpSession, clientId = session.GetClientId(),
+			route, buffer{ std::move(buffer) }]() mutable
+			{
+				Common::UdpSendResult result = udpChannel->Send(clientId, route, buffer);
+				if (result == Common::UdpSendResult::Sent)
+				{
+					return;
+				}
+				if (!Common::ShouldFallBackToTcp(route, result))
+				{
+					SPDLOG_LOGGER_ERROR(s_logger, "Couldn't send a reliable message over UDP,"
+						" disconnecting. clientId= {} stream= {} result= {} size= {}", clientId,
+						route.stream, static_cast<uint32_t>(result), buffer->size());
+					tcpSession->Post([tcpSession]() { tcpSession->Stop(); });
+					return;
+				}
+
+				tcpSession->Post([tcpSession, buffer{ std::move(buffer) }]() mutable
+					{
+						tcpSession->Write(std::move(buffer));
+					});
+			});
+		return;
+	}
+
+	tcpSession->Post([tcpSession, buffer{ std::move(buffer) }]() mutable
+	{
+		tcpSession->Write(std::move(buffer));
+	});
+}
+
+void GameServer::SetClientTransportRouting(uint32_t clientId,
+	std::shared_ptr<const Common::TransportRouting> routing)
+{
+	if (ClientTcpSession* session = m_sessionManager->GetSessionById(clientId))
+	{
+		session->m_transportRouting = std::move(routing);
 	}
 }
 
@@ -6,14 +6,27 @@
 #pragma once
 
 #include "common/NetworkTypes.h"
+#include "common/ReceiveBufferPool.h"
+#include "common/RttTracker.h"
 #include "common/ThreadSafeQueue.h"
+#include "common/WireFormat.h"
 
 #include <atomic>
+#include <functional>
 #include <memory>
+#include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 
 namespace Common {
 class AsioEventProcessor;
+class CaptureWriter;
+enum class ReadEngine : uint32_t;
+class TcpListener;
+struct TcpSessionConfig;
+class TransportRouting;
+class UdpChannel;
 }
 
 namespace Server {
@@ -22,41 +35,114 @@ namespace Server {
 
 class ClientSessionManager;
 class ClientSessionEvents;
+class ClientTcpSession;
 class Game;
-class TcpListener;
 class GameServer {
 
 public:
 	friend class ClientSessionManager;
-	GameServer(Game* game);
+	// Sessions are spread across ioThreadCount io threads. 0 means one per hardware core.
+	GameServer(Game* game, uint32_t ioThreadCount = 0);
 	~GameServer();
 
 	// Start the server and begin listening for and handling connections.
 	void Start();
 
+	// Records everything clients send to a capture file that CaptureReplayer can play back.
+	// Call before Start.
+	bool StartCapture(const std::string& path);
+
+	// How frames are laid out on client connections. Clients have to be set to the same.
+	// Call before Start.
+	void SetWireFormat(Common::WireFormat format);
+
+	// Compresses what's sent to clients, for payloads of at least threshold bytes. Only takes
+	// effect with the compact wire format. See TcpSessionConfig. Call before Start.
+	void SetCompression(uint32_t threshold, bool isStreamed);
+
+	// How client sockets are read. See ReadEngine. Call before Start.
+	void SetReadEngine(Common::ReadEngine engine);
+
+	// Opens an acceptor per io thread on the same port, for when thousands of clients connect
+	// at once. See TcpListenerConfig. Call before Start.
+	void SetReusePort(bool reusePort);
+
 	// Stop the server. This will close all client connections.
 	void Stop();
 
 	// Returns true if the server is running.
 	bool IsRunning() const { return m_isRunning; };
 
-	// Posts a serialized message to the specified client.
+	// Closes the client's connection. Its id is rejected from then on. Clients that disconnect,
+	// or whose sessions are stopped for falling behind, are destroyed the same way on the next
+	// tick. Either way SessionDestroyedEvent fires. Only call from the game thread.
+	void DestroySession(uint32_t clientId);
+
+	// Call once per tick from the game thread.
+	void Update();
+
+	// Posts a serialized message to the specified client. Only call from the game thread.
 	void PostMessageToClient(uint32_t clientId, std::string message);
 
+	// Broadcasts post one serialized message to many clients. The bytes are shared by every
+	// client's output queue rather than copied per client. Only call from the game thread.
+	void BroadcastToAll(std::string message);
+	void BroadcastToClients(const std::vector<uint32_t>& clientIds, std::string message);
+
+	// Sends to every client the predicate returns true for. The predicate is called with no lock
+	// held, so it may destroy sessions or broadcast itself.
+	void BroadcastIf(const std::function<bool(uint32_t clientId)>& predicate, std::string message);
+
+	// Round trip to the client, measured by its session's pings. Empty if there's no such
+	// client. Only call from the game thread.
+	Common::RttStats GetClientRttStats(uint32_t clientId) const;
+
+	// How much the receive buffers client sessions share have taken. Safe to call from any thread.
+	Common::ReceiveBufferPoolStats GetReceivePoolStats() const;
+
 	// Returns number of connected clients.
 	uint32_t GetConnectionClientCount() const { return m_currentConnectionCount; }
 
 	ClientSessionEvents& GetEvents();
 
+	// Which messages go over UDP, for clients without a routing of their own. Only change this
+	// from the game thread, before clients connect.
+	Common::TransportRouting& GetTransportRouting() { return *m_transportRouting; }
+
+	// Routes one client's messages with routing instead, or with the table above again if it's
+	// null. Only call from the game thread, before sending the client anything, e.g. from
+	// SessionCreatedEvent. Changing a reliable stream's transport later would reorder it.
+	void SetClientTransportRouting(uint32_t clientId,
+		std::shared_ptr<const Common::TransportRouting> routing);
+
 private:
+	// Queues a shared buffer on the session's io thread, or sends it over UDP if it's routed there.
+	void PostBuffer(ClientTcpSession& session, std::shared_ptr<const std::string> buffer);
+
+	void StartUdpChannel();
+
+	// Helper class that handles the asio work queue. Declared first so it outlives the
+	// sessions, listener and UDP channel, whose sockets and timers belong to its io services.
+	std::unique_ptr<Common::AsioEventProcessor> m_asioEventProcessor;
+
 	// Helper class for managing client connection sessions.
 	std::unique_ptr<ClientSessionManager> m_sessionManager;
 
 	// Listens for connections.
-	std::shared_ptr<TcpListener> m_listener;
+	std::shared_ptr<Common::TcpListener> m_listener;
+	bool m_reusePort = false;
 
-	// Helper class that handles the asio work queue.
-	std::unique_ptr<Common::AsioEventProcessor> m_asioEventProcessor;
+	// Sessions a broadcast goes to, copied out of the session map so its lock isn't held while
+	// posting. Kept only for its capacity, and moved out by each broadcast while it runs. Only
+	// used on the game thread.
+	std::vector<std::pair<uint32_t, std::shared_ptr<ClientTcpSession>>> m_broadcastTargets;
+
+	// Datagrams for every client go through this one channel. Null if it failed to open.
+	std::shared_ptr<Common::UdpChannel> m_udpChannel;
+	std::unique_ptr<Common::TransportRouting> m_transportRouting;
+
+	// What every client session starts with. Includes the capture they all share, if any.
+	std::unique_ptr<Common::TcpSessionConfig> m_sessionConfig;
 
 	// How many clients are currently connected.
 	std::atomic<uint32_t> m_currentConnectionCount{0};
@@ -4,12 +4,16 @@
 //
 
 #include "common/Log.h"
+#include "common/TcpSession.h"
 #include "server/Game.h"
 
+#include <cstdlib>
 #include <filesystem>
+#include <iostream>
 #include <memory>
+#include <string>
 
-int main()
+int main(int argc, char** argv)
 {
 	//init directories.
 	if (!std::filesystem::is_regular_file(Log::GetLogFile()))
@@ -19,7 +23,73 @@ int main()
 		std::ofstream(Log::GetLogFile().c_str());
 	}
 
-	Server::Game game;
+	// --tick-rate <hz> sets how many times a second the game ticks.
+	// --snapshot-budget <bytes> sets how much snapshot each client is sent per tick.
+	// --capture <file> records client traffic for CaptureReplayer.
+	// --wire-format legacy|compact picks the framing clients have to speak.
+	// --compression-threshold <bytes> and --stream-compression compress what's sent to them.
+	// --read-engine async|drain picks how their sockets are read.
+	// --io-threads <count> sets how many io threads serve clients, 0 for one per core.
+	// --reuse-port accepts on every io thread.
+	Server::GameOptions options;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--stream-compression")
+		{
+			options.streamCompression = true;
+			continue;
+		}
+		if (arg == "--reuse-port")
+		{
+			options.reusePort = true;
+			continue;
+		}
+
+		if (i + 1 == argc)
+		{
+			break;
+		}
+
+		const char* value = argv[++i];
+		if (arg == "--tick-rate")
+		{
+			options.tickRate = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			if (options.tickRate == 0)
+			{
+				std::cerr << "Invalid tick rate: " << value << "\n";
+				return 1;
+			}
+		}
+		else if (arg == "--snapshot-budget")
+		{
+			options.snapshotBytesPerTick = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+		}
+		else if (arg == "--capture")
+		{
+			options.capturePath = value;
+		}
+		else if (arg == "--wire-format" && !Common::ParseWireFormat(value, options.wireFormat))
+		{
+			std::cerr << "Unknown wire format: " << value << "\n";
+			return 1;
+		}
+		else if (arg == "--read-engine" && !Common::ParseReadEngine(value, options.readEngine))
+		{
+			std::cerr << "Unknown read engine: " << value << "\n";
+			return 1;
+		}
+		else if (arg == "--io-threads")
+		{
+			options.ioThreadCount = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+		}
+		else if (arg == "--compression-threshold")
+		{
+			options.compressionThreshold = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+		}
+	}
+
+	Server::Game game(options);
 	game.Run();
 	return 0;
 }
\ No newline at end of file
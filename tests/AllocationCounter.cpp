@@ -0,0 +1,75 @@
+//---------------------------------------------------------------
+//
+// AllocationCounter.cpp
+//
+
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace Tests {
+
+//===============================================================================
+
+namespace {
+	// Per thread so allocations made by logger and io threads don't show up in a test's count.
+	thread_local uint64_t s_allocationCount = 0;
+	thread_local uint64_t s_allocatedBytes = 0;
+
+	void* CountedAlloc(size_t size)
+	{
+		++s_allocationCount;
+		s_allocatedBytes += size;
+		if (void* memory = std::malloc(size ? size : 1))
+		{
+			return memory;
+		}
+
+		throw std::bad_alloc();
+	}
+} // anon namespace
+
+uint64_t GetThreadAllocationCount()
+{
+	return s_allocationCount;
+}
+
+uint64_t GetThreadAllocatedBytes()
+{
+	return s_allocatedBytes;
+}
+
+//===============================================================================
+
+} // namespace Tests
+
+void* operator new(size_t size)
+{
+	return Tests::CountedAlloc(size);
+}
+
+void* operator new[](size_t size)
+{
+	return Tests::CountedAlloc(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
@@ -0,0 +1,42 @@
+//---------------------------------------------------------------
+//
+// AllocationCounter.h
+//
+// The test project replaces the global operator new so tests can count heap allocations.
+//
+
+#pragma once
+
+#include <cstdint>
+
+namespace Tests {
+
+//===============================================================================
+
+// Number of times the calling thread has gone through operator new.
+uint64_t GetThreadAllocationCount();
+
+// Total bytes the calling thread has asked operator new for.
+uint64_t GetThreadAllocatedBytes();
+
+// Counts allocations made by the calling thread while it's in scope.
+class AllocationScope
+{
+public:
+	AllocationScope()
+		: m_start(GetThreadAllocationCount())
+		, m_startBytes(GetThreadAllocatedBytes())
+	{
+	}
+
+	uint64_t GetCount() const { return GetThreadAllocationCount() - m_start; }
+	uint64_t GetBytes() const { return GetThreadAllocatedBytes() - m_startBytes; }
+
+private:
+	uint64_t m_start;
+	uint64_t m_startBytes;
+};
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,87 @@
+//---------------------------------------------------------------
+//
+// AsioEventProcessorTest.cpp
+//
+
+#include "AsioEventProcessorTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <chrono>
+#include <future>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace Tests {
+
+//===============================================================================
+
+SCENARIO("Spreading work across an io thread pool.", "[AsioEventProcessor]")
+{
+	GIVEN("A running pool with four threads")
+	{
+		Common::AsioEventProcessor pool(4);
+		REQUIRE(pool.GetThreadCount() == 4);
+		pool.Run();
+
+		WHEN("Services are handed out")
+		{
+			std::set<asio::io_service*> services;
+			for (uint32_t i = 0; i < pool.GetThreadCount(); ++i)
+			{
+				services.insert(&pool.GetNextIoService());
+			}
+
+			THEN("Each service in the pool is handed out once per round")
+			{
+				REQUIRE(services.size() == 4);
+			}
+		}
+		AND_WHEN("Many threads post unsynchronized work to the same service")
+		{
+			asio::io_service& ios = pool.GetNextIoService();
+
+			// Deliberately not atomic. Handlers on one service must never overlap.
+			uint32_t counter = 0;
+			std::set<std::thread::id> handlerThreads;
+			const uint32_t postsPerThread = 10000;
+
+			std::vector<std::thread> producers;
+			for (int i = 0; i < 4; ++i)
+			{
+				producers.emplace_back([&]()
+					{
+						for (uint32_t j = 0; j < postsPerThread; ++j)
+						{
+							ios.post([&]()
+								{
+									++counter;
+									handlerThreads.insert(std::this_thread::get_id());
+								});
+						}
+					});
+			}
+
+			for (auto& producer : producers)
+			{
+				producer.join();
+			}
+
+			std::promise<void> drained;
+			ios.post([&drained]() { drained.set_value(); });
+			REQUIRE(drained.get_future().wait_for(std::chrono::seconds(10))
+				== std::future_status::ready);
+
+			THEN("Every handler ran, one at a time, on the service's own thread")
+			{
+				REQUIRE(counter == 4 * postsPerThread);
+				REQUIRE(handlerThreads.size() == 1);
+			}
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
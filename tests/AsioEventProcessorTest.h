@@ -0,0 +1,8 @@
+//---------------------------------------------------------------
+//
+// AsioEventProcessorTest.h
+//
+
+#pragma once
+
+#include "common/AsioEventProcessor.h"
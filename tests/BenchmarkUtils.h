@@ -0,0 +1,46 @@
+//---------------------------------------------------------------
+//
+// BenchmarkUtils.h
+//
+// Benchmarks are tagged [.][Benchmark] so they're hidden from the post build test run.
+// Run them explicitly with: tests.exe [Benchmark]
+//
+
+#pragma once
+
+#include "Catch2/catch.hpp"
+#include "common/Timer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+namespace Tests {
+
+//===============================================================================
+
+// Runs fn iterations times and reports how many units per second got through.
+template <typename Fn>
+double MeasureThroughput(const std::string& name, const std::string& unit,
+	uint64_t unitsPerIteration, uint32_t iterations, Fn&& fn)
+{
+	// Warm up caches and allocators so the first iteration doesn't skew the result.
+	fn();
+
+	Common::Timer timer;
+	timer.Start();
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		fn();
+	}
+	timer.Stop();
+
+	double seconds = std::max<int64_t>(timer.GetElapsedUs().count(), 1) / 1000000.0;
+	double rate = static_cast<double>(unitsPerIteration) * iterations / seconds;
+	WARN(name << ": " << static_cast<uint64_t>(rate) << " " << unit << "/s");
+	return rate;
+}
+
+//===============================================================================
+
+} // namespace Tests
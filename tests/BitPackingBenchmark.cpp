@@ -0,0 +1,76 @@
+//---------------------------------------------------------------
+//
+// BitPackingBenchmark.cpp
+//
+
+#include "BenchmarkUtils.h"
+#include "BitPackingTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <string>
+#include <vector>
+
+namespace Tests {
+
+namespace {
+	const uint32_t s_stateCount = 1000;
+	const uint32_t s_iterations = 2000;
+} // anon namespace
+
+//===============================================================================
+
+TEST_CASE("Motion packing throughput for 1000 objects.", "[.][Benchmark][BitPacking]")
+{
+	Common::MotionQuantization quantization;
+	std::vector<Common::MotionState> states = MakeMotionStates(s_stateCount);
+
+	std::string data;
+	MeasureThroughput("Encode", "states", s_stateCount, s_iterations, [&]()
+		{
+			data.clear();
+			Common::BitWriter writer(data);
+			Common::EncodeMotion(states.data(), states.size(), quantization, writer);
+			writer.Flush();
+		});
+
+	std::vector<Common::MotionState> decoded;
+	MeasureThroughput("Decode", "states", s_stateCount, s_iterations, [&]()
+		{
+			Common::BitReader reader(data);
+			REQUIRE(Common::DecodeMotion(reader, states.size(), quantization, decoded));
+		});
+
+	size_t rawSize = s_stateCount * (sizeof(uint32_t) + 5 * sizeof(float));
+	WARN("Packed " << data.size() << " bytes, unpacked " << rawSize << " bytes ("
+		<< 100 * data.size() / rawSize << "%)");
+
+	// The batch path against quantizing one value at a time.
+	std::vector<float> values(s_stateCount);
+	for (uint32_t i = 0; i < s_stateCount; ++i)
+	{
+		values[i] = states[i].position.x;
+	}
+	std::vector<uint32_t> quantized(s_stateCount);
+	uint32_t checksum = 0;
+
+	double batchRate = MeasureThroughput("Quantize batch", "values", s_stateCount, s_iterations * 10, [&]()
+		{
+			Common::QuantizeBatch(values.data(), values.size(), quantization.positionX, quantized.data());
+			checksum += quantized[s_stateCount / 2];
+		});
+	double scalarRate = MeasureThroughput("Quantize one at a time", "values", s_stateCount, s_iterations * 10, [&]()
+		{
+			for (uint32_t i = 0; i < s_stateCount; ++i)
+			{
+				quantized[i] = quantization.positionX.Quantize(values[i]);
+			}
+			checksum += quantized[s_stateCount / 2];
+		});
+
+	WARN("Batch is " << batchRate / scalarRate << "x one at a time (checksum " << checksum << ")");
+}
+
+//===============================================================================
+
+} // namespace Tests
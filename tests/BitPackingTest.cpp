@@ -0,0 +1,328 @@
+//---------------------------------------------------------------
+//
+// BitPackingTest.cpp
+//
+
+#include "BitPackingTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+
+namespace Tests {
+
+namespace {
+	// Float arithmetic in quantizing and dequantizing can land a hair past the ideal bound.
+	const float s_slack = 1.0001f;
+
+	float AngleBetween(const glm::vec2& a, const glm::vec2& b)
+	{
+		float cosine = (a.x * b.x + a.y * b.y) / (std::hypot(a.x, a.y) * std::hypot(b.x, b.y));
+		return std::acos(std::min(std::max(cosine, -1.0f), 1.0f));
+	}
+} // anon namespace
+
+//===============================================================================
+
+SCENARIO("Writing and reading values bit by bit.", "[BitPacking]")
+{
+	GIVEN("Values of every width from 1 to 32 bits")
+	{
+		std::mt19937 random(1);
+		std::vector<uint32_t> values;
+		for (uint32_t bits = 1; bits <= 32; ++bits)
+		{
+			values.push_back(random() & (bits == 32 ? ~0u : (1u << bits) - 1));
+		}
+
+		std::string data;
+		Common::BitWriter writer(data);
+		for (uint32_t bits = 1; bits <= 32; ++bits)
+		{
+			writer.Write(values[bits - 1], bits);
+		}
+		writer.Flush();
+
+		THEN("They take up no more bytes than their bits need")
+		{
+			REQUIRE(writer.GetBitsWritten() == 528);
+			REQUIRE(data.size() == 66);
+		}
+
+		THEN("They read back the same")
+		{
+			Common::BitReader reader(data);
+			for (uint32_t bits = 1; bits <= 32; ++bits)
+			{
+				uint32_t value = 0;
+				REQUIRE(reader.Read(bits, value));
+				REQUIRE(value == values[bits - 1]);
+			}
+			REQUIRE(reader.GetBitsRemaining() == 0);
+		}
+	}
+
+	GIVEN("A value wider than the bits written")
+	{
+		std::string data;
+		Common::BitWriter writer(data);
+		writer.Write(0xFFu, 3);
+		writer.Write(0u, 5);
+		writer.Flush();
+
+		THEN("Only its low bits are written")
+		{
+			REQUIRE(data.size() == 1);
+			REQUIRE(static_cast<uint8_t>(data[0]) == 0x07);
+		}
+	}
+
+	GIVEN("A reader with fewer bits left than asked for")
+	{
+		std::string data;
+		Common::BitWriter writer(data);
+		writer.Write(5, 12);
+		writer.Flush();
+
+		Common::BitReader reader(data);
+		uint32_t value = 0;
+		REQUIRE(reader.Read(12, value));
+
+		THEN("Reading past the end fails")
+		{
+			REQUIRE(reader.GetBitsRemaining() == 4);
+			REQUIRE_FALSE(reader.Read(5, value));
+		}
+	}
+}
+
+SCENARIO("Quantizing floats to a range.", "[BitPacking]")
+{
+	GIVEN("16 bit positions in a world 4096 units across")
+	{
+		Common::QuantizedRange range(-2048.0f, 2048.0f, 16);
+
+		THEN("The most they're out by is half a step")
+		{
+			REQUIRE(range.GetMaxError() == Approx(4096.0f / 65535.0f / 2.0f));
+		}
+
+		WHEN("Values across the range are round tripped")
+		{
+			std::mt19937 random(1);
+			std::uniform_real_distribution<float> distribution(-2048.0f, 2048.0f);
+			float worst = 0.0f;
+			for (int i = 0; i < 100000; ++i)
+			{
+				float value = distribution(random);
+				worst = std::max(worst, std::abs(range.Dequantize(range.Quantize(value)) - value));
+			}
+
+			THEN("None are out by more than the max error")
+			{
+				REQUIRE(worst <= range.GetMaxError() * s_slack);
+			}
+		}
+
+		WHEN("The ends of the range are round tripped")
+		{
+			THEN("They come back exactly")
+			{
+				REQUIRE(range.Quantize(-2048.0f) == 0);
+				REQUIRE(range.Quantize(2048.0f) == 65535);
+				REQUIRE(range.Dequantize(0) == -2048.0f);
+				REQUIRE(range.Dequantize(65535) == Approx(2048.0f));
+			}
+		}
+
+		WHEN("Values outside the range are quantized")
+		{
+			THEN("They're clamped to it")
+			{
+				REQUIRE(range.Quantize(-1.0e9f) == 0);
+				REQUIRE(range.Quantize(1.0e9f) == 65535);
+				REQUIRE(range.Quantize(std::numeric_limits<float>::infinity()) == 65535);
+				REQUIRE(range.Quantize(std::numeric_limits<float>::quiet_NaN()) == 0);
+			}
+		}
+	}
+
+	GIVEN("The same values quantized one at a time and in a batch")
+	{
+		Common::QuantizedRange range(-2048.0f, 2048.0f, 16);
+		std::mt19937 random(2);
+		std::uniform_real_distribution<float> distribution(-2100.0f, 2100.0f);
+
+		// Not a multiple of four, so the batch has a tail done one at a time too.
+		std::vector<float> values(1003);
+		for (float& value : values)
+		{
+			value = distribution(random);
+		}
+		values[0] = std::numeric_limits<float>::quiet_NaN();
+		values[1] = -std::numeric_limits<float>::infinity();
+
+		std::vector<uint32_t> batch(values.size());
+		Common::QuantizeBatch(values.data(), values.size(), range, batch.data());
+
+		THEN("They quantize the same")
+		{
+			for (size_t i = 0; i < values.size(); ++i)
+			{
+				REQUIRE(batch[i] == range.Quantize(values[i]));
+			}
+		}
+	}
+}
+
+SCENARIO("Quantizing floats to a range at the widest it goes.", "[BitPacking]")
+{
+	GIVEN("24 bit positions in a world 4096 units across")
+	{
+		Common::QuantizedRange range(-2048.0f, 2048.0f, 24);
+		const uint32_t last = (1u << 24) - 1;
+
+		WHEN("The top of the range is quantized")
+		{
+			THEN("It's the last step, not one past it")
+			{
+				REQUIRE(range.Quantize(2048.0f) == last);
+				REQUIRE(range.Quantize(1.0e9f) == last);
+			}
+			AND_THEN("It's the same in a batch")
+			{
+				std::vector<float> values(8, 2048.0f);
+				std::vector<uint32_t> batch(values.size());
+				Common::QuantizeBatch(values.data(), values.size(), range, batch.data());
+				for (uint32_t value : batch)
+				{
+					REQUIRE(value == last);
+				}
+			}
+		}
+
+		WHEN("The top of the range is written, read back and dequantized")
+		{
+			std::string buffer;
+			Common::BitWriter writer(buffer);
+			writer.Write(range.Quantize(2048.0f), range.bits);
+			writer.Flush();
+
+			Common::BitReader reader(buffer);
+			uint32_t value = 0;
+			REQUIRE(reader.Read(range.bits, value));
+
+			THEN("It comes back at the top, not at the bottom")
+			{
+				REQUIRE(range.Dequantize(value) == Approx(2048.0f));
+			}
+		}
+	}
+}
+
+SCENARIO("Quantizing directions to an angle.", "[BitPacking]")
+{
+	GIVEN("8 bit directions")
+	{
+		Common::QuantizedAngle angle(8);
+
+		WHEN("Directions all the way round are round tripped")
+		{
+			float worst = 0.0f;
+			for (int i = 0; i < 3600; ++i)
+			{
+				float radians = i * 6.28318530718f / 3600.0f;
+				glm::vec2 direction = { std::cos(radians), std::sin(radians) };
+				glm::vec2 result = angle.Dequantize(angle.Quantize(direction));
+
+				REQUIRE(std::hypot(result.x, result.y) == Approx(1.0f));
+				worst = std::max(worst, AngleBetween(direction, result));
+			}
+
+			THEN("None are out by more than the max error")
+			{
+				REQUIRE(angle.GetMaxError() == Approx(6.28318530718f / 512.0f));
+				REQUIRE(worst <= angle.GetMaxError() * s_slack + 0.001f);
+			}
+		}
+
+		WHEN("A direction that isn't a unit vector is quantized")
+		{
+			THEN("Only its angle counts")
+			{
+				REQUIRE(angle.Quantize({ 0.0f, 5.0f }) == angle.Quantize({ 0.0f, 1.0f }));
+				REQUIRE(angle.Quantize({ 0.0f, 1.0f }) == 64);
+			}
+		}
+
+		WHEN("A direction just short of all the way round is quantized")
+		{
+			THEN("It wraps to 0")
+			{
+				REQUIRE(angle.Quantize({ 1.0f, -0.001f }) == 0);
+			}
+		}
+	}
+}
+
+SCENARIO("Packing object motion.", "[BitPacking]")
+{
+	GIVEN("States encoded with the default quantization")
+	{
+		Common::MotionQuantization quantization;
+		std::vector<Common::MotionState> states = MakeMotionStates(301);
+
+		std::string data;
+		Common::BitWriter writer(data);
+		Common::EncodeMotion(states.data(), states.size(), quantization, writer);
+		writer.Flush();
+
+		THEN("Each takes 66 bits rather than the 24 bytes it takes unpacked")
+		{
+			REQUIRE(quantization.GetBitsPerState() == 66);
+			REQUIRE(data.size() == (301 * 66 + 7) / 8);
+		}
+
+		WHEN("They're decoded")
+		{
+			Common::BitReader reader(data);
+			std::vector<Common::MotionState> decoded;
+			REQUIRE(Common::DecodeMotion(reader, states.size(), quantization, decoded));
+
+			THEN("Each is within the error bounds of the original")
+			{
+				REQUIRE(decoded.size() == states.size());
+				for (size_t i = 0; i < states.size(); ++i)
+				{
+					REQUIRE(decoded[i].entityId == states[i].entityId);
+					REQUIRE(std::abs(decoded[i].position.x - states[i].position.x)
+						<= quantization.positionX.GetMaxError() * s_slack);
+					REQUIRE(std::abs(decoded[i].position.y - states[i].position.y)
+						<= quantization.positionY.GetMaxError() * s_slack);
+					REQUIRE(AngleBetween(decoded[i].direction, states[i].direction)
+						<= quantization.direction.GetMaxError() * s_slack + 0.001f);
+					REQUIRE(std::abs(decoded[i].speed - states[i].speed)
+						<= quantization.speed.GetMaxError() * s_slack);
+				}
+			}
+		}
+
+		WHEN("More are decoded than were encoded")
+		{
+			Common::BitReader reader(data);
+			std::vector<Common::MotionState> decoded;
+
+			THEN("Decoding fails")
+			{
+				REQUIRE_FALSE(Common::DecodeMotion(reader, states.size() + 1, quantization, decoded));
+				REQUIRE(decoded.empty());
+			}
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
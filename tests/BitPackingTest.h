@@ -0,0 +1,42 @@
+//---------------------------------------------------------------
+//
+// BitPackingTest.h
+//
+
+#pragma once
+
+#include "common/BitPacking.h"
+#include "common/PackedMotion.h"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace Tests {
+
+//===============================================================================
+
+// States spread at random over the default MotionQuantization's world, heading every which way.
+inline std::vector<Common::MotionState> MakeMotionStates(uint32_t count, uint32_t seed = 1)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> position(-2000.0f, 2000.0f);
+	std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f);
+	std::uniform_real_distribution<float> speed(0.0f, 60.0f);
+
+	std::vector<Common::MotionState> states(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		float heading = angle(random);
+		states[i].entityId = i + 1;
+		states[i].position = { position(random), position(random) };
+		states[i].direction = { std::cos(heading), std::sin(heading) };
+		states[i].speed = speed(random);
+	}
+	return states;
+}
+
+//===============================================================================
+
+} // namespace Tests
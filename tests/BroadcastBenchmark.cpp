@@ -0,0 +1,82 @@
+//---------------------------------------------------------------
+//
+// BroadcastBenchmark.cpp
+//
+
+#include "AllocationCounter.h"
+#include "BenchmarkUtils.h"
+
+#include "Catch2/catch.hpp"
+#include "common/TcpSession.h"
+
+#include <asio.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Tests {
+
+namespace {
+	const uint32_t s_clientCount = 1000;
+	const uint32_t s_iterations = 20;
+
+	// Roughly the size of a world update.
+	const size_t s_payloadSize = 1200;
+} // anon namespace
+
+//===============================================================================
+
+TEST_CASE("Broadcasting one message to 1000 sessions.", "[.][Benchmark][Broadcast]")
+{
+	// Sessions are never started, so writes just sit in their output queues.
+	asio::io_context ioc;
+	std::vector<std::shared_ptr<Common::TcpSession>> sessions;
+	for (uint32_t i = 0; i < s_clientCount; ++i)
+	{
+		sessions.push_back(std::make_shared<Common::TcpSession>(asio::ip::tcp::socket(ioc),
+			"BroadcastBenchmark-" + std::to_string(i)));
+	}
+
+	const std::string payload(s_payloadSize, 'x');
+
+	// What PostMessageToClient did per client: a copy of the message for every session.
+	auto copyPerClient = [&]()
+	{
+		for (auto& session : sessions)
+		{
+			session->Write(std::string(payload));
+		}
+	};
+
+	// Serialize once and queue a reference on every session.
+	auto sharedBuffer = [&]()
+	{
+		auto buffer = std::make_shared<const std::string>(payload);
+		for (auto& session : sessions)
+		{
+			session->Write(buffer);
+		}
+	};
+
+	double before = MeasureThroughput("Copy per client", "sends", s_clientCount, s_iterations,
+		copyPerClient);
+	double after = MeasureThroughput("Shared buffer", "sends", s_clientCount, s_iterations,
+		sharedBuffer);
+	WARN("Speedup: " << after / before << "x");
+
+	AllocationScope copyAllocations;
+	copyPerClient();
+	uint64_t copyBytes = copyAllocations.GetBytes();
+
+	AllocationScope sharedAllocations;
+	sharedBuffer();
+	uint64_t sharedBytes = sharedAllocations.GetBytes();
+
+	WARN("Heap bytes per broadcast: copy per client=" << copyBytes << " shared buffer="
+		<< sharedBytes);
+	REQUIRE(sharedBytes < copyBytes);
+}
+
+//===============================================================================
+
+} // namespace Tests
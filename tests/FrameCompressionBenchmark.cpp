@@ -0,0 +1,144 @@
+//---------------------------------------------------------------
+//
+// FrameCompressionBenchmark.cpp
+//
+
+#include "BenchmarkUtils.h"
+#include "FrameCompressionTest.h"
+#include "SnapshotTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace Tests {
+
+namespace {
+	const uint32_t s_entityCount = 200;
+	const uint32_t s_tickCount = 100;
+
+	// What a client joining a busy area is sent every tick until it acks: the whole state,
+	// with a quarter of the entities having moved since the last one.
+	std::vector<std::string> MakeFullSnapshots()
+	{
+		Common::GameState world = MakeGameState(s_entityCount);
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+
+		std::vector<std::string> snapshots;
+		for (uint32_t tick = 0; tick < s_tickCount; ++tick)
+		{
+			for (const Common::EntityState& entity : std::vector<Common::EntityState>(world.GetEntities()))
+			{
+				if (chance(random) < 0.25f)
+				{
+					Common::EntityState* state = world.FindEntity(entity.entityId);
+					state->x += chance(random);
+					state->y += chance(random);
+				}
+			}
+
+			Common::SnapshotEncoder encoder;
+			snapshots.push_back(encoder.Encode(world));
+		}
+		return snapshots;
+	}
+
+	struct Setting
+	{
+		const char* name;
+		int level;
+		bool isStreamed;
+	};
+} // anon namespace
+
+//===============================================================================
+
+TEST_CASE("Frame compression ratio and throughput.", "[.][Benchmark][FrameCompression]")
+{
+	const std::vector<Setting> settings = {
+		{ "Per frame, level 1", 1, false },
+		{ "Per frame, level 6", 6, false },
+		{ "Streamed, level 1", 1, true },
+		{ "Streamed, level 6", 6, true } };
+
+	struct Payloads
+	{
+		const char* name;
+		std::vector<std::string> payloads;
+	};
+	std::vector<Payloads> kinds = {
+		{ "full snapshots", MakeFullSnapshots() },
+		{ "text", {} } };
+	for (uint32_t i = 0; i < s_tickCount; ++i)
+	{
+		kinds.back().payloads.push_back(MakeCompressiblePayload(i, 4000));
+	}
+
+	for (const Payloads& kind : kinds)
+	{
+		uint64_t bytes = 0;
+		for (const std::string& payload : kind.payloads)
+		{
+			bytes += payload.size();
+		}
+
+		for (const Setting& setting : settings)
+		{
+			// One pass to check the round trip and measure the ratio.
+			std::vector<std::string> compressed(kind.payloads.size());
+			{
+				Common::FrameCompressor compressor(setting.level, setting.isStreamed);
+				Common::FrameDecompressor decompressor;
+				std::string inflated;
+				for (size_t i = 0; i < kind.payloads.size(); ++i)
+				{
+					if (!compressor.Compress(kind.payloads[i], compressed[i]))
+					{
+						compressed[i].clear();
+						continue;
+					}
+					REQUIRE(decompressor.Decompress(compressed[i], 1024 * 1024, inflated));
+					REQUIRE(inflated == kind.payloads[i]);
+				}
+
+				const Common::CompressionStats& stats = compressor.GetStats();
+				WARN(kind.name << ", " << setting.name << ": " << bytes / kind.payloads.size()
+					<< " bytes per frame, ratio " << stats.Ratio() << ", "
+					<< stats.framesIncompressible << " incompressible");
+			}
+
+			// Streams have to start over each iteration so every frame is compressed the same
+			// way the first pass did.
+			std::string out;
+			MeasureThroughput(std::string(kind.name) + ", " + setting.name + " compress", "bytes",
+				bytes, 20, [&]()
+				{
+					Common::FrameCompressor compressor(setting.level, setting.isStreamed);
+					for (const std::string& payload : kind.payloads)
+					{
+						compressor.Compress(payload, out);
+					}
+				});
+
+			MeasureThroughput(std::string(kind.name) + ", " + setting.name + " decompress",
+				"bytes", bytes, 20, [&]()
+				{
+					Common::FrameDecompressor decompressor;
+					for (const std::string& payload : compressed)
+					{
+						if (!payload.empty())
+						{
+							decompressor.Decompress(payload, 1024 * 1024, out);
+						}
+					}
+				});
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
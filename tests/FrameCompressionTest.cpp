@@ -0,0 +1,313 @@
+//---------------------------------------------------------------
+//
+// FrameCompressionTest.cpp
+//
+
+#include "FrameCompressionTest.h"
+#include "WireFormatTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <string>
+#include <vector>
+
+namespace Tests {
+
+namespace {
+	std::string Preamble()
+	{
+		return std::string(Common::s_wirePreamble, Common::s_wirePreambleSize);
+	}
+
+	std::string CompressedFrame(Common::FrameCompressor& compressor, Common::MessageId id,
+		const std::string& payload, uint32_t flags = Common::CompactFrameNone)
+	{
+		std::string compressed;
+		REQUIRE(compressor.Compress(payload, compressed));
+		return Common::PackageCompactMessage(id, compressed, flags | Common::CompactFrameCompressed);
+	}
+} // anon namespace
+
+//===============================================================================
+
+SCENARIO("Compressing frames one at a time.", "[FrameCompression]")
+{
+	GIVEN("A compressor and a decompressor")
+	{
+		Common::FrameCompressor compressor(6, false);
+		Common::FrameDecompressor decompressor;
+
+		WHEN("A compressible payload is compressed")
+		{
+			const std::string payload = MakeCompressiblePayload(0, 2000);
+			std::string compressed;
+			REQUIRE(compressor.Compress(payload, compressed));
+
+			THEN("It's smaller and inflates back the same")
+			{
+				REQUIRE(compressed.size() < payload.size() / 2);
+				REQUIRE(compressed[0] == static_cast<char>(Common::CompressionMethod::Deflate));
+
+				std::string inflated;
+				REQUIRE(decompressor.Decompress(compressed, 4096, inflated));
+				REQUIRE(inflated == payload);
+			}
+
+			THEN("Both sides count it")
+			{
+				std::string inflated;
+				REQUIRE(decompressor.Decompress(compressed, 4096, inflated));
+
+				REQUIRE(compressor.GetStats().frames == 1);
+				REQUIRE(compressor.GetStats().uncompressedBytes == payload.size());
+				REQUIRE(compressor.GetStats().compressedBytes == compressed.size());
+				REQUIRE(compressor.GetStats().Ratio() < 0.5);
+				REQUIRE(decompressor.GetStats().frames == 1);
+				REQUIRE(decompressor.GetStats().uncompressedBytes == payload.size());
+			}
+		}
+
+		WHEN("Several payloads are compressed")
+		{
+			std::vector<std::string> payloads;
+			std::vector<std::string> compressed(3);
+			for (uint32_t i = 0; i < 3; ++i)
+			{
+				payloads.push_back(MakeCompressiblePayload(i * 100, 1000 + i * 500));
+				REQUIRE(compressor.Compress(payloads[i], compressed[i]));
+			}
+
+			THEN("Each inflates on its own, in any order")
+			{
+				for (uint32_t i : { 2, 0, 1 })
+				{
+					std::string inflated;
+					REQUIRE(decompressor.Decompress(compressed[i], 4096, inflated));
+					REQUIRE(inflated == payloads[i]);
+				}
+			}
+		}
+
+		WHEN("A payload that doesn't compress is compressed")
+		{
+			std::string compressed;
+			bool isCompressed = compressor.Compress(MakeRandomPayload(1000), compressed);
+
+			THEN("It's left to be sent as it is, and counted as incompressible")
+			{
+				REQUIRE(!isCompressed);
+				REQUIRE(compressor.GetStats().frames == 1);
+				REQUIRE(compressor.GetStats().framesIncompressible == 1);
+				REQUIRE(compressor.GetStats().compressedBytes == 1000);
+			}
+		}
+	}
+}
+
+SCENARIO("Compressing frames with a shared stream.", "[FrameCompression]")
+{
+	GIVEN("A streamed compressor and a run of payloads that are a lot alike")
+	{
+		Common::FrameCompressor compressor(6, true);
+		Common::FrameCompressor frameCompressor(6, false);
+		Common::FrameDecompressor decompressor;
+
+		std::vector<std::string> payloads;
+		for (uint32_t i = 0; i < 10; ++i)
+		{
+			payloads.push_back(MakeCompressiblePayload(i, 2000));
+		}
+
+		WHEN("They're compressed in turn")
+		{
+			std::vector<std::string> compressed(payloads.size());
+			for (size_t i = 0; i < payloads.size(); ++i)
+			{
+				REQUIRE(compressor.Compress(payloads[i], compressed[i]));
+			}
+
+			THEN("They inflate back the same, in order")
+			{
+				for (size_t i = 0; i < payloads.size(); ++i)
+				{
+					REQUIRE(compressed[i][0]
+						== static_cast<char>(Common::CompressionMethod::StreamedDeflate));
+
+					std::string inflated;
+					REQUIRE(decompressor.Decompress(compressed[i], 4096, inflated));
+					REQUIRE(inflated == payloads[i]);
+				}
+			}
+
+			THEN("Later ones cost far less than compressing each on its own")
+			{
+				std::string alone;
+				REQUIRE(frameCompressor.Compress(payloads.back(), alone));
+				REQUIRE(compressed.back().size() * 2 < alone.size());
+			}
+		}
+
+		WHEN("Streamed and per frame payloads arrive mixed together")
+		{
+			std::string streamed;
+			std::string alone;
+			REQUIRE(compressor.Compress(payloads[0], streamed));
+			REQUIRE(frameCompressor.Compress(payloads[1], alone));
+
+			std::string nextStreamed;
+			REQUIRE(compressor.Compress(payloads[2], nextStreamed));
+
+			THEN("Per frame ones don't disturb the shared stream")
+			{
+				std::string inflated;
+				REQUIRE(decompressor.Decompress(streamed, 4096, inflated));
+				REQUIRE(inflated == payloads[0]);
+				REQUIRE(decompressor.Decompress(alone, 4096, inflated));
+				REQUIRE(inflated == payloads[1]);
+				REQUIRE(decompressor.Decompress(nextStreamed, 4096, inflated));
+				REQUIRE(inflated == payloads[2]);
+			}
+		}
+	}
+}
+
+SCENARIO("Inflating payloads that can't be trusted.", "[FrameCompression]")
+{
+	GIVEN("A compressed payload")
+	{
+		Common::FrameCompressor compressor(6, false);
+		Common::FrameDecompressor decompressor;
+		const std::string payload = MakeCompressiblePayload(0, 2000);
+		std::string compressed;
+		REQUIRE(compressor.Compress(payload, compressed));
+		std::string inflated;
+
+		THEN("It's rejected if it claims to inflate to more than the limit")
+		{
+			REQUIRE(!decompressor.Decompress(compressed, 1999, inflated));
+		}
+
+		THEN("It's rejected if it's cut short")
+		{
+			REQUIRE(!decompressor.Decompress(std::string_view(compressed).substr(0,
+				compressed.size() - 4), 4096, inflated));
+		}
+
+		THEN("It's rejected if it claims the wrong size")
+		{
+			std::string wrongSize = compressed;
+			wrongSize[1] = static_cast<char>(static_cast<uint8_t>(wrongSize[1]) - 1);
+			REQUIRE(!decompressor.Decompress(wrongSize, 4096, inflated));
+		}
+
+		THEN("It's rejected if the method is unknown")
+		{
+			std::string unknown = compressed;
+			unknown[0] = 7;
+			REQUIRE(!decompressor.Decompress(unknown, 4096, inflated));
+		}
+
+		THEN("It's rejected if the deflate data is garbage")
+		{
+			std::string garbage = compressed.substr(0, 3) + MakeRandomPayload(200);
+			REQUIRE(!decompressor.Decompress(garbage, 4096, inflated));
+		}
+
+		THEN("The decompressor still works afterwards")
+		{
+			REQUIRE(!decompressor.Decompress("", 4096, inflated));
+			REQUIRE(decompressor.Decompress(compressed, 4096, inflated));
+			REQUIRE(inflated == payload);
+		}
+	}
+}
+
+SCENARIO("Parsing compressed compact frames.", "[FrameCompression]")
+{
+	GIVEN("A compact parser reading through a ring smaller than the frames")
+	{
+		Common::NetworkMessageParser parser;
+		parser.SetWireFormat(Common::WireFormat::Compact);
+		Common::ReceiveRing ring(64);
+		Common::FrameCompressor compressor(6, true);
+
+		WHEN("Compressed and plain frames arrive, some with checksums")
+		{
+			const std::string snapshot = MakeCompressiblePayload(0, 3000);
+			const std::string nextSnapshot = MakeCompressiblePayload(1, 3000);
+			// One at a time, since the streamed compressor has to see them in order.
+			std::string stream = Preamble();
+			stream += CompressedFrame(compressor, Common::MessageId::Snapshot, snapshot);
+			stream += Common::PackageCompactMessage(Common::MessageId::Move, "move");
+			stream += CompressedFrame(compressor, Common::MessageId::Snapshot, nextSnapshot,
+				Common::CompactFrameChecksum);
+
+			std::vector<Common::NetworkMessage> messages;
+			REQUIRE(ParseThroughRing(parser, ring, stream, messages));
+
+			THEN("Compressed ones come out inflated, with their inflated length")
+			{
+				REQUIRE(messages.size() == 3);
+				REQUIRE(messages[0].header.messageType == Common::MessageId::Snapshot);
+				REQUIRE(messages[0].header.messageLength == snapshot.size());
+				REQUIRE(messages[0].messageData == snapshot);
+				REQUIRE(messages[1].messageData == "move");
+				REQUIRE(messages[2].header.messageLength == nextSnapshot.size());
+				REQUIRE(messages[2].messageData == nextSnapshot);
+
+				REQUIRE(parser.GetDecompressionStats().frames == 2);
+			}
+		}
+
+		WHEN("Several compressed frames are parsed in one go")
+		{
+			const std::string first = MakeCompressiblePayload(0, 500);
+			const std::string second = MakeCompressiblePayload(1, 500);
+			Common::ReceiveRing bigRing(4096);
+			std::string stream = Preamble();
+			stream += CompressedFrame(compressor, Common::MessageId::Snapshot, first);
+			stream += CompressedFrame(compressor, Common::MessageId::Snapshot, second);
+
+			std::vector<Common::NetworkMessage> messages;
+			REQUIRE(ParseThroughRing(parser, bigRing, stream, messages));
+
+			THEN("Each view has a payload of its own")
+			{
+				REQUIRE(messages.size() == 2);
+				REQUIRE(messages[0].messageData == first);
+				REQUIRE(messages[1].messageData == second);
+			}
+		}
+
+		WHEN("A compressed frame would inflate past the size limit")
+		{
+			parser.SetMaxFrameSize(1000);
+			std::string stream = Preamble() + CompressedFrame(compressor,
+				Common::MessageId::Snapshot, MakeCompressiblePayload(0, 1001));
+
+			THEN("The parser gives up on it, though it's small on the wire")
+			{
+				REQUIRE(stream.size() < 1000);
+				std::vector<Common::NetworkMessage> messages;
+				REQUIRE(!ParseThroughRing(parser, ring, stream, messages));
+			}
+		}
+
+		WHEN("A compressed frame's checksum doesn't match")
+		{
+			std::string frame = CompressedFrame(compressor, Common::MessageId::Snapshot,
+				MakeCompressiblePayload(0, 1000), Common::CompactFrameChecksum);
+			frame.back() ^= 0x01;
+
+			THEN("The parser gives up on it")
+			{
+				std::vector<Common::NetworkMessage> messages;
+				REQUIRE(!ParseThroughRing(parser, ring, Preamble() + frame, messages));
+			}
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
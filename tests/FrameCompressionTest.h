@@ -0,0 +1,46 @@
+//---------------------------------------------------------------
+//
+// FrameCompressionTest.h
+//
+
+#pragma once
+
+#include "common/FrameCompression.h"
+
+#include <cstdint>
+#include <random>
+#include <string>
+
+namespace Tests {
+
+//===============================================================================
+
+// Something like a listing of entities, size bytes long. Payloads with nearby versions share
+// most of their text, the way consecutive snapshots of the same area do.
+inline std::string MakeCompressiblePayload(uint32_t version, size_t size)
+{
+	std::string payload;
+	for (uint32_t id = 1; payload.size() < size; ++id)
+	{
+		payload += "entity " + std::to_string(id) + " x=" + std::to_string(id * 3 + version / 4)
+			+ " y=" + std::to_string(id * 7) + " health=100;";
+	}
+	payload.resize(size);
+	return payload;
+}
+
+inline std::string MakeRandomPayload(size_t size, uint32_t seed = 1)
+{
+	std::mt19937 random(seed);
+	std::uniform_int_distribution<int> byte(0, 255);
+	std::string payload(size, '\0');
+	for (char& c : payload)
+	{
+		c = static_cast<char>(byte(random));
+	}
+	return payload;
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,136 @@
+//---------------------------------------------------------------
+//
+// InterestGridBenchmark.cpp
+//
+
+#include "BenchmarkUtils.h"
+#include "InterestGridTest.h"
+
+#include "Catch2/catch.hpp"
+#include "common/Snapshot.h"
+
+#include <string>
+#include <vector>
+
+namespace Tests {
+
+namespace {
+	const uint32_t s_clientCount = 1000;
+	const uint32_t s_entityCount = 20000;
+	const float s_worldSize = 4000.0f;
+	const uint32_t s_tickCount = 30;
+	const uint32_t s_ackDelayTicks = 3;
+
+	// Sending everything keeps the whole world in each client's snapshot history, which for 1000
+	// clients is more memory than a test should take. Every client gets the same bytes when
+	// there's no filtering, so a few are run and the rest extrapolated.
+	const uint32_t s_everythingSampleCount = 10;
+
+	// A quarter of the entities move each tick.
+	void SimulateTick(Common::GameState& world, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+		std::uniform_real_distribution<float> step(-3.0f, 3.0f);
+		for (const Common::EntityState& entity : world.GetEntities())
+		{
+			if (chance(random) < 0.25f)
+			{
+				Common::EntityState* state = world.FindEntity(entity.entityId);
+				state->x += step(random);
+				state->y += step(random);
+			}
+		}
+	}
+
+	struct Result
+	{
+		double tickMs = 0.0;
+		double bytesPerClient = 0.0;
+	};
+
+	// Runs the ticks for clientCount clients, each sent a snapshot of what filter leaves of the
+	// world. Only the server's side of each tick is timed, not simulating the world.
+	template <typename Filter>
+	Result Run(uint32_t clientCount, Filter&& filter)
+	{
+		Common::GameState world = MakeScatteredGameState(s_entityCount, s_worldSize);
+		std::mt19937 random(1);
+		std::vector<Common::SnapshotEncoder> encoders(clientCount);
+
+		uint64_t bytes = 0;
+		Common::Timer timer;
+		timer.Start();
+		timer.Pause();
+		for (uint32_t tick = 1; tick <= s_tickCount; ++tick)
+		{
+			SimulateTick(world, random);
+
+			timer.Resume();
+			for (uint32_t client = 0; client < clientCount; ++client)
+			{
+				bytes += encoders[client].Encode(filter(world, client)).size();
+				if (tick > s_ackDelayTicks)
+				{
+					encoders[client].OnAck(tick - s_ackDelayTicks);
+				}
+			}
+			timer.Pause();
+		}
+		timer.Stop();
+
+		Result result;
+		result.tickMs = timer.GetElapsedUs().count() / 1000.0 / s_tickCount;
+		result.bytesPerClient = static_cast<double>(bytes) / clientCount / s_tickCount;
+		return result;
+	}
+} // anon namespace
+
+//===============================================================================
+
+TEST_CASE("Interest filtered snapshots for 1000 clients and 20000 entities.", "[.][Benchmark][InterestGrid]")
+{
+	Result everything = Run(s_everythingSampleCount,
+		[](const Common::GameState& world, uint32_t) -> const Common::GameState& { return world; });
+	everything.tickMs *= static_cast<double>(s_clientCount) / s_everythingSampleCount;
+
+	// Clients scattered over the world, each seeing entities within 200 units.
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> position(-s_worldSize / 2.0f, s_worldSize / 2.0f);
+	std::vector<Common::InterestArea> areas(s_clientCount);
+	for (Common::InterestArea& area : areas)
+	{
+		area.x = position(random);
+		area.y = position(random);
+	}
+
+	Common::InterestGrid grid(200.0f);
+	std::vector<Common::InterestSet> interests(s_clientCount);
+	Common::GameState visibleState;
+	uint64_t visibleCount = 0;
+	Result filtered = Run(s_clientCount,
+		[&](const Common::GameState& world, uint32_t client) -> const Common::GameState&
+		{
+			// Once a tick, before the first client, as Game::Tick does.
+			if (client == 0)
+			{
+				grid.Rebuild(world);
+			}
+
+			interests[client].Update(grid, areas[client]);
+			interests[client].Filter(world, visibleState);
+			visibleCount += interests[client].GetVisible().size();
+			return visibleState;
+		});
+
+	WARN("Everything (extrapolated from " << s_everythingSampleCount << " clients): tick="
+		<< everything.tickMs << "ms, " << static_cast<uint64_t>(everything.bytesPerClient)
+		<< " bytes/client/tick");
+	WARN("Interest filtered: tick=" << filtered.tickMs << "ms, "
+		<< static_cast<uint64_t>(filtered.bytesPerClient) << " bytes/client/tick, "
+		<< visibleCount / s_clientCount / s_tickCount << " entities in view per client");
+	REQUIRE(filtered.bytesPerClient < everything.bytesPerClient);
+}
+
+//===============================================================================
+
+} // namespace Tests
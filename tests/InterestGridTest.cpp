@@ -0,0 +1,196 @@
+//---------------------------------------------------------------
+//
+// InterestGridTest.cpp
+//
+
+#include "InterestGridTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <vector>
+
+namespace Tests {
+
+namespace {
+	// What the grid should find, worked out by checking every entity.
+	std::vector<uint32_t> QueryAll(const Common::GameState& state, float x, float y, float radius)
+	{
+		std::vector<uint32_t> entityIds;
+		for (const Common::EntityState& entity : state.GetEntities())
+		{
+			float dx = entity.x - x;
+			float dy = entity.y - y;
+			if (dx * dx + dy * dy <= radius * radius)
+			{
+				entityIds.push_back(entity.entityId);
+			}
+		}
+		return entityIds;
+	}
+
+	void MoveEntity(Common::GameState& state, uint32_t entityId, float x, float y)
+	{
+		Common::EntityState entity;
+		entity.entityId = entityId;
+		entity.x = x;
+		entity.y = y;
+		state.SetEntity(entity);
+	}
+} // anon namespace
+
+//===============================================================================
+
+SCENARIO("Finding entities near a point.", "[InterestGrid]")
+{
+	GIVEN("A grid over scattered entities, including some on negative cells")
+	{
+		Common::GameState state = MakeScatteredGameState(2000, 2000.0f);
+		Common::InterestGrid grid(100.0f);
+		grid.Rebuild(state);
+
+		THEN("Queries find the same entities as checking every one")
+		{
+			std::mt19937 random(3);
+			std::uniform_real_distribution<float> position(-1100.0f, 1100.0f);
+			std::vector<uint32_t> entityIds;
+			for (float radius : { 0.0f, 30.0f, 150.0f, 450.0f, 5000.0f })
+			{
+				for (int i = 0; i < 20; ++i)
+				{
+					float x = position(random);
+					float y = position(random);
+					grid.Query(x, y, radius, entityIds);
+					REQUIRE(entityIds == QueryAll(state, x, y, radius));
+				}
+			}
+		}
+
+		WHEN("The state changes and the grid is rebuilt")
+		{
+			MoveEntity(state, 1, 10000.0f, 10000.0f);
+			state.RemoveEntity(2);
+			grid.Rebuild(state);
+
+			THEN("Queries see the new positions")
+			{
+				std::vector<uint32_t> entityIds;
+				grid.Query(10000.0f, 10000.0f, 1.0f, entityIds);
+				REQUIRE(entityIds == std::vector<uint32_t>{ 1 });
+
+				grid.Query(0.0f, 0.0f, 5000.0f, entityIds);
+				REQUIRE(entityIds.size() == 1998);
+			}
+		}
+	}
+}
+
+SCENARIO("Tracking what a client can see.", "[InterestGrid]")
+{
+	GIVEN("A client's view with entities inside, on the edge and outside")
+	{
+		Common::GameState state;
+		MoveEntity(state, 1, 0.0f, 0.0f);
+		MoveEntity(state, 2, 150.0f, 0.0f);
+		MoveEntity(state, 3, 0.0f, 500.0f);
+
+		Common::InterestGrid grid(100.0f);
+		Common::InterestArea area;
+		area.enterRadius = 200.0f;
+		area.leaveRadius = 250.0f;
+
+		grid.Rebuild(state);
+		Common::InterestSet interest;
+		interest.Update(grid, area);
+
+		THEN("The ones inside enter view")
+		{
+			REQUIRE(interest.GetVisible() == std::vector<uint32_t>{ 1, 2 });
+			REQUIRE(interest.GetEntered() == std::vector<uint32_t>{ 1, 2 });
+			REQUIRE(interest.GetLeft().empty());
+		}
+
+		WHEN("An entity in view moves between the two radii")
+		{
+			MoveEntity(state, 2, 220.0f, 0.0f);
+			grid.Rebuild(state);
+			interest.Update(grid, area);
+
+			THEN("It stays in view and nothing enters or leaves")
+			{
+				REQUIRE(interest.GetVisible() == std::vector<uint32_t>{ 1, 2 });
+				REQUIRE(interest.GetEntered().empty());
+				REQUIRE(interest.GetLeft().empty());
+			}
+
+			AND_WHEN("It moves beyond the leave radius")
+			{
+				MoveEntity(state, 2, 260.0f, 0.0f);
+				grid.Rebuild(state);
+				interest.Update(grid, area);
+
+				THEN("It leaves view")
+				{
+					REQUIRE(interest.GetVisible() == std::vector<uint32_t>{ 1 });
+					REQUIRE(interest.GetLeft() == std::vector<uint32_t>{ 2 });
+				}
+
+				AND_WHEN("It comes back between the two radii")
+				{
+					MoveEntity(state, 2, 220.0f, 0.0f);
+					grid.Rebuild(state);
+					interest.Update(grid, area);
+
+					THEN("It stays out of view until it's within the enter radius")
+					{
+						REQUIRE(interest.GetVisible() == std::vector<uint32_t>{ 1 });
+						REQUIRE(interest.GetEntered().empty());
+					}
+				}
+			}
+		}
+
+		WHEN("The area moves")
+		{
+			area.y = 450.0f;
+			interest.Update(grid, area);
+
+			THEN("What it moved away from leaves and what it moved to enters")
+			{
+				REQUIRE(interest.GetVisible() == std::vector<uint32_t>{ 3 });
+				REQUIRE(interest.GetEntered() == std::vector<uint32_t>{ 3 });
+				REQUIRE(interest.GetLeft() == std::vector<uint32_t>{ 1, 2 });
+			}
+		}
+
+		WHEN("An entity in view is removed from the world")
+		{
+			state.RemoveEntity(1);
+			grid.Rebuild(state);
+			interest.Update(grid, area);
+
+			THEN("It leaves view")
+			{
+				REQUIRE(interest.GetVisible() == std::vector<uint32_t>{ 2 });
+				REQUIRE(interest.GetLeft() == std::vector<uint32_t>{ 1 });
+			}
+		}
+
+		WHEN("The state is filtered to what's in view")
+		{
+			Common::GameState visibleState;
+			interest.Filter(state, visibleState);
+
+			THEN("Only the visible entities are in it, as they are in the world")
+			{
+				REQUIRE(visibleState.GetEntities().size() == 2);
+				REQUIRE(visibleState.GetEntities()[0].entityId == 1);
+				REQUIRE(visibleState.GetEntities()[1].entityId == 2);
+				REQUIRE(visibleState.GetEntities()[1].x == 150.0f);
+			}
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,40 @@
+//---------------------------------------------------------------
+//
+// InterestGridTest.h
+//
+
+#pragma once
+
+#include "common/GameState.h"
+#include "common/InterestGrid.h"
+
+#include <cstdint>
+#include <random>
+
+namespace Tests {
+
+//===============================================================================
+
+// A world of entities with ids 1 to count, scattered at random over a square size units across
+// centred on the origin.
+inline Common::GameState MakeScatteredGameState(uint32_t count, float size, uint32_t seed = 1)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> position(-size / 2.0f, size / 2.0f);
+
+	Common::GameState state;
+	for (uint32_t id = 1; id <= count; ++id)
+	{
+		Common::EntityState entity;
+		entity.entityId = id;
+		entity.x = position(random);
+		entity.y = position(random);
+		entity.health = 100;
+		state.SetEntity(entity);
+	}
+	return state;
+}
+
+//===============================================================================
+
+} // namespace Tests
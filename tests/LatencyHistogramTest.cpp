@@ -0,0 +1,107 @@
+//---------------------------------------------------------------
+//
+// LatencyHistogramTest.cpp
+//
+
+#include "LatencyHistogramTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <chrono>
+
+using namespace std::chrono_literals;
+
+namespace Tests {
+
+//===============================================================================
+
+SCENARIO("Reading percentiles out of a latency histogram.", "[LatencyHistogram]")
+{
+	GIVEN("An empty histogram")
+	{
+		Common::LatencyHistogram histogram;
+
+		THEN("Everything reads as zero")
+		{
+			REQUIRE(histogram.GetCount() == 0);
+			REQUIRE(histogram.GetPercentile(50.0) == 0us);
+			REQUIRE(histogram.GetMin() == 0us);
+			REQUIRE(histogram.GetMax() == 0us);
+			REQUIRE(histogram.GetMean() == 0us);
+		}
+	}
+
+	GIVEN("The values 1 to 1000 milliseconds")
+	{
+		Common::LatencyHistogram histogram;
+		for (int i = 1; i <= 1000; ++i)
+		{
+			histogram.Record(std::chrono::milliseconds(i));
+		}
+
+		THEN("Percentiles are within a few percent of the real ones")
+		{
+			for (double percentile : { 1.0, 50.0, 95.0, 99.0 })
+			{
+				double expected = percentile * 10000.0;
+				double actual = static_cast<double>(histogram.GetPercentile(percentile).count());
+				REQUIRE(actual == Approx(expected).epsilon(0.035));
+			}
+		}
+
+		THEN("The count, extremes and mean are exact")
+		{
+			REQUIRE(histogram.GetCount() == 1000);
+			REQUIRE(histogram.GetMin() == 1ms);
+			REQUIRE(histogram.GetMax() == 1000ms);
+			REQUIRE(histogram.GetMean() == 500500us);
+			REQUIRE(histogram.GetPercentile(100.0) == 1000ms);
+		}
+	}
+
+	GIVEN("Small values")
+	{
+		Common::LatencyHistogram histogram;
+		histogram.Record(3us);
+		histogram.Record(7us);
+		histogram.Record(7us);
+
+		THEN("Each gets its own bucket and reads back exactly")
+		{
+			REQUIRE(histogram.GetPercentile(33.0) == 3us);
+			REQUIRE(histogram.GetPercentile(50.0) == 7us);
+		}
+	}
+
+	GIVEN("Two histograms")
+	{
+		Common::LatencyHistogram fast;
+		Common::LatencyHistogram slow;
+		for (int i = 0; i < 90; ++i)
+		{
+			fast.Record(100us);
+		}
+		for (int i = 0; i < 10; ++i)
+		{
+			slow.Record(50ms);
+		}
+
+		WHEN("One is merged into the other")
+		{
+			fast.Merge(slow);
+
+			THEN("Percentiles cover the samples from both")
+			{
+				REQUIRE(fast.GetCount() == 100);
+				REQUIRE(fast.GetPercentile(90.0).count() == Approx(100).epsilon(0.035));
+				REQUIRE(fast.GetPercentile(95.0).count() == Approx(50000).epsilon(0.035));
+				REQUIRE(fast.GetMax() == 50ms);
+				REQUIRE(fast.GetMin() == 100us);
+			}
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,8 @@
+//---------------------------------------------------------------
+//
+// LatencyHistogramTest.h
+//
+
+#pragma once
+
+#include "common/LatencyHistogram.h"
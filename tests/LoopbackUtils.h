@@ -0,0 +1,72 @@
+//---------------------------------------------------------------
+//
+// LoopbackUtils.h
+//
+// Shared by the fixtures that run sessions, channels and listeners over loopback.
+//
+
+#pragma once
+
+#include <asio.hpp>
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace Tests {
+
+//===============================================================================
+
+// How long a test waits for something to happen over loopback before giving up on it.
+constexpr std::chrono::seconds s_loopbackTimeout{ 5 };
+
+inline asio::ip::address GetLoopbackAddress()
+{
+	return asio::ip::make_address("127.0.0.1");
+}
+
+// Loggers are registered by name, so every session, channel and listener a test makes needs a
+// name of its own.
+inline std::string MakeLoggingContext(const std::string& prefix)
+{
+	static int s_count = 0;
+	return prefix + "-" + std::to_string(s_count++);
+}
+
+// For fixtures whose test drives the io_context itself, so every handler runs on the test's
+// thread. Polls it until done returns true. Returns false if that takes too long.
+template <typename Fn>
+bool PumpUntil(asio::io_context& ioc, Fn&& done)
+{
+	auto deadline = std::chrono::steady_clock::now() + s_loopbackTimeout;
+	while (!done())
+	{
+		if (std::chrono::steady_clock::now() > deadline)
+		{
+			return false;
+		}
+		ioc.restart();
+		ioc.poll();
+	}
+	return true;
+}
+
+// For fixtures whose io_context runs on threads of their own. Returns false if done doesn't
+// return true in time.
+template <typename Fn>
+bool WaitUntil(Fn&& done)
+{
+	auto deadline = std::chrono::steady_clock::now() + s_loopbackTimeout;
+	while (!done())
+	{
+		if (std::chrono::steady_clock::now() > deadline)
+		{
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,101 @@
+//---------------------------------------------------------------
+//
+// MessageDispatcherBenchmark.cpp
+//
+
+#include "AllocationCounter.h"
+#include "BenchmarkUtils.h"
+#include "MessageDispatcherTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <memory>
+
+namespace Tests {
+
+namespace {
+	const uint32_t s_messagesPerTick = 2000;
+	const uint32_t s_iterations = 500;
+} // anon namespace
+
+//===============================================================================
+
+TEST_CASE("Decoding a tick of messages on the heap vs in an arena.", "[.][Benchmark][MessageDispatcher]")
+{
+	Common::MessageBatch batch;
+	for (uint32_t i = 0; i < s_messagesPerTick; ++i)
+	{
+		AppendToBatch(batch, Common::MessageId::TestMessage,
+			MakeTestMessage(static_cast<int>(i)).SerializeAsString());
+	}
+
+	int64_t sum = 0;
+	Common::MessageDispatcher::Handler<Hydra::TestMessage> handle = [&sum](uint32_t, const Hydra::TestMessage& message)
+	{
+		sum += message.value_1();
+	};
+
+	// A fresh heap allocated message per payload, freed once its handler has run.
+	auto decodeOnHeap = [&]()
+	{
+		for (size_t i = 0; i < batch.Size(); ++i)
+		{
+			auto message = std::make_unique<Hydra::TestMessage>();
+			const auto& payload = batch[i].messageData;
+			message->ParseFromArray(payload.data(), static_cast<int>(payload.size()));
+			handle(0, *message);
+		}
+	};
+
+	// The same loop, with every message of the tick placed in an arena that's reset at the end.
+	google::protobuf::Arena arena;
+	auto decodeInArena = [&]()
+	{
+		for (size_t i = 0; i < batch.Size(); ++i)
+		{
+			auto* message = google::protobuf::Arena::CreateMessage<Hydra::TestMessage>(&arena);
+			const auto& payload = batch[i].messageData;
+			message->ParseFromArray(payload.data(), static_cast<int>(payload.size()));
+			handle(0, *message);
+		}
+		arena.Reset();
+	};
+
+	// The whole dispatch path, with an initial block big enough for the tick.
+	Common::MessageDispatcher dispatcher(s_messagesPerTick * 128);
+	dispatcher.RegisterHandler<Hydra::TestMessage>(Common::MessageId::TestMessage, handle);
+	auto dispatch = [&]()
+	{
+		dispatcher.Dispatch(0, batch);
+		dispatcher.EndTick();
+	};
+
+	double heapRate = MeasureThroughput("Heap decode", "messages", s_messagesPerTick,
+		s_iterations, decodeOnHeap);
+	double arenaRate = MeasureThroughput("Arena decode", "messages", s_messagesPerTick,
+		s_iterations, decodeInArena);
+	MeasureThroughput("MessageDispatcher", "messages", s_messagesPerTick, s_iterations, dispatch);
+	WARN("Arena speedup: " << arenaRate / heapRate << "x");
+
+	AllocationScope heapAllocations;
+	decodeOnHeap();
+	uint64_t heapCount = heapAllocations.GetCount();
+
+	AllocationScope arenaAllocations;
+	decodeInArena();
+	uint64_t arenaCount = arenaAllocations.GetCount();
+
+	AllocationScope dispatchAllocations;
+	dispatch();
+	uint64_t dispatchCount = dispatchAllocations.GetCount();
+
+	WARN("Heap allocations per tick: heap=" << heapCount << " arena=" << arenaCount
+		<< " dispatcher=" << dispatchCount);
+	REQUIRE(arenaCount < heapCount);
+	REQUIRE(dispatchCount == 0);
+	REQUIRE(sum != 0);
+}
+
+//===============================================================================
+
+} // namespace Tests
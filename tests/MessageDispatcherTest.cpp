@@ -0,0 +1,267 @@
+//---------------------------------------------------------------
+//
+// MessageDispatcherTest.cpp
+//
+
+#include "MessageDispatcherTest.h"
+#include "AllocationCounter.h"
+
+#include "Catch2/catch.hpp"
+
+#include <vector>
+
+namespace Tests {
+
+//===============================================================================
+
+SCENARIO("Dispatching a batch of messages.", "[MessageDispatcher]")
+{
+	GIVEN("A dispatcher with a TestMessage handler")
+	{
+		Common::MessageDispatcher dispatcher;
+
+		std::vector<int> received;
+		std::vector<uint32_t> senders;
+		dispatcher.RegisterHandler<Hydra::TestMessage>(Common::MessageId::TestMessage,
+			[&](uint32_t sender, const Hydra::TestMessage& message)
+			{
+				received.push_back(message.value_1());
+				senders.push_back(sender);
+			});
+
+		WHEN("A batch mixing handled and unhandled ids is dispatched")
+		{
+			Common::MessageBatch batch;
+			AppendToBatch(batch, Common::MessageId::TestMessage,
+				MakeTestMessage(1).SerializeAsString());
+			AppendToBatch(batch, Common::MessageId::Move, "not registered");
+			AppendToBatch(batch, Common::MessageId::TestMessage,
+				MakeTestMessage(2).SerializeAsString());
+			AppendToBatch(batch, static_cast<Common::MessageId>(9999), "garbage id");
+			AppendToBatch(batch, Common::MessageId::TestMessage,
+				MakeTestMessage(3).SerializeAsString());
+
+			uint32_t handled = dispatcher.Dispatch(7, batch);
+
+			THEN("Handled messages are decoded and delivered in order")
+			{
+				REQUIRE(handled == 3);
+				REQUIRE(received == std::vector<int>{ 1, 2, 3 });
+				REQUIRE(senders == std::vector<uint32_t>{ 7, 7, 7 });
+			}
+			AND_THEN("Everything else is counted as unhandled")
+			{
+				REQUIRE(dispatcher.GetUnhandledCount() == 2);
+			}
+			AND_THEN("Latency is tracked per message type")
+			{
+				const auto& stats = dispatcher.GetStats(Common::MessageId::TestMessage);
+				REQUIRE(stats.dispatched == 3);
+				REQUIRE(stats.maxLatency >= stats.AverageLatency());
+				REQUIRE(dispatcher.GetStats(Common::MessageId::Move).dispatched == 0);
+			}
+		}
+		AND_WHEN("A payload can't be decoded")
+		{
+			Common::MessageBatch batch;
+			AppendToBatch(batch, Common::MessageId::TestMessage, std::string(4, '\xff'));
+			dispatcher.Dispatch(0, batch);
+
+			THEN("The handler isn't called and the failure is counted")
+			{
+				REQUIRE(received.empty());
+				REQUIRE(dispatcher.GetStats(Common::MessageId::TestMessage).decodeFailures == 1);
+			}
+		}
+		AND_WHEN("The handler is unregistered")
+		{
+			dispatcher.UnregisterHandler(Common::MessageId::TestMessage);
+
+			Common::MessageBatch batch;
+			AppendToBatch(batch, Common::MessageId::TestMessage,
+				MakeTestMessage(1).SerializeAsString());
+
+			THEN("Messages with that id are no longer delivered")
+			{
+				REQUIRE(dispatcher.Dispatch(0, batch) == 0);
+				REQUIRE(received.empty());
+			}
+		}
+		AND_WHEN("A handler swaps the TestMessage handler for a raw one partway through a batch")
+		{
+			std::vector<std::string> raw;
+			dispatcher.RegisterRawHandler(Common::MessageId::Move,
+				[&](uint32_t, const std::string_view&)
+				{
+					dispatcher.RegisterRawHandler(Common::MessageId::TestMessage,
+						[&raw](uint32_t, const std::string_view& data) { raw.emplace_back(data); });
+				});
+
+			Common::MessageBatch batch;
+			AppendToBatch(batch, Common::MessageId::TestMessage,
+				MakeTestMessage(1).SerializeAsString());
+			AppendToBatch(batch, Common::MessageId::Move, "swap");
+			AppendToBatch(batch, Common::MessageId::TestMessage,
+				MakeTestMessage(2).SerializeAsString());
+			uint32_t handled = dispatcher.Dispatch(0, batch);
+
+			THEN("Messages decoded for the old handler aren't given to the new one")
+			{
+				REQUIRE(handled == 2);
+				REQUIRE(received == std::vector<int>{ 1 });
+				REQUIRE(raw.empty());
+				REQUIRE(dispatcher.GetUnhandledCount() == 1);
+			}
+		}
+		AND_WHEN("A handler replaces and then unregisters itself")
+		{
+			// Captures enough that using them after they're freed shows up under a sanitizer.
+			std::string name(64, 'm');
+			std::vector<std::string> moves;
+			std::vector<std::string> replaced;
+			dispatcher.RegisterRawHandler(Common::MessageId::Move,
+				[&, name](uint32_t, const std::string_view& data)
+				{
+					dispatcher.RegisterRawHandler(Common::MessageId::Move,
+						[&replaced](uint32_t, const std::string_view& payload)
+						{
+							replaced.emplace_back(payload);
+						});
+					moves.push_back(name + std::string(data));
+					dispatcher.UnregisterHandler(Common::MessageId::Move);
+					moves.push_back(name);
+				});
+
+			Common::MessageBatch batch;
+			AppendToBatch(batch, Common::MessageId::Move, "first");
+			AppendToBatch(batch, Common::MessageId::Move, "second");
+			uint32_t handled = dispatcher.Dispatch(0, batch);
+
+			THEN("It runs to the end with its captures intact and nothing else gets the batch")
+			{
+				REQUIRE(handled == 1);
+				REQUIRE(moves == std::vector<std::string>{ name + "first", name });
+				REQUIRE(replaced.empty());
+				REQUIRE(dispatcher.GetUnhandledCount() == 1);
+			}
+		}
+		AND_WHEN("A handler dispatches a batch of its own")
+		{
+			Common::MessageBatch inner;
+			AppendToBatch(inner, Common::MessageId::TestMessage,
+				MakeTestMessage(10).SerializeAsString());
+			AppendToBatch(inner, Common::MessageId::TestMessage,
+				MakeTestMessage(11).SerializeAsString());
+			dispatcher.RegisterRawHandler(Common::MessageId::Move,
+				[&](uint32_t, const std::string_view&) { dispatcher.Dispatch(1, inner); });
+
+			Common::MessageBatch batch;
+			AppendToBatch(batch, Common::MessageId::Move, "nested");
+			AppendToBatch(batch, Common::MessageId::TestMessage,
+				MakeTestMessage(2).SerializeAsString());
+			uint32_t handled = dispatcher.Dispatch(0, batch);
+
+			THEN("Both batches are delivered whole, the inner one first")
+			{
+				REQUIRE(handled == 2);
+				REQUIRE(received == std::vector<int>{ 10, 11, 2 });
+				REQUIRE(senders == std::vector<uint32_t>{ 1, 1, 0 });
+			}
+		}
+	}
+}
+
+SCENARIO("Dispatching raw payloads.", "[MessageDispatcher]")
+{
+	GIVEN("A dispatcher with a raw handler")
+	{
+		Common::MessageDispatcher dispatcher;
+		std::string payload;
+		dispatcher.RegisterRawHandler(Common::MessageId::Move,
+			[&payload](uint32_t, const std::string_view& data) { payload = std::string(data); });
+
+		WHEN("A message with that id is dispatched")
+		{
+			Common::MessageBatch batch;
+			AppendToBatch(batch, Common::MessageId::Move, "raw bytes");
+			dispatcher.Dispatch(0, batch);
+
+			THEN("The handler sees the payload untouched")
+			{
+				REQUIRE(payload == "raw bytes");
+			}
+		}
+	}
+}
+
+SCENARIO("Decoding into the dispatcher's arena.", "[MessageDispatcher]")
+{
+	GIVEN("A dispatcher with a handler that holds on to what it's given")
+	{
+		Common::MessageDispatcher dispatcher;
+
+		std::vector<const Hydra::TestMessage*> received;
+		dispatcher.RegisterHandler<Hydra::TestMessage>(Common::MessageId::TestMessage,
+			[&received](uint32_t, const Hydra::TestMessage& message)
+			{
+				received.push_back(&message);
+			});
+
+		Common::MessageBatch batch;
+		for (int i = 0; i < 100; ++i)
+		{
+			AppendToBatch(batch, Common::MessageId::TestMessage,
+				MakeTestMessage(i).SerializeAsString());
+		}
+
+		WHEN("Several batches are dispatched in one tick")
+		{
+			dispatcher.Dispatch(0, batch);
+			dispatcher.Dispatch(0, batch);
+
+			THEN("Every decoded message is still intact until the tick ends")
+			{
+				REQUIRE(received.size() == 200);
+				for (size_t i = 0; i < received.size(); ++i)
+				{
+					REQUIRE(received[i]->value_1() == static_cast<int>(i % 100));
+					REQUIRE(received[i]->some_test_message() == MakeTestMessage(i % 100).some_test_message());
+				}
+			}
+			AND_WHEN("The tick ends")
+			{
+				dispatcher.EndTick();
+
+				THEN("What the tick used is recorded")
+				{
+					const auto& stats = dispatcher.GetArenaStats();
+					REQUIRE(stats.ticks == 1);
+					REQUIRE(stats.messagesDecoded == 200);
+					REQUIRE(stats.lastTickBytes > 0);
+					REQUIRE(stats.peakTickBytes == stats.lastTickBytes);
+				}
+			}
+		}
+		AND_WHEN("A tick is dispatched after the dispatcher has warmed up")
+		{
+			dispatcher.Dispatch(0, batch);
+			dispatcher.EndTick();
+			received.clear();
+
+			AllocationScope allocations;
+			dispatcher.Dispatch(0, batch);
+			dispatcher.EndTick();
+			uint64_t allocationCount = allocations.GetCount();
+
+			THEN("Decoding doesn't touch the heap")
+			{
+				REQUIRE(received.size() == 100);
+				REQUIRE(allocationCount == 0);
+			}
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,36 @@
+//---------------------------------------------------------------
+//
+// MessageDispatcherTest.h
+//
+
+#pragma once
+
+#include "common/MessageDispatcher.h"
+#include "common/NetworkTypes.h"
+#include "proto/TestMessage.pb.h"
+
+#include <string>
+
+namespace Tests {
+
+//===============================================================================
+
+inline Hydra::TestMessage MakeTestMessage(int value)
+{
+	Hydra::TestMessage message;
+	message.set_some_test_message("message " + std::to_string(value));
+	message.set_value_1(value);
+	return message;
+}
+
+// Appends a message to the batch as though it had just been parsed off the wire.
+inline void AppendToBatch(Common::MessageBatch& batch, Common::MessageId id,
+	const std::string& payload)
+{
+	Common::MessageHeader header{ id, static_cast<uint32_t>(payload.size()) };
+	batch.Append({ header, payload });
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,68 @@
+//---------------------------------------------------------------
+//
+// MessageParserBenchmark.cpp
+//
+
+#include "BenchmarkUtils.h"
+#include "MessageParserTest.h"
+
+#include "Catch2/catch.hpp"
+#include "common/ReceiveRing.h"
+
+#include <cstring>
+
+namespace Tests {
+
+namespace {
+	const uint32_t s_streamSize = 65536;
+	const uint32_t s_iterations = 500;
+} // anon namespace
+
+//===============================================================================
+
+TEST_CASE_METHOD(HelperFixture, "Message parser throughput, string vs receive ring.",
+	"[.][Benchmark][Message Parser]")
+{
+	std::string packagedMessage = PackageMessage(GetDefaultTestMessage().SerializeAsString(),
+		Common::MessageId::TestMessage);
+
+	// Same 64k of back to back messages that a full socket read would hand us.
+	const uint32_t messagesPerRead = s_streamSize / static_cast<uint32_t>(packagedMessage.size());
+	std::string stream;
+	stream.reserve(s_streamSize);
+	for (uint32_t i = 0; i < messagesPerRead; ++i)
+	{
+		stream.append(packagedMessage);
+	}
+
+	std::vector<Common::NetworkMessage> messages;
+	messages.reserve(messagesPerRead);
+	double before = MeasureThroughput("ExtractMessages(std::string)", "messages", messagesPerRead,
+		s_iterations, [&]()
+		{
+			messages.clear();
+			ExtractMessages(stream, messages);
+		});
+	REQUIRE(messages.size() == messagesPerRead);
+
+	Common::ReceiveRing benchRing(s_streamSize);
+	std::vector<Common::NetworkMessageView> views;
+	views.reserve(messagesPerRead);
+	double after = MeasureThroughput("ExtractMessages(ReceiveRing)", "messages", messagesPerRead,
+		s_iterations, [&]()
+		{
+			// Stand in for the socket read landing in the ring.
+			std::memcpy(benchRing.WriteData(), stream.data(), stream.size());
+			benchRing.CommitWrite(static_cast<uint32_t>(stream.size()));
+
+			views.clear();
+			networkParser->ExtractMessages(benchRing, views);
+		});
+	REQUIRE(views.size() == messagesPerRead);
+
+	WARN("Speedup: " << after / before << "x");
+}
+
+//===============================================================================
+
+} // namespace Tests
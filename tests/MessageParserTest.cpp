@@ -4,6 +4,7 @@
 //
 
 #include "MessageParserTest.h"
+#include "AllocationCounter.h"
 
 #include "Catch2/catch.hpp"
 #include "common/Log.h"
@@ -242,6 +243,168 @@ SCENARIO_METHOD(HelperFixture, "Messages get parsed unevenly in addition to bein
 	}
 }
 
+SCENARIO_METHOD(HelperFixture, "Parsing messages in place out of a receive ring.", "[Message Parser]")
+{
+	GIVEN("Ten distinct 24 byte messages and a 64 byte ring")
+	{
+		std::vector<Hydra::TestMessage> originals;
+		std::string packagedMessageBuffer;
+		for (int i = 0; i < 10; ++i)
+		{
+			Hydra::TestMessage message;
+			message.set_some_test_message("message" + std::to_string(i));
+			message.set_value_1(i + 1);
+			message.set_value_2((i + 1) * 2);
+			message.set_value_3((i + 1) * 3);
+			packagedMessageBuffer.append(PackageMessage(message.SerializeAsString(),
+				Common::MessageId::TestMessage));
+			originals.push_back(message);
+		}
+		REQUIRE(packagedMessageBuffer.size() == 240);
+
+		std::vector<Common::NetworkMessage> messages;
+		WHEN("The whole stream is read through the ring, wrapping it several times")
+		{
+			ExtractMessagesFromRing(packagedMessageBuffer, messages);
+
+			THEN("Every message comes out once, in order, and intact")
+			{
+				REQUIRE(messages.size() == originals.size());
+				for (size_t i = 0; i < originals.size(); ++i)
+				{
+					REQUIRE(VerifyEqual(originals[i].ByteSize(), Common::MessageId::TestMessage,
+						originals[i], messages[i]));
+				}
+			}
+		}
+		AND_WHEN("The stream arrives in small uneven reads")
+		{
+			size_t offset = 0;
+			size_t readSize = 1;
+			while (offset < packagedMessageBuffer.size())
+			{
+				ExtractMessagesFromRing(packagedMessageBuffer.substr(offset, readSize), messages);
+				offset += readSize;
+				readSize = readSize % 7 + 1;
+			}
+
+			THEN("Every message comes out once, in order, and intact")
+			{
+				REQUIRE(messages.size() == originals.size());
+				for (size_t i = 0; i < originals.size(); ++i)
+				{
+					REQUIRE(VerifyEqual(originals[i].ByteSize(), Common::MessageId::TestMessage,
+						originals[i], messages[i]));
+				}
+			}
+		}
+	}
+}
+
+SCENARIO_METHOD(HelperFixture, "A message too large for the receive ring.", "[Message Parser]")
+{
+	GIVEN("A large message sandwiched between two small ones")
+	{
+		Hydra::TestMessage small = GetDefaultTestMessage();
+		Hydra::TestMessage large = GetDefaultTestMessage();
+		large.set_some_test_message(std::string(500, 'x'));
+
+		std::string packagedMessageBuffer = PackageMessage(small.SerializeAsString(),
+			Common::MessageId::TestMessage);
+		packagedMessageBuffer.append(PackageMessage(large.SerializeAsString(),
+			Common::MessageId::TestMessage));
+		packagedMessageBuffer.append(PackageMessage(small.SerializeAsString(),
+			Common::MessageId::TestMessage));
+		REQUIRE(large.ByteSize() > static_cast<int>(ring.Capacity()));
+
+		WHEN("The stream is read through the ring")
+		{
+			std::vector<Common::NetworkMessage> messages;
+			ExtractMessagesFromRing(packagedMessageBuffer, messages);
+
+			THEN("The large message is assembled outside the ring and nothing is lost")
+			{
+				REQUIRE(messages.size() == 3);
+				REQUIRE(VerifyEqual(small.ByteSize(), Common::MessageId::TestMessage, small,
+					messages[0]));
+				REQUIRE(VerifyEqual(large.ByteSize(), Common::MessageId::TestMessage, large,
+					messages[1]));
+				REQUIRE(VerifyEqual(small.ByteSize(), Common::MessageId::TestMessage, small,
+					messages[2]));
+			}
+		}
+	}
+}
+
+SCENARIO_METHOD(HelperFixture, "A frame over the max frame size.", "[Message Parser]")
+{
+	GIVEN("A parser with a small frame limit")
+	{
+		networkParser->SetMaxFrameSize(100);
+
+		Hydra::TestMessage small = GetDefaultTestMessage();
+		std::string stream = PackageMessage(small.SerializeAsString(),
+			Common::MessageId::TestMessage);
+
+		WHEN("A header claims a payload bigger than the limit")
+		{
+			Common::MessageHeader header{ Common::MessageId::TestMessage, 0x7FFFFFFF };
+			stream.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+			std::memcpy(ring.WriteData(), stream.data(), stream.size());
+			ring.CommitWrite(static_cast<uint32_t>(stream.size()));
+
+			std::vector<Common::NetworkMessageView> views;
+			bool isValid = networkParser->ExtractMessages(ring, views);
+
+			THEN("The stream is rejected without anything being allocated for the frame")
+			{
+				REQUIRE(!isValid);
+				REQUIRE(views.size() == 1);
+				REQUIRE(views[0].messageData == small.SerializeAsString());
+			}
+		}
+	}
+
+	GIVEN("A parser asked for the largest frame limit there is")
+	{
+		networkParser->SetMaxFrameSize(UINT32_MAX);
+
+		WHEN("A header claims a payload that would wrap once its header is added")
+		{
+			Common::MessageHeader header{ Common::MessageId::TestMessage,
+				UINT32_MAX - static_cast<uint32_t>(sizeof(header)) + 1 };
+			std::memcpy(ring.WriteData(), &header, sizeof(header));
+			ring.CommitWrite(static_cast<uint32_t>(sizeof(header)));
+
+			std::vector<Common::NetworkMessageView> views;
+			bool isValid = networkParser->ExtractMessages(ring, views);
+
+			THEN("The limit is capped below it and the stream is rejected")
+			{
+				REQUIRE(networkParser->GetMaxFrameSize() < header.messageLength);
+				REQUIRE(!isValid);
+				REQUIRE(views.empty());
+			}
+		}
+	}
+}
+
+SCENARIO("A parser that hasn't been used yet.", "[Message Parser]")
+{
+	GIVEN("A newly made parser")
+	{
+		AllocationScope allocations;
+		Common::NetworkMessageParser parser;
+		uint64_t allocatedBytes = allocations.GetBytes();
+
+		THEN("It hasn't reserved buffers for a mode it may never use")
+		{
+			REQUIRE(allocatedBytes < 1024);
+		}
+	}
+}
+
 //===============================================================================
 
 } // namespace Tests
@@ -7,6 +7,7 @@
 
 #include "common/NetworkMessageParser.h"
 #include "common/NetworkTypes.h"
+#include "common/ReceiveRing.h"
 #include "proto/TestMessage.pb.h"
 
 #include <string>
@@ -27,6 +28,32 @@ struct HelperFixture {
 		networkParser->ExtractMessages(data, messages);
 	}
 
+	// Feeds data through the ring the same way a socket read would, a free region at a time.
+	// Views don't survive the next write, so they're copied out into owned messages.
+	void ExtractMessagesFromRing(const std::string& data,
+		std::vector<Common::NetworkMessage>& messages)
+	{
+		std::vector<Common::NetworkMessageView> views;
+		size_t written = 0;
+		while (written < data.size())
+		{
+			uint32_t size = std::min<uint32_t>(ring.WriteSize(),
+				static_cast<uint32_t>(data.size() - written));
+			std::memcpy(ring.WriteData(), data.data() + written, size);
+			ring.CommitWrite(size);
+			written += size;
+
+			views.clear();
+			networkParser->ExtractMessages(ring, views);
+			for (const auto& view : views)
+			{
+				Common::NetworkMessage message(view.header);
+				message.messageData.assign(view.messageData.data(), view.messageData.size());
+				messages.push_back(std::move(message));
+			}
+		}
+	}
+
 	std::string PackageMessage(const std::string& messageData, Common::MessageId id)
 	{
 		std::string buffer;
@@ -66,6 +93,9 @@ struct HelperFixture {
 	}
 
 	std::unique_ptr<Common::NetworkMessageParser> networkParser;
+
+	// Deliberately small so tests can exercise wrapping and oversized frames.
+	Common::ReceiveRing ring{ 64 };
 };
 
 //===============================================================================
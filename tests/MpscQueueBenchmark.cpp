@@ -0,0 +1,105 @@
+//---------------------------------------------------------------
+//
+// MpscQueueBenchmark.cpp
+//
+
+#include "BenchmarkUtils.h"
+#include "MpscQueueTest.h"
+
+#include "Catch2/catch.hpp"
+#include "common/ThreadSafeQueue.h"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace Tests {
+
+namespace {
+	const uint32_t s_tasksPerRun = 400000;
+	const uint32_t s_iterations = 5;
+
+	// Runs producerCount threads that post s_tasksPerRun tasks between them, while this thread
+	// plays the game loop and drains until it has run every one of them.
+	template <typename PushFn, typename DrainFn>
+	void RunProducers(uint32_t producerCount, PushFn&& push, DrainFn&& drain)
+	{
+		std::atomic<uint32_t> executed{ 0 };
+		std::vector<std::thread> producers;
+		for (uint32_t p = 0; p < producerCount; ++p)
+		{
+			producers.emplace_back([&]()
+				{
+					for (uint32_t i = 0; i < s_tasksPerRun / producerCount; ++i)
+					{
+						push([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); });
+					}
+				});
+		}
+
+		const uint32_t expected = (s_tasksPerRun / producerCount) * producerCount;
+		while (executed.load(std::memory_order_relaxed) < expected)
+		{
+			drain();
+		}
+
+		for (auto& producer : producers)
+		{
+			producer.join();
+		}
+	}
+
+	void CompareQueues(uint32_t producerCount)
+	{
+		const std::string suffix = " (" + std::to_string(producerCount) + " producers)";
+
+		// What Game::ProcessCallbackQueue used to do.
+		Common::ThreadSafeQueue<std::function<void()>> lockedQueue;
+		std::deque<std::function<void()>> processQueue;
+		double before = MeasureThroughput("ThreadSafeQueue" + suffix, "tasks", s_tasksPerRun,
+			s_iterations, [&]()
+			{
+				RunProducers(producerCount,
+					[&](std::function<void()> cb) { lockedQueue.Push(cb); },
+					[&]()
+					{
+						lockedQueue.SwapWithEmpty(processQueue);
+						for (auto cb : processQueue)
+						{
+							cb();
+						}
+						std::deque<std::function<void()>>().swap(processQueue);
+					});
+			});
+
+		Common::MpscQueue<std::function<void()>> mpscQueue;
+		double after = MeasureThroughput("MpscQueue" + suffix, "tasks", s_tasksPerRun,
+			s_iterations, [&]()
+			{
+				RunProducers(producerCount,
+					[&](std::function<void()> cb) { mpscQueue.Push(std::move(cb)); },
+					[&]()
+					{
+						mpscQueue.ConsumeAll([](std::function<void()>& cb) { cb(); });
+					});
+			});
+
+		WARN("Speedup" << suffix << ": " << after / before << "x");
+	}
+} // anon namespace
+
+//===============================================================================
+
+TEST_CASE("Main thread task queue throughput, ThreadSafeQueue vs MpscQueue.",
+	"[.][Benchmark][MpscQueue]")
+{
+	CompareQueues(1);
+	CompareQueues(4);
+	CompareQueues(16);
+}
+
+//===============================================================================
+
+} // namespace Tests
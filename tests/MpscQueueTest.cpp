@@ -0,0 +1,143 @@
+//---------------------------------------------------------------
+//
+// MpscQueueTest.cpp
+//
+
+#include "MpscQueueTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace Tests {
+
+//===============================================================================
+
+SCENARIO("Consuming from a single producer.", "[MpscQueue]")
+{
+	GIVEN("A queue with a few items pushed")
+	{
+		Common::MpscQueue<int> queue;
+		REQUIRE(queue.IsEmpty());
+		for (int i = 0; i < 5; ++i)
+		{
+			queue.Push(i);
+		}
+
+		WHEN("The consumer drains it")
+		{
+			std::vector<int> consumed;
+			uint32_t count = queue.ConsumeAll([&consumed](int& i) { consumed.push_back(i); });
+
+			THEN("Items come out in the order they were pushed")
+			{
+				REQUIRE(count == 5);
+				REQUIRE(consumed == std::vector<int>{ 0, 1, 2, 3, 4 });
+				REQUIRE(queue.IsEmpty());
+			}
+		}
+		AND_WHEN("An item pushes more work while being consumed")
+		{
+			std::vector<int> consumed;
+			queue.ConsumeAll([&](int& i)
+				{
+					consumed.push_back(i);
+					if (i == 4)
+					{
+						queue.Push(5);
+					}
+				});
+
+			THEN("The new item waits for the next drain")
+			{
+				REQUIRE(consumed.size() == 5);
+				queue.ConsumeAll([&consumed](int& i) { consumed.push_back(i); });
+				REQUIRE(consumed.back() == 5);
+			}
+		}
+	}
+}
+
+SCENARIO("Items are released once they've been consumed.", "[MpscQueue]")
+{
+	GIVEN("A queue holding shared pointers")
+	{
+		Common::MpscQueue<std::shared_ptr<int>> queue;
+		auto value = std::make_shared<int>(1);
+		queue.Push(value);
+		REQUIRE(value.use_count() == 2);
+
+		WHEN("The queue is drained")
+		{
+			queue.ConsumeAll([](std::shared_ptr<int>&) {});
+
+			THEN("The queue no longer holds a reference")
+			{
+				REQUIRE(value.use_count() == 1);
+			}
+		}
+	}
+}
+
+SCENARIO("Many producers pushing while the consumer drains.", "[MpscQueue]")
+{
+	GIVEN("Eight producers each pushing a numbered sequence")
+	{
+		const int producerCount = 8;
+		const int itemsPerProducer = 20000;
+		Common::MpscQueue<std::pair<int, int>> queue;
+
+		std::atomic<bool> go{ false };
+		std::vector<std::thread> producers;
+		for (int p = 0; p < producerCount; ++p)
+		{
+			producers.emplace_back([&, p]()
+				{
+					while (!go) {}
+					for (int i = 0; i < itemsPerProducer; ++i)
+					{
+						queue.Push(std::make_pair(p, i));
+					}
+				});
+		}
+
+		WHEN("The consumer drains until everything has arrived")
+		{
+			std::vector<int> nextExpected(producerCount, 0);
+			bool inOrder = true;
+			int received = 0;
+
+			go = true;
+			while (received < producerCount * itemsPerProducer)
+			{
+				received += queue.ConsumeAll([&](std::pair<int, int>& item)
+					{
+						inOrder = inOrder && item.second == nextExpected[item.first];
+						++nextExpected[item.first];
+					});
+			}
+
+			for (auto& producer : producers)
+			{
+				producer.join();
+			}
+
+			THEN("Every item arrives exactly once, in order per producer")
+			{
+				REQUIRE(inOrder);
+				REQUIRE(queue.IsEmpty());
+				for (int p = 0; p < producerCount; ++p)
+				{
+					REQUIRE(nextExpected[p] == itemsPerProducer);
+				}
+			}
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
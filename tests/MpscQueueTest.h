@@ -0,0 +1,8 @@
+//---------------------------------------------------------------
+//
+// MpscQueueTest.h
+//
+
+#pragma once
+
+#include "common/MpscQueue.h"
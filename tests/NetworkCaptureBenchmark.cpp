@@ -0,0 +1,136 @@
+//---------------------------------------------------------------
+//
+// NetworkCaptureBenchmark.cpp
+//
+// Point s_capturePath at a capture taken with the server's --capture option to benchmark real
+// traffic. Without one, a capture is made up of test messages read in random sized pieces.
+//
+
+#include "BenchmarkUtils.h"
+#include "MessageDispatcherTest.h"
+#include "NetworkCaptureTest.h"
+
+#include "Catch2/catch.hpp"
+#include "common/MessageDispatcher.h"
+
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace Tests {
+
+namespace {
+	const char* s_capturePath = "";
+
+	const uint32_t s_sessionCount = 200;
+	const uint32_t s_messagesPerSession = 500;
+	const uint32_t s_maxReadSize = 1500;
+	const uint32_t s_iterations = 20;
+
+	// Every session's messages, cut into reads and interleaved with the other sessions' reads.
+	void WriteSyntheticCapture(const std::string& path)
+	{
+		std::mt19937 random(1);
+		std::uniform_int_distribution<uint32_t> readSize(1, s_maxReadSize);
+
+		std::vector<std::string> streams(s_sessionCount);
+		for (uint32_t session = 0; session < s_sessionCount; ++session)
+		{
+			for (uint32_t i = 0; i < s_messagesPerSession; ++i)
+			{
+				streams[session] += Common::PackageMessage(Common::MessageId::TestMessage,
+					MakeTestMessage(static_cast<int>(i)).SerializeAsString());
+			}
+		}
+
+		Common::CaptureWriter writer;
+		REQUIRE(writer.Open(path));
+
+		std::vector<size_t> offsets(s_sessionCount, 0);
+		uint32_t remaining = s_sessionCount;
+		std::uniform_int_distribution<uint32_t> pickSession(0, s_sessionCount - 1);
+		while (remaining > 0)
+		{
+			uint32_t session = pickSession(random);
+			std::string_view stream = streams[session];
+			if (offsets[session] == stream.size())
+			{
+				continue;
+			}
+
+			std::string_view read = stream.substr(offsets[session], readSize(random));
+			writer.Record(session + 1, read);
+			offsets[session] += read.size();
+			if (offsets[session] == stream.size())
+			{
+				--remaining;
+			}
+		}
+		writer.Close();
+	}
+} // anon namespace
+
+//===============================================================================
+
+TEST_CASE("Replaying a capture through the parser and dispatcher.", "[.][Benchmark][NetworkCapture]")
+{
+	std::string path = s_capturePath;
+	bool isSynthetic = path.empty();
+	if (isSynthetic)
+	{
+		path = GetCapturePath("benchmark");
+		WriteSyntheticCapture(path);
+	}
+
+	Common::CaptureReader reader;
+	REQUIRE(reader.Open(path));
+
+	Common::MessageDispatcher dispatcher;
+	int64_t sum = 0;
+	dispatcher.RegisterHandler<Hydra::TestMessage>(Common::MessageId::TestMessage,
+		[&sum](uint32_t, const Hydra::TestMessage& message)
+	{
+		sum += message.value_1();
+	});
+
+	Common::CaptureReplayer replayer;
+	replayer.SetMessageBatchHandler([&dispatcher](uint32_t sessionId,
+		std::shared_ptr<Common::MessageBatch> batch)
+	{
+		dispatcher.Dispatch(sessionId, *batch);
+		dispatcher.EndTick();
+	});
+
+	auto replay = [&]()
+	{
+		reader.Rewind();
+		replayer.Reset();
+		return replayer.Replay(reader, Common::ReplaySpeed::AsFastAsPossible);
+	};
+
+	Common::ReplayStats stats = replay();
+	REQUIRE(stats.sessionsDropped == 0);
+	if (isSynthetic)
+	{
+		REQUIRE(stats.messages == s_sessionCount * s_messagesPerSession);
+	}
+	WARN(stats.records << " reads, " << stats.bytes << " bytes, " << stats.messages
+		<< " messages");
+
+	MeasureThroughput("Replay", "bytes", stats.bytes, s_iterations, replay);
+	MeasureThroughput("Replay", "messages", stats.messages, s_iterations, replay);
+	REQUIRE(sum != 0);
+
+	// The mapping has to go before the file can be removed on Windows.
+	reader.Close();
+	if (isSynthetic)
+	{
+		std::remove(path.c_str());
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
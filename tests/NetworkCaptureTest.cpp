@@ -0,0 +1,284 @@
+//---------------------------------------------------------------
+//
+// NetworkCaptureTest.cpp
+//
+
+#include "NetworkCaptureTest.h"
+
+#include "Catch2/catch.hpp"
+#include "common/NetworkTypes.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace Tests {
+
+namespace {
+	struct ReplayedMessage
+	{
+		uint32_t sessionId;
+		Common::MessageId id;
+		std::string payload;
+	};
+
+	// Replays the whole capture, copying out every message that comes through.
+	Common::ReplayStats ReplayAll(Common::CaptureReplayer& replayer, Common::CaptureReader& reader,
+		std::vector<ReplayedMessage>& replayed,
+		Common::ReplaySpeed speed = Common::ReplaySpeed::AsFastAsPossible)
+	{
+		replayer.SetMessageBatchHandler([&replayed](uint32_t sessionId,
+			std::shared_ptr<Common::MessageBatch> batch)
+		{
+			for (size_t i = 0; i < batch->Size(); ++i)
+			{
+				const Common::NetworkMessageView& message = (*batch)[i];
+				replayed.push_back({ sessionId, message.header.messageType,
+					std::string(message.messageData) });
+			}
+		});
+		return replayer.Replay(reader, speed);
+	}
+} // anon namespace
+
+//===============================================================================
+
+SCENARIO("Writing and reading back a capture.", "[NetworkCapture]")
+{
+	std::string path = GetCapturePath("round_trip");
+
+	GIVEN("A capture with reads from two sessions")
+	{
+		Common::CaptureWriter writer;
+		REQUIRE(writer.Open(path));
+		writer.Record(1, "first");
+		writer.Record(2, "second");
+		writer.Record(1, "");
+		writer.Record(1, "third");
+		REQUIRE(writer.GetRecordCount() == 4);
+		writer.Close();
+
+		WHEN("It's read back")
+		{
+			Common::CaptureReader reader;
+			REQUIRE(reader.Open(path));
+
+			std::vector<Common::CaptureRecord> records;
+			Common::CaptureRecord record;
+			while (reader.Next(record))
+			{
+				records.push_back(record);
+			}
+
+			THEN("Every record comes back in order with its session")
+			{
+				REQUIRE(records.size() == 4);
+				REQUIRE(records[0].sessionId == 1);
+				REQUIRE(records[0].data == "first");
+				REQUIRE(records[1].sessionId == 2);
+				REQUIRE(records[1].data == "second");
+				REQUIRE(records[2].data.empty());
+				REQUIRE(records[3].data == "third");
+				REQUIRE(!reader.IsTruncated());
+
+				AND_THEN("Timestamps never go backwards")
+				{
+					for (size_t i = 1; i < records.size(); ++i)
+					{
+						REQUIRE(records[i].timestamp >= records[i - 1].timestamp);
+					}
+				}
+			}
+
+			AND_WHEN("It's rewound")
+			{
+				reader.Rewind();
+
+				THEN("The first record comes back again")
+				{
+					REQUIRE(reader.Next(record));
+					REQUIRE(record.data == "first");
+				}
+			}
+		}
+	}
+
+	GIVEN("A capture whose last record was cut short")
+	{
+		Common::CaptureWriter writer;
+		REQUIRE(writer.Open(path));
+		writer.Record(1, "whole");
+		writer.Record(1, "cut short");
+		writer.Close();
+
+		std::string contents;
+		{
+			std::ifstream file(path, std::ios::binary);
+			contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+		std::ofstream(path, std::ios::binary | std::ios::trunc).write(contents.data(),
+			contents.size() - 3);
+
+		WHEN("It's read back")
+		{
+			Common::CaptureReader reader;
+			REQUIRE(reader.Open(path));
+
+			Common::CaptureRecord record;
+			REQUIRE(reader.Next(record));
+			REQUIRE(record.data == "whole");
+
+			THEN("Reading stops at the cut and says so")
+			{
+				REQUIRE(!reader.Next(record));
+				REQUIRE(reader.IsTruncated());
+			}
+		}
+	}
+
+	GIVEN("A file that isn't a capture")
+	{
+		std::ofstream(path, std::ios::binary | std::ios::trunc) << "definitely not a capture";
+
+		THEN("It can't be opened")
+		{
+			Common::CaptureReader reader;
+			REQUIRE(!reader.Open(path));
+		}
+	}
+
+	std::remove(path.c_str());
+}
+
+SCENARIO("Replaying a capture.", "[NetworkCapture]")
+{
+	std::string path = GetCapturePath("replay");
+
+	GIVEN("Two sessions whose frames were split across reads and interleaved")
+	{
+		std::string a = Common::PackageMessage(Common::MessageId::Move, "move")
+			+ Common::PackageMessage(Common::MessageId::Attack, "attack");
+		std::string b = Common::PackageMessage(Common::MessageId::SnapshotAck, "ack");
+
+		Common::CaptureWriter writer;
+		REQUIRE(writer.Open(path));
+		writer.Record(7, std::string_view(a).substr(0, 5));
+		writer.Record(9, std::string_view(b).substr(0, 3));
+		writer.Record(7, std::string_view(a).substr(5));
+		writer.Record(9, std::string_view(b).substr(3));
+		writer.Close();
+
+		WHEN("It's replayed")
+		{
+			Common::CaptureReader reader;
+			REQUIRE(reader.Open(path));
+
+			Common::CaptureReplayer replayer;
+			std::vector<ReplayedMessage> replayed;
+			Common::ReplayStats stats = ReplayAll(replayer, reader, replayed);
+
+			THEN("Each session's frames are put back together")
+			{
+				REQUIRE(stats.records == 4);
+				REQUIRE(stats.bytes == a.size() + b.size());
+				REQUIRE(stats.messages == 3);
+				REQUIRE(stats.batches == 2);
+				REQUIRE(stats.sessionsDropped == 0);
+
+				REQUIRE(replayed.size() == 3);
+				REQUIRE(replayed[0].sessionId == 7);
+				REQUIRE(replayed[0].id == Common::MessageId::Move);
+				REQUIRE(replayed[0].payload == "move");
+				REQUIRE(replayed[1].sessionId == 7);
+				REQUIRE(replayed[1].id == Common::MessageId::Attack);
+				REQUIRE(replayed[1].payload == "attack");
+				REQUIRE(replayed[2].sessionId == 9);
+				REQUIRE(replayed[2].id == Common::MessageId::SnapshotAck);
+				REQUIRE(replayed[2].payload == "ack");
+			}
+
+			AND_WHEN("It's replayed again after a reset")
+			{
+				reader.Rewind();
+				replayer.Reset();
+				replayed.clear();
+				ReplayAll(replayer, reader, replayed);
+
+				THEN("The same messages come through")
+				{
+					REQUIRE(replayed.size() == 3);
+				}
+			}
+		}
+	}
+
+	GIVEN("A session that sent a frame over the size limit")
+	{
+		std::string good = Common::PackageMessage(Common::MessageId::Move, "move");
+		std::string bad = Common::PackageMessage(Common::MessageId::Move, std::string(100, 'x'));
+
+		Common::CaptureWriter writer;
+		REQUIRE(writer.Open(path));
+		writer.Record(1, bad);
+		writer.Record(2, good);
+		writer.Record(1, good);
+		writer.Close();
+
+		WHEN("It's replayed")
+		{
+			Common::CaptureReader reader;
+			REQUIRE(reader.Open(path));
+
+			Common::CaptureReplayer replayer(64);
+			std::vector<ReplayedMessage> replayed;
+			Common::ReplayStats stats = ReplayAll(replayer, reader, replayed);
+
+			THEN("That session is dropped and the others carry on")
+			{
+				REQUIRE(stats.sessionsDropped == 1);
+				REQUIRE(replayed.size() == 1);
+				REQUIRE(replayed[0].sessionId == 2);
+			}
+		}
+	}
+
+	GIVEN("A capture spread over some time")
+	{
+		const std::chrono::milliseconds gap(50);
+		std::string message = Common::PackageMessage(Common::MessageId::Move, "move");
+
+		Common::CaptureWriter writer;
+		REQUIRE(writer.Open(path));
+		writer.Record(1, message);
+		std::this_thread::sleep_for(gap);
+		writer.Record(1, message);
+		writer.Close();
+
+		Common::CaptureReader reader;
+		REQUIRE(reader.Open(path));
+
+		WHEN("It's replayed at the recorded speed")
+		{
+			Common::CaptureReplayer replayer;
+			std::vector<ReplayedMessage> replayed;
+			Common::ReplayStats stats = ReplayAll(replayer, reader, replayed,
+				Common::ReplaySpeed::Recorded);
+
+			THEN("It takes at least as long as it took to record")
+			{
+				REQUIRE(replayed.size() == 2);
+				REQUIRE(stats.elapsed >= gap);
+			}
+		}
+	}
+
+	std::remove(path.c_str());
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,25 @@
+//---------------------------------------------------------------
+//
+// NetworkCaptureTest.h
+//
+
+#pragma once
+
+#include "common/NetworkCapture.h"
+
+#include <filesystem>
+#include <string>
+
+namespace Tests {
+
+//===============================================================================
+
+// Somewhere to write a capture that won't clash with other tests.
+inline std::string GetCapturePath(const std::string& name)
+{
+	return (std::filesystem::temp_directory_path() / ("hydra_" + name + ".hycp")).string();
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,129 @@
+//---------------------------------------------------------------
+//
+// PriorityAccumulatorBenchmark.cpp
+//
+
+#include "BenchmarkUtils.h"
+#include "InterestGridTest.h"
+#include "PriorityAccumulatorTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <cmath>
+#include <deque>
+#include <string>
+
+namespace Tests {
+
+namespace {
+	const uint32_t s_tickCount = 150;
+	const uint32_t s_ackDelayTicks = 3;
+
+	// Entities are spread over a square this size around the client.
+	const float s_areaSize = 400.0f;
+
+	// A third of the entities move each tick.
+	void SimulateTick(Common::GameState& world, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+		std::uniform_real_distribution<float> step(-1.0f, 1.0f);
+		for (const Common::EntityState& entity : world.GetEntities())
+		{
+			if (chance(random) < 0.33f)
+			{
+				Common::EntityState* state = world.FindEntity(entity.entityId);
+				state->x += step(random);
+				state->y += step(random);
+			}
+		}
+	}
+
+	// How far the client's idea of where entities are is from where they really are, on average,
+	// for the nearest and furthest quarter of them.
+	void MeasureError(const Common::GameState& world, const Common::GameState& clientState,
+		double& nearError, double& farError, uint32_t& missing)
+	{
+		std::vector<std::pair<float, float>> errors;
+		for (const Common::EntityState& entity : world.GetEntities())
+		{
+			const Common::EntityState* seen = clientState.FindEntity(entity.entityId);
+			if (!seen)
+			{
+				++missing;
+				continue;
+			}
+			errors.push_back({ std::hypot(entity.x, entity.y),
+				std::hypot(entity.x - seen->x, entity.y - seen->y) });
+		}
+
+		std::sort(errors.begin(), errors.end());
+		size_t quarter = errors.size() / 4;
+		for (size_t i = 0; i < quarter; ++i)
+		{
+			nearError += errors[i].second / quarter;
+			farError += errors[errors.size() - 1 - i].second / quarter;
+		}
+	}
+} // anon namespace
+
+//===============================================================================
+
+TEST_CASE("Snapshot quality under a fixed budget as entities grow.", "[.][Benchmark][PriorityAccumulator]")
+{
+	const Common::PriorityConfig config;
+	for (uint32_t entityCount : { 25, 50, 100, 200, 400, 800, 1600 })
+	{
+		Common::GameState world = MakeScatteredGameState(entityCount, s_areaSize);
+		Common::GameState clientState;
+		Common::SnapshotEncoder encoder;
+		Common::SnapshotDecoder decoder;
+		Common::PriorityAccumulator accumulator(config);
+		std::mt19937 random(1);
+		std::deque<std::pair<uint32_t, uint32_t>> acks;
+
+		uint64_t bytes = 0;
+		uint64_t deferred = 0;
+		uint32_t maxSize = 0;
+		double nearError = 0.0;
+		double farError = 0.0;
+		uint32_t missing = 0;
+		for (uint32_t tick = 0; tick < s_tickCount; ++tick)
+		{
+			SimulateTick(world, random);
+			while (!acks.empty() && acks.front().first <= tick)
+			{
+				encoder.OnAck(acks.front().second);
+				acks.pop_front();
+			}
+
+			std::string snapshot = encoder.Encode(world, config.bytesPerTick,
+				[&accumulator](std::vector<Common::SnapshotChange>& changes, uint32_t budget)
+				{
+					accumulator.Select(changes, budget);
+				});
+			bytes += snapshot.size();
+			deferred += accumulator.GetDeferredCount();
+			maxSize = std::max(maxSize, static_cast<uint32_t>(snapshot.size()));
+
+			REQUIRE(decoder.Decode(snapshot, clientState));
+			acks.push_back({ tick + s_ackDelayTicks, decoder.GetLastSequence() });
+
+			// Once the client has had time to fill in the world.
+			if (tick >= s_tickCount / 2)
+			{
+				MeasureError(world, clientState, nearError, farError, missing);
+			}
+		}
+
+		uint32_t measuredTicks = s_tickCount - s_tickCount / 2;
+		WARN(entityCount << " entities: " << bytes / s_tickCount << " bytes/tick (max " << maxSize
+			<< "), " << deferred / s_tickCount << " updates deferred/tick, position error near="
+			<< nearError / measuredTicks << " far=" << farError / measuredTicks << ", "
+			<< missing / measuredTicks << " not yet seen");
+		REQUIRE(maxSize <= config.bytesPerTick);
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,179 @@
+//---------------------------------------------------------------
+//
+// PriorityAccumulatorTest.cpp
+//
+
+#include "PriorityAccumulatorTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <vector>
+
+namespace Tests {
+
+namespace {
+	const uint32_t s_changeSize = 10;
+
+	// Entity n sits n * 10 units from the origin along x.
+	std::vector<Common::EntityState> MakeEntities(uint32_t count)
+	{
+		std::vector<Common::EntityState> entities(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			entities[i].entityId = i + 1;
+			entities[i].x = (i + 1) * 10.0f;
+		}
+		return entities;
+	}
+
+	std::vector<Common::SnapshotChange> MakeChanges(const std::vector<Common::EntityState>& entities)
+	{
+		std::vector<Common::SnapshotChange> changes(entities.size());
+		for (size_t i = 0; i < entities.size(); ++i)
+		{
+			changes[i].entity = &entities[i];
+			changes[i].fields = Common::EntityFields::Position;
+			changes[i].size = s_changeSize;
+		}
+		return changes;
+	}
+
+	std::vector<uint32_t> GetSelected(const std::vector<Common::SnapshotChange>& changes)
+	{
+		std::vector<uint32_t> entityIds;
+		for (const Common::SnapshotChange& change : changes)
+		{
+			if (change.isSelected)
+			{
+				entityIds.push_back(change.entity->entityId);
+			}
+		}
+		return entityIds;
+	}
+} // anon namespace
+
+//===============================================================================
+
+SCENARIO("Picking which changes fit in a client's budget.", "[PriorityAccumulator]")
+{
+	GIVEN("Ten changes and room for three")
+	{
+		Common::PriorityAccumulator accumulator;
+		std::vector<Common::EntityState> entities = MakeEntities(10);
+		std::vector<Common::SnapshotChange> changes = MakeChanges(entities);
+		const uint32_t budget = 3 * s_changeSize;
+
+		WHEN("They're all equally important")
+		{
+			accumulator.Select(changes, budget);
+
+			THEN("The nearest go first and the rest wait with what they've built up")
+			{
+				REQUIRE(GetSelected(changes) == std::vector<uint32_t>{ 1, 2, 3 });
+				REQUIRE(accumulator.GetDeferredCount() == 7);
+				REQUIRE(accumulator.GetAccumulated(1) == 0.0f);
+				REQUIRE(accumulator.GetAccumulated(4) > 0.0f);
+			}
+		}
+
+		WHEN("The same changes are offered tick after tick")
+		{
+			std::vector<uint32_t> ticksToSend(entities.size() + 1, 0);
+			for (uint32_t tick = 1; tick <= 20; ++tick)
+			{
+				changes = MakeChanges(entities);
+				accumulator.Select(changes, budget);
+				for (uint32_t entityId : GetSelected(changes))
+				{
+					if (ticksToSend[entityId] == 0)
+					{
+						ticksToSend[entityId] = tick;
+					}
+				}
+			}
+
+			THEN("Even the furthest is sent eventually, and no later than nearer ones")
+			{
+				for (uint32_t entityId = 1; entityId <= entities.size(); ++entityId)
+				{
+					REQUIRE(ticksToSend[entityId] > 0);
+					REQUIRE(ticksToSend[entityId] >= ticksToSend[entityId > 1 ? entityId - 1 : 1]);
+				}
+			}
+		}
+
+		WHEN("Some creature types are weighted up and an entity is new")
+		{
+			Common::PriorityConfig config;
+			config.typeWeights = { 1.0f, 10.0f };
+			accumulator.SetConfig(config);
+			entities[9].creatureType = 1;
+			changes = MakeChanges(entities);
+			changes[8].isNew = true;
+			accumulator.Select(changes, budget);
+
+			THEN("They're sent ahead of nearer ones")
+			{
+				REQUIRE(GetSelected(changes) == std::vector<uint32_t>{ 1, 9, 10 });
+			}
+		}
+
+		WHEN("The viewpoint moves")
+		{
+			accumulator.SetViewpoint(100.0f, 0.0f);
+			accumulator.Select(changes, budget);
+
+			THEN("What's near it now goes first")
+			{
+				REQUIRE(GetSelected(changes) == std::vector<uint32_t>{ 8, 9, 10 });
+			}
+		}
+
+		WHEN("A waiting change stops being offered")
+		{
+			accumulator.Select(changes, budget);
+			REQUIRE(accumulator.GetAccumulated(10) > 0.0f);
+
+			changes.pop_back();
+			accumulator.Select(changes, budget);
+
+			THEN("What it built up is forgotten")
+			{
+				REQUIRE(accumulator.GetAccumulated(10) == 0.0f);
+			}
+		}
+
+		WHEN("A far away change is required")
+		{
+			accumulator.Select(changes, budget);
+			REQUIRE(accumulator.GetAccumulated(10) > 0.0f);
+
+			changes = MakeChanges(entities);
+			changes[9].isRequired = true;
+			accumulator.Select(changes, budget);
+
+			THEN("It's selected without taking room from the others, and starts again from nothing")
+			{
+				REQUIRE(GetSelected(changes).size() == 4);
+				REQUIRE(changes[9].isSelected);
+				REQUIRE(accumulator.GetAccumulated(10) == 0.0f);
+				REQUIRE(accumulator.GetDeferredCount() == 6);
+			}
+		}
+
+		WHEN("A change is too big for what's left")
+		{
+			changes[1].size = budget;
+			accumulator.Select(changes, budget);
+
+			THEN("Smaller ones behind it still go in")
+			{
+				REQUIRE(GetSelected(changes) == std::vector<uint32_t>{ 1, 3, 4 });
+			}
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,8 @@
+//---------------------------------------------------------------
+//
+// PriorityAccumulatorTest.h
+//
+
+#pragma once
+
+#include "common/PriorityAccumulator.h"
@@ -0,0 +1,280 @@
+//---------------------------------------------------------------
+//
+// ReceiveBufferPoolTest.cpp
+//
+
+#include "ReceiveBufferPoolTest.h"
+#include "TcpSessionTest.h"
+
+#include "Catch2/catch.hpp"
+#include "common/NetworkTypes.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Tests {
+
+//===============================================================================
+
+SCENARIO("Borrowing buffers from a receive buffer pool.", "[ReceiveBufferPool]")
+{
+	GIVEN("A pool with classes from 4 KB to 32 KB")
+	{
+		Common::ReceiveBufferPool pool(4096, 32768);
+
+		WHEN("Buffers of various sizes are borrowed")
+		{
+			Common::PooledBuffer tiny = pool.Borrow(1);
+			Common::PooledBuffer between = pool.Borrow(5000);
+			Common::PooledBuffer huge = pool.Borrow(1024 * 1024);
+
+			THEN("Each gets the smallest class that holds it, within the range")
+			{
+				REQUIRE(tiny.Size() == 4096);
+				REQUIRE(between.Size() == 8192);
+				REQUIRE(huge.Size() == 32768);
+			}
+
+			THEN("What's lent out is counted")
+			{
+				Common::ReceiveBufferPoolStats stats = pool.GetStats();
+				REQUIRE(stats.borrows == 3);
+				REQUIRE(stats.buffersInUse == 3);
+				REQUIRE(stats.bytesInUse == 4096 + 8192 + 32768);
+				REQUIRE(stats.peakBytesInUse == stats.bytesInUse);
+			}
+
+			AND_WHEN("They're given back")
+			{
+				tiny.Reset();
+				between = Common::PooledBuffer();
+				{
+					Common::PooledBuffer moved = std::move(huge);
+				}
+
+				THEN("Nothing's in use, but the peak is remembered")
+				{
+					Common::ReceiveBufferPoolStats stats = pool.GetStats();
+					REQUIRE(tiny.IsEmpty());
+					REQUIRE(huge.IsEmpty());
+					REQUIRE(stats.buffersInUse == 0);
+					REQUIRE(stats.bytesInUse == 0);
+					REQUIRE(stats.peakBytesInUse == 4096 + 8192 + 32768);
+				}
+			}
+		}
+
+		WHEN("Many small buffers are borrowed")
+		{
+			std::vector<Common::PooledBuffer> buffers;
+			for (int i = 0; i < 64; ++i)
+			{
+				buffers.push_back(pool.Borrow(4096));
+			}
+
+			THEN("They're carved out of one slab, without overlapping")
+			{
+				REQUIRE(pool.GetStats().slabsAllocated == 1);
+				for (size_t i = 0; i < buffers.size(); ++i)
+				{
+					std::memset(buffers[i].Data(), static_cast<int>(i), buffers[i].Size());
+				}
+				for (size_t i = 0; i < buffers.size(); ++i)
+				{
+					REQUIRE(buffers[i].Data()[0] == static_cast<char>(i));
+					REQUIRE(buffers[i].Data()[4095] == static_cast<char>(i));
+				}
+			}
+
+			AND_WHEN("They're given back and borrowed again")
+			{
+				buffers.clear();
+				for (int i = 0; i < 64; ++i)
+				{
+					buffers.push_back(pool.Borrow(4096));
+				}
+
+				THEN("No more memory is taken")
+				{
+					REQUIRE(pool.GetStats().slabsAllocated == 1);
+					REQUIRE(pool.GetStats().bytesReserved == 64 * 4096);
+				}
+			}
+		}
+	}
+}
+
+SCENARIO("A receive ring borrowing its buffer from a pool.", "[ReceiveBufferPool]")
+{
+	GIVEN("A pooled ring that may grow to 16 KB")
+	{
+		auto pool = std::make_shared<Common::ReceiveBufferPool>(4096, 65536);
+		Common::ReceiveRing ring(pool, 16384);
+
+		THEN("It holds nothing until it's about to be read into")
+		{
+			REQUIRE(!ring.HasBuffer());
+			REQUIRE(ring.Capacity() == 0);
+			REQUIRE(pool->GetStats().bytesInUse == 0);
+
+			ring.Borrow();
+			REQUIRE(ring.HasBuffer());
+			REQUIRE(ring.Capacity() == 4096);
+		}
+
+		WHEN("Part of what was read is still waiting to be consumed")
+		{
+			ring.Borrow();
+			WriteToRing(ring, std::string(100, 'x'));
+			ring.Consume(60);
+			ring.ReturnIfEmpty();
+
+			THEN("The buffer is kept")
+			{
+				REQUIRE(ring.HasBuffer());
+				REQUIRE(ring.ReadSize() == 40);
+				REQUIRE(pool->GetStats().buffersInUse == 1);
+			}
+
+			AND_WHEN("The rest is consumed")
+			{
+				ring.Consume(40);
+				ring.ReturnIfEmpty();
+
+				THEN("It goes back to the pool")
+				{
+					REQUIRE(!ring.HasBuffer());
+					REQUIRE(pool->GetStats().buffersInUse == 0);
+				}
+			}
+		}
+
+		WHEN("Reads keep filling it")
+		{
+			std::vector<uint32_t> capacities;
+			for (int i = 0; i < 4; ++i)
+			{
+				ring.Borrow();
+				capacities.push_back(ring.Capacity());
+				ring.Consume(WriteToRing(ring, std::string(65536, 'x')));
+				ring.ReturnIfEmpty();
+			}
+
+			THEN("It borrows a bigger buffer each time, up to its limit")
+			{
+				REQUIRE(capacities == std::vector<uint32_t>{ 4096, 8192, 16384, 16384 });
+			}
+
+			AND_WHEN("Reads then only use a little of it")
+			{
+				capacities.clear();
+				for (int i = 0; i < 4; ++i)
+				{
+					ring.Borrow();
+					capacities.push_back(ring.Capacity());
+					ring.Consume(WriteToRing(ring, std::string(100, 'x')));
+					ring.ReturnIfEmpty();
+				}
+
+				THEN("It shrinks back to the smallest size")
+				{
+					REQUIRE(capacities == std::vector<uint32_t>{ 16384, 8192, 4096, 4096 });
+				}
+			}
+		}
+	}
+
+	GIVEN("A pooled ring holding the only reference to its pool")
+	{
+		auto ring = std::make_unique<Common::ReceiveRing>(
+			std::make_shared<Common::ReceiveBufferPool>(4096, 65536), 16384);
+		ring->Borrow();
+		WriteToRing(*ring, std::string(100, 'x'));
+
+		WHEN("It's destroyed with the buffer still borrowed")
+		{
+			ring.reset();
+
+			THEN("The buffer goes back before the pool is freed")
+			{
+				REQUIRE(ring == nullptr);
+			}
+		}
+	}
+
+	GIVEN("A ring with no pool")
+	{
+		Common::ReceiveRing ring(nullptr, 16384);
+
+		THEN("It keeps a buffer of its own")
+		{
+			REQUIRE(ring.Capacity() == 16384);
+			ring.ReturnIfEmpty();
+			REQUIRE(ring.HasBuffer());
+		}
+	}
+}
+
+SCENARIO_METHOD(LoopbackSessionFixture, "Sessions sharing a receive buffer pool.", "[ReceiveBufferPool]")
+{
+	GIVEN("A session borrowing its receive buffer from a pool")
+	{
+		auto pool = std::make_shared<Common::ReceiveBufferPool>();
+		size_t received = 0;
+		Common::TcpSessionConfig config;
+		config.receivePool = pool;
+		Connect(config, [&received](std::shared_ptr<Common::MessageBatch> batch)
+			{
+				received += batch->Size();
+			});
+		Pump();
+
+		THEN("It holds no buffer while idle")
+		{
+			REQUIRE(pool->GetStats().bytesInUse == 0);
+		}
+
+		WHEN("Whole messages arrive")
+		{
+			std::string stream;
+			for (int i = 0; i < 100; ++i)
+			{
+				stream += Common::PackageMessage(Common::MessageId::Move, "move " + std::to_string(i));
+			}
+			asio::write(peer, asio::buffer(stream));
+
+			PumpUntil([&received]() { return received >= 100; });
+
+			THEN("They're delivered and the buffer goes back")
+			{
+				REQUIRE(received == 100);
+				REQUIRE(pool->GetStats().borrows > 0);
+				REQUIRE(pool->GetStats().bytesInUse == 0);
+			}
+		}
+
+		WHEN("Only part of a message arrives")
+		{
+			std::string message = Common::PackageMessage(Common::MessageId::Move, "move");
+			asio::write(peer, asio::buffer(message.data(), message.size() - 2));
+
+			PumpUntil([&pool]() { return pool->GetStats().borrows > 0; });
+			Pump();
+
+			THEN("The buffer is kept until the rest arrives")
+			{
+				REQUIRE(pool->GetStats().bytesInUse > 0);
+
+				asio::write(peer, asio::buffer(message.data() + message.size() - 2, 2));
+				PumpUntil([&received]() { return received >= 1; });
+				REQUIRE(received == 1);
+				REQUIRE(pool->GetStats().bytesInUse == 0);
+			}
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
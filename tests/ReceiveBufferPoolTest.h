@@ -0,0 +1,31 @@
+//---------------------------------------------------------------
+//
+// ReceiveBufferPoolTest.h
+//
+
+#pragma once
+
+#include "common/ReceiveBufferPool.h"
+#include "common/ReceiveRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace Tests {
+
+//===============================================================================
+
+// Writes as much of data into the ring as fits in one go, the way a socket read would.
+// Returns the bytes written.
+inline uint32_t WriteToRing(Common::ReceiveRing& ring, const std::string& data)
+{
+	uint32_t size = std::min(ring.WriteSize(), static_cast<uint32_t>(data.size()));
+	std::memcpy(ring.WriteData(), data.data(), size);
+	ring.CommitWrite(size);
+	return size;
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,247 @@
+//---------------------------------------------------------------
+//
+// ReliableEndpointTest.cpp
+//
+
+#include "ReliableEndpointTest.h"
+
+#include "Catch2/catch.hpp"
+#include "common/NetworkTypes.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace Tests {
+
+namespace {
+	using Clock = Common::ReliableEndpoint::Clock;
+
+	const auto s_resendDelay = std::chrono::milliseconds(30);
+	const uint32_t s_largeBudget = 1000;
+	const uint32_t s_maxMessages = 32;
+
+	Common::SharedBuffer MakeMessage(const std::string& payload)
+	{
+		return std::make_shared<const std::string>(payload);
+	}
+
+	// Hands a packet's reliable messages to the receiver, the way UdpChannel does.
+	void Deliver(Common::ReliableEndpoint& receiver, const Common::OutgoingPacket& packet,
+		Clock::time_point now, Common::MessageBatch& delivered)
+	{
+		if (receiver.OnPacket(packet.sequence, packet.ack, packet.ackBits, now)
+			== Common::PacketStatus::Duplicate)
+		{
+			return;
+		}
+
+		for (const Common::ReliableMessage& reliable : packet.reliable)
+		{
+			Common::NetworkMessageView view;
+			view.header.messageLength = static_cast<uint32_t>(reliable.message->size());
+			view.messageData = *reliable.message;
+			receiver.OnReliableMessage(reliable.header, view, delivered);
+		}
+	}
+
+	// Sends one packet carrying whatever is due, with a budget that fits one message.
+	Common::OutgoingPacket SendOne(Common::ReliableEndpoint& sender, Clock::time_point now)
+	{
+		Common::OutgoingPacket packet;
+		sender.WritePacket(now, sizeof(Common::ReliableMessageHeader) + 1, s_maxMessages, packet);
+		return packet;
+	}
+} // anon namespace
+
+//===============================================================================
+
+SCENARIO("Delivering reliable messages.", "[ReliableEndpoint]")
+{
+	GIVEN("A sender and a receiver")
+	{
+		Common::ReliableEndpoint sender(s_resendDelay);
+		Common::ReliableEndpoint receiver(s_resendDelay);
+		Common::MessageBatch delivered;
+		Clock::time_point now = Clock::now();
+
+		WHEN("The first message on a stream is lost and a second is sent")
+		{
+			sender.Queue(0, MakeMessage("a"));
+			SendOne(sender, now);
+			sender.Queue(0, MakeMessage("b"));
+			Deliver(receiver, SendOne(sender, now), now, delivered);
+
+			THEN("The second waits for the first")
+			{
+				REQUIRE(delivered.IsEmpty());
+			}
+
+			AND_WHEN("The second is acked and the delay passes")
+			{
+				Common::MessageBatch unused;
+				Deliver(sender, SendOne(receiver, now), now, unused);
+
+				REQUIRE_FALSE(sender.HasDue(now));
+				now += s_resendDelay;
+				REQUIRE(sender.HasDue(now));
+
+				Common::OutgoingPacket resent;
+				sender.WritePacket(now, s_largeBudget, s_maxMessages, resent);
+				Deliver(receiver, resent, now, delivered);
+
+				THEN("Only the lost message went again, and both are delivered in order")
+				{
+					REQUIRE(resent.reliable.size() == 1);
+					REQUIRE(resent.resentCount == 1);
+					REQUIRE(delivered.Size() == 2);
+					REQUIRE(delivered[0].messageData == "a");
+					REQUIRE(delivered[1].messageData == "b");
+				}
+			}
+		}
+
+		WHEN("A message is lost on one stream and another is sent on a second stream")
+		{
+			sender.Queue(0, MakeMessage("a"));
+			SendOne(sender, now);
+			sender.Queue(1, MakeMessage("b"));
+			Deliver(receiver, SendOne(sender, now), now, delivered);
+
+			THEN("The second stream isn't held up")
+			{
+				REQUIRE(delivered.Size() == 1);
+				REQUIRE(delivered[0].messageData == "b");
+			}
+		}
+
+		WHEN("A message arrives and is acked by the receiver's next packet")
+		{
+			sender.Queue(0, MakeMessage("a"));
+			Deliver(receiver, SendOne(sender, now), now, delivered);
+			REQUIRE(receiver.NeedsAck());
+
+			Common::MessageBatch unused;
+			Deliver(sender, SendOne(receiver, now), now, unused);
+
+			THEN("The sender stops resending it")
+			{
+				REQUIRE_FALSE(receiver.NeedsAck());
+				REQUIRE(sender.GetUnackedCount() == 0);
+				REQUIRE_FALSE(sender.HasDue(now + s_resendDelay));
+			}
+		}
+
+		WHEN("The same packet arrives twice")
+		{
+			sender.Queue(0, MakeMessage("a"));
+			Common::OutgoingPacket packet = SendOne(sender, now);
+			Deliver(receiver, packet, now, delivered);
+
+			THEN("It's reported as a duplicate and delivered once")
+			{
+				REQUIRE(receiver.OnPacket(packet.sequence, packet.ack, packet.ackBits, now)
+					== Common::PacketStatus::Duplicate);
+				REQUIRE(delivered.Size() == 1);
+			}
+		}
+
+		WHEN("A resent message arrives after the original made it")
+		{
+			sender.Queue(0, MakeMessage("a"));
+			Deliver(receiver, SendOne(sender, now), now, delivered);
+			Deliver(receiver, SendOne(sender, now + s_resendDelay), now, delivered);
+
+			THEN("It isn't delivered again")
+			{
+				REQUIRE(delivered.Size() == 1);
+			}
+		}
+
+		WHEN("More is queued on a stream than its window holds")
+		{
+			const uint32_t windowSize = Common::ReliableEndpoint::s_windowSize;
+			for (uint32_t i = 0; i <= windowSize; ++i)
+			{
+				REQUIRE(sender.Queue(2, MakeMessage(std::to_string(i))));
+			}
+
+			THEN("The last waits behind the window until acks make room, then goes in order")
+			{
+				REQUIRE(sender.GetUnackedCount() == windowSize + 1);
+
+				Common::OutgoingPacket packet;
+				sender.WritePacket(now, s_largeBudget * windowSize, windowSize + 1, packet);
+				REQUIRE(packet.reliable.size() == windowSize);
+				REQUIRE_FALSE(sender.HasDue(now));
+				Deliver(receiver, packet, now, delivered);
+
+				Common::MessageBatch unused;
+				Deliver(sender, SendOne(receiver, now), now, unused);
+				REQUIRE(sender.HasDue(now));
+				sender.WritePacket(now, s_largeBudget, s_maxMessages, packet);
+				REQUIRE(packet.reliable.size() == 1);
+				Deliver(receiver, packet, now, delivered);
+
+				REQUIRE(delivered.Size() == windowSize + 1);
+				for (uint32_t i = 0; i <= windowSize; ++i)
+				{
+					REQUIRE(delivered[i].messageData == std::to_string(i));
+				}
+			}
+			AND_THEN("More are refused once the backlog is full too, but not on other streams")
+			{
+				for (uint32_t i = 1; i < Common::ReliableEndpoint::s_maxBacklog; ++i)
+				{
+					REQUIRE(sender.Queue(2, MakeMessage("x")));
+				}
+
+				REQUIRE_FALSE(sender.Queue(2, MakeMessage("x")));
+				REQUIRE(sender.Queue(3, MakeMessage("x")));
+				REQUIRE_FALSE(sender.Queue(Common::ReliableEndpoint::s_streamCount, MakeMessage("x")));
+			}
+		}
+	}
+}
+
+SCENARIO("Acking packets.", "[ReliableEndpoint]")
+{
+	GIVEN("An endpoint that has received packets with gaps between them")
+	{
+		Common::ReliableEndpoint endpoint;
+		Clock::time_point now = Clock::now();
+		endpoint.OnPacket(10, 0, 0, now);
+		endpoint.OnPacket(12, 0, 0, now);
+		endpoint.OnPacket(15, 0, 0, now);
+
+		WHEN("It writes a packet")
+		{
+			Common::OutgoingPacket packet;
+			endpoint.WritePacket(now, 0, s_maxMessages, packet);
+
+			THEN("The acks cover the newest and the ones before it")
+			{
+				REQUIRE(packet.ack == 15);
+
+				// Bit n is sequence 15 - 1 - n.
+				REQUIRE(packet.ackBits == ((1u << 2) | (1u << 4)));
+			}
+		}
+
+		WHEN("One of the gaps turns up late")
+		{
+			THEN("It's late, and its sequence is acked from then on")
+			{
+				REQUIRE(endpoint.OnPacket(13, 0, 0, now) == Common::PacketStatus::Late);
+
+				Common::OutgoingPacket packet;
+				endpoint.WritePacket(now, 0, s_maxMessages, packet);
+				REQUIRE((packet.ackBits & (1u << 1)) != 0);
+			}
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,8 @@
+//---------------------------------------------------------------
+//
+// ReliableEndpointTest.h
+//
+
+#pragma once
+
+#include "common/ReliableEndpoint.h"
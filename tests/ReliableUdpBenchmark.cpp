@@ -0,0 +1,172 @@
+//---------------------------------------------------------------
+//
+// ReliableUdpBenchmark.cpp
+//
+
+#include "BenchmarkUtils.h"
+#include "TcpSessionTest.h"
+#include "UdpChannelTest.h"
+
+#include "Catch2/catch.hpp"
+#include "common/NetworkTypes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace Tests {
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	const int s_messageCount = 2000;
+	const auto s_sendInterval = std::chrono::microseconds(250);
+
+	// Fixed size so the TCP side can tell where messages end.
+	std::string MakePayload(int i)
+	{
+		char payload[16];
+		std::snprintf(payload, sizeof(payload), "%08d", i);
+		return payload;
+	}
+
+	void ReportLatency(const std::string& name, std::vector<Clock::duration> latencies)
+	{
+		REQUIRE(latencies.size() == s_messageCount);
+		std::sort(latencies.begin(), latencies.end());
+		auto percentile = [&](double p)
+		{
+			size_t index = std::min(latencies.size() - 1, static_cast<size_t>(latencies.size() * p));
+			return std::chrono::duration_cast<std::chrono::microseconds>(latencies[index]).count();
+		};
+
+		WARN(name << ": p50=" << percentile(0.5) << "us p99=" << percentile(0.99) << "us p99.9="
+			<< percentile(0.999) << "us max=" << percentile(1.0) << "us");
+	}
+
+	// Sends a message every s_sendInterval and times each from send to delivery. A send that's
+	// refused because too much is waiting on acks is retried, and the wait counts as latency.
+	template <typename SendFn, typename PumpFn>
+	std::vector<Clock::duration> MeasureLatency(SendFn&& send, PumpFn&& pump)
+	{
+		std::vector<Clock::time_point> sentAt(s_messageCount);
+		std::vector<Clock::duration> latencies;
+		latencies.reserve(s_messageCount);
+
+		int sent = 0;
+		Clock::time_point nextSend = Clock::now();
+		Clock::time_point deadline = nextSend + std::chrono::seconds(30);
+		while (latencies.size() < s_messageCount && Clock::now() < deadline)
+		{
+			if (sent < s_messageCount && Clock::now() >= nextSend)
+			{
+				if (sentAt[sent] == Clock::time_point())
+				{
+					sentAt[sent] = Clock::now();
+				}
+
+				if (send(sent))
+				{
+					++sent;
+					nextSend += s_sendInterval;
+				}
+			}
+
+			pump([&](int index) { latencies.push_back(Clock::now() - sentAt[index]); });
+		}
+
+		return latencies;
+	}
+} // anon namespace
+
+//===============================================================================
+
+TEST_CASE("Latency of reliable messages over lossy UDP.", "[.][Benchmark][ReliableUdp]")
+{
+	// One stream orders everything like TCP does. Spread over more, a loss only holds up its own.
+	for (uint8_t streamCount : { 1, 4 })
+	for (float loss : { 0.0f, 0.01f, 0.03f, 0.05f })
+	{
+		// Loss applies both ways, so acks go missing too.
+		Common::UdpChannelConfig config;
+		config.simulatedLoss = loss;
+		config.simulationSeed = 1;
+
+		LoopbackUdpFixture udp;
+		udp.Connect(config, LoopbackUdpFixture::s_token, config);
+		udp.PumpUntil([&]() { return udp.server->GetStats().datagramsReceived > 0; });
+
+		size_t delivered = 0;
+		uint32_t refused = 0;
+		auto latencies = MeasureLatency(
+			[&](int i)
+			{
+				auto message = std::make_shared<const std::string>(
+					Common::PackageMessage(Common::MessageId::Move, MakePayload(i)));
+				if (udp.client->SendReliable(LoopbackUdpFixture::s_clientId,
+					static_cast<uint8_t>(i % streamCount), message) == Common::UdpSendResult::Sent)
+				{
+					return true;
+				}
+
+				++refused;
+				return false;
+			},
+			[&](auto&& onDelivered)
+			{
+				udp.ioc.restart();
+				udp.ioc.poll();
+				for (; delivered < udp.received.size(); ++delivered)
+				{
+					onDelivered(std::stoi(udp.received[delivered].payload));
+				}
+			});
+
+		ReportLatency("Reliable UDP, " + std::to_string(streamCount) + " stream(s), "
+			+ std::to_string(static_cast<int>(loss * 100)) + "% loss", latencies);
+		WARN("Resent " << udp.client->GetStats().reliableMessagesResent << " of "
+			<< s_messageCount << ", refused " << refused << " sends with a full window");
+	}
+
+	// Loopback TCP can't be made to lose packets from here, so this is the lossless baseline.
+	// Under loss, TCP holds every message behind a lost segment for at least one retransmit
+	// timeout, which is 200ms on Linux.
+	{
+		LoopbackSessionFixture tcp;
+		tcp.Connect({});
+		tcp.Pump();
+		tcp.peer.non_blocking(true);
+
+		const size_t messageSize = sizeof(Common::MessageHeader) + MakePayload(0).size();
+		std::string stream;
+		int nextIndex = 0;
+		auto latencies = MeasureLatency(
+			[&](int i)
+			{
+				tcp.session->Write(Common::PackageMessage(Common::MessageId::Move, MakePayload(i)));
+				return true;
+			},
+			[&](auto&& onDelivered)
+			{
+				tcp.Pump();
+
+				char buffer[4096];
+				std::error_code ec;
+				size_t bytes = tcp.peer.read_some(asio::buffer(buffer), ec);
+				stream.append(buffer, ec ? 0 : bytes);
+				while (stream.size() >= messageSize)
+				{
+					onDelivered(nextIndex++);
+					stream.erase(0, messageSize);
+				}
+			});
+
+		ReportLatency("TcpSession, 0% loss", latencies);
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
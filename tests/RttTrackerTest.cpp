@@ -0,0 +1,101 @@
+//---------------------------------------------------------------
+//
+// RttTrackerTest.cpp
+//
+
+#include "RttTrackerTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <chrono>
+
+using namespace std::chrono_literals;
+
+namespace Tests {
+
+//===============================================================================
+
+SCENARIO("Tracking round trip times.", "[RttTracker]")
+{
+	GIVEN("A tracker with no samples")
+	{
+		Common::RttTracker tracker;
+
+		THEN("Its stats are empty")
+		{
+			Common::RttStats stats = tracker.GetStats();
+			REQUIRE(stats.sampleCount == 0);
+			REQUIRE(stats.smoothed == 0us);
+			REQUIRE(stats.recent.empty());
+		}
+	}
+
+	GIVEN("Two samples")
+	{
+		Common::RttTracker tracker;
+		tracker.AddSample(10ms);
+		tracker.AddSample(26ms);
+
+		THEN("The first sets the smoothed RTT and the second moves it an eighth of the way")
+		{
+			Common::RttStats stats = tracker.GetStats();
+			REQUIRE(stats.sampleCount == 2);
+			REQUIRE(stats.latest == 26ms);
+			REQUIRE(stats.smoothed == 12ms);
+		}
+		AND_THEN("Jitter moves a sixteenth of the way towards the difference between them")
+		{
+			REQUIRE(tracker.GetStats().jitter == 1ms);
+		}
+		AND_THEN("The extremes are exact")
+		{
+			Common::RttStats stats = tracker.GetStats();
+			REQUIRE(stats.min == 10ms);
+			REQUIRE(stats.max == 26ms);
+		}
+	}
+
+	GIVEN("A steady RTT with the odd spike")
+	{
+		Common::RttTracker tracker;
+		for (int i = 0; i < 1000; ++i)
+		{
+			tracker.AddSample(i % 50 == 0 ? 200ms : 20ms);
+		}
+
+		THEN("p50 is the steady RTT and p99 catches the spikes")
+		{
+			Common::RttStats stats = tracker.GetStats();
+			REQUIRE(stats.p50.count() == Approx(20000).epsilon(0.035));
+			REQUIRE(stats.p95.count() == Approx(20000).epsilon(0.035));
+			REQUIRE(stats.p99.count() == Approx(200000).epsilon(0.035));
+		}
+	}
+
+	GIVEN("More samples than the ring holds")
+	{
+		Common::RttTracker tracker;
+		const int count = Common::RttTracker::s_recentCount + 10;
+		for (int i = 0; i < count; ++i)
+		{
+			tracker.AddSample(std::chrono::microseconds(i));
+		}
+
+		THEN("Only the most recent are kept, oldest first")
+		{
+			Common::RttStats stats = tracker.GetStats();
+			REQUIRE(stats.sampleCount == count);
+			REQUIRE(stats.recent.size() == Common::RttTracker::s_recentCount);
+			REQUIRE(stats.recent.front() == 10us);
+			REQUIRE(stats.recent.back() == std::chrono::microseconds(count - 1));
+		}
+		AND_THEN("They can be left out")
+		{
+			REQUIRE(tracker.GetStats(false).recent.empty());
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,8 @@
+//---------------------------------------------------------------
+//
+// RttTrackerTest.h
+//
+
+#pragma once
+
+#include "common/RttTracker.h"
@@ -0,0 +1,77 @@
+//---------------------------------------------------------------
+//
+// SlotMapBenchmark.cpp
+//
+
+#include "BenchmarkUtils.h"
+#include "SlotMapTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace Tests {
+
+namespace {
+	const uint32_t s_clientCount = 1000;
+	const uint32_t s_iterations = 50;
+
+	struct Session
+	{
+		uint32_t clientId = 0;
+		uint64_t messagesPosted = 0;
+	};
+} // anon namespace
+
+//===============================================================================
+
+TEST_CASE("Broadcasting to every client by id.", "[.][Benchmark][SlotMap]")
+{
+	// How ClientSessionManager used to find sessions: a linear search of a set ordered by pointer.
+	std::set<std::shared_ptr<Session>> sessionSet;
+	std::vector<uint32_t> setIds;
+	for (uint32_t i = 0; i < s_clientCount; ++i)
+	{
+		auto session = std::make_shared<Session>();
+		session->clientId = i;
+		sessionSet.insert(session);
+		setIds.push_back(i);
+	}
+
+	Common::SlotMap<Session> slotMap(s_clientCount);
+	std::vector<uint32_t> slotIds;
+	for (uint32_t i = 0; i < s_clientCount; ++i)
+	{
+		slotIds.push_back(slotMap.Add(std::make_shared<Session>()));
+	}
+
+	double before = MeasureThroughput("std::set find_if", "lookups", s_clientCount, s_iterations,
+		[&]()
+		{
+			for (uint32_t id : setIds)
+			{
+				auto it = std::find_if(sessionSet.begin(), sessionSet.end(),
+					[id](const std::shared_ptr<Session>& session) { return session->clientId == id; });
+				++(*it)->messagesPosted;
+			}
+		});
+
+	double after = MeasureThroughput("SlotMap", "lookups", s_clientCount, s_iterations,
+		[&]()
+		{
+			for (uint32_t id : slotIds)
+			{
+				++slotMap.Find(id)->messagesPosted;
+			}
+		});
+
+	WARN("Speedup with " << s_clientCount << " clients: " << after / before << "x");
+	REQUIRE(after > before);
+}
+
+//===============================================================================
+
+} // namespace Tests
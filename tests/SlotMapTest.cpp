@@ -0,0 +1,151 @@
+//---------------------------------------------------------------
+//
+// SlotMapTest.cpp
+//
+
+#include "SlotMapTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace Tests {
+
+//===============================================================================
+
+SCENARIO("Adding and removing entries in a slot map.", "[SlotMap]")
+{
+	GIVEN("A slot map with room for four entries")
+	{
+		Common::SlotMap<int> map(4);
+		REQUIRE(map.Capacity() == 4);
+
+		WHEN("Entries are added")
+		{
+			std::set<uint32_t> ids;
+			for (int i = 0; i < 4; ++i)
+			{
+				ids.insert(map.Add(std::make_shared<int>(i)));
+			}
+
+			THEN("Each gets its own valid id")
+			{
+				REQUIRE(ids.size() == 4);
+				REQUIRE(ids.count(Common::SlotMap<int>::s_invalidId) == 0);
+				REQUIRE(map.Size() == 4);
+			}
+			AND_THEN("Each can be found by its id")
+			{
+				std::set<int> values;
+				for (uint32_t id : ids)
+				{
+					REQUIRE(map.Find(id));
+					values.insert(*map.Find(id));
+				}
+				REQUIRE(values == std::set<int>{ 0, 1, 2, 3 });
+			}
+			AND_THEN("Nothing more fits")
+			{
+				REQUIRE(map.Add(std::make_shared<int>(4)) == Common::SlotMap<int>::s_invalidId);
+			}
+		}
+		AND_WHEN("An entry is removed and its slot reused")
+		{
+			uint32_t first = map.Add(std::make_shared<int>(1));
+			REQUIRE(map.Remove(first));
+			uint32_t second = map.Add(std::make_shared<int>(2));
+
+			THEN("The stale id is rejected")
+			{
+				REQUIRE(second != first);
+				REQUIRE(map.Find(first) == nullptr);
+				REQUIRE(!map.Remove(first));
+				REQUIRE(*map.Find(second) == 2);
+				REQUIRE(map.Size() == 1);
+			}
+		}
+		AND_WHEN("Ids that were never handed out are looked up")
+		{
+			map.Add(std::make_shared<int>(1));
+
+			THEN("They aren't found")
+			{
+				REQUIRE(map.Find(Common::SlotMap<int>::s_invalidId) == nullptr);
+				REQUIRE(map.Find(0xFFFFFFFF) == nullptr);
+				REQUIRE(map.Find(3) == nullptr);
+			}
+		}
+	}
+}
+
+SCENARIO("Releasing removed entries.", "[SlotMap]")
+{
+	GIVEN("An entry that's been removed")
+	{
+		Common::SlotMap<int> map(4);
+		auto value = std::make_shared<int>(7);
+		std::weak_ptr<int> weak = value;
+		uint32_t id = map.Add(std::move(value));
+		int* found = map.Find(id);
+		map.Remove(id);
+
+		THEN("It stays alive for the reader until Collect")
+		{
+			REQUIRE(!weak.expired());
+			REQUIRE(*found == 7);
+
+			map.Collect();
+			REQUIRE(weak.expired());
+		}
+	}
+}
+
+SCENARIO("Looking up entries while another thread adds and removes them.", "[SlotMap]")
+{
+	GIVEN("A slot map with one entry that's never removed")
+	{
+		Common::SlotMap<uint32_t> map(64);
+		uint32_t stableId = map.Add(std::make_shared<uint32_t>(12345));
+
+		WHEN("A writer churns the other slots while this thread reads")
+		{
+			std::atomic<bool> done{ false };
+			std::atomic<uint32_t> lastRemoved{ Common::SlotMap<uint32_t>::s_invalidId };
+			std::thread writer([&]()
+				{
+					for (uint32_t i = 0; i < 20000; ++i)
+					{
+						uint32_t id = map.Add(std::make_shared<uint32_t>(i));
+						map.Remove(id);
+						lastRemoved = id;
+					}
+					done = true;
+				});
+
+			bool stableAlwaysFound = true;
+			bool staleNeverFound = true;
+			while (!done)
+			{
+				uint32_t* stable = map.Find(stableId);
+				stableAlwaysFound &= stable && *stable == 12345;
+				staleNeverFound &= map.Find(lastRemoved) == nullptr;
+				map.Collect();
+			}
+			writer.join();
+
+			THEN("The live entry is always found and removed ones never are")
+			{
+				REQUIRE(stableAlwaysFound);
+				REQUIRE(staleNeverFound);
+				REQUIRE(map.Size() == 1);
+			}
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,8 @@
+//---------------------------------------------------------------
+//
+// SlotMapTest.h
+//
+
+#pragma once
+
+#include "common/SlotMap.h"
@@ -0,0 +1,126 @@
+//---------------------------------------------------------------
+//
+// SnapshotBenchmark.cpp
+//
+
+#include "BenchmarkUtils.h"
+#include "SnapshotTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <deque>
+#include <random>
+#include <string>
+
+namespace Tests {
+
+namespace {
+	const uint32_t s_entityCount = 200;
+	const uint32_t s_tickCount = 300;
+
+	// About 100ms at 30 ticks per second.
+	const uint32_t s_ackDelayTicks = 3;
+
+	// A tick of a busy area: a quarter of the entities move, a few take damage and now and then
+	// one leaves and another arrives.
+	void SimulateTick(Common::GameState& world, std::mt19937& random, uint32_t& nextEntityId)
+	{
+		std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+		for (const Common::EntityState& entity : std::vector<Common::EntityState>(world.GetEntities()))
+		{
+			Common::EntityState* state = world.FindEntity(entity.entityId);
+			if (chance(random) < 0.25f)
+			{
+				state->x += chance(random);
+				state->y += chance(random);
+				state->heading = chance(random) * 6.28f;
+			}
+			if (chance(random) < 0.02f)
+			{
+				state->health -= 1;
+			}
+		}
+
+		if (chance(random) < 0.1f)
+		{
+			world.RemoveEntity(world.GetEntities().front().entityId);
+
+			Common::EntityState entity;
+			entity.entityId = nextEntityId++;
+			entity.health = 100;
+			world.SetEntity(entity);
+		}
+	}
+} // anon namespace
+
+//===============================================================================
+
+TEST_CASE("Snapshot bytes per tick for 200 entities.", "[.][Benchmark][Snapshot]")
+{
+	for (float loss : { 0.0f, 0.05f })
+	{
+		Common::GameState world = MakeGameState(s_entityCount);
+		Common::GameState clientState;
+		Common::SnapshotEncoder encoder;
+		Common::SnapshotDecoder decoder;
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+		uint32_t nextEntityId = s_entityCount + 1;
+
+		// Acks in flight, and the tick each one reaches the server.
+		std::deque<std::pair<uint32_t, uint32_t>> acks;
+
+		uint64_t fullBytes = 0;
+		uint64_t deltaBytes = 0;
+		for (uint32_t tick = 0; tick < s_tickCount; ++tick)
+		{
+			SimulateTick(world, random, nextEntityId);
+			while (!acks.empty() && acks.front().first <= tick)
+			{
+				encoder.OnAck(acks.front().second);
+				acks.pop_front();
+			}
+
+			// What sending the whole state costs: every entity with every field.
+			Common::SnapshotEncoder fullEncoder;
+			fullBytes += fullEncoder.Encode(world).size();
+
+			std::string delta = encoder.Encode(world);
+			deltaBytes += delta.size();
+
+			if (chance(random) >= loss)
+			{
+				REQUIRE(decoder.Decode(delta, clientState));
+				acks.push_back({ tick + s_ackDelayTicks, decoder.GetLastSequence() });
+			}
+		}
+
+		REQUIRE(clientState.GetEntities().size() == world.GetEntities().size());
+		WARN(static_cast<int>(loss * 100) << "% loss: full state=" << fullBytes / s_tickCount
+			<< " bytes/tick, delta=" << deltaBytes / s_tickCount << " bytes/tick ("
+			<< 100 * deltaBytes / fullBytes << "%)");
+		REQUIRE(deltaBytes < fullBytes);
+	}
+
+	// Encoding cost, with the world changing every tick and acks a few ticks behind as they
+	// would be in practice. Includes simulating the tick.
+	Common::GameState world = MakeGameState(s_entityCount);
+	std::mt19937 random(1);
+	uint32_t nextEntityId = s_entityCount + 1;
+	Common::SnapshotEncoder encoder;
+	uint32_t sequence = 0;
+
+	MeasureThroughput("Simulate and delta encode", "ticks", 1, 1000, [&]()
+		{
+			SimulateTick(world, random, nextEntityId);
+			encoder.Encode(world);
+			if (++sequence > s_ackDelayTicks)
+			{
+				encoder.OnAck(sequence - s_ackDelayTicks);
+			}
+		});
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,423 @@
+//---------------------------------------------------------------
+//
+// SnapshotTest.cpp
+//
+
+#include "SnapshotTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <algorithm>
+#include <string>
+
+namespace Tests {
+
+namespace {
+	const uint32_t s_entityCount = 200;
+	const size_t s_headerSize = sizeof(Common::SnapshotHeader);
+
+	bool StatesMatch(const Common::GameState& a, const Common::GameState& b)
+	{
+		return a.GetEntities().size() == b.GetEntities().size()
+			&& std::equal(a.GetEntities().begin(), a.GetEntities().end(), b.GetEntities().begin(),
+				EntitiesMatch);
+	}
+} // anon namespace
+
+//===============================================================================
+
+SCENARIO("Keeping entities in a game state.", "[Snapshot]")
+{
+	GIVEN("A state with entities added out of order")
+	{
+		Common::GameState state;
+		for (uint32_t id : { 5, 1, 3 })
+		{
+			Common::EntityState entity;
+			entity.entityId = id;
+			state.SetEntity(entity);
+		}
+
+		THEN("They're kept sorted by id")
+		{
+			REQUIRE(state.GetEntities().size() == 3);
+			REQUIRE(state.GetEntities()[0].entityId == 1);
+			REQUIRE(state.GetEntities()[2].entityId == 5);
+		}
+
+		WHEN("An entity is set again and another removed")
+		{
+			Common::EntityState entity;
+			entity.entityId = 3;
+			entity.health = 7;
+			state.SetEntity(entity);
+
+			REQUIRE(state.RemoveEntity(1));
+			REQUIRE_FALSE(state.RemoveEntity(1));
+
+			THEN("The set one is replaced and the removed one is gone")
+			{
+				REQUIRE(state.GetEntities().size() == 2);
+				REQUIRE(state.FindEntity(3)->health == 7);
+				REQUIRE(state.FindEntity(1) == nullptr);
+			}
+		}
+	}
+}
+
+SCENARIO("Sending snapshots as deltas from acked baselines.", "[Snapshot]")
+{
+	GIVEN("An encoder and decoder, and a world of entities")
+	{
+		Common::SnapshotEncoder encoder;
+		Common::SnapshotDecoder decoder;
+		Common::GameState world = MakeGameState(s_entityCount);
+		Common::GameState clientState;
+
+		WHEN("Nothing has been acked")
+		{
+			std::string first = encoder.Encode(world);
+			std::string second = encoder.Encode(world);
+
+			THEN("Every snapshot carries the whole state")
+			{
+				REQUIRE(first.size() == second.size());
+				REQUIRE(decoder.Decode(second, clientState));
+				REQUIRE(StatesMatch(world, clientState));
+			}
+		}
+
+		WHEN("The first snapshot is acked and nothing changes")
+		{
+			REQUIRE(decoder.Decode(encoder.Encode(world), clientState));
+			encoder.OnAck(decoder.GetLastSequence());
+			std::string delta = encoder.Encode(world);
+
+			THEN("The next is just a header")
+			{
+				REQUIRE(delta.size() == s_headerSize);
+				REQUIRE(decoder.Decode(delta, clientState));
+				REQUIRE(StatesMatch(world, clientState));
+			}
+		}
+
+		WHEN("Entities move, change, appear and disappear after an ack")
+		{
+			REQUIRE(decoder.Decode(encoder.Encode(world), clientState));
+			encoder.OnAck(decoder.GetLastSequence());
+
+			world.FindEntity(10)->x += 1.0f;
+			world.FindEntity(20)->health = 50;
+			world.RemoveEntity(30);
+			Common::EntityState entity;
+			entity.entityId = 1000;
+			entity.health = 1;
+			world.SetEntity(entity);
+
+			std::string delta = encoder.Encode(world);
+
+			THEN("Only those are sent, and only the fields that changed")
+			{
+				// Header, one removed id, two changed entities with one field each and a new one.
+				// Position packs into 6 bytes, position and heading into 8.
+				size_t changed = (4 + 1 + 6) + (4 + 1 + 4);
+				size_t added = 4 + 1 + 8 + 4 + 4 + 4;
+				REQUIRE(delta.size() == s_headerSize + 4 + changed + added);
+
+				REQUIRE(decoder.Decode(delta, clientState));
+				REQUIRE(StatesMatch(world, clientState));
+			}
+		}
+
+		WHEN("An entity moves to between quantization steps, turned back past zero")
+		{
+			Common::EntityState* moved = world.FindEntity(10);
+			moved->x = 123.456f;
+			moved->y = -987.654f;
+			moved->z = 3.21f;
+			moved->heading = -1.0f;
+			REQUIRE(decoder.Decode(encoder.Encode(world), clientState));
+
+			THEN("The client has it within the quantization error, with the heading wrapped")
+			{
+				const Common::EntityState* decoded = clientState.FindEntity(10);
+				REQUIRE(IsQuantizedClose(decoded->x, 123.456f, Common::SnapshotQuantization::s_horizontal));
+				REQUIRE(IsQuantizedClose(decoded->y, -987.654f, Common::SnapshotQuantization::s_horizontal));
+				REQUIRE(IsQuantizedClose(decoded->z, 3.21f, Common::SnapshotQuantization::s_vertical));
+				REQUIRE(IsQuantizedClose(decoded->heading, 6.28318530718f - 1.0f,
+					Common::SnapshotQuantization::s_heading));
+			}
+		}
+
+		WHEN("Snapshots after the acked one are lost")
+		{
+			REQUIRE(decoder.Decode(encoder.Encode(world), clientState));
+			encoder.OnAck(decoder.GetLastSequence());
+
+			world.FindEntity(1)->heading = 1.0f;
+			encoder.Encode(world);
+			world.FindEntity(2)->heading = 2.0f;
+			std::string delta = encoder.Encode(world);
+
+			THEN("The next still decodes, since it builds on what was acked")
+			{
+				REQUIRE(decoder.Decode(delta, clientState));
+				REQUIRE(StatesMatch(world, clientState));
+			}
+		}
+
+		WHEN("A snapshot arrives after a newer one")
+		{
+			std::string older = encoder.Encode(world);
+			std::string newer = encoder.Encode(world);
+			REQUIRE(decoder.Decode(newer, clientState));
+
+			THEN("It's ignored")
+			{
+				REQUIRE_FALSE(decoder.Decode(older, clientState));
+			}
+		}
+
+		WHEN("A delta's baseline is one the decoder never got")
+		{
+			// Pretend the client acked a snapshot it never applied.
+			encoder.Encode(world);
+			encoder.OnAck(1);
+			world.FindEntity(1)->health = 1;
+
+			THEN("It's refused and the state is left alone")
+			{
+				REQUIRE_FALSE(decoder.Decode(encoder.Encode(world), clientState));
+				REQUIRE(clientState.GetEntities().empty());
+			}
+		}
+
+		WHEN("The last ack falls out of the encoder's history")
+		{
+			REQUIRE(decoder.Decode(encoder.Encode(world), clientState));
+			encoder.OnAck(decoder.GetLastSequence());
+			for (uint32_t i = 0; i < Common::SnapshotEncoder::s_historySize; ++i)
+			{
+				encoder.Encode(world);
+			}
+
+			THEN("The whole state is sent again")
+			{
+				std::string full = encoder.Encode(world);
+				REQUIRE(full.size() > s_headerSize + s_entityCount);
+				REQUIRE(decoder.Decode(full, clientState));
+				REQUIRE(StatesMatch(world, clientState));
+			}
+		}
+
+		WHEN("A payload is cut short")
+		{
+			std::string full = encoder.Encode(world);
+			full.resize(full.size() - 1);
+
+			THEN("It's refused")
+			{
+				REQUIRE_FALSE(decoder.Decode(full, clientState));
+				REQUIRE(clientState.GetEntities().empty());
+			}
+		}
+	}
+}
+
+SCENARIO("Sending snapshots within a byte budget.", "[Snapshot]")
+{
+	GIVEN("A world too big to send in one snapshot of the budget")
+	{
+		Common::SnapshotEncoder encoder;
+		Common::SnapshotDecoder decoder;
+		Common::GameState world = MakeGameState(s_entityCount);
+		Common::GameState clientState;
+		const uint32_t maxBytes = 1000;
+
+		// Picks changes in id order until they don't fit.
+		Common::SnapshotEncoder::ChangeSelector selector =
+			[](std::vector<Common::SnapshotChange>& changes, uint32_t budget)
+			{
+				for (Common::SnapshotChange& change : changes)
+				{
+					change.isSelected = change.size <= budget;
+					budget -= change.isSelected ? change.size : 0;
+				}
+			};
+
+		WHEN("Snapshots are sent and acked until the client catches up")
+		{
+			uint32_t snapshotCount = 0;
+			bool isCaughtUp = false;
+			while (!isCaughtUp && snapshotCount < 100)
+			{
+				std::string snapshot = encoder.Encode(world, maxBytes, selector);
+				REQUIRE(snapshot.size() <= maxBytes);
+				REQUIRE(decoder.Decode(snapshot, clientState));
+				encoder.OnAck(decoder.GetLastSequence());
+
+				isCaughtUp = snapshot.size() == s_headerSize;
+				++snapshotCount;
+			}
+
+			THEN("It takes several, and the client ends up with the whole world")
+			{
+				REQUIRE(snapshotCount > 2);
+				REQUIRE(StatesMatch(world, clientState));
+			}
+		}
+
+		WHEN("Changes are left out of a snapshot that's lost")
+		{
+			REQUIRE(decoder.Decode(encoder.Encode(world), clientState));
+			encoder.OnAck(decoder.GetLastSequence());
+
+			world.FindEntity(1)->health = 1;
+			world.FindEntity(2)->health = 2;
+			encoder.Encode(world, s_headerSize + 9,
+				[](std::vector<Common::SnapshotChange>& changes, uint32_t)
+				{
+					REQUIRE(changes.size() == 2);
+					changes[1].isSelected = true;
+				});
+
+			THEN("The next still carries everything the client doesn't have")
+			{
+				REQUIRE(decoder.Decode(encoder.Encode(world), clientState));
+				REQUIRE(StatesMatch(world, clientState));
+			}
+		}
+
+		WHEN("Changes go out in a snapshot that isn't acked yet, and the next has no room for them")
+		{
+			REQUIRE(decoder.Decode(encoder.Encode(world), clientState));
+			encoder.OnAck(decoder.GetLastSequence());
+
+			world.FindEntity(1)->health = 1;
+			Common::EntityState added;
+			added.entityId = s_entityCount + 1;
+			world.SetEntity(added);
+			REQUIRE(decoder.Decode(encoder.Encode(world, maxBytes, selector), clientState));
+			REQUIRE(clientState.FindEntity(1)->health == 1);
+			REQUIRE(clientState.FindEntity(added.entityId) != nullptr);
+
+			world.FindEntity(2)->health = 2;
+			std::vector<uint32_t> offered;
+			std::string snapshot = encoder.Encode(world, s_headerSize,
+				[&offered](std::vector<Common::SnapshotChange>& changes, uint32_t budget)
+				{
+					REQUIRE(budget == 0);
+					for (const Common::SnapshotChange& change : changes)
+					{
+						offered.push_back(change.isRequired ? change.entity->entityId : 0);
+					}
+				});
+
+			THEN("They're sent again anyway, so the client doesn't go back to the baseline")
+			{
+				REQUIRE(offered == std::vector<uint32_t>{ 1, 0, added.entityId });
+				REQUIRE(decoder.Decode(snapshot, clientState));
+				REQUIRE(clientState.FindEntity(1)->health == 1);
+				REQUIRE(clientState.FindEntity(2)->health == 100);
+				REQUIRE(clientState.FindEntity(added.entityId) != nullptr);
+			}
+			AND_WHEN("The snapshot that carried them is acked")
+			{
+				encoder.OnAck(decoder.GetLastSequence());
+				std::string next = encoder.Encode(world, s_headerSize, selector);
+
+				THEN("They're not required any more")
+				{
+					REQUIRE(next.size() == s_headerSize);
+				}
+			}
+		}
+
+		WHEN("A selector picks more than the budget")
+		{
+			std::string snapshot = encoder.Encode(world, maxBytes,
+				[](std::vector<Common::SnapshotChange>& changes, uint32_t)
+				{
+					for (Common::SnapshotChange& change : changes)
+					{
+						change.isSelected = true;
+					}
+				});
+
+			THEN("The snapshot is cut off at the budget anyway")
+			{
+				REQUIRE(snapshot.size() <= maxBytes);
+				REQUIRE(decoder.Decode(snapshot, clientState));
+				REQUIRE(!clientState.GetEntities().empty());
+			}
+		}
+
+		WHEN("Entities are removed while the budget is used up")
+		{
+			REQUIRE(decoder.Decode(encoder.Encode(world), clientState));
+			encoder.OnAck(decoder.GetLastSequence());
+
+			world.RemoveEntity(1);
+			world.FindEntity(2)->health = 1;
+			std::string snapshot = encoder.Encode(world, s_headerSize + 4, selector);
+
+			THEN("The removals still go in, and the changes wait")
+			{
+				REQUIRE(decoder.Decode(snapshot, clientState));
+				REQUIRE(clientState.FindEntity(1) == nullptr);
+				REQUIRE(clientState.FindEntity(2)->health == 100);
+			}
+		}
+	}
+}
+
+SCENARIO("Sending more entities than a snapshot can count.", "[Snapshot]")
+{
+	GIVEN("A world of 70000 entities, more than the header's 16 bit counts")
+	{
+		const uint32_t count = 70000;
+		const uint32_t maxListed = 65535;
+		Common::GameState world = MakeGameState(count);
+		Common::SnapshotEncoder encoder;
+		Common::SnapshotDecoder decoder;
+		Common::GameState clientState;
+
+		WHEN("It's sent from nothing")
+		{
+			REQUIRE(decoder.Decode(encoder.Encode(world), clientState));
+
+			THEN("As many as the header can count go in, and the rest follow once that's acked")
+			{
+				REQUIRE(clientState.GetEntities().size() == maxListed);
+
+				encoder.OnAck(decoder.GetLastSequence());
+				REQUIRE(decoder.Decode(encoder.Encode(world), clientState));
+				REQUIRE(clientState.GetEntities().size() == count);
+			}
+		}
+
+		WHEN("Every entity is removed after the client has them all")
+		{
+			REQUIRE(decoder.Decode(encoder.Encode(world), clientState));
+			encoder.OnAck(decoder.GetLastSequence());
+			REQUIRE(decoder.Decode(encoder.Encode(world), clientState));
+			encoder.OnAck(decoder.GetLastSequence());
+
+			world.Clear();
+			REQUIRE(decoder.Decode(encoder.Encode(world), clientState));
+
+			THEN("The removals are split the same way")
+			{
+				REQUIRE(clientState.GetEntities().size() == count - maxListed);
+
+				encoder.OnAck(decoder.GetLastSequence());
+				REQUIRE(decoder.Decode(encoder.Encode(world), clientState));
+				REQUIRE(clientState.GetEntities().empty());
+			}
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
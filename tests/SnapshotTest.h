@@ -0,0 +1,56 @@
+//---------------------------------------------------------------
+//
+// SnapshotTest.h
+//
+
+#pragma once
+
+#include "common/GameState.h"
+#include "common/Snapshot.h"
+
+#include <cmath>
+#include <cstdint>
+
+namespace Tests {
+
+//===============================================================================
+
+// A world of entities with ids 1 to count, spread out so no two share a position.
+inline Common::GameState MakeGameState(uint32_t count)
+{
+	Common::GameState state;
+	for (uint32_t id = 1; id <= count; ++id)
+	{
+		Common::EntityState entity;
+		entity.entityId = id;
+		entity.x = static_cast<float>(id);
+		entity.y = static_cast<float>(id * 2);
+		entity.creatureType = id % 5;
+		entity.health = 100;
+		state.SetEntity(entity);
+	}
+	return state;
+}
+
+// Within range's quantization error, plus a little for float rounding.
+inline bool IsQuantizedClose(float a, float b, const Common::QuantizedRange& range)
+{
+	return std::abs(a - b) <= range.GetMaxError() * 1.0001f;
+}
+
+// Position and heading only have to match as closely as snapshots quantize them.
+inline bool EntitiesMatch(const Common::EntityState& a, const Common::EntityState& b)
+{
+	auto isClose = IsQuantizedClose;
+
+	return a.entityId == b.entityId
+		&& isClose(a.x, b.x, Common::SnapshotQuantization::s_horizontal)
+		&& isClose(a.y, b.y, Common::SnapshotQuantization::s_horizontal)
+		&& isClose(a.z, b.z, Common::SnapshotQuantization::s_vertical)
+		&& isClose(a.heading, b.heading, Common::SnapshotQuantization::s_heading)
+		&& a.creatureType == b.creatureType && a.health == b.health && a.flags == b.flags;
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,152 @@
+//---------------------------------------------------------------
+//
+// TcpListenerBenchmark.cpp
+//
+
+#include "BenchmarkUtils.h"
+#include "TcpListenerTest.h"
+
+#include "Catch2/catch.hpp"
+#include "common/LatencyHistogram.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Tests {
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	// What a server restart looks like: every client reconnecting at once.
+	const uint32_t s_connectionCount = 10000;
+	const uint32_t s_ioThreadCount = 4;
+
+	struct StormResult
+	{
+		uint32_t firstBytes = 0;
+		uint32_t connectErrors = 0;
+		Clock::duration acceptTime = Clock::duration::zero();
+		Common::LatencyHistogram firstByteTime;
+		Common::TcpListenerStats stats;
+	};
+
+	struct StormClient
+	{
+		explicit StormClient(asio::io_context& ioc) : socket(ioc) {}
+
+		asio::ip::tcp::socket socket;
+		char firstByte = 0;
+	};
+
+	// Starts every connect before running any of them, then times each until the server's first
+	// byte arrives. The server sends it as soon as it has the socket, like a handshake would.
+	StormResult RunStorm(const Common::TcpListenerConfig& config)
+	{
+		StormResult result;
+		std::atomic<Clock::rep> lastAcceptAt{ 0 };
+
+		LoopbackListenerFixture fixture(s_ioThreadCount);
+		REQUIRE(fixture.Listen(config, [&lastAcceptAt](asio::ip::tcp::socket socket)
+			{
+				std::error_code ec;
+				asio::write(socket, asio::buffer("x", 1), ec);
+				lastAcceptAt = Clock::now().time_since_epoch().count();
+			}));
+		fixture.ioPool.Run();
+
+		asio::ip::tcp::endpoint endpoint = fixture.GetEndpoint(fixture.listener->GetPort());
+		std::vector<std::unique_ptr<StormClient>> clients;
+		clients.reserve(s_connectionCount);
+
+		Clock::time_point startedAt = Clock::now();
+		for (uint32_t i = 0; i < s_connectionCount; ++i)
+		{
+			clients.push_back(std::make_unique<StormClient>(fixture.clientIoc));
+			StormClient& client = *clients.back();
+			client.socket.async_connect(endpoint, [&, startedAt](const std::error_code& ec)
+				{
+					if (ec)
+					{
+						++result.connectErrors;
+						return;
+					}
+
+					asio::async_read(client.socket, asio::buffer(&client.firstByte, 1),
+						[&, startedAt](const std::error_code& ec, std::size_t)
+						{
+							if (!ec)
+							{
+								++result.firstBytes;
+								result.firstByteTime.Record(
+									std::chrono::duration_cast<std::chrono::microseconds>(
+										Clock::now() - startedAt));
+							}
+						});
+				});
+		}
+
+		// Connects whose SYN was dropped by a full queue are retried by the kernel, a second
+		// later and then doubling, so this can take a while.
+		fixture.clientIoc.run();
+
+		result.acceptTime = Clock::time_point(Clock::duration(lastAcceptAt.load())) - startedAt;
+		result.stats = fixture.listener->GetStats();
+		return result;
+	}
+
+	void Report(const std::string& name, const StormResult& result)
+	{
+		double seconds = std::max<int64_t>(
+			std::chrono::duration_cast<std::chrono::microseconds>(result.acceptTime).count(), 1)
+			/ 1000000.0;
+		WARN(name << ": accepted " << result.stats.accepted << " in "
+			<< static_cast<int64_t>(seconds * 1000) << "ms ("
+			<< static_cast<uint64_t>(result.stats.accepted / seconds) << " connections/s, "
+			<< static_cast<double>(result.stats.accepted) / std::max<uint64_t>(result.stats.wakeups, 1)
+			<< " per wakeup)");
+		WARN(name << ": first byte p50=" << result.firstByteTime.GetPercentile(50).count()
+			<< "us p99=" << result.firstByteTime.GetPercentile(99).count()
+			<< "us max=" << result.firstByteTime.GetMax().count() << "us, "
+			<< result.connectErrors << " connects failed");
+	}
+} // anon namespace
+
+//===============================================================================
+
+TEST_CASE("Accepting a storm of simultaneous connections.", "[.][Benchmark][TcpListener]")
+{
+	Common::TcpListenerConfig single;
+	single.maxAcceptsPerWakeup = 1;
+
+	Common::TcpListenerConfig batched;
+
+	Common::TcpListenerConfig reusePort;
+	reusePort.reusePort = true;
+
+	struct Setting
+	{
+		std::string name;
+		Common::TcpListenerConfig config;
+	};
+
+	std::vector<Setting> settings = {
+		{ "One acceptor, one accept per wakeup", single },
+		{ "One acceptor, batched", batched },
+		{ "Acceptor per io thread, batched", reusePort }
+	};
+
+	for (const Setting& setting : settings)
+	{
+		StormResult result = RunStorm(setting.config);
+		CHECK(result.firstBytes == s_connectionCount);
+		Report(setting.name, result);
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
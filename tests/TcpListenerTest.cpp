@@ -0,0 +1,154 @@
+//---------------------------------------------------------------
+//
+// TcpListenerTest.cpp
+//
+
+#include "TcpListenerTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <atomic>
+#include <map>
+
+namespace Tests {
+
+//===============================================================================
+
+SCENARIO("Accepting connections on one acceptor.", "[TcpListener]")
+{
+	GIVEN("A listener on a running pool of four threads")
+	{
+		LoopbackListenerFixture fixture;
+		REQUIRE(fixture.Listen({}));
+		fixture.ioPool.Run();
+
+		REQUIRE(fixture.listener->GetPort() != 0);
+		REQUIRE(fixture.listener->GetAcceptorCount() == 1);
+
+		WHEN("Clients connect")
+		{
+			fixture.ConnectClients(20);
+
+			THEN("Every one is accepted")
+			{
+				REQUIRE(fixture.WaitForAccepted(20));
+				REQUIRE(fixture.listener->GetStats().acceptErrors == 0);
+			}
+			AND_THEN("The sockets are handed out round robin across the pool")
+			{
+				REQUIRE(fixture.WaitForAccepted(20));
+
+				std::map<asio::io_context*, int> socketsPerService;
+				std::lock_guard<std::mutex> lock(fixture.mutex);
+				for (asio::ip::tcp::socket& socket : fixture.accepted)
+				{
+					++socketsPerService[&socket.get_executor().context()];
+				}
+
+				REQUIRE(socketsPerService.size() == 4);
+				for (const auto& entry : socketsPerService)
+				{
+					REQUIRE(entry.second == 5);
+				}
+			}
+		}
+
+		WHEN("The listener is stopped")
+		{
+			fixture.listener->Stop();
+
+			THEN("Connecting is refused once the acceptor is closed")
+			{
+				// Closing happens on the acceptor's thread, so it takes a moment.
+				std::error_code ec;
+				WaitUntil([&fixture, &ec]()
+					{
+						asio::ip::tcp::socket client(fixture.clientIoc);
+						client.connect(fixture.GetEndpoint(fixture.listener->GetPort()), ec);
+						return static_cast<bool>(ec);
+					});
+
+				REQUIRE(ec == asio::error::connection_refused);
+			}
+		}
+	}
+}
+
+SCENARIO("Accepting connections that queued up before the listener ran.", "[TcpListener]")
+{
+	GIVEN("Twenty connections waiting in the accept queue")
+	{
+		LoopbackListenerFixture fixture;
+		Common::TcpListenerConfig config;
+
+		WHEN("The listener takes as many as it likes per wakeup")
+		{
+			REQUIRE(fixture.Listen(config));
+			fixture.ConnectClients(20);
+			fixture.ioPool.Run();
+
+			THEN("They're all accepted in one wakeup")
+			{
+				REQUIRE(fixture.WaitForAccepted(20));
+				REQUIRE(fixture.listener->GetStats().wakeups == 1);
+			}
+		}
+		AND_WHEN("The listener takes at most four per wakeup")
+		{
+			config.maxAcceptsPerWakeup = 4;
+			REQUIRE(fixture.Listen(config));
+			fixture.ConnectClients(20);
+			fixture.ioPool.Run();
+
+			THEN("They're accepted four at a time")
+			{
+				REQUIRE(fixture.WaitForAccepted(20));
+				REQUIRE(fixture.listener->GetStats().wakeups == 5);
+			}
+		}
+	}
+}
+
+SCENARIO("Accepting connections on an acceptor per io thread.", "[TcpListener]")
+{
+	GIVEN("A listener with reusePort set on a running pool of four threads")
+	{
+		// Each socket should already be on the thread that accepted it.
+		std::atomic<int> acceptedElsewhere{ 0 };
+		LoopbackListenerFixture fixture;
+		Common::TcpListenerConfig config;
+		config.reusePort = true;
+		REQUIRE(fixture.Listen(config, [&](asio::ip::tcp::socket socket)
+			{
+				if (!socket.get_executor().running_in_this_thread())
+				{
+					++acceptedElsewhere;
+				}
+			}));
+		fixture.ioPool.Run();
+
+		THEN("There's an acceptor per thread, where the platform allows it")
+		{
+			uint32_t expected = Common::TcpListener::IsReusePortSupported() ? 4 : 1;
+			REQUIRE(fixture.listener->GetAcceptorCount() == expected);
+		}
+
+		WHEN("Clients connect")
+		{
+			fixture.ConnectClients(200);
+
+			THEN("Every one is accepted, and kept on the thread that accepted it")
+			{
+				REQUIRE(fixture.WaitForAccepted(200));
+				if (Common::TcpListener::IsReusePortSupported())
+				{
+					REQUIRE(acceptedElsewhere == 0);
+				}
+			}
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,97 @@
+//---------------------------------------------------------------
+//
+// TcpListenerTest.h
+//
+
+#pragma once
+
+#include "LoopbackUtils.h"
+#include "common/AsioEventProcessor.h"
+#include "common/TcpListener.h"
+
+#include <asio.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Tests {
+
+//===============================================================================
+
+// A TcpListener on a free loopback port, with an io thread pool of its own. The pool isn't
+// running until the test runs it, so connections can be queued up first.
+struct LoopbackListenerFixture {
+
+	explicit LoopbackListenerFixture(uint32_t threadCount = 4)
+		: ioPool(threadCount)
+	{
+	}
+
+	~LoopbackListenerFixture()
+	{
+		if (listener)
+		{
+			listener->Stop();
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		accepted.clear();
+	}
+
+	// Without a handler, accepted sockets are kept in accepted.
+	bool Listen(const Common::TcpListenerConfig& config,
+		Common::TcpListener::AcceptHandler handler = nullptr)
+	{
+		listener = std::make_shared<Common::TcpListener>(ioPool,
+			MakeLoggingContext("TcpListenerTest"), config);
+
+		if (!handler)
+		{
+			handler = [this](asio::ip::tcp::socket socket)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				accepted.push_back(std::move(socket));
+			};
+		}
+		listener->SetAcceptHandler(std::move(handler));
+
+		std::error_code ec;
+		return listener->Listen(GetEndpoint(0), ec);
+	}
+
+	asio::ip::tcp::endpoint GetEndpoint(uint16_t port) const
+	{
+		return asio::ip::tcp::endpoint(GetLoopbackAddress(), port);
+	}
+
+	// Connects count blocking clients. The kernel finishes the handshake whether or not the
+	// listener has accepted them yet.
+	void ConnectClients(uint32_t count)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			clients.emplace_back(clientIoc);
+			clients.back().connect(GetEndpoint(listener->GetPort()));
+		}
+	}
+
+	// Returns false if count sockets aren't accepted in time.
+	bool WaitForAccepted(uint64_t count)
+	{
+		return WaitUntil([this, count]() { return listener->GetStats().accepted >= count; });
+	}
+
+	Common::AsioEventProcessor ioPool;
+	std::shared_ptr<Common::TcpListener> listener;
+
+	std::mutex mutex;
+	std::vector<asio::ip::tcp::socket> accepted;
+
+	asio::io_context clientIoc;
+	std::vector<asio::ip::tcp::socket> clients;
+};
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,1038 @@
+//---------------------------------------------------------------
+//
+// TcpSessionTest.cpp
+//
+
+#include "FrameCompressionTest.h"
+#include "TcpSessionTest.h"
+
+#include "Catch2/catch.hpp"
+#include "common/NetworkTypes.h"
+#include "common/SlotMap.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Tests {
+
+namespace {
+	const int s_messageCount = 1000;
+
+	std::string MakeMessage(int i)
+	{
+		return "message " + std::to_string(i) + ";";
+	}
+
+	// A framed Move for entityId, whose payload starts with the id as MessageCoalescing expects.
+	std::string MakeMove(uint32_t entityId, const std::string& value)
+	{
+		std::string payload(reinterpret_cast<const char*>(&entityId), sizeof(entityId));
+		return Common::PackageMessage(Common::MessageId::Move, payload + value);
+	}
+
+	bool RttStatsAreEmpty(const Common::RttStats& stats)
+	{
+		return stats.sampleCount == 0 && stats.recent.empty();
+	}
+} // anon namespace
+
+//===============================================================================
+
+SCENARIO_METHOD(LoopbackSessionFixture, "Writing many small messages to a session.", "[TcpSession]")
+{
+	GIVEN("An uncorked session that is ready to write")
+	{
+		Connect({});
+		Pump();
+
+		WHEN("A burst of small messages is written in one go")
+		{
+			std::string expected;
+			for (int i = 0; i < s_messageCount; ++i)
+			{
+				expected.append(MakeMessage(i));
+				session->Write(MakeMessage(i));
+			}
+
+			std::string received = ReadFromPeer(expected.size());
+
+			THEN("Every byte arrives in order")
+			{
+				REQUIRE(received == expected);
+			}
+			AND_THEN("Messages queued behind the first write are gathered into shared syscalls")
+			{
+				Common::TcpSessionStats stats = session->GetStats();
+				CAPTURE(stats.writeCalls, stats.messagesWritten);
+
+				REQUIRE(stats.messagesWritten == s_messageCount);
+				REQUIRE(stats.writeCalls < s_messageCount / 10);
+			}
+		}
+	}
+	AND_GIVEN("A corked session with a small batch limit")
+	{
+		Common::TcpSessionConfig config;
+		config.corkWrites = true;
+		config.maxWriteBatchBytes = 256;
+		Connect(config);
+		Pump();
+
+		WHEN("Less than a batch is written")
+		{
+			session->Write(MakeMessage(0));
+			Pump();
+
+			THEN("Nothing goes out until it's flushed")
+			{
+				REQUIRE(session->GetStats().writeCalls == 0);
+
+				session->Flush();
+				REQUIRE(ReadFromPeer(MakeMessage(0).size()) == MakeMessage(0));
+				REQUIRE(session->GetStats().writeCalls == 1);
+			}
+		}
+		AND_WHEN("A burst of messages is written and flushed")
+		{
+			std::string expected;
+			for (int i = 0; i < s_messageCount; ++i)
+			{
+				expected.append(MakeMessage(i));
+				session->Write(MakeMessage(i));
+			}
+			session->Flush();
+
+			std::string received = ReadFromPeer(expected.size());
+
+			THEN("Every byte arrives in order, in batches no bigger than the limit")
+			{
+				REQUIRE(received == expected);
+
+				Common::TcpSessionStats stats = session->GetStats();
+				CAPTURE(stats.writeCalls, stats.bytesWritten);
+				REQUIRE(stats.messagesWritten == s_messageCount);
+				REQUIRE(stats.writeCalls >= expected.size() / config.maxWriteBatchBytes);
+				REQUIRE(stats.writeCalls < s_messageCount);
+			}
+		}
+	}
+}
+
+SCENARIO_METHOD(LoopbackSessionFixture, "Writing a shared buffer to a session.", "[TcpSession]")
+{
+	GIVEN("A session that is ready to write")
+	{
+		Connect({});
+		Pump();
+
+		WHEN("The same buffer is written several times")
+		{
+			auto buffer = std::make_shared<const std::string>(MakeMessage(42));
+			for (int i = 0; i < 3; ++i)
+			{
+				session->Write(buffer);
+			}
+
+			std::string received = ReadFromPeer(buffer->size() * 3);
+
+			THEN("Its bytes go out once per write")
+			{
+				REQUIRE(received == *buffer + *buffer + *buffer);
+			}
+			AND_THEN("The session lets go of it once it's written")
+			{
+				REQUIRE(buffer.use_count() == 1);
+			}
+		}
+	}
+}
+
+SCENARIO_METHOD(LoopbackSessionFixture, "Receiving messages on a session.", "[TcpSession]")
+{
+	GIVEN("A session with a batch handler")
+	{
+		std::vector<std::shared_ptr<Common::MessageBatch>> batches;
+		Connect({}, [&batches](std::shared_ptr<Common::MessageBatch> batch)
+			{
+				batches.push_back(std::move(batch));
+			});
+
+		WHEN("The peer sends several framed messages in one write")
+		{
+			std::string stream;
+			for (int i = 0; i < 3; ++i)
+			{
+				std::string payload = MakeMessage(i);
+				Common::MessageHeader header{ Common::MessageId::TestMessage,
+					static_cast<uint32_t>(payload.size()) };
+				stream.append(reinterpret_cast<const char*>(&header), sizeof(header));
+				stream.append(payload);
+			}
+			asio::write(peer, asio::buffer(stream));
+
+			size_t received = 0;
+			PumpUntil([&]()
+				{
+					received = 0;
+					for (const auto& batch : batches)
+					{
+						received += batch->Size();
+					}
+					return received >= 3;
+				});
+
+			THEN("They're delivered as owned batches, in order")
+			{
+				REQUIRE(received == 3);
+
+				int i = 0;
+				for (const auto& batch : batches)
+				{
+					for (size_t m = 0; m < batch->Size(); ++m, ++i)
+					{
+						REQUIRE((*batch)[m].header.messageType == Common::MessageId::TestMessage);
+						REQUIRE((*batch)[m].messageData == MakeMessage(i));
+					}
+				}
+			}
+		}
+	}
+}
+
+SCENARIO_METHOD(LoopbackSessionFixture, "A session with a full output queue.", "[TcpSession]")
+{
+	// Corked, so nothing leaves the queue until it's flushed.
+	Common::TcpSessionConfig config;
+	config.corkWrites = true;
+	config.maxQueuedBytes = 100;
+
+	auto writeMessages = [this]()
+	{
+		std::string all;
+		for (int i = 0; i < 20; ++i)
+		{
+			all.append(MakeMessage(i));
+			session->Write(MakeMessage(i));
+		}
+		return all;
+	};
+
+	GIVEN("The drop policy")
+	{
+		config.overflowPolicy = Common::OverflowPolicy::Drop;
+		Connect(config);
+		Pump();
+
+		WHEN("More is written than the queue may hold")
+		{
+			std::string all = writeMessages();
+			Common::TcpSessionStats stats = session->GetStats();
+			session->Flush();
+			std::string received = ReadFromPeer(static_cast<size_t>(stats.peakQueuedBytes));
+
+			THEN("The queue stays under its limit and the newest messages are dropped")
+			{
+				REQUIRE(stats.peakQueuedBytes <= config.maxQueuedBytes);
+				REQUIRE(stats.messagesDropped > 0);
+				REQUIRE(stats.bytesDropped + stats.peakQueuedBytes == all.size());
+				REQUIRE(all.compare(0, received.size(), received) == 0);
+			}
+		}
+	}
+	AND_GIVEN("The coalesce policy")
+	{
+		config.overflowPolicy = Common::OverflowPolicy::Coalesce;
+		config.coalescing = std::make_shared<Common::MessageCoalescing>();
+		Connect(config);
+		Pump();
+
+		WHEN("Moves and other messages are written past the limit")
+		{
+			std::string first = Common::PackageMessage(Common::MessageId::Attack, "first");
+			std::string last = Common::PackageMessage(Common::MessageId::Attack, "last");
+			std::string all = first;
+			session->Write(first);
+			for (uint32_t i = 0; i < 20; ++i)
+			{
+				all.append(MakeMove(i, "x"));
+				session->Write(MakeMove(i, "x"));
+			}
+			all.append(last);
+			session->Write(last);
+
+			Common::TcpSessionStats stats = session->GetStats();
+			session->Flush();
+			std::string received = ReadFromPeer(all.size() - static_cast<size_t>(stats.bytesDropped));
+
+			THEN("The oldest moves make way, and nothing else is dropped")
+			{
+				REQUIRE(stats.peakQueuedBytes <= config.maxQueuedBytes);
+				REQUIRE(stats.messagesDropped > 0);
+				REQUIRE(received.compare(0, first.size(), first) == 0);
+				REQUIRE(received.compare(received.size() - last.size(), last.size(), last) == 0);
+
+				std::string newest = MakeMove(19, "x");
+				REQUIRE(received.compare(received.size() - last.size() - newest.size(),
+					newest.size(), newest) == 0);
+			}
+		}
+		AND_WHEN("Only messages that aren't latest-value-wins are written past the limit")
+		{
+			std::string all = writeMessages();
+			Common::TcpSessionStats stats = session->GetStats();
+			session->Flush();
+			std::string received = ReadFromPeer(static_cast<size_t>(stats.peakQueuedBytes));
+
+			THEN("The newest messages are dropped, as with the drop policy")
+			{
+				REQUIRE(stats.messagesDropped > 0);
+				REQUIRE(stats.bytesDropped + stats.peakQueuedBytes == all.size());
+				REQUIRE(all.compare(0, received.size(), received) == 0);
+			}
+		}
+	}
+	AND_GIVEN("The disconnect policy with a grace period")
+	{
+		config.overflowPolicy = Common::OverflowPolicy::Disconnect;
+		config.overflowGracePeriod = std::chrono::hours(1);
+		Connect(config);
+		Pump();
+
+		WHEN("More is written than the queue may hold")
+		{
+			std::string all = writeMessages();
+			Common::TcpSessionStats stats = session->GetStats();
+
+			THEN("The session stays connected and the newest messages are dropped")
+			{
+				REQUIRE(!session->IsStopped());
+				REQUIRE(stats.messagesDropped > 0);
+
+				session->Flush();
+				std::string received = ReadFromPeer(static_cast<size_t>(stats.peakQueuedBytes));
+				REQUIRE(all.compare(0, received.size(), received) == 0);
+			}
+		}
+	}
+	AND_GIVEN("The disconnect policy without a grace period")
+	{
+		config.overflowPolicy = Common::OverflowPolicy::Disconnect;
+		config.overflowGracePeriod = std::chrono::milliseconds::zero();
+		Connect(config);
+		Pump();
+
+		WHEN("More is written than the queue may hold")
+		{
+			writeMessages();
+
+			THEN("The session is closed")
+			{
+				REQUIRE(session->IsStopped());
+				REQUIRE(session->GetStats().messagesDropped > 0);
+			}
+			AND_WHEN("More is written once it's closed")
+			{
+				Common::TcpSessionStats before = session->GetStats();
+				writeMessages();
+
+				THEN("It's ignored rather than queued or dropped")
+				{
+					Common::TcpSessionStats after = session->GetStats();
+					REQUIRE(after.messagesDropped == before.messagesDropped);
+					REQUIRE(after.peakQueuedBytes == before.peakQueuedBytes);
+				}
+			}
+		}
+	}
+}
+
+SCENARIO_METHOD(LoopbackSessionFixture, "Writing to a stopped session.", "[TcpSession]")
+{
+	GIVEN("A corked session with a message queued")
+	{
+		Common::TcpSessionConfig config;
+		config.corkWrites = true;
+		Connect(config);
+		Pump();
+
+		auto buffer = std::make_shared<const std::string>(MakeMessage(0));
+		session->Write(buffer);
+		REQUIRE(buffer.use_count() == 2);
+
+		WHEN("The session is stopped")
+		{
+			session->Stop();
+
+			THEN("It lets go of what was queued")
+			{
+				REQUIRE(buffer.use_count() == 1);
+			}
+			AND_WHEN("It's written to again and flushed")
+			{
+				session->Write(buffer);
+				session->Flush();
+				Pump();
+
+				THEN("Nothing is queued or written")
+				{
+					REQUIRE(buffer.use_count() == 1);
+					REQUIRE(session->GetStats().writeCalls == 0);
+					REQUIRE(session->GetStats().messagesDropped == 0);
+				}
+			}
+		}
+	}
+}
+
+SCENARIO_METHOD(LoopbackSessionFixture, "A session that stops on its own.", "[TcpSession]")
+{
+	GIVEN("A session with a stopped handler")
+	{
+		int stopCount = 0;
+		Connect({});
+		session->SetStoppedHandler([&stopCount]() { ++stopCount; });
+		Pump();
+
+		WHEN("The peer disconnects")
+		{
+			peer.close();
+
+			THEN("The handler runs once, however many times the session is stopped")
+			{
+				REQUIRE(PumpUntil([this]() { return session->IsStopped(); }));
+				REQUIRE(stopCount == 1);
+
+				session->Stop();
+				REQUIRE(stopCount == 1);
+			}
+		}
+	}
+	AND_GIVEN("Sessions kept in a slot map that frees a slot when its session stops")
+	{
+		// The way the server keeps its clients.
+		Common::SlotMap<Common::TcpSession> sessions(8);
+
+		WHEN("Many more clients than there are slots connect and disconnect one after another")
+		{
+			const uint32_t connectCount = sessions.Capacity() * 4;
+			uint32_t added = 0;
+			for (uint32_t i = 0; i < connectCount; ++i)
+			{
+				asio::ip::tcp::socket client(ioc);
+				asio::ip::tcp::socket accepted(ioc);
+				client.connect(acceptor.local_endpoint());
+				acceptor.accept(accepted);
+
+				auto reconnected = std::make_shared<Common::TcpSession>(std::move(accepted),
+					MakeLoggingContext("TcpSessionTest-Reconnect"));
+				uint32_t id = sessions.Add(reconnected);
+				if (id == Common::SlotMap<Common::TcpSession>::s_invalidId)
+				{
+					break;
+				}
+
+				++added;
+				reconnected->SetStoppedHandler([&sessions, id]() { sessions.Remove(id); });
+				reconnected->Start();
+				client.close();
+
+				PumpUntil([&sessions]() { return sessions.Size() == 0; });
+				sessions.Collect();
+			}
+
+			THEN("Every one of them gets a slot")
+			{
+				REQUIRE(added == connectCount);
+				REQUIRE(sessions.Size() == 0);
+			}
+		}
+	}
+}
+
+SCENARIO_METHOD(LoopbackSessionFixture, "Replacing queued latest-value-wins messages.", "[TcpSession]")
+{
+	// Corked, so messages wait in the queue until they're flushed.
+	Common::TcpSessionConfig config;
+	config.corkWrites = true;
+	config.coalescing = std::make_shared<Common::MessageCoalescing>();
+
+	GIVEN("A session that coalesces Moves by entity")
+	{
+		Connect(config);
+		Pump();
+
+		WHEN("Several Moves for the same entities are queued")
+		{
+			session->Write(MakeMove(1, "a"));
+			session->Write(MakeMove(2, "b"));
+			session->Write(MakeMove(1, "c"));
+			session->Write(MakeMove(1, "d"));
+			session->Flush();
+
+			std::string expected = MakeMove(1, "d") + MakeMove(2, "b");
+			std::string received = ReadFromPeer(expected.size());
+
+			THEN("Only the latest for each goes out, where the first one was queued")
+			{
+				REQUIRE(received == expected);
+				REQUIRE(session->GetStats().messagesCoalesced == 2);
+				REQUIRE(session->GetStats().bytesCoalesced == 2 * MakeMove(1, "a").size());
+			}
+		}
+
+		WHEN("A Move is queued after another message that came after an older Move")
+		{
+			std::string attack = Common::PackageMessage(Common::MessageId::Attack, "attack");
+			session->Write(MakeMove(1, "a"));
+			session->Write(attack);
+			session->Write(MakeMove(1, "b"));
+			session->Write(MakeMove(1, "c"));
+			session->Flush();
+
+			std::string expected = MakeMove(1, "a") + attack + MakeMove(1, "c");
+			std::string received = ReadFromPeer(expected.size());
+
+			THEN("It doesn't overtake that message, but Moves behind it still coalesce")
+			{
+				REQUIRE(received == expected);
+				REQUIRE(session->GetStats().messagesCoalesced == 1);
+			}
+		}
+
+		WHEN("A stream of Moves for a few entities is queued")
+		{
+			for (uint32_t i = 0; i < 1000; ++i)
+			{
+				session->Write(MakeMove(i % 10, std::to_string(i % 7)));
+			}
+
+			THEN("The queue holds one per entity")
+			{
+				REQUIRE(session->GetStats().peakQueuedBytes == 10 * MakeMove(0, "0").size());
+				REQUIRE(session->GetStats().messagesCoalesced == 990);
+			}
+		}
+
+		WHEN("A Move is too short to have an entity id")
+		{
+			std::string shortMove = Common::PackageMessage(Common::MessageId::Move, "ab");
+			session->Write(shortMove);
+			session->Write(shortMove);
+			session->Flush();
+
+			std::string received = ReadFromPeer(2 * shortMove.size());
+
+			THEN("It's queued as usual")
+			{
+				REQUIRE(received == shortMove + shortMove);
+				REQUIRE(session->GetStats().messagesCoalesced == 0);
+			}
+		}
+	}
+	AND_GIVEN("An uncorked session coalescing Moves")
+	{
+		config.corkWrites = false;
+		Connect(config);
+		Pump();
+
+		WHEN("A Move is queued while an older one is being written")
+		{
+			session->Write(MakeMove(1, "a"));
+			session->Write(MakeMove(1, "b"));
+
+			std::string expected = MakeMove(1, "a") + MakeMove(1, "b");
+			std::string received = ReadFromPeer(expected.size());
+
+			THEN("Both go out, since the one being written can't be replaced")
+			{
+				REQUIRE(received == expected);
+				REQUIRE(session->GetStats().messagesCoalesced == 0);
+			}
+		}
+	}
+	AND_GIVEN("A session that coalesces Moves with a small output queue")
+	{
+		config.maxQueuedBytes = static_cast<uint32_t>(MakeMove(1, "a").size() * 2 + 4);
+		config.overflowPolicy = Common::OverflowPolicy::Drop;
+		Connect(config);
+		Pump();
+
+		WHEN("A Move is replaced by a bigger one that doesn't fit")
+		{
+			session->Write(MakeMove(1, "a"));
+			session->Write(MakeMove(2, "b"));
+			session->Write(MakeMove(1, std::string(64, 'c')));
+			Common::TcpSessionStats stats = session->GetStats();
+			session->Flush();
+
+			std::string expected = MakeMove(1, "a") + MakeMove(2, "b");
+			std::string received = ReadFromPeer(expected.size());
+
+			THEN("The queue stays under its limit and the overflow policy decides")
+			{
+				REQUIRE(received == expected);
+				REQUIRE(stats.peakQueuedBytes <= config.maxQueuedBytes);
+				REQUIRE(stats.messagesCoalesced == 0);
+				REQUIRE(stats.messagesDropped == 1);
+			}
+		}
+
+		WHEN("A Move is replaced by a bigger one that still fits")
+		{
+			session->Write(MakeMove(1, "a"));
+			session->Write(MakeMove(2, "b"));
+			session->Write(MakeMove(1, "cde"));
+			session->Flush();
+
+			std::string expected = MakeMove(1, "cde") + MakeMove(2, "b");
+			std::string received = ReadFromPeer(expected.size());
+
+			THEN("It takes the old one's place")
+			{
+				REQUIRE(received == expected);
+				REQUIRE(session->GetStats().messagesCoalesced == 1);
+			}
+		}
+	}
+	AND_GIVEN("A session without coalescing")
+	{
+		config.coalescing = nullptr;
+		Connect(config);
+		Pump();
+
+		WHEN("Moves for the same entity are queued")
+		{
+			session->Write(MakeMove(1, "a"));
+			session->Write(MakeMove(1, "b"));
+			session->Flush();
+
+			std::string expected = MakeMove(1, "a") + MakeMove(1, "b");
+			std::string received = ReadFromPeer(expected.size());
+
+			THEN("They all go out")
+			{
+				REQUIRE(received == expected);
+			}
+		}
+	}
+}
+
+SCENARIO_METHOD(LoopbackSessionFixture, "A peer sending an oversized frame.", "[TcpSession]")
+{
+	GIVEN("A session with a small inbound frame limit")
+	{
+		Common::TcpSessionConfig config;
+		config.maxInboundFrameSize = 1024;
+		Connect(config, [](std::shared_ptr<Common::MessageBatch>) {});
+		Pump();
+
+		WHEN("The peer sends a header claiming a huge payload")
+		{
+			Common::MessageHeader header{ Common::MessageId::TestMessage, 512 * 1024 * 1024 };
+			asio::write(peer, asio::buffer(&header, sizeof(header)));
+
+			PumpUntil([this]() { return session->IsStopped(); });
+
+			THEN("The session disconnects instead of waiting for it")
+			{
+				REQUIRE(session->IsStopped());
+			}
+		}
+	}
+}
+
+SCENARIO_METHOD(LoopbackSessionFixture, "Measuring the round trip with pings.", "[TcpSession]")
+{
+	const size_t probeSize = sizeof(Common::MessageHeader) + sizeof(Common::PingPayload);
+
+	std::vector<std::shared_ptr<Common::MessageBatch>> batches;
+	auto handler = [&batches](std::shared_ptr<Common::MessageBatch> batch)
+	{
+		batches.push_back(std::move(batch));
+	};
+
+	GIVEN("A session that pings once on start")
+	{
+		Common::TcpSessionConfig config;
+		config.pingInterval = std::chrono::hours(1);
+		Connect(config, handler);
+
+		std::string ping = ReadFromPeer(probeSize);
+		Common::MessageHeader header;
+		REQUIRE(Common::PeekHeader(ping, header));
+		REQUIRE(header.messageType == Common::MessageId::Ping);
+		REQUIRE(RttStatsAreEmpty(session->GetRttStats()));
+
+		WHEN("The peer sends it back as a pong")
+		{
+			asio::write(peer, asio::buffer(Common::PackageMessage(Common::MessageId::Pong,
+				std::string_view(ping).substr(sizeof(header)))));
+
+			PumpUntil([this]() { return session->GetRttStats().sampleCount > 0; });
+
+			THEN("The round trip is recorded and the pong isn't passed on")
+			{
+				Common::RttStats stats = session->GetRttStats();
+				REQUIRE(stats.sampleCount == 1);
+				REQUIRE(stats.smoothed == stats.latest);
+				REQUIRE(stats.recent.size() == 1);
+				REQUIRE(batches.empty());
+			}
+		}
+	}
+	AND_GIVEN("A session that never pings")
+	{
+		Connect({}, handler);
+		Pump();
+
+		WHEN("The peer pings it")
+		{
+			Common::PingPayload payload;
+			payload.sequence = 7;
+			payload.sentAt = 123456;
+			std::string_view bytes(reinterpret_cast<const char*>(&payload), sizeof(payload));
+			asio::write(peer, asio::buffer(Common::PackageMessage(Common::MessageId::Ping, bytes)));
+
+			std::string pong = ReadFromPeer(probeSize);
+
+			THEN("It answers with the same payload and doesn't pass the ping on")
+			{
+				REQUIRE(pong == Common::PackageMessage(Common::MessageId::Pong, bytes));
+				REQUIRE(batches.empty());
+				REQUIRE(RttStatsAreEmpty(session->GetRttStats()));
+			}
+		}
+	}
+	AND_GIVEN("A session whose peer pings without reading")
+	{
+		Common::TcpSessionConfig config;
+		config.maxWriteBatchBuffers = 4;
+		Connect(config, handler);
+		Pump();
+
+		WHEN("The peer floods it with pings, some the wrong size")
+		{
+			Common::PingPayload payload;
+			std::string_view bytes(reinterpret_cast<const char*>(&payload), sizeof(payload));
+			std::string flood;
+			for (int i = 0; i < 4096; ++i)
+			{
+				flood.append(Common::PackageMessage(Common::MessageId::Ping, bytes));
+			}
+			flood.append(Common::PackageMessage(Common::MessageId::Ping, std::string(1024, 'x')));
+			asio::write(peer, asio::buffer(flood));
+
+			PumpUntil([this]() { return session->GetStats().messagesRead == 4097; });
+			Common::TcpSessionStats stats = session->GetStats();
+
+			THEN("Only a handful of pongs are kept and the rest are dropped")
+			{
+				REQUIRE(stats.probesDropped > 0);
+				REQUIRE(stats.messagesWritten + stats.probesDropped <= 4096);
+				REQUIRE(stats.peakQueuedBytes == 0);
+				REQUIRE(batches.empty());
+			}
+		}
+	}
+	AND_GIVEN("A corked session that pings once on start")
+	{
+		Common::TcpSessionConfig config;
+		config.corkWrites = true;
+		config.pingInterval = std::chrono::hours(1);
+		Connect(config, handler);
+
+		WHEN("Nothing is flushed")
+		{
+			std::string ping = ReadFromPeer(probeSize);
+
+			THEN("The ping goes out anyway")
+			{
+				Common::MessageHeader header;
+				REQUIRE(Common::PeekHeader(ping, header));
+				REQUIRE(header.messageType == Common::MessageId::Ping);
+			}
+			AND_WHEN("The peer pings it")
+			{
+				Common::PingPayload payload;
+				payload.sequence = 7;
+				std::string_view bytes(reinterpret_cast<const char*>(&payload), sizeof(payload));
+				asio::write(peer, asio::buffer(Common::PackageMessage(Common::MessageId::Ping, bytes)));
+
+				std::string pong = ReadFromPeer(probeSize);
+
+				THEN("The pong goes out without waiting for a flush either")
+				{
+					REQUIRE(pong == Common::PackageMessage(Common::MessageId::Pong, bytes));
+				}
+			}
+			AND_WHEN("A message is queued and then the peer pings it")
+			{
+				session->Write(MakeMessage(0));
+
+				Common::PingPayload payload;
+				payload.sequence = 8;
+				std::string_view bytes(reinterpret_cast<const char*>(&payload), sizeof(payload));
+				asio::write(peer, asio::buffer(Common::PackageMessage(Common::MessageId::Ping, bytes)));
+
+				std::string pong = ReadFromPeer(probeSize);
+				Common::TcpSessionStats stats = session->GetStats();
+
+				THEN("The pong goes out ahead of the message, which still waits for a flush")
+				{
+					REQUIRE(pong == Common::PackageMessage(Common::MessageId::Pong, bytes));
+					REQUIRE(stats.messagesWritten == 2);
+
+					session->Flush();
+					REQUIRE(ReadFromPeer(MakeMessage(0).size()) == MakeMessage(0));
+				}
+			}
+		}
+	}
+}
+
+SCENARIO_METHOD(LoopbackSessionFixture, "A session using the compact wire format.", "[TcpSession]")
+{
+	GIVEN("A compact session with checksums")
+	{
+		std::vector<std::shared_ptr<Common::MessageBatch>> batches;
+		Common::TcpSessionConfig config;
+		config.wireFormat = Common::WireFormat::Compact;
+		config.wireChecksums = true;
+		Connect(config, [&batches](std::shared_ptr<Common::MessageBatch> batch)
+			{
+				batches.push_back(std::move(batch));
+			});
+
+		WHEN("Legacy framed messages are written, some sharing a buffer")
+		{
+			std::string first = Common::PackageMessage(Common::MessageId::Move, "move");
+			std::string second = Common::PackageMessage(Common::MessageId::Attack, "attack")
+				+ Common::PackageMessage(Common::MessageId::SnapshotAck, "");
+			session->Write(first);
+			session->Write(second);
+
+			std::string expected = std::string(Common::s_wirePreamble, Common::s_wirePreambleSize)
+				+ Common::PackageCompactMessage(Common::MessageId::Move, "move",
+					Common::CompactFrameChecksum)
+				+ Common::PackageCompactMessage(Common::MessageId::Attack, "attack",
+					Common::CompactFrameChecksum)
+				+ Common::PackageCompactMessage(Common::MessageId::SnapshotAck, "",
+					Common::CompactFrameChecksum);
+
+			THEN("The peer gets the preamble then every frame reframed")
+			{
+				REQUIRE(ReadFromPeer(expected.size()) == expected);
+
+				AND_THEN("What was sent is counted as it went out on the wire")
+				{
+					Common::TcpSessionStats stats = session->GetStats();
+					REQUIRE(stats.messagesWritten == 2);
+					REQUIRE(stats.bytesWritten == expected.size());
+				}
+			}
+		}
+
+		WHEN("The peer sends compact frames")
+		{
+			std::string stream = std::string(Common::s_wirePreamble, Common::s_wirePreambleSize)
+				+ Common::PackageCompactMessage(Common::MessageId::Move, MakeMessage(0))
+				+ Common::PackageCompactMessage(Common::MessageId::Attack, MakeMessage(1),
+					Common::CompactFrameChecksum);
+			asio::write(peer, asio::buffer(stream));
+
+			size_t received = 0;
+			PumpUntil([&]()
+				{
+					received = 0;
+					for (const auto& batch : batches)
+					{
+						received += batch->Size();
+					}
+					return received >= 2;
+				});
+
+			THEN("They're delivered with the same headers as legacy frames")
+			{
+				REQUIRE(received == 2);
+				Common::NetworkMessageView move = (*batches.front())[0];
+				REQUIRE(move.header.messageType == Common::MessageId::Move);
+				REQUIRE(move.header.messageLength == MakeMessage(0).size());
+				REQUIRE(move.messageData == MakeMessage(0));
+			}
+		}
+	}
+}
+
+SCENARIO_METHOD(LoopbackSessionFixture, "A compact session with a small buffer limit.", "[TcpSession]")
+{
+	GIVEN("A corked compact session that writes at most four buffers at a time")
+	{
+		Common::TcpSessionConfig config;
+		config.wireFormat = Common::WireFormat::Compact;
+		config.corkWrites = true;
+		config.maxWriteBatchBuffers = 4;
+		Connect(config);
+
+		WHEN("Two messages, a header and a payload each, are flushed before the preamble is sent")
+		{
+			session->Write(Common::PackageMessage(Common::MessageId::Move, "first"));
+			session->Write(Common::PackageMessage(Common::MessageId::Move, "second"));
+			session->Flush();
+
+			std::string expected = std::string(Common::s_wirePreamble, Common::s_wirePreambleSize)
+				+ Common::PackageCompactMessage(Common::MessageId::Move, "first")
+				+ Common::PackageCompactMessage(Common::MessageId::Move, "second");
+
+			THEN("The preamble counts as a buffer, so the second goes in a write of its own")
+			{
+				REQUIRE(ReadFromPeer(expected.size()) == expected);
+				REQUIRE(session->GetStats().writeCalls == 2);
+			}
+		}
+	}
+}
+
+SCENARIO_METHOD(LoopbackSessionFixture, "A session compressing large frames.", "[TcpSession]")
+{
+	GIVEN("A compact session that compresses payloads of 256 bytes or more")
+	{
+		Common::TcpSessionConfig config;
+		config.wireFormat = Common::WireFormat::Compact;
+		config.compressionThreshold = 256;
+		Connect(config, [](std::shared_ptr<Common::MessageBatch>) {});
+
+		WHEN("A large and a small message are written")
+		{
+			const std::string large = MakeCompressiblePayload(0, 2000);
+			session->Write(Common::PackageMessage(Common::MessageId::Snapshot, large)
+				+ Common::PackageMessage(Common::MessageId::Move, "move"));
+
+			// Per frame compression comes out the same every time for the same payload.
+			Common::FrameCompressor compressor(config.compressionLevel, false);
+			std::string compressed;
+			REQUIRE(compressor.Compress(large, compressed));
+			std::string expected = std::string(Common::s_wirePreamble, Common::s_wirePreambleSize)
+				+ Common::PackageCompactMessage(Common::MessageId::Snapshot, compressed,
+					Common::CompactFrameCompressed)
+				+ Common::PackageCompactMessage(Common::MessageId::Move, "move");
+
+			THEN("Only the large one is compressed")
+			{
+				REQUIRE(ReadFromPeer(expected.size()) == expected);
+
+				AND_THEN("It's counted, and bytes written are what went out on the wire")
+				{
+					Common::TcpSessionStats stats = session->GetStats();
+					REQUIRE(stats.compression.frames == 1);
+					REQUIRE(stats.compression.uncompressedBytes == large.size());
+					REQUIRE(stats.compression.compressedBytes == compressed.size());
+					REQUIRE(stats.bytesWritten == expected.size());
+				}
+			}
+		}
+
+		WHEN("The peer sends a compressed frame and then a plain one")
+		{
+			const std::string large = MakeCompressiblePayload(0, 2000);
+			Common::FrameCompressor compressor(config.compressionLevel, false);
+			std::string compressed;
+			REQUIRE(compressor.Compress(large, compressed));
+
+			std::string stream = std::string(Common::s_wirePreamble, Common::s_wirePreambleSize)
+				+ Common::PackageCompactMessage(Common::MessageId::Snapshot, compressed,
+					Common::CompactFrameCompressed);
+			asio::write(peer, asio::buffer(stream));
+
+			PumpUntil([this]() { return session->GetStats().messagesRead >= 1; });
+
+			std::string move = Common::PackageCompactMessage(Common::MessageId::Move, "move");
+			asio::write(peer, asio::buffer(move));
+			PumpUntil([this]() { return session->GetStats().messagesRead >= 2; });
+
+			THEN("Only the compressed one is counted as inflated")
+			{
+				Common::TcpSessionStats stats = session->GetStats();
+				REQUIRE(stats.messagesRead == 2);
+				REQUIRE(stats.decompression.frames == 1);
+				REQUIRE(stats.decompression.uncompressedBytes == large.size());
+				REQUIRE(stats.decompression.compressedBytes == compressed.size());
+			}
+		}
+	}
+}
+
+SCENARIO_METHOD(LoopbackSessionFixture, "A session draining its socket on each wakeup.", "[TcpSession]")
+{
+	GIVEN("A session using the drain read engine, allowed two reads per wakeup")
+	{
+		std::vector<std::shared_ptr<Common::MessageBatch>> batches;
+		Common::TcpSessionConfig config;
+		config.readEngine = Common::ReadEngine::Drain;
+		config.maxReadsPerWakeup = 2;
+		Connect(config, [&batches](std::shared_ptr<Common::MessageBatch> batch)
+			{
+				batches.push_back(std::move(batch));
+			});
+
+		WHEN("The peer sends more than the receive ring holds in one go")
+		{
+			std::string stream;
+			for (int i = 0; i < s_messageCount; ++i)
+			{
+				stream += Common::PackageMessage(Common::MessageId::Move,
+					MakeMessage(i) + std::string(100, 'x'));
+			}
+			asio::write(peer, asio::buffer(stream));
+
+			size_t received = 0;
+			PumpUntil([&]()
+				{
+					received = 0;
+					for (const auto& batch : batches)
+					{
+						received += batch->Size();
+					}
+					return received >= s_messageCount;
+				});
+
+			THEN("Every message arrives, in order")
+			{
+				REQUIRE(received == s_messageCount);
+				int i = 0;
+				for (const auto& batch : batches)
+				{
+					for (size_t j = 0; j < batch->Size(); ++j, ++i)
+					{
+						REQUIRE((*batch)[j].messageData == MakeMessage(i) + std::string(100, 'x'));
+					}
+				}
+
+				AND_THEN("Reads are counted, with at least one per wakeup")
+				{
+					Common::TcpSessionStats stats = session->GetStats();
+					REQUIRE(stats.messagesRead == s_messageCount);
+					REQUIRE(stats.bytesRead == stream.size());
+					REQUIRE(stats.readWakeups > 0);
+					REQUIRE(stats.readCalls >= stats.readWakeups);
+				}
+			}
+		}
+
+		WHEN("The peer closes the connection")
+		{
+			peer.close();
+
+			PumpUntil([this]() { return session->IsStopped(); });
+
+			THEN("The session stops")
+			{
+				REQUIRE(session->IsStopped());
+			}
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,90 @@
+//---------------------------------------------------------------
+//
+// TcpSessionTest.h
+//
+
+#pragma once
+
+#include "LoopbackUtils.h"
+#include "common/TcpSession.h"
+
+#include <asio.hpp>
+#include <memory>
+#include <string>
+
+namespace Tests {
+
+//===============================================================================
+
+// Connects a TcpSession to a plain socket over loopback. See PumpUntil.
+struct LoopbackSessionFixture {
+
+	LoopbackSessionFixture()
+		: acceptor(ioc, asio::ip::tcp::endpoint(GetLoopbackAddress(), 0))
+		, peer(ioc)
+	{
+	}
+
+	~LoopbackSessionFixture()
+	{
+		if (session)
+		{
+			session->Stop();
+		}
+		ioc.stop();
+	}
+
+	void Connect(const Common::TcpSessionConfig& config,
+		Common::MessageBatchHandler handler = nullptr)
+	{
+		asio::ip::tcp::socket accepted(ioc);
+		peer.connect(acceptor.local_endpoint());
+		acceptor.accept(accepted);
+
+		session = std::make_shared<Common::TcpSession>(std::move(accepted),
+			MakeLoggingContext("TcpSessionTest"), config);
+		session->SetMessageBatchHandler(std::move(handler));
+		session->Start();
+	}
+
+	// Pumps the io_context until nothing is ready to run.
+	void Pump()
+	{
+		ioc.restart();
+		ioc.poll();
+	}
+
+	template <typename Fn>
+	bool PumpUntil(Fn&& done)
+	{
+		return Tests::PumpUntil(ioc, std::forward<Fn>(done));
+	}
+
+	// Reads exactly size bytes off the peer, pumping the session while waiting.
+	std::string ReadFromPeer(std::size_t size)
+	{
+		std::string data;
+		data.resize(size);
+		std::size_t received = 0;
+		peer.non_blocking(true);
+
+		PumpUntil([this, &data, &received, size]()
+			{
+				std::error_code ec;
+				received += peer.read_some(asio::buffer(&data[received], size - received), ec);
+				return received == size;
+			});
+
+		data.resize(received);
+		return data;
+	}
+
+	asio::io_context ioc;
+	asio::ip::tcp::acceptor acceptor;
+	asio::ip::tcp::socket peer;
+	std::shared_ptr<Common::TcpSession> session;
+};
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,138 @@
+//---------------------------------------------------------------
+//
+// TickSchedulerTest.cpp
+//
+
+#include "TickSchedulerTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace Tests {
+
+//===============================================================================
+
+SCENARIO("Running a fixed rate loop.", "[TickScheduler]")
+{
+	using namespace std::chrono;
+
+	GIVEN("A scheduler ticking at 100Hz")
+	{
+		Common::TickScheduler scheduler(100);
+		REQUIRE(scheduler.GetTickInterval() == milliseconds(10));
+
+		WHEN("It runs for a while")
+		{
+			uint32_t ticks = 0;
+			uint32_t work = 0;
+			auto start = steady_clock::now();
+			scheduler.Run(
+				[&work]() { ++work; },
+				[&]()
+				{
+					if (++ticks == 10)
+					{
+						scheduler.Stop();
+					}
+				});
+			auto elapsed = steady_clock::now() - start;
+
+			THEN("Ticks are spaced out rather than run back to back")
+			{
+				REQUIRE(ticks == 10);
+				REQUIRE(elapsed >= milliseconds(85));
+			}
+			AND_THEN("Nothing woke it between ticks")
+			{
+				REQUIRE(work == 0);
+				REQUIRE(scheduler.GetStats().wakeups == 0);
+			}
+			AND_THEN("Each tick's use of its budget is tracked")
+			{
+				const auto& stats = scheduler.GetStats();
+				REQUIRE(stats.ticks == 10);
+				REQUIRE(stats.overruns == 0);
+				REQUIRE(stats.tickInterval == milliseconds(10));
+				REQUIRE(stats.maxTickTime >= stats.lastTickTime);
+				REQUIRE(stats.AverageBudgetUsed() < 1.0);
+			}
+		}
+		AND_WHEN("Ticks take longer than the interval")
+		{
+			uint32_t ticks = 0;
+			uint32_t overrunCalls = 0;
+			scheduler.Run(
+				[]() {},
+				[&]()
+				{
+					std::this_thread::sleep_for(milliseconds(15));
+					if (++ticks == 3)
+					{
+						scheduler.Stop();
+					}
+				},
+				[&overrunCalls](const Common::TickSchedulerStats&) { ++overrunCalls; });
+
+			THEN("They're counted as overruns")
+			{
+				REQUIRE(scheduler.GetStats().overruns == 3);
+				REQUIRE(overrunCalls == 3);
+				REQUIRE(scheduler.GetStats().AverageBudgetUsed() > 1.0);
+			}
+		}
+	}
+}
+
+SCENARIO("Waking a scheduler between ticks.", "[TickScheduler]")
+{
+	using namespace std::chrono;
+
+	GIVEN("A scheduler ticking once a second")
+	{
+		Common::TickScheduler scheduler(1);
+
+		WHEN("Another thread notifies it while it waits for the next tick")
+		{
+			std::atomic<bool> ticked{ false };
+			uint32_t work = 0;
+			steady_clock::time_point notifiedAt;
+			steady_clock::time_point workedAt;
+
+			std::thread poster([&]()
+				{
+					while (!ticked)
+					{
+						std::this_thread::yield();
+					}
+					std::this_thread::sleep_for(milliseconds(20));
+					notifiedAt = steady_clock::now();
+					scheduler.Notify();
+				});
+
+			scheduler.Run(
+				[&]()
+				{
+					++work;
+					workedAt = steady_clock::now();
+					scheduler.Stop();
+				},
+				[&ticked]() { ticked = true; });
+			poster.join();
+
+			THEN("Work runs straight away instead of waiting for the next tick")
+			{
+				REQUIRE(work == 1);
+				REQUIRE(scheduler.GetStats().wakeups == 1);
+				REQUIRE(scheduler.GetStats().ticks == 1);
+				REQUIRE(workedAt - notifiedAt < milliseconds(500));
+			}
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
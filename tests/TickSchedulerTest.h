@@ -0,0 +1,8 @@
+//---------------------------------------------------------------
+//
+// TickSchedulerTest.h
+//
+
+#pragma once
+
+#include "common/TickScheduler.h"
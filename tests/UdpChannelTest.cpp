@@ -0,0 +1,329 @@
+//---------------------------------------------------------------
+//
+// UdpChannelTest.cpp
+//
+
+#include "UdpChannelTest.h"
+
+#include "Catch2/catch.hpp"
+#include "common/NetworkTypes.h"
+#include "common/TransportRouting.h"
+
+#include <string>
+
+namespace Tests {
+
+namespace {
+	const int s_messageCount = 200;
+
+	Common::SharedBuffer MakeMessage(int i)
+	{
+		return std::make_shared<const std::string>(
+			Common::PackageMessage(Common::MessageId::Move, std::to_string(i)));
+	}
+
+	// Hellos count as datagrams too.
+	const uint64_t s_helloCount = 3;
+} // anon namespace
+
+//===============================================================================
+
+SCENARIO_METHOD(LoopbackUdpFixture, "Sending messages over a UDP channel.", "[UdpChannel]")
+{
+	GIVEN("A client that has said hello with the right token")
+	{
+		Connect();
+		PumpUntilReceived(s_helloCount);
+
+		THEN("The server has learned where the client is")
+		{
+			REQUIRE(server->Send(s_clientId, MakeMessage(0)));
+			REQUIRE(server->GetStats().datagramsRejected == 0);
+		}
+
+		WHEN("The client sends messages")
+		{
+			for (int i = 0; i < s_messageCount; ++i)
+			{
+				REQUIRE(client->Send(s_clientId, MakeMessage(i)));
+			}
+			PumpUntilReceived(s_helloCount + s_messageCount);
+
+			THEN("Each is delivered once, in order, tagged with the client id")
+			{
+				REQUIRE(received.size() == s_messageCount);
+				for (int i = 0; i < s_messageCount; ++i)
+				{
+					REQUIRE(received[i].clientId == s_clientId);
+					REQUIRE(received[i].payload == std::to_string(i));
+				}
+			}
+		}
+
+		WHEN("A message too big for a datagram is sent")
+		{
+			auto message = std::make_shared<const std::string>(
+				Common::UdpChannel::s_maxMessageSize + 1, 'x');
+
+			THEN("It's refused so it can go over TCP instead")
+			{
+				REQUIRE_FALSE(client->Send(s_clientId, message));
+			}
+		}
+	}
+	AND_GIVEN("A client that has the wrong token")
+	{
+		Connect({}, s_token + 1);
+		PumpUntilReceived(s_helloCount);
+
+		THEN("Its datagrams are rejected and the server doesn't learn its address")
+		{
+			REQUIRE(server->GetStats().datagramsRejected == s_helloCount);
+			REQUIRE_FALSE(server->Send(s_clientId, MakeMessage(0)));
+		}
+	}
+}
+
+SCENARIO_METHOD(LoopbackUdpFixture, "Sending over a bad network.", "[UdpChannel]")
+{
+	GIVEN("A client whose datagrams are sometimes lost")
+	{
+		Common::UdpChannelConfig config;
+		config.simulatedLoss = 0.25f;
+		config.simulationSeed = 1;
+		Connect(config);
+
+		WHEN("It sends messages")
+		{
+			for (int i = 0; i < s_messageCount; ++i)
+			{
+				client->Send(s_clientId, MakeMessage(i));
+			}
+
+			uint64_t sent = client->GetStats().datagramsSent;
+			PumpUntilReceived(sent);
+
+			THEN("Some never arrive, and none arrive twice")
+			{
+				REQUIRE(client->GetStats().datagramsSimulatedLost > 0);
+				REQUIRE(received.size() < s_messageCount);
+				for (size_t i = 1; i < received.size(); ++i)
+				{
+					REQUIRE(std::stoi(received[i - 1].payload) < std::stoi(received[i].payload));
+				}
+			}
+		}
+	}
+	AND_GIVEN("A client whose datagrams are sometimes reordered")
+	{
+		Common::UdpChannelConfig config;
+		config.simulatedReorder = 0.25f;
+		config.simulationSeed = 1;
+		Connect(config);
+
+		WHEN("It sends messages")
+		{
+			for (int i = 0; i < s_messageCount; ++i)
+			{
+				client->Send(s_clientId, MakeMessage(i));
+			}
+
+			uint64_t sent = client->GetStats().datagramsSent;
+			PumpUntilReceived(sent);
+
+			THEN("Late datagrams are dropped instead of delivered out of order")
+			{
+				REQUIRE(server->GetStats().datagramsStale > 0);
+				for (size_t i = 1; i < received.size(); ++i)
+				{
+					REQUIRE(std::stoi(received[i - 1].payload) < std::stoi(received[i].payload));
+				}
+			}
+		}
+	}
+	AND_GIVEN("A client that holds back every datagram it can")
+	{
+		Common::UdpChannelConfig config;
+		config.simulatedReorder = 1.0f;
+		Connect(config);
+		PumpUntil([this]() { return server->GetStats().datagramsReceived >= s_helloCount; });
+
+		WHEN("It sends one message and then nothing else")
+		{
+			client->Send(s_clientId, MakeMessage(0));
+			PumpUntil([this]() { return !received.empty(); });
+
+			THEN("The message still arrives, without anything to overtake it")
+			{
+				REQUIRE(received.size() == 1);
+				REQUIRE(received[0].payload == "0");
+			}
+		}
+	}
+}
+
+SCENARIO_METHOD(LoopbackUdpFixture, "Sending reliable messages over a bad network.", "[UdpChannel]")
+{
+	GIVEN("A client and server that both lose datagrams")
+	{
+		Common::UdpChannelConfig config;
+		config.simulatedLoss = 0.2f;
+		config.simulatedReorder = 0.1f;
+		config.updateInterval = std::chrono::milliseconds(2);
+		config.minResendDelay = std::chrono::milliseconds(5);
+		config.simulationSeed = 1;
+		Connect(config, s_token, config);
+
+		// The server learns where the client is from its first datagram that gets through.
+		PumpUntil([this]() { return server->GetStats().datagramsReceived > 0; });
+
+		WHEN("Messages are sent reliably on two streams")
+		{
+			for (int i = 0; i < s_messageCount; ++i)
+			{
+				REQUIRE(client->SendReliable(s_clientId, static_cast<uint8_t>(i % 2), MakeMessage(i))
+					== Common::UdpSendResult::Sent);
+			}
+			PumpUntil([this]() { return received.size() >= s_messageCount; });
+
+			THEN("Every one arrives once, in order within its stream")
+			{
+				REQUIRE(received.size() == s_messageCount);
+
+				int last[2] = { -1, -1 };
+				for (const Received& message : received)
+				{
+					int index = std::stoi(message.payload);
+					REQUIRE(index > last[index % 2]);
+					last[index % 2] = index;
+				}
+			}
+			AND_THEN("Only what was lost was resent")
+			{
+				Common::UdpChannelStats stats = client->GetStats();
+				CAPTURE(stats.reliableMessagesSent, stats.reliableMessagesResent,
+					stats.datagramsSimulatedLost);
+
+				REQUIRE(stats.reliableMessagesResent > 0);
+				REQUIRE(stats.reliableMessagesResent < s_messageCount);
+			}
+		}
+	}
+}
+
+SCENARIO_METHOD(LoopbackUdpFixture, "Overflowing a reliable stream over a bad network.", "[UdpChannel]")
+{
+	GIVEN("A client and server that both lose datagrams")
+	{
+		Common::UdpChannelConfig config;
+		config.simulatedLoss = 0.2f;
+		config.updateInterval = std::chrono::milliseconds(2);
+		config.minResendDelay = std::chrono::milliseconds(5);
+		config.simulationSeed = 2;
+		Connect(config, s_token, config);
+		PumpUntil([this]() { return server->GetStats().datagramsReceived > 0; });
+
+		WHEN("More messages are sent on one stream at once than its window holds")
+		{
+			const int count = static_cast<int>(Common::ReliableEndpoint::s_windowSize) * 3;
+			for (int i = 0; i < count; ++i)
+			{
+				REQUIRE(client->SendReliable(s_clientId, 0, MakeMessage(i))
+					== Common::UdpSendResult::Sent);
+			}
+			PumpUntil([this, count]() { return received.size() >= static_cast<size_t>(count); });
+
+			THEN("None are refused, and every one arrives once, in the order it was sent")
+			{
+				REQUIRE(client->GetStats().reliableMessagesRefused == 0);
+				REQUIRE(received.size() == count);
+				for (int i = 0; i < count; ++i)
+				{
+					REQUIRE(std::stoi(received[i].payload) == i);
+				}
+			}
+		}
+	}
+	AND_GIVEN("A server that hasn't heard from the client yet")
+	{
+		Connect();
+
+		THEN("Unreliable messages are refused in a way that says to send them over TCP")
+		{
+			Common::Route route{ Common::Transport::Udp, 0 };
+			Common::UdpSendResult result = server->Send(s_clientId, route, MakeMessage(0));
+			REQUIRE(result == Common::UdpSendResult::NotConnected);
+			REQUIRE(Common::ShouldFallBackToTcp(route, result));
+		}
+		AND_THEN("Reliable ones never fall back to TCP")
+		{
+			Common::Route route{ Common::Transport::ReliableUdp, 0 };
+			REQUIRE_FALSE(Common::ShouldFallBackToTcp(route, Common::UdpSendResult::NotConnected));
+			REQUIRE_FALSE(Common::ShouldFallBackToTcp(route, Common::UdpSendResult::TooLarge));
+			REQUIRE_FALSE(Common::ShouldFallBackToTcp(route, Common::UdpSendResult::StreamFull));
+		}
+
+		WHEN("Reliable messages are sent to it")
+		{
+			Common::Route route{ Common::Transport::ReliableUdp, 0 };
+			REQUIRE(server->Send(s_clientId, route, MakeMessage(0)) == Common::UdpSendResult::Sent);
+			REQUIRE(server->Send(s_clientId, route, MakeMessage(1)) == Common::UdpSendResult::Sent);
+			uint64_t sentBeforeHello = server->GetStats().reliableMessagesSent;
+			PumpUntil([this]() { return client->GetStats().messagesReceived >= 2; });
+
+			THEN("They're held until its hello, then delivered")
+			{
+				REQUIRE(sentBeforeHello == 0);
+				REQUIRE(client->GetStats().messagesReceived == 2);
+			}
+		}
+		AND_WHEN("A reliable message is too big for a datagram")
+		{
+			Common::Route route{ Common::Transport::ReliableUdp, 0 };
+			auto message = std::make_shared<const std::string>(Common::PackageMessage(
+				Common::MessageId::Move, std::string(Common::UdpChannel::s_maxReliableMessageSize, 'x')));
+
+			THEN("It's refused, and not to be sent over TCP either")
+			{
+				Common::UdpSendResult result = server->Send(s_clientId, route, message);
+				REQUIRE(result == Common::UdpSendResult::TooLarge);
+				REQUIRE_FALSE(Common::ShouldFallBackToTcp(route, result));
+			}
+		}
+	}
+}
+
+SCENARIO("Routing messages by type.", "[UdpChannel]")
+{
+	GIVEN("The default routing")
+	{
+		Common::TransportRouting routing;
+
+		THEN("Moves go over UDP and everything else over TCP")
+		{
+			REQUIRE(routing.GetTransport(Common::MessageId::Move) == Common::Transport::Udp);
+			REQUIRE(routing.GetTransport(Common::MessageId::UdpHandshake) == Common::Transport::Tcp);
+			REQUIRE(routing.GetTransport(*MakeMessage(0)) == Common::Transport::Udp);
+		}
+		AND_THEN("Something that isn't a whole header goes over TCP")
+		{
+			REQUIRE(routing.GetTransport(std::string_view("ab")) == Common::Transport::Tcp);
+		}
+
+		WHEN("A type is rerouted")
+		{
+			routing.SetTransport(Common::MessageId::Move, Common::Transport::ReliableUdp, 2);
+
+			THEN("It goes the new way, on its stream")
+			{
+				Common::Route route = routing.GetRoute(Common::MessageId::Move);
+				REQUIRE(route.transport == Common::Transport::ReliableUdp);
+				REQUIRE(route.stream == 2);
+			}
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
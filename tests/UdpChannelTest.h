@@ -0,0 +1,93 @@
+//---------------------------------------------------------------
+//
+// UdpChannelTest.h
+//
+
+#pragma once
+
+#include "LoopbackUtils.h"
+#include "common/UdpChannel.h"
+
+#include <asio.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Tests {
+
+//===============================================================================
+
+// A server and a client channel talking over loopback. See PumpUntil.
+struct LoopbackUdpFixture {
+
+	struct Received
+	{
+		uint32_t clientId = 0;
+		std::string payload;
+	};
+
+	static constexpr uint32_t s_clientId = 7;
+	static constexpr uint32_t s_token = 0xC0FFEE;
+
+	~LoopbackUdpFixture()
+	{
+		if (server)
+		{
+			server->Stop();
+			client->Stop();
+		}
+		ioc.stop();
+	}
+
+	// The client does the sending, so its config is the one that matters for simulated loss.
+	// The server's only sends acks.
+	void Connect(const Common::UdpChannelConfig& clientConfig = {}, uint32_t clientToken = s_token,
+		const Common::UdpChannelConfig& serverConfig = {})
+	{
+		server = std::make_shared<Common::UdpChannel>(OpenSocket(),
+			MakeLoggingContext("UdpChannelTest"), serverConfig);
+		client = std::make_shared<Common::UdpChannel>(OpenSocket(),
+			MakeLoggingContext("UdpChannelTest"), clientConfig);
+
+		server->SetMessageBatchHandler(
+			[this](uint32_t clientId, std::shared_ptr<Common::MessageBatch> batch)
+			{
+				for (size_t i = 0; i < batch->Size(); ++i)
+				{
+					received.push_back({ clientId, std::string((*batch)[i].messageData) });
+				}
+			});
+		server->AddPeer(s_clientId, s_token);
+		server->Start();
+		client->Start();
+
+		asio::ip::udp::endpoint serverEndpoint(GetLoopbackAddress(), server->GetLocalPort());
+		client->Connect(serverEndpoint, s_clientId, clientToken);
+	}
+
+	asio::ip::udp::socket OpenSocket()
+	{
+		return asio::ip::udp::socket(ioc, asio::ip::udp::endpoint(GetLoopbackAddress(), 0));
+	}
+
+	template <typename Fn>
+	bool PumpUntil(Fn&& done)
+	{
+		return Tests::PumpUntil(ioc, std::forward<Fn>(done));
+	}
+
+	// Pumps the io_context until the server has had count datagrams in total, or a timeout.
+	void PumpUntilReceived(uint64_t count)
+	{
+		PumpUntil([this, count]() { return server->GetStats().datagramsReceived >= count; });
+	}
+
+	asio::io_context ioc;
+	std::shared_ptr<Common::UdpChannel> server;
+	std::shared_ptr<Common::UdpChannel> client;
+	std::vector<Received> received;
+};
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,125 @@
+//---------------------------------------------------------------
+//
+// WireFormatBenchmark.cpp
+//
+
+#include "BenchmarkUtils.h"
+#include "WireFormatTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Tests {
+
+namespace {
+	const uint32_t s_streamSize = 32768;
+	const uint32_t s_iterations = 2000;
+
+	// About what a Move carries: an entity id and a packed position and direction.
+	const std::string s_movePayload(12, 'm');
+
+	struct Format
+	{
+		const char* name;
+		Common::WireFormat wireFormat;
+		uint32_t flags;
+	};
+
+	std::string Frame(const Format& format, const std::string& payload)
+	{
+		return format.wireFormat == Common::WireFormat::Legacy
+			? Common::PackageMessage(Common::MessageId::Move, payload)
+			: Common::PackageCompactMessage(Common::MessageId::Move, payload, format.flags);
+	}
+} // anon namespace
+
+//===============================================================================
+
+TEST_CASE("Wire format throughput, legacy vs compact headers.", "[.][Benchmark][WireFormat]")
+{
+	const std::vector<Format> formats = {
+		{ "Legacy", Common::WireFormat::Legacy, Common::CompactFrameNone },
+		{ "Compact", Common::WireFormat::Compact, Common::CompactFrameNone },
+		{ "Compact with checksums", Common::WireFormat::Compact, Common::CompactFrameChecksum } };
+
+	for (const Format& format : formats)
+	{
+		// A read's worth of back to back Moves.
+		const std::string frame = Frame(format, s_movePayload);
+		const uint32_t messagesPerRead = s_streamSize / static_cast<uint32_t>(frame.size());
+		std::string stream;
+		for (uint32_t i = 0; i < messagesPerRead; ++i)
+		{
+			stream += frame;
+		}
+		WARN(format.name << ": " << frame.size() << " bytes per Move, "
+			<< frame.size() - s_movePayload.size() << " of them header");
+
+		// What TcpSession does per frame when it writes.
+		std::string legacy = Common::PackageMessage(Common::MessageId::Move, s_movePayload);
+		std::string encoded;
+		encoded.reserve(s_streamSize + Common::s_maxCompactHeaderSize);
+		MeasureThroughput(std::string(format.name) + " encode", "messages", messagesPerRead,
+			s_iterations, [&]()
+			{
+				encoded.clear();
+				for (uint32_t i = 0; i < messagesPerRead; ++i)
+				{
+					if (format.wireFormat == Common::WireFormat::Legacy)
+					{
+						encoded.append(legacy);
+						continue;
+					}
+
+					char header[Common::s_maxCompactHeaderSize];
+					std::string_view payload(legacy.data() + sizeof(Common::MessageHeader),
+						s_movePayload.size());
+					uint32_t checksum = (format.flags & Common::CompactFrameChecksum)
+						? Common::Crc32(payload) : 0;
+					uint32_t size = Common::EncodeCompactHeader(Common::MessageId::Move,
+						static_cast<uint32_t>(payload.size()), format.flags, checksum, header);
+					encoded.append(header, size);
+					encoded.append(payload);
+				}
+			});
+		REQUIRE(encoded == stream);
+
+		Common::NetworkMessageParser parser;
+		parser.SetWireFormat(format.wireFormat);
+		Common::ReceiveRing ring(s_streamSize);
+		if (format.wireFormat == Common::WireFormat::Compact)
+		{
+			std::memcpy(ring.WriteData(), Common::s_wirePreamble, Common::s_wirePreambleSize);
+			ring.CommitWrite(Common::s_wirePreambleSize);
+		}
+
+		std::vector<Common::NetworkMessageView> views;
+		views.reserve(messagesPerRead);
+		MeasureThroughput(std::string(format.name) + " decode", "messages", messagesPerRead,
+			s_iterations, [&]()
+			{
+				// Stand in for the socket read landing in the ring, which may wrap its end.
+				std::string_view remaining = stream;
+				while (!remaining.empty())
+				{
+					uint32_t size = std::min<uint32_t>(ring.WriteSize(),
+						static_cast<uint32_t>(remaining.size()));
+					std::memcpy(ring.WriteData(), remaining.data(), size);
+					ring.CommitWrite(size);
+					remaining.remove_prefix(size);
+				}
+
+				views.clear();
+				parser.ExtractMessages(ring, views);
+			});
+		REQUIRE(views.size() == messagesPerRead);
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
@@ -0,0 +1,213 @@
+//---------------------------------------------------------------
+//
+// WireFormatTest.cpp
+//
+
+#include "WireFormatTest.h"
+
+#include "Catch2/catch.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Tests {
+
+namespace {
+	std::string Preamble()
+	{
+		return std::string(Common::s_wirePreamble, Common::s_wirePreambleSize);
+	}
+} // anon namespace
+
+//===============================================================================
+
+SCENARIO("Encoding varints.", "[WireFormat]")
+{
+	GIVEN("Values either side of each byte boundary")
+	{
+		const std::vector<std::pair<uint32_t, int32_t>> values = {
+			{ 0, 1 }, { 127, 1 }, { 128, 2 }, { 16383, 2 }, { 16384, 3 },
+			{ 2097151, 3 }, { 2097152, 4 }, { 268435455, 4 }, { 268435456, 5 },
+			{ UINT32_MAX, 5 } };
+
+		THEN("Each takes as few bytes as it needs and reads back the same")
+		{
+			for (const auto& value : values)
+			{
+				char buffer[5];
+				REQUIRE(Common::WriteVarint(value.first, buffer) == static_cast<uint32_t>(value.second));
+
+				uint32_t read = 0;
+				REQUIRE(Common::ReadVarint(buffer, sizeof(buffer), read) == value.second);
+				REQUIRE(read == value.first);
+
+				AND_THEN("It's partial until the last byte is there")
+				{
+					REQUIRE(Common::ReadVarint(buffer, value.second - 1, read) == 0);
+				}
+			}
+		}
+	}
+
+	GIVEN("A varint that runs past what a uint32_t can hold")
+	{
+		const char tooLong[] = { '\xFF', '\xFF', '\xFF', '\xFF', '\x7F' };
+		const char endless[] = { '\xFF', '\xFF', '\xFF', '\xFF', '\xFF', '\x01' };
+
+		THEN("It's malformed")
+		{
+			uint32_t value = 0;
+			REQUIRE(Common::ReadVarint(tooLong, sizeof(tooLong), value) == -1);
+			REQUIRE(Common::ReadVarint(endless, sizeof(endless), value) == -1);
+		}
+	}
+}
+
+SCENARIO("Encoding compact frame headers.", "[WireFormat]")
+{
+	GIVEN("A small Move")
+	{
+		std::string frame = Common::PackageCompactMessage(Common::MessageId::Move, "12345678");
+
+		THEN("The header is 2 bytes")
+		{
+			REQUIRE(frame.size() == 2 + 8);
+
+			Common::CompactFrameHeader header;
+			REQUIRE(Common::DecodeCompactHeader(frame.data(), frame.size(), header)
+				== Common::WireDecodeResult::Complete);
+			REQUIRE(header.messageType == Common::MessageId::Move);
+			REQUIRE(header.messageLength == 8);
+			REQUIRE(header.flags == Common::CompactFrameNone);
+			REQUIRE(header.size == 2);
+		}
+	}
+
+	GIVEN("A frame with a checksum")
+	{
+		std::string payload = "checked";
+		std::string frame = Common::PackageCompactMessage(Common::MessageId::Attack, payload,
+			Common::CompactFrameChecksum);
+
+		THEN("The checksum follows the length in little endian order")
+		{
+			Common::CompactFrameHeader header;
+			REQUIRE(Common::DecodeCompactHeader(frame.data(), frame.size(), header)
+				== Common::WireDecodeResult::Complete);
+			REQUIRE(header.flags == Common::CompactFrameChecksum);
+			REQUIRE(header.size == 6);
+			REQUIRE(header.checksum == Common::Crc32(payload));
+			REQUIRE(static_cast<uint8_t>(frame[2]) == (header.checksum & 0xFF));
+		}
+
+		THEN("It's partial until the whole checksum is there")
+		{
+			Common::CompactFrameHeader header;
+			REQUIRE(Common::DecodeCompactHeader(frame.data(), 5, header)
+				== Common::WireDecodeResult::Partial);
+		}
+	}
+
+	GIVEN("The standard CRC-32 check value")
+	{
+		THEN("It matches")
+		{
+			REQUIRE(Common::Crc32("123456789") == 0xCBF43926);
+		}
+	}
+}
+
+SCENARIO("Parsing a compact stream.", "[WireFormat]")
+{
+	Common::NetworkMessageParser parser;
+	parser.SetWireFormat(Common::WireFormat::Compact);
+
+	// Small enough that frames wrap the end of it and big ones spill.
+	Common::ReceiveRing ring(64);
+
+	GIVEN("A stream of frames of every size, some with checksums")
+	{
+		std::string stream = Preamble();
+		std::vector<std::string> payloads;
+		for (uint32_t i = 0; i < 40; ++i)
+		{
+			payloads.push_back(std::string(i * 7 % 150, static_cast<char>('a' + i % 26)));
+			uint32_t flags = i % 3 == 0 ? Common::CompactFrameChecksum : Common::CompactFrameNone;
+			stream += Common::PackageCompactMessage(Common::MessageId::TestMessage, payloads.back(),
+				flags);
+		}
+
+		WHEN("It arrives a free region at a time")
+		{
+			std::vector<Common::NetworkMessage> messages;
+			bool isValid = ParseThroughRing(parser, ring, stream, messages);
+
+			THEN("Every frame comes out whole and in order")
+			{
+				REQUIRE(isValid);
+				REQUIRE(messages.size() == payloads.size());
+				for (size_t i = 0; i < messages.size(); ++i)
+				{
+					REQUIRE(messages[i].header.messageType == Common::MessageId::TestMessage);
+					REQUIRE(messages[i].header.messageLength == payloads[i].size());
+					REQUIRE(messages[i].messageData == payloads[i]);
+				}
+			}
+		}
+	}
+
+	GIVEN("A stream with the wrong preamble")
+	{
+		std::string stream = Common::PackageMessage(Common::MessageId::Move, "legacy");
+
+		THEN("The parser gives up on it")
+		{
+			std::vector<Common::NetworkMessage> messages;
+			REQUIRE(!ParseThroughRing(parser, ring, stream, messages));
+		}
+	}
+
+	GIVEN("A frame whose payload doesn't match its checksum")
+	{
+		std::string frame = Common::PackageCompactMessage(Common::MessageId::Move, "payload",
+			Common::CompactFrameChecksum);
+		frame.back() ^= 1;
+
+		THEN("The parser gives up on it")
+		{
+			std::vector<Common::NetworkMessage> messages;
+			REQUIRE(!ParseThroughRing(parser, ring, Preamble() + frame, messages));
+			REQUIRE(messages.empty());
+		}
+	}
+
+	GIVEN("A frame flagged compressed that doesn't inflate")
+	{
+		std::string frame = Common::PackageCompactMessage(Common::MessageId::Move, "payload",
+			Common::CompactFrameCompressed);
+
+		THEN("The parser gives up on it")
+		{
+			std::vector<Common::NetworkMessage> messages;
+			REQUIRE(!ParseThroughRing(parser, ring, Preamble() + frame, messages));
+		}
+	}
+
+	GIVEN("A frame over the size limit")
+	{
+		parser.SetMaxFrameSize(16);
+		std::string frame = Common::PackageCompactMessage(Common::MessageId::Move,
+			std::string(17, 'x'));
+
+		THEN("The parser gives up on it")
+		{
+			std::vector<Common::NetworkMessage> messages;
+			REQUIRE(!ParseThroughRing(parser, ring, Preamble() + frame, messages));
+		}
+	}
+}
+
+//===============================================================================
+
+} // namespace Tests
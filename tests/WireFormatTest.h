@@ -0,0 +1,56 @@
+//---------------------------------------------------------------
+//
+// WireFormatTest.h
+//
+
+#pragma once
+
+#include "common/NetworkMessageParser.h"
+#include "common/NetworkTypes.h"
+#include "common/ReceiveRing.h"
+#include "common/WireFormat.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Tests {
+
+//===============================================================================
+
+// Feeds data through the ring a free region at a time, the way socket reads would. Payloads
+// are copied out since views don't survive the next write. Returns false if the parser gave up
+// on the stream.
+inline bool ParseThroughRing(Common::NetworkMessageParser& parser, Common::ReceiveRing& ring,
+	const std::string& data, std::vector<Common::NetworkMessage>& messages)
+{
+	std::vector<Common::NetworkMessageView> views;
+	size_t written = 0;
+	while (written < data.size())
+	{
+		uint32_t size = std::min<uint32_t>(ring.WriteSize(),
+			static_cast<uint32_t>(data.size() - written));
+		std::memcpy(ring.WriteData(), data.data() + written, size);
+		ring.CommitWrite(size);
+		written += size;
+
+		views.clear();
+		if (!parser.ExtractMessages(ring, views))
+		{
+			return false;
+		}
+
+		for (const auto& view : views)
+		{
+			Common::NetworkMessage message(view.header);
+			message.messageData.assign(view.messageData.data(), view.messageData.size());
+			messages.push_back(std::move(message));
+		}
+	}
+	return true;
+}
+
+//===============================================================================
+
+} // namespace Tests